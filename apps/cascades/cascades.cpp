@@ -22,12 +22,17 @@
 
 
 #include <graphlab.hpp>
+#include <graphlab/util/bit_lanes.hpp>
 #include <math.h>
 #include <cstdlib>
 #include <ctime>
+#include <vector>
+#include <numeric>
+#include <algorithm>
 
 double infection_chance;
 double recovery_chance;
+uint64_t seed;
 
 enum Status {INFECTED, SUSCEPTIBLE, RECOVERED};
 
@@ -61,6 +66,16 @@ typedef infected_status gather_type;
 // The graph type is determined by the vertex and edge data types
 typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
 
+Status parse_status(char label) {
+  if (label == 'S') {
+    return SUSCEPTIBLE;
+  } else if (label == 'I') {
+    return INFECTED;
+  } else {
+    return RECOVERED;
+  }
+}
+
 bool line_parser(graph_type& graph, const std::string& filename, const std::string& textline) {
   std::stringstream strm(textline);
   graphlab::vertex_id_type vid;
@@ -72,14 +87,7 @@ bool line_parser(graph_type& graph, const std::string& filename, const std::stri
   // next entry is their status (S, I, or R)
   strm >> label;
 
-  vertex_data_type statusLabel;
-  if (label == 'S') {
-    statusLabel = SUSCEPTIBLE;
-  } else if (label == 'I') {
-    statusLabel = INFECTED;
-  } else {
-    statusLabel = RECOVERED;
-  }
+  vertex_data_type statusLabel = parse_status(label);
 
   
   // insert this vertex with its label 
@@ -184,6 +192,199 @@ struct cascades_writer{
   std::string save_edge (graph_type::edge_type e) { return ""; }
 };
 
+/**
+ * Bit-parallel mode: runs 64 * NWords independent simulations at once.
+ * Each vertex holds one bit per simulation for the infected and the
+ * recovered states, and every step of all simulations is a handful of
+ * bitwise operations on the lanes. Draws come from counter_rng streams
+ * keyed by the edge or vertex and the step count, so a run is
+ * reproducible for a given --seed on any engine.
+ */
+template <size_t NWords>
+struct multi_status: public graphlab::IS_POD_TYPE {
+  typedef graphlab::bit_lanes<NWords> lanes_type;
+  lanes_type infected;
+  lanes_type recovered;
+  // number of times apply ran; keys the random streams
+  uint32_t nsteps;
+
+  multi_status(): nsteps(0) { }
+  explicit multi_status(Status status): nsteps(0) {
+    infected.fill(status == INFECTED);
+    recovered.fill(status == RECOVERED);
+  }
+
+  lanes_type susceptible() const { return ~(infected | recovered); }
+};
+
+template <size_t NWords>
+struct multi_cascades_types {
+  typedef multi_status<NWords> vertex_data_type;
+  typedef typename vertex_data_type::lanes_type gather_type;
+  typedef graphlab::distributed_graph<vertex_data_type, graphlab::empty> graph_type;
+};
+
+template <size_t NWords>
+bool multi_line_parser(typename multi_cascades_types<NWords>::graph_type& graph,
+                       const std::string& filename, const std::string& textline) {
+  typedef typename multi_cascades_types<NWords>::vertex_data_type vdata;
+  std::stringstream strm(textline);
+  graphlab::vertex_id_type vid;
+  char label;
+  strm >> vid >> label;
+  graph.add_vertex(vid, vdata(parse_status(label)));
+  while(1) {
+    graphlab::vertex_id_type other_vid;
+    strm >> other_vid;
+    if (strm.fail()) {
+      break;
+    }
+    graph.add_edge(vid, other_vid);
+  }
+  return true;
+}
+
+template <size_t NWords>
+class multi_cascades:
+  public graphlab::ivertex_program<typename multi_cascades_types<NWords>::graph_type,
+                                   typename multi_cascades_types<NWords>::gather_type>,
+  public graphlab::IS_POD_TYPE {
+  typedef multi_cascades_types<NWords> types;
+  typedef typename types::gather_type lanes_type;
+  typedef graphlab::ivertex_program<typename types::graph_type, lanes_type> base;
+
+  public:
+    typedef typename base::icontext_type icontext_type;
+    typedef typename base::vertex_type vertex_type;
+    typedef typename base::edge_type edge_type;
+    typedef typename base::edge_dir_type edge_dir_type;
+
+    edge_dir_type gather_edges(icontext_type& context, const vertex_type& vertex) const {
+      // only the susceptible lanes can change by gathering
+      return vertex.data().susceptible().any() ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+    }
+
+    lanes_type gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      const vertex_type other = (vertex.id() == edge.source().id()) ?
+        edge.target() : edge.source();
+      lanes_type contact = other.data().infected;
+      if (contact.none()) return contact;
+      // one transmission attempt per lane in which the neighbor is infected
+      graphlab::random::counter_rng rng(seed, vertex.id(), other.id(),
+                                        2 * uint64_t(vertex.data().nsteps));
+      return contact &= lanes_type::bernoulli(rng, infection_chance);
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex, const lanes_type& total) {
+      typename types::vertex_data_type& data = vertex.data();
+      const lanes_type susceptible = data.susceptible();
+      if (data.infected.any()) {
+        graphlab::random::counter_rng rng(seed, vertex.id(),
+                                          2 * uint64_t(data.nsteps) + 1);
+        const lanes_type recovering = data.infected &
+          lanes_type::bernoulli(rng, recovery_chance);
+        data.recovered |= recovering;
+        data.infected.andnot(recovering);
+      }
+      data.infected |= total & susceptible;
+      ++data.nsteps;
+      if (data.infected.any()) {
+        context.signal(vertex);
+      }
+    }
+
+    edge_dir_type scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+      return vertex.data().infected.any() ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+      const vertex_type other = (vertex.id() == edge.source().id()) ?
+        edge.target() : edge.source();
+      // wake the neighbor only if it can still be infected in a lane
+      // in which this vertex is infected
+      if ((vertex.data().infected & other.data().susceptible()).any()) {
+        context.signal(other);
+      }
+    }
+  };
+
+/**
+ * Saves, for every vertex, the fraction of simulations in which it was
+ * ever infected.
+ */
+template <size_t NWords>
+struct multi_cascades_writer {
+  typedef typename multi_cascades_types<NWords>::graph_type graph_type;
+  std::string save_vertex(typename graph_type::vertex_type v) {
+    std::stringstream strm;
+    const size_t reached = (v.data().infected | v.data().recovered).count();
+    strm << v.id() << "\t" << double(reached) / (64 * NWords) << "\n";
+    return strm.str();
+  }
+  std::string save_edge(typename graph_type::edge_type e) { return ""; }
+};
+
+/// Per simulation number of vertices ever infected
+template <size_t NWords>
+struct lane_counts {
+  std::vector<size_t> counts;
+  lane_counts(): counts(64 * NWords, 0) { }
+  lane_counts& operator+=(const lane_counts& other) {
+    for (size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const { oarc << counts; }
+  void load(graphlab::iarchive& iarc) { iarc >> counts; }
+};
+
+template <size_t NWords>
+lane_counts<NWords> count_reached(const typename multi_cascades_types<NWords>::graph_type::vertex_type& v) {
+  lane_counts<NWords> ret;
+  const graphlab::bit_lanes<NWords> reached = v.data().infected | v.data().recovered;
+  for (size_t i = 0; i < ret.counts.size(); ++i) ret.counts[i] = reached.get(i);
+  return ret;
+}
+
+template <size_t NWords>
+int run_multi_cascades(graphlab::distributed_control& dc,
+                       graphlab::command_line_options& clopts,
+                       const std::string& graph_dir,
+                       const std::string& execution_type,
+                       const std::string& saveprefix) {
+  typedef typename multi_cascades_types<NWords>::graph_type mgraph_type;
+  mgraph_type graph(dc);
+  dc.cout() << "Loading graph using line parser" << std::endl;
+  graph.load(graph_dir, multi_line_parser<NWords>);
+  graph.finalize();
+
+  dc.cout() << "#vertices: " << graph.num_vertices() << " #edges:" << graph.num_edges() << std::endl;
+  dc.cout() << "Running " << 64 * NWords << " simulations in parallel" << std::endl;
+
+  graphlab::omni_engine<multi_cascades<NWords> > engine(dc, graph, execution_type, clopts);
+  engine.signal_all();
+  engine.start();
+
+  const float runtime = engine.elapsed_seconds();
+  dc.cout() << "Finished Running engine in " << runtime << " seconds." << std::endl;
+
+  const std::vector<size_t> reached =
+    graph.template map_reduce_vertices<lane_counts<NWords> >(count_reached<NWords>).counts;
+  const size_t total = std::accumulate(reached.begin(), reached.end(), size_t(0));
+  dc.cout() << "Vertices ever infected: mean "
+            << double(total) / reached.size()
+            << " min " << *std::min_element(reached.begin(), reached.end())
+            << " max " << *std::max_element(reached.begin(), reached.end())
+            << std::endl;
+
+  if (saveprefix != "") {
+    graph.save(saveprefix, multi_cascades_writer<NWords>(),
+       false,  // do not gzip
+       true,   //save vertices
+       false); // do not save edges
+  }
+  return EXIT_SUCCESS;
+}
+
 
 int main(int argc, char** argv) {
   srand((unsigned) time(0));
@@ -199,6 +400,8 @@ int main(int argc, char** argv) {
   double recovery = -1;
   double infection = -1;
   size_t iterations = -1;
+  size_t simulations = 1;
+  seed = time(0);
 
   clopts.attach_option("graph", graph_dir, "The graph file. Required ");
   clopts.add_positional("graph");
@@ -212,6 +415,9 @@ int main(int argc, char** argv) {
   clopts.attach_option("recovery chance", recovery, "Chance of recovery for an infected individual at each step. Required.");
   clopts.attach_option("infection chance", infection, "Chance of infection for a susceptible individual per person at each step. Required.");
 
+  clopts.attach_option("simulations", simulations, "Number of independent simulations to run at once: 1, 64 or 256. With 64 or 256, each vertex keeps one bit per simulation and saveprefix stores the fraction of simulations in which the vertex was infected.");
+  clopts.attach_option("seed", seed, "Random seed of the bit-parallel simulations. Defaults to the current time.");
+
   clopts.attach_option("iterations", iterations, "If set, will force the use of synchronous engine overriding any engine option set by the --engine parameter. Runs cascades for a fixed number of iterations. Also overrides the max_iterations option in the engine.");
 
   if(!clopts.parse(argc, argv)) {
@@ -243,6 +449,19 @@ int main(int argc, char** argv) {
     clopts.get_engine_args().set_option("type", "synchronous");
     clopts.get_engine_args().set_option("max_iterations", iterations);
   }
+
+  if (simulations != 1) {
+    int ret = EXIT_FAILURE;
+    if (simulations == 64) {
+      ret = run_multi_cascades<1>(dc, clopts, graph_dir, execution_type, saveprefix);
+    } else if (simulations == 256) {
+      ret = run_multi_cascades<4>(dc, clopts, graph_dir, execution_type, saveprefix);
+    } else {
+      dc.cout() << "--simulations must be 1, 64 or 256. Cannot continue";
+    }
+    graphlab::mpi_tools::finalize();
+    return ret;
+  }
  
   // Build the graph ----------------------------------------------------------
   graph_type graph(dc);
@@ -37,10 +37,12 @@
 #include <graphlab/vertex_program/context.hpp>
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/engine_handoff.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/engine/distributed_chandy_misra.hpp>
 #include <graphlab/engine/message_array.hpp>
+#include <graphlab/engine/snapshot_io.hpp>
 
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
@@ -48,6 +50,7 @@
 #include <graphlab/rpc/distributed_event_log.hpp>
 #include <graphlab/parallel/fiber_group.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/parallel/lock_table.hpp>
 #include <graphlab/rpc/fiber_async_consensus.hpp>
 #include <graphlab/aggregation/distributed_aggregator.hpp>
 #include <graphlab/parallel/fiber_remote_request.hpp>
@@ -200,6 +203,30 @@ namespace graphlab {
    * increases in throughput at a consistency penalty.
    * \li \b nfibers (default: 10000) Number of fibers to use
    * \li \b stacksize (default: 16384) Stacksize of each fiber.
+   * \li \b snapshot_interval (default: -1) If set to a positive value,
+   * a snapshot is taken approximately every this number of seconds.
+   * To obtain a consistent snapshot the engine stops issuing new tasks,
+   * waits for all running tasks and messages in flight to complete,
+   * saves the graph and the pending messages, and then continues.
+   * The snapshot can be restored with
+   * \ref graphlab::async_consistent_engine::load_snapshot.
+   * \li \b snapshot_path The path including folder and file prefix in
+   * which the snapshots should be saved. Must be set if
+   * snapshot_interval is set.
+   * \li \b snapshot_full_interval (default: 8) Only every this number
+   * of snapshots contains a complete copy of the graph.  The snapshots
+   * in between only contain the vertex data pages which were modified
+   * since the previous snapshot.
+   * \li \b snapshot_async (default: true) If set, snapshots are
+   * compressed and written to disk in a background thread while the
+   * engine continues execution.
+   * \li \b snapshot_edges (default: true) If set to false, the edge
+   * data is assumed to be constant and is only written in the complete
+   * snapshots.
+   * \li \b lock_table (default: vertex) The representation of the per
+   * vertex data locks: "vertex" (one lock per vertex) or "bit" (one
+   * bit per vertex). Striped locks are not supported since locks are
+   * held across calls into the vertex program.
    */
   template<typename VertexProgram>
   class async_consistent_engine: public iengine<VertexProgram> {
@@ -329,7 +356,10 @@ namespace graphlab {
     distributed_chandy_misra<graph_type>* cmlocks;
 
     /// Per vertex data locks
-    std::vector<simple_spinlock> vertexlocks;
+    lock_table vertexlocks;
+
+    /// The representation of the per vertex data locks
+    lock_table::lock_mode vertexlock_mode;
 
     /// Total update function completion time
     std::vector<double> total_completion_time;
@@ -414,8 +444,51 @@ namespace graphlab {
 
     std::vector<mutex> aggregation_lock;
     std::vector<std::deque<std::string> > aggregation_queue;
+
+    /// Seconds between snapshots. Snapshots are disabled if <= 0
+    float snapshot_interval;
+
+    /// The file prefix of the snapshots
+    std::string snapshot_path;
+
+    /// Time the last snapshot was requested
+    float last_snapshot_time;
+
+    /**
+     * Set on all machines when a snapshot is requested. While set, no
+     * new tasks are started and the engine threads exit once all
+     * machines are quiescent.
+     */
+    bool snapshot_requested;
+
+    /// Tracks modified vertex pages and writes the snapshots
+    snapshot_manager<graph_type> snapshots;
+
+    /**
+     * If positive, start() yields once more than this fraction of the
+     * vertices have pending messages. See set_yield_threshold().
+     */
+    double yield_fraction;
+
+    /// Seconds between checks of the yield threshold
+    float yield_check_interval;
+
+    /// Time the last check of the yield threshold was requested
+    float last_activity_check_time;
+
+    /**
+     * Set on all machines when the yield threshold is checked. Stops
+     * the engine threads like snapshot_requested.
+     */
+    bool activity_check_requested;
   public:
 
+    /**
+     * The pending messages and gather caches moved between engines by
+     * export_state() and import_state().
+     */
+    typedef engine_handoff<message_type, gather_type> handoff_type;
+
     /**
      * Constructs an asynchronous consistent distributed engine.
      * The number of threads to create are read from
@@ -440,7 +513,11 @@ namespace graphlab {
                             const graphlab_options& opts = graphlab_options()) :
         rmi(dc, this), graph(graph), scheduler_ptr(NULL),
         aggregator(dc, graph, new context_type(*this, graph)), started(false),
-        engine_start_time(timer::approx_time_seconds()), force_stop(false) {
+        engine_start_time(timer::approx_time_seconds()), force_stop(false),
+        snapshot_interval(-1), last_snapshot_time(0),
+        snapshot_requested(false), yield_fraction(0),
+        yield_check_interval(1), last_activity_check_time(0),
+        activity_check_requested(false) {
       rmi.barrier();
 
       nfibers = 10000;
@@ -448,6 +525,7 @@ namespace graphlab {
       use_cache = false;
       factorized_consistency = true;
       track_task_time = false;
+      vertexlock_mode = lock_table::VERTEX_LOCKS;
       timed_termination = (size_t)(-1);
       termination_reason = execution_status::UNSET;
       set_options(opts);
@@ -500,10 +578,45 @@ namespace graphlab {
           opts.get_engine_args().get_option("use_cache", use_cache);
           if (rmi.procid() == 0)
             logstream(LOG_EMPH) << "Engine Option: use_cache = " << use_cache << std::endl;
+        } else if (opt == "snapshot_interval") {
+          opts.get_engine_args().get_option("snapshot_interval", snapshot_interval);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: snapshot_interval = " << snapshot_interval << std::endl;
+        } else if (opt == "snapshot_path") {
+          opts.get_engine_args().get_option("snapshot_path", snapshot_path);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: snapshot_path = " << snapshot_path << std::endl;
+        } else if (opt == "snapshot_full_interval") {
+          opts.get_engine_args().get_option("snapshot_full_interval", snapshots.full_interval);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: snapshot_full_interval = " << snapshots.full_interval << std::endl;
+        } else if (opt == "snapshot_async") {
+          opts.get_engine_args().get_option("snapshot_async", snapshots.background);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: snapshot_async = " << snapshots.background << std::endl;
+        } else if (opt == "snapshot_edges") {
+          opts.get_engine_args().get_option("snapshot_edges", snapshots.save_edges);
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: snapshot_edges = " << snapshots.save_edges << std::endl;
+        } else if (opt == "lock_table") {
+          std::string mode_name;
+          opts.get_engine_args().get_option("lock_table", mode_name);
+          if (!lock_table::parse_mode(mode_name, vertexlock_mode) ||
+              (vertexlock_mode != lock_table::VERTEX_LOCKS &&
+               vertexlock_mode != lock_table::BIT_LOCKS)) {
+            logstream(LOG_FATAL) << "Unsupported lock_table " << mode_name
+                                 << ". Expected vertex or bit" << std::endl;
+          }
+          if (rmi.procid() == 0)
+            logstream(LOG_EMPH) << "Engine Option: lock_table = " << mode_name << std::endl;
         } else {
           logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
         }
       }
+      if (snapshot_interval > 0 && snapshot_path.length() == 0) {
+        logstream(LOG_FATAL)
+          << "Snapshot interval specified, but no snapshot path" << std::endl;
+      }
       opts_copy = opts;
       // set a default scheduler if none
       if (opts_copy.get_scheduler_type() == "") {
@@ -542,7 +655,7 @@ namespace graphlab {
       graph.finalize();
       scheduler_ptr->set_num_vertices(graph.num_local_vertices());
       messages.resize(graph.num_local_vertices());
-      vertexlocks.resize(graph.num_local_vertices());
+      vertexlocks.resize(graph.num_local_vertices(), vertexlock_mode);
       program_running.resize(graph.num_local_vertices());
       hasnext.resize(graph.num_local_vertices());
       if (use_cache) {
@@ -553,6 +666,9 @@ namespace graphlab {
       if (!factorized_consistency) {
         cm_handles.resize(graph.num_local_vertices());
       }
+      if (snapshot_interval > 0) {
+        snapshots.resize(graph.num_local_vertices());
+      }
       rmi.barrier();
     }
 
@@ -703,7 +819,7 @@ namespace graphlab {
                              const gather_type& delta) {
       if(use_cache) {
         const lvid_type lvid = vertex.local_id();
-        vertexlocks[lvid].lock();
+        vertexlocks.lock(lvid);
         if( has_cache.get(lvid) ) {
           gather_cache[lvid] += delta;
         } else {
@@ -712,7 +828,7 @@ namespace graphlab {
           // gather_cache[lvid] = delta;
           // has_cache.set_bit(lvid);
         }
-        vertexlocks[lvid].unlock();
+        vertexlocks.unlock(lvid);
       }
     }
 
@@ -727,10 +843,10 @@ namespace graphlab {
     void internal_clear_gather_cache(const vertex_type& vertex) {
       const lvid_type lvid = vertex.local_id();
       if(use_cache && has_cache.get(lvid)) {
-        vertexlocks[lvid].lock();
+        vertexlocks.lock(lvid);
         gather_cache[lvid] = gather_type();
         has_cache.clear_bit(lvid);
-        vertexlocks[lvid].unlock();
+        vertexlocks.unlock(lvid);
       }
 
     }
@@ -781,6 +897,18 @@ namespace graphlab {
       rmi.barrier();
     }
 
+    void clear_gather_caches(const vertex_set& vset) {
+      if (!use_cache) return;
+      const size_t ncached = has_cache.size();
+      foreach(size_t lvid, vset.get_lvid_bitset(graph)) {
+        if (lvid >= ncached) break;
+        if (has_cache.get(lvid)) {
+          gather_cache[lvid] = gather_type();
+          has_cache.clear_bit(lvid);
+        }
+      }
+    }
+
 
   private: 
 
@@ -801,6 +929,84 @@ namespace graphlab {
       }
     }
 
+    /**
+     * \internal
+     * Called on all machines by machine 0 to begin a snapshot. Wakes
+     * up the threads waiting for termination so that they can
+     * participate in the consensus.
+     */
+    void rpc_request_snapshot() {
+      snapshot_requested = true;
+      consensus->cancel();
+    }
+
+    /**
+     * \internal
+     * Called periodically by the engine threads on machine 0 to request
+     * a snapshot every snapshot_interval seconds.
+     */
+    void check_snapshot_timer() {
+      if (snapshot_interval <= 0 || rmi.procid() != 0 ||
+          snapshot_requested || endgame_mode) return;
+      const float now = timer::approx_time_seconds();
+      if (now - last_snapshot_time < snapshot_interval) return;
+      // multiple threads may get here, which is harmless
+      last_snapshot_time = now;
+      for (procid_t i = 0;i < rmi.numprocs(); ++i) {
+        rmi.remote_call(i, &async_consistent_engine::rpc_request_snapshot);
+      }
+    }
+
+    /**
+     * \internal
+     * Called on all machines by machine 0 to check whether the engine
+     * should yield. Stops the threads as for a snapshot.
+     */
+    void rpc_request_activity_check() {
+      activity_check_requested = true;
+      consensus->cancel();
+    }
+
+    /**
+     * \internal
+     * Called periodically by the engine threads on machine 0 to check
+     * the yield threshold every yield_check_interval seconds.
+     */
+    void check_activity_timer() {
+      if (yield_fraction <= 0 || rmi.procid() != 0 ||
+          activity_check_requested || endgame_mode) return;
+      const float now = timer::approx_time_seconds();
+      if (now - last_activity_check_time < yield_check_interval) return;
+      last_activity_check_time = now;
+      for (procid_t i = 0;i < rmi.numprocs(); ++i) {
+        rmi.remote_call(i, &async_consistent_engine::rpc_request_activity_check);
+      }
+    }
+
+    /**
+     * \internal
+     * True while the threads must not start new tasks because the
+     * machines are being brought to a quiescent state.
+     */
+    bool pause_requested() const {
+      return snapshot_requested || activity_check_requested;
+    }
+
+    /**
+     * \internal
+     * The total number of vertices with pending messages. A vertex
+     * with messages on several machines is counted on each. Must be
+     * called on all machines while the engine threads are stopped.
+     */
+    size_t num_pending_messages() {
+      size_t pending = 0;
+      for (lvid_type lvid = 0; lvid < messages.size(); ++lvid) {
+        if (!messages.empty(lvid)) ++pending;
+      }
+      rmi.all_reduce(pending);
+      return pending;
+    }
+
     void set_endgame_mode() {
         if (!endgame_mode) logstream(LOG_EMPH) << "Endgame mode\n";
         endgame_mode = true;
@@ -825,18 +1031,23 @@ namespace graphlab {
       logstream(LOG_DEBUG) << rmi.procid() << "-" << threadid << ": " << "Termination Attempt " << std::endl;
       has_sched_msg = false;
       consensus->begin_done_critical_section(threadid);
-      sched_status::status_enum stat = 
+      // while a snapshot is pending the scheduler is left untouched so
+      // that the threads quit once all running tasks have completed
+      sched_status::status_enum stat = pause_requested() ?
+          sched_status::EMPTY :
           get_next_sched_task(threadid, sched_lvid, msg);
       if (stat == sched_status::EMPTY || force_stop) {
         logstream(LOG_DEBUG) << rmi.procid() << "-" << threadid <<  ": "
                              << "\tTermination Double Checked" << std::endl;
 
-        if (!endgame_mode) logstream(LOG_EMPH) << "Endgame mode\n";
-        endgame_mode = true;
-        // put everyone in endgame
-        for (procid_t i = 0;i < rmi.dc().numprocs(); ++i) {
-          rmi.remote_call(i, &async_consistent_engine::set_endgame_mode);
-        } 
+        if (!pause_requested()) {
+          if (!endgame_mode) logstream(LOG_EMPH) << "Endgame mode\n";
+          endgame_mode = true;
+          // put everyone in endgame
+          for (procid_t i = 0;i < rmi.dc().numprocs(); ++i) {
+            rmi.remote_call(i, &async_consistent_engine::set_endgame_mode);
+          }
+        }
         bool ret = consensus->end_done_critical_section(threadid);
         if (ret == false) {
           logstream(LOG_DEBUG) << rmi.procid() << "-" << threadid <<  ": "
@@ -891,11 +1102,9 @@ namespace graphlab {
         foreach(local_edge_type local_edge, local_vertex.in_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks.lock_pair(a, b);
           accum += vprog.gather(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks.unlock_pair(a, b);
         }
       } 
       // do out edges
@@ -903,11 +1112,9 @@ namespace graphlab {
         foreach(local_edge_type local_edge, local_vertex.out_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks.lock_pair(a, b);
           accum += vprog.gather(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks.unlock_pair(a, b);
         }
       } 
       if (use_cache) {
@@ -927,22 +1134,18 @@ namespace graphlab {
         foreach(local_edge_type local_edge, local_vertex.in_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks.lock_pair(a, b);
           vprog.scatter(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks.unlock_pair(a, b);
         }
       } 
       if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
         foreach(local_edge_type local_edge, local_vertex.out_edges()) {
           edge_type edge(local_edge);
           lvid_type a = edge.source().local_id(), b = edge.target().local_id();
-          vertexlocks[std::min(a,b)].lock();
-          vertexlocks[std::max(a,b)].lock();
+          vertexlocks.lock_pair(a, b);
           vprog.scatter(context, vertex, edge);
-          vertexlocks[a].unlock();
-          vertexlocks[b].unlock();
+          vertexlocks.unlock_pair(a, b);
         }
       } 
 
@@ -958,9 +1161,10 @@ namespace graphlab {
                     const vertex_data_type& newdata) {
       vertex_program_type vprog = vprog_;
       lvid_type lvid = graph.local_vid(vid);
-      vertexlocks[lvid].lock();
+      vertexlocks.lock(lvid);
       graph.l_vertex(lvid).data() = newdata;
-      vertexlocks[lvid].unlock();
+      vertexlocks.unlock(lvid);
+      snapshots.mark_dirty(lvid);
       perform_scatter_local(lvid, vprog);
     }
 
@@ -970,7 +1174,7 @@ namespace graphlab {
     // quit
     bool get_exclusive_access_to_vertex(const lvid_type lvid,
                                         const message_type& msg) {
-      vertexlocks[lvid].lock();
+      vertexlocks.lock(lvid);
       bool someone_else_running = program_running.set_bit(lvid);
       if (someone_else_running) {
         // bad. someone else is here.
@@ -978,7 +1182,7 @@ namespace graphlab {
         messages.add(lvid, msg);
         hasnext.set_bit(lvid);
       } 
-      vertexlocks[lvid].unlock();
+      vertexlocks.unlock(lvid);
       return !someone_else_running;
     }
 
@@ -988,7 +1192,7 @@ namespace graphlab {
     // if returns false, the message has been dropped into the message array.
     // quit
     void release_exclusive_access_to_vertex(const lvid_type lvid) {
-      vertexlocks[lvid].lock();
+      vertexlocks.lock(lvid);
       // someone left a next message for me
       // reschedule it at high priority
       if (hasnext.get(lvid)) {
@@ -997,7 +1201,7 @@ namespace graphlab {
         hasnext.clear_bit(lvid);
       }
       program_running.clear_bit(lvid);
-      vertexlocks[lvid].unlock();
+      vertexlocks.unlock(lvid);
     }
 
 
@@ -1079,9 +1283,10 @@ namespace graphlab {
      /**************************************************************************/
      /*                              apply phase                               */
      /**************************************************************************/
-     vertexlocks[lvid].lock();
+     vertexlocks.lock(lvid);
      vprog.apply(context, vertex, gather_result.value);      
-     vertexlocks[lvid].unlock();
+     vertexlocks.unlock(lvid);
+     snapshots.mark_dirty(lvid);
 
 
      /**************************************************************************/
@@ -1167,7 +1372,11 @@ namespace graphlab {
           aggregator.tick_asynchronous_compute(wid, key);
         }
 
-        sched_status::status_enum stat = get_next_sched_task(threadid, sched_lvid, msg);
+        check_snapshot_timer();
+        check_activity_timer();
+        sched_status::status_enum stat = pause_requested() ?
+            sched_status::EMPTY :
+            get_next_sched_task(threadid, sched_lvid, msg);
 
 
         has_sched_msg = stat != sched_status::EMPTY;
@@ -1238,13 +1447,48 @@ namespace graphlab {
         logstream(LOG_INFO) << "Total Allocated Bytes: " << allocatedmem << std::endl;
       }
       thrgroup.set_stacksize(stacksize);
-        
+      snapshot_requested = false;
+      last_snapshot_time = timer::approx_time_seconds();
+      activity_check_requested = false;
+      last_activity_check_time = timer::approx_time_seconds();
+      // the graph may have been modified since the last run
+      snapshots.require_full();
+
       size_t effncpus = std::min(ncpus, fiber_control::get_instance().num_workers());
-      for (size_t i = 0; i < nfibers ; ++i) {
-        thrgroup.launch(boost::bind(&engine_type::thread_start, this, i), 
-                        i % effncpus);
+      while(1) {
+        for (size_t i = 0; i < nfibers ; ++i) {
+          thrgroup.launch(boost::bind(&engine_type::thread_start, this, i), 
+                          i % effncpus);
+        }
+        thrgroup.join();
+        // The threads also exit when a snapshot or a check of the
+        // yield threshold was requested. All machines are quiescent at
+        // this point: no task is running and no message is in flight.
+        rmi.full_barrier();
+        size_t num_snapshot = snapshot_requested;
+        size_t num_check = activity_check_requested;
+        size_t num_stopped = force_stop;
+        rmi.all_reduce(num_snapshot);
+        rmi.all_reduce(num_check);
+        rmi.all_reduce(num_stopped);
+        if (num_stopped > 0 || (num_snapshot == 0 && num_check == 0)) break;
+        snapshot_requested = false;
+        activity_check_requested = false;
+        if (num_check > 0 &&
+            num_pending_messages() > yield_fraction * graph.num_vertices()) {
+          termination_reason = execution_status::YIELDED;
+          break;
+        }
+        if (num_snapshot > 0) save_snapshot(snapshot_path);
+        endgame_mode = false;
+        rmi.dc().set_fast_track_requests(false);
+        consensus->reset();
+        rmi.barrier();
+      }
+      if (snapshot_interval > 0 && !snapshots.wait()) {
+        logstream(LOG_ERROR) << "Failed to write the last snapshot to "
+                             << snapshot_path << std::endl;
       }
-      thrgroup.join();
       aggregator.stop();
       // if termination reason was not changed, then it must be depletion
       if (termination_reason == execution_status::RUNNING) {
@@ -1277,7 +1521,10 @@ namespace graphlab {
       }
 
 
-      ASSERT_TRUE(scheduler_ptr->empty());
+      // a yielded engine keeps its pending tasks for export_state()
+      if (termination_reason != execution_status::YIELDED) {
+        ASSERT_TRUE(scheduler_ptr->empty());
+      }
       started = false;
 
       rmi.dc().set_fast_track_requests(old_fasttrack);
@@ -1285,9 +1532,168 @@ namespace graphlab {
     } // end of start
 
 
+    /**
+     * \brief Saves a snapshot of the graph and the pending messages.
+     *
+     * The snapshot can be restored with \ref load_snapshot.  This
+     * function must be called on all machines simultaneously and must
+     * not be called while the engine is running.  Snapshots are also
+     * taken automatically during execution if the
+     * <code>snapshot_interval</code> option is set.
+     *
+     * Unless <code>full</code> is set, only the vertex data modified
+     * since the previous snapshot of this engine is written.
+     *
+     * @param [in] prefix the prefix of the snapshot files.
+     * @param [in] full If true, the complete graph is saved.
+     * @return false if an earlier background write failed.
+     */
+    bool save_snapshot(const std::string& prefix, bool full = false) {
+      bool ret = snapshots.save(rmi, graph, prefix, full,
+                                boost::bind(&engine_type::save_engine_state,
+                                            this, _1));
+      rmi.barrier();
+      return ret;
+    }
+
+    /**
+     * \brief Restores the graph and the pending messages from the most
+     * recent snapshot completed by all machines.
+     *
+     * This function must be called on all machines simultaneously
+     * with the same number of machines used to save the snapshot.  The
+     * graph is replaced by the contents of the snapshot and all saved
+     * messages are signaled again, so that the next call to start()
+     * continues the interrupted execution.
+     *
+     * @param [in] prefix the prefix of the snapshot files.
+     * @return true on success and false if no complete snapshot was found.
+     */
+    bool load_snapshot(const std::string& prefix) {
+      return snapshots.load(rmi, graph, prefix,
+                            boost::bind(&engine_type::load_engine_state,
+                                        this, _1, _2));
+    }
+
+  private:
+    /**
+     * \internal
+     * Writes the pending messages and the gather caches.  Must only be
+     * called while the engine threads are stopped.
+     */
+    void save_engine_state(oarchive& oarc) {
+      std::vector<lvid_type> pending;
+      for (lvid_type lvid = 0; lvid < messages.size(); ++lvid) {
+        if (!messages.empty(lvid)) pending.push_back(lvid);
+      }
+      oarc << pending;
+      message_type msg;
+      foreach(lvid_type lvid, pending) {
+        messages.peek(lvid, msg);
+        oarc << msg;
+      }
+      oarc << use_cache;
+      if (use_cache) {
+        oarc << has_cache;
+        foreach(size_t lvid, has_cache) oarc << gather_cache[lvid];
+      }
+    }
+
+    /**
+     * \internal
+     * Reverses save_engine_state, scheduling all the restored messages.
+     */
+    void load_engine_state(iarchive& iarc, bool graph_replaced) {
+      if (graph_replaced) init();
+      std::vector<lvid_type> pending;
+      iarc >> pending;
+      messages.clear();
+      message_type msg;
+      foreach(lvid_type lvid, pending) {
+        iarc >> msg;
+        double priority;
+        messages.add(lvid, msg, &priority);
+        scheduler_ptr->schedule(lvid, priority);
+      }
+      bool caching_enabled = false;
+      iarc >> caching_enabled;
+      if (caching_enabled) {
+        dense_bitset saved_cache;
+        iarc >> saved_cache;
+        gather_type accum;
+        foreach(size_t lvid, saved_cache) {
+          iarc >> accum;
+          // the cache is only restored if caching is enabled now
+          if (use_cache) {
+            gather_cache[lvid] = accum;
+            has_cache.set_bit(lvid);
+          }
+        }
+      }
+    }
+
   public:
     aggregator_type* get_aggregator() { return &aggregator; }
 
+    /**
+     * \brief Makes start() yield when the computation becomes dense.
+     *
+     * If fraction is positive, the engine checks every check_interval
+     * seconds whether more than this fraction of the vertices have
+     * pending messages, and if so start() returns
+     * execution_status::YIELDED. The pending messages are left in the
+     * engine and can be moved to another engine with export_state().
+     * Used by the adaptive \ref omni_engine. Each check briefly stops
+     * all machines, as a snapshot does.
+     */
+    void set_yield_threshold(double fraction, float check_interval = 1) {
+      yield_fraction = fraction;
+      yield_check_interval = check_interval;
+    }
+
+    /**
+     * \brief Moves the pending messages and the gather caches of this
+     * machine into state, leaving the engine empty. Must not be called
+     * while the engine is running.
+     */
+    void export_state(handoff_type& state) {
+      message_type msg;
+      for (lvid_type lvid = 0; lvid < messages.size(); ++lvid) {
+        if (messages.get(lvid, msg)) state.add_message(lvid, msg);
+      }
+      // the scheduler only holds vertices whose messages were taken
+      lvid_type sched_lvid;
+      for (size_t i = 0; i < ncpus; ++i) {
+        while(scheduler_ptr->get_next(i, sched_lvid) == sched_status::NEW_TASK);
+      }
+      if (use_cache) {
+        foreach(size_t lvid, has_cache) {
+          state.add_cache(lvid, gather_cache[lvid]);
+          gather_cache[lvid] = gather_type();
+        }
+        has_cache.clear();
+      }
+    }
+
+    /**
+     * \brief Schedules the messages in state and adds its gather
+     * caches. The caches are dropped unless caching is enabled. Must
+     * not be called while the engine is running.
+     */
+    void import_state(const handoff_type& state) {
+      for (size_t i = 0; i < state.message_lvids.size(); ++i) {
+        double priority;
+        messages.add(state.message_lvids[i], state.messages[i], &priority);
+        scheduler_ptr->schedule(state.message_lvids[i], priority);
+      }
+      if (use_cache) {
+        for (size_t i = 0; i < state.cache_lvids.size(); ++i) {
+          gather_cache[state.cache_lvids[i]] = state.caches[i];
+          has_cache.set_bit(state.cache_lvids[i]);
+        }
+      }
+    }
+
   }; // end of class
 } // namespace
 
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_ENGINE_HANDOFF_HPP
+#define GRAPHLAB_ENGINE_HANDOFF_HPP
+
+#include <vector>
+#include <graphlab/graph/graph_basic_types.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * \brief The live state of an engine on this machine, moved between
+   * the engines by the adaptive \ref omni_engine.
+   *
+   * All state is keyed by local vertex id, which the engines running
+   * on the same graph share: the messages which have not been
+   * delivered yet and the cached partial gathers.
+   */
+  template <typename MessageType, typename GatherType>
+  struct engine_handoff {
+    std::vector<lvid_type> message_lvids;
+    std::vector<MessageType> messages;
+    std::vector<lvid_type> cache_lvids;
+    std::vector<GatherType> caches;
+
+    void add_message(lvid_type lvid, const MessageType& message) {
+      message_lvids.push_back(lvid);
+      messages.push_back(message);
+    }
+
+    void add_cache(lvid_type lvid, const GatherType& cache) {
+      cache_lvids.push_back(lvid);
+      caches.push_back(cache);
+    }
+
+    void clear() {
+      message_lvids.clear(); messages.clear();
+      cache_lvids.clear(); caches.clear();
+    }
+  }; // end of engine_handoff
+
+} // end of namespace graphlab
+
+#endif
@@ -46,7 +46,11 @@ namespace graphlab {
       FORCED_ABORT,     /**< the engine was stopped by calling force
                                 abort */
       
-      EXCEPTION        /**< the engine was stopped by an exception */
+      EXCEPTION,       /**< the engine was stopped by an exception */
+
+      YIELDED          /**< the engine stopped so that another engine
+                              can continue the execution. The pending
+                              work was left in the engine */
     }; // end of enum
     
     // Convenience function.
@@ -58,6 +62,7 @@ namespace graphlab {
         case TIMEOUT: return "timeout";
         case FORCED_ABORT: return "forced abort";
         case EXCEPTION: return "exception";
+        case YIELDED: return "yielded";
         default: return "unknown";
       };
     } // end of to_string
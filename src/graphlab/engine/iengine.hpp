@@ -341,6 +341,21 @@ namespace graphlab {
                              const message_type& message = message_type(),
                              const std::string& order = "shuffle") = 0;
 
+    /**
+     * \brief Drops the cached gathers of a set of vertices.
+     *
+     * Engines which cache gathers (the use_cache option) keep the
+     * caches from one call to start() to the next. A cache goes stale
+     * when the graph changes around its vertex between runs, for
+     * instance when edges are added. This forces the next gather of
+     * every vertex in vset to be recomputed. Engines without gather
+     * caches ignore it. Must be invoked on all machines
+     * simultaneously.
+     *
+     * @param [in] vset The set of vertices whose caches to drop
+     */
+    virtual void clear_gather_caches(const vertex_set& vset) { }
+
 
      /** 
      * \brief Creates a vertex aggregator. Returns true on success.
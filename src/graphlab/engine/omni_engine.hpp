@@ -26,7 +26,10 @@
 
 
 
+#include <vector>
+#include <string>
 #include <graphlab/options/graphlab_options.hpp>
+#include <graphlab/util/timer.hpp>
 
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/engine/synchronous_engine.hpp>
@@ -71,6 +74,35 @@ namespace graphlab {
    *  (\ref synchronous_engine)
    *  \li "asynchronous" or "async": uses the asynchronous engine
    *  (\ref async_consistent_engine)
+   *  \li "adaptive": starts with the synchronous engine and moves the
+   *  pending messages and gather caches to the asynchronous engine
+   *  when the computation becomes sparse, and back again when it
+   *  becomes dense. This suits algorithms whose early iterations touch
+   *  most of the graph and whose tails only a few vertices, such as
+   *  label propagation, shortest paths or residual PageRank.
+   *
+   * The adaptive engine accepts the options of both engines and
+   * the following:
+   *
+   *  \li \b adaptive_async_below (default: 0.05) Switch to the
+   *  asynchronous engine at the beginning of a synchronous iteration
+   *  in which fewer than this fraction of the vertices have pending
+   *  messages.
+   *  \li \b adaptive_sync_above (default: 0.2) Switch back to the
+   *  synchronous engine once more than this fraction of the vertices
+   *  have pending messages. Should be well above adaptive_async_below
+   *  to avoid switching back and forth.
+   *  \li \b adaptive_check_interval (default: 1) Seconds between
+   *  checks of the activity while running asynchronously.
+   *
+   * A lock_table other than vertex or bit only applies to the
+   * synchronous engine; the asynchronous engine keeps its default.
+   *
+   * In adaptive mode the aggregators run during the synchronous
+   * phases only, and iteration() counts the iterations of the current
+   * synchronous phase. Likewise max_iterations and timeout bound each
+   * phase separately rather than the whole run, since every switch
+   * restarts the engine it moves to.
 *
    * \see graphlab::synchronous_engine
    * \see graphlab::async_consistent_engine
@@ -145,6 +177,26 @@ namespace graphlab {
      */
     iengine_type* engine_ptr;
 
+    /**
+     * \brief In adaptive mode, the two engines between which the
+     * execution is moved. engine_ptr is the synchronous one.
+     */
+    synchronous_engine_type* sync_engine_ptr;
+    async_consistent_engine_type* async_engine_ptr;
+
+    /// The activity thresholds of the adaptive mode
+    double async_below, sync_above;
+
+    /// Seconds between activity checks in asynchronous phases
+    float check_interval;
+
+    /// The number of updates and the time of the last adaptive start()
+    size_t adaptive_updates;
+    float adaptive_start_time;
+
+    /// The number of engine switches during the last adaptive start()
+    size_t adaptive_switches;
+
     /**
      * \brief omni engines are not default constructible
      */
@@ -177,7 +229,9 @@ namespace graphlab {
     omni_engine(distributed_control& dc, graph_type& graph,
                 const std::string& default_engine_type,
                 const graphlab_options& options = graphlab_options()) :
-      engine_ptr(NULL) {
+      engine_ptr(NULL), sync_engine_ptr(NULL), async_engine_ptr(NULL),
+      async_below(0.05), sync_above(0.2), check_interval(1),
+      adaptive_updates(0), adaptive_start_time(0), adaptive_switches(0) {
       graphlab_options new_options = options;
       std::string engine_type = default_engine_type;
       options_map& engine_options = new_options.get_engine_args();
@@ -193,6 +247,30 @@ namespace graphlab {
       } else if(engine_type == "async" || engine_type == "asynchronous") {
         logstream(LOG_INFO) << "Using the Synchronous engine." << std::endl;
         engine_ptr = new async_consistent_engine_type(dc, graph, new_options);
+      } else if(engine_type == "adaptive") {
+        logstream(LOG_INFO) << "Using the Adaptive engine." << std::endl;
+        engine_options.get_option("adaptive_async_below", async_below);
+        engine_options.get_option("adaptive_sync_above", sync_above);
+        engine_options.get_option("adaptive_check_interval", check_interval);
+        engine_options.options.erase("adaptive_async_below");
+        engine_options.options.erase("adaptive_sync_above");
+        engine_options.options.erase("adaptive_check_interval");
+        if (sync_above < async_below) {
+          logstream(LOG_FATAL) << "adaptive_sync_above must not be less than "
+                               << "adaptive_async_below" << std::endl;
+        }
+        // each engine rejects the options of the other
+        graphlab_options sync_options = new_options;
+        graphlab_options async_options = new_options;
+        filter_options(sync_options, async_only_options());
+        filter_options(async_options, sync_only_options());
+        translate_async_lock_table(async_options);
+        sync_engine_ptr = new synchronous_engine_type(dc, graph, sync_options);
+        async_engine_ptr = new async_consistent_engine_type(dc, graph,
+                                                            async_options);
+        sync_engine_ptr->set_yield_threshold(async_below);
+        async_engine_ptr->set_yield_threshold(sync_above, check_interval);
+        engine_ptr = sync_engine_ptr;
       } else {
         logstream(LOG_FATAL) << "Invalid engine type: " << engine_type << std::endl;
       }
@@ -206,13 +284,33 @@ namespace graphlab {
       if(engine_ptr != NULL) {
         delete engine_ptr; engine_ptr = NULL;
       }
+      if(async_engine_ptr != NULL) {
+        delete async_engine_ptr; async_engine_ptr = NULL;
+      }
     } // end of destructor
 
-    execution_status::status_enum start( ) { return engine_ptr->start(); }
+    execution_status::status_enum start( ) {
+      if (async_engine_ptr == NULL) return engine_ptr->start();
+      return start_adaptive();
+    }
 
-    size_t num_updates() const { return engine_ptr->num_updates(); }
-    float elapsed_seconds() const { return engine_ptr->elapsed_seconds(); }
+    size_t num_updates() const {
+      if (async_engine_ptr != NULL) return adaptive_updates;
+      return engine_ptr->num_updates();
+    }
+    float elapsed_seconds() const {
+      if (async_engine_ptr != NULL) {
+        return timer::approx_time_seconds() - adaptive_start_time;
+      }
+      return engine_ptr->elapsed_seconds();
+    }
     int iteration() const { return engine_ptr->iteration(); }
+
+    /**
+     * \brief The number of times the last start() moved the execution
+     * between the engines. Always 0 outside the adaptive mode.
+     */
+    size_t num_switches() const { return adaptive_switches; }
     void signal(vertex_id_type vertex,
                 const message_type& message = message_type()) {
       engine_ptr->signal(vertex, message);
@@ -226,10 +324,93 @@ namespace graphlab {
                      const std::string& order = "shuffle") {
       engine_ptr->signal_vset(vset, message, order);
     }
+    void clear_gather_caches(const vertex_set& vset) {
+      if (async_engine_ptr != NULL && async_engine_ptr != engine_ptr) {
+        async_engine_ptr->clear_gather_caches(vset);
+      }
+      engine_ptr->clear_gather_caches(vset);
+    }
 
 
     aggregator_type* get_aggregator() { return engine_ptr->get_aggregator(); }
 
+  private:
+    /**
+     * \brief Runs the engines in turn, moving the live state to the
+     * other engine whenever one yields, until one of them terminates.
+     */
+    execution_status::status_enum start_adaptive() {
+      typename synchronous_engine_type::handoff_type state;
+      adaptive_updates = 0;
+      adaptive_switches = 0;
+      adaptive_start_time = timer::approx_time_seconds();
+      while(1) {
+        execution_status::status_enum ret = sync_engine_ptr->start();
+        adaptive_updates += sync_engine_ptr->num_updates();
+        if (ret != execution_status::YIELDED) return ret;
+        logstream(LOG_EMPH) << "Computation became sparse. "
+                            << "Switching to the asynchronous engine."
+                            << std::endl;
+        sync_engine_ptr->export_state(state);
+        async_engine_ptr->import_state(state);
+        state.clear();
+        ++adaptive_switches;
+
+        ret = async_engine_ptr->start();
+        adaptive_updates += async_engine_ptr->num_updates();
+        if (ret != execution_status::YIELDED) return ret;
+        logstream(LOG_EMPH) << "Computation became dense. "
+                            << "Switching to the synchronous engine."
+                            << std::endl;
+        async_engine_ptr->export_state(state);
+        sync_engine_ptr->import_state(state);
+        state.clear();
+        ++adaptive_switches;
+      }
+    }
+
+    /// Removes the given engine options
+    static void filter_options(graphlab_options& opts,
+                               const std::vector<std::string>& names) {
+      for (size_t i = 0; i < names.size(); ++i) {
+        opts.get_engine_args().options.erase(names[i]);
+      }
+    }
+
+    /**
+     * \brief The asynchronous engine only supports the vertex and bit
+     * lock tables. Any other lock_table meant for the synchronous
+     * engine leaves the asynchronous engine with its default.
+     */
+    static void translate_async_lock_table(graphlab_options& opts) {
+      options_map& engine_options = opts.get_engine_args();
+      std::string mode_name;
+      lock_table::lock_mode mode;
+      if (engine_options.get_option("lock_table", mode_name) &&
+          lock_table::parse_mode(mode_name, mode) &&
+          mode != lock_table::VERTEX_LOCKS && mode != lock_table::BIT_LOCKS) {
+        logstream(LOG_INFO) << "lock_table=" << mode_name << " applies to the "
+                            << "synchronous engine only" << std::endl;
+        engine_options.options.erase("lock_table");
+      }
+    }
+
+    /// The options understood by the synchronous engine only
+    static std::vector<std::string> sync_only_options() {
+      const char* names[] = {"max_iterations", "sched_allv", "sparse",
+                             "lock_stripes", "message_cache_size"};
+      return std::vector<std::string>(names,
+                                      names + sizeof(names) / sizeof(char*));
+    }
+
+    /// The options understood by the asynchronous engine only
+    static std::vector<std::string> async_only_options() {
+      const char* names[] = {"nfibers", "stacksize", "factorized",
+                             "track_task_time"};
+      return std::vector<std::string>(names,
+                                      names + sizeof(names) / sizeof(char*));
+    }
+
 
   }; // end of omni_engine
 
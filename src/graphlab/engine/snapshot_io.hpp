@@ -0,0 +1,613 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SNAPSHOT_IO_HPP
+#define GRAPHLAB_SNAPSHOT_IO_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/util/hdfs.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * Constants and helpers shared by the engines to write and read
+   * snapshots.
+   *
+   * A snapshot is a numbered sequence of per-machine files
+   * \li [prefix].[seq].[procid].snap
+   *
+   * Every file either holds a complete copy of the local graph (a
+   * "base" snapshot) or only the vertex pages that changed since the
+   * previous snapshot (a "delta").  Every file also carries the
+   * engine state (pending messages, caches, iteration counters)
+   * required to resume execution.  After a file has been completely
+   * written the per-machine manifest [prefix].[procid].snap_latest is
+   * atomically replaced to point to it, so a partially written file
+   * is never used for restore.
+   */
+  namespace snapshot_io {
+
+    /// Magic number at the beginning and end of each snapshot file.
+    static const size_t SNAPSHOT_MAGIC = 0x67726c6162736e70ULL;
+
+    /**
+     * Number of consecutive local vertices tracked by a single dirty
+     * bit.  Delta snapshots are written at this granularity.
+     */
+    static const size_t SNAPSHOT_PAGE_SIZE = 1024;
+
+    /// The header written at the start of every snapshot file
+    struct snapshot_header {
+      /// SNAPSHOT_MAGIC once a header has been read successfully
+      size_t magic;
+      /// The sequence number of this snapshot
+      size_t seq;
+      /// The sequence number of the base snapshot this delta applies to
+      size_t base_seq;
+      /// The number of machines which wrote the snapshot
+      size_t numprocs;
+      snapshot_header() : magic(0), seq(0), base_seq(0), numprocs(0) { }
+      bool is_base() const { return seq == base_seq; }
+    };
+
+    inline std::string snapshot_filename(const std::string& prefix,
+                                         size_t seq, procid_t procid) {
+      return prefix + "." + tostr(seq) + "." + tostr(procid) + ".snap";
+    }
+
+    inline std::string manifest_filename(const std::string& prefix,
+                                         procid_t procid) {
+      return prefix + "." + tostr(procid) + ".snap_latest";
+    }
+
+    inline size_t num_pages(size_t num_vertices) {
+      return (num_vertices + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+    }
+
+    /// Marks the page containing lvid as modified
+    inline void mark_dirty(dense_bitset& dirty_pages, size_t lvid) {
+      const size_t page = lvid / SNAPSHOT_PAGE_SIZE;
+      // avoid the atomic on the (common) already dirty case
+      if (!dirty_pages.get(page)) dirty_pages.set_bit(page);
+    }
+
+    /// Writes the snapshot header
+    inline void write_header(oarchive& oarc, const snapshot_header& header) {
+      oarc << SNAPSHOT_MAGIC << header.seq << header.base_seq
+           << header.numprocs;
+    }
+
+    /// Terminates the snapshot so that truncated files can be detected
+    inline void write_footer(oarchive& oarc) {
+      oarc << SNAPSHOT_MAGIC;
+    }
+
+
+    /**
+     * Serializes the vertex data in the pages marked in dirty_pages
+     * (or all pages if dirty_pages is empty).
+     */
+    template <typename Graph>
+    void save_vertex_pages(oarchive& oarc, const Graph& graph,
+                           const dense_bitset& dirty_pages) {
+      const size_t nverts = graph.num_local_vertices();
+      const size_t npages = num_pages(nverts);
+      const bool all_pages = dirty_pages.size() == 0;
+      size_t ndirty = all_pages ? npages : dirty_pages.popcount();
+      oarc << ndirty;
+      for (size_t page = 0; page < npages; ++page) {
+        if (!all_pages && !dirty_pages.get(page)) continue;
+        oarc << page;
+        const size_t end = std::min(nverts, (page + 1) * SNAPSHOT_PAGE_SIZE);
+        for (size_t lvid = page * SNAPSHOT_PAGE_SIZE; lvid < end; ++lvid) {
+          oarc << graph.get_local_graph().vertex_data(lvid);
+        }
+      }
+    } // end of save_vertex_pages
+
+    /// Reverses save_vertex_pages()
+    template <typename Graph>
+    void load_vertex_pages(iarchive& iarc, Graph& graph) {
+      const size_t nverts = graph.num_local_vertices();
+      size_t ndirty = 0;
+      iarc >> ndirty;
+      for (size_t i = 0; i < ndirty; ++i) {
+        size_t page = 0;
+        iarc >> page;
+        const size_t end = std::min(nverts, (page + 1) * SNAPSHOT_PAGE_SIZE);
+        for (size_t lvid = page * SNAPSHOT_PAGE_SIZE; lvid < end; ++lvid) {
+          iarc >> graph.get_local_graph().vertex_data(lvid);
+        }
+      }
+    } // end of load_vertex_pages
+
+    /// Serializes all the edge data of the local graph
+    template <typename Graph>
+    void save_edge_data(oarchive& oarc, const Graph& graph) {
+      const size_t nedges = graph.get_local_graph().num_edges();
+      oarc << nedges;
+      for (size_t eid = 0; eid < nedges; ++eid) {
+        oarc << graph.get_local_graph().edge_data(eid);
+      }
+    } // end of save_edge_data
+
+    /// Reverses save_edge_data()
+    template <typename Graph>
+    void load_edge_data(iarchive& iarc, Graph& graph) {
+      size_t nedges = 0;
+      iarc >> nedges;
+      ASSERT_EQ(nedges, graph.get_local_graph().num_edges());
+      for (size_t eid = 0; eid < nedges; ++eid) {
+        iarc >> graph.get_local_graph().edge_data(eid);
+      }
+    } // end of load_edge_data
+
+
+    /**
+     * Reads the manifest for this machine.  Returns false if there is
+     * no complete snapshot.
+     */
+    inline bool read_manifest(const std::string& prefix, procid_t procid,
+                              size_t& seq, size_t& base_seq) {
+      const std::string fname = manifest_filename(prefix, procid);
+      if (boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream in_file(hdfs, fname);
+        boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+        fin.push(in_file);
+        if (!fin.good()) return false;
+        fin >> seq >> base_seq;
+        bool success = !fin.fail();
+        fin.pop();
+        in_file.close();
+        return success;
+      } else {
+        std::ifstream fin(fname.c_str());
+        if (!fin.good()) return false;
+        fin >> seq >> base_seq;
+        return !fin.fail();
+      }
+    } // end of read_manifest
+
+
+    /**
+     * Decompresses a snapshot file, checks the header and passes an
+     * iarchive positioned after the header to the reader.  Returns
+     * false if the file cannot be opened or is not a snapshot.
+     */
+    template <typename Reader>
+    bool read_snapshot(const std::string& fname, snapshot_header& header,
+                       Reader reader) {
+      logstream(LOG_INFO) << "Reading snapshot " << fname << std::endl;
+      boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+      fin.push(boost::iostreams::gzip_decompressor());
+      if (boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        graphlab::hdfs::fstream in_file(hdfs, fname);
+        fin.push(in_file);
+        if (!fin.good()) return false;
+        iarchive iarc(fin);
+        iarc >> header.magic;
+        if (header.magic != SNAPSHOT_MAGIC) return false;
+        iarc >> header.seq >> header.base_seq >> header.numprocs;
+        reader(iarc, header);
+        size_t footer = 0;
+        iarc >> footer;
+        fin.pop(); fin.pop();
+        in_file.close();
+        return footer == SNAPSHOT_MAGIC;
+      } else {
+        std::ifstream in_file(fname.c_str(),
+                              std::ios_base::in | std::ios_base::binary);
+        if (!in_file.good()) return false;
+        fin.push(in_file);
+        iarchive iarc(fin);
+        iarc >> header.magic;
+        if (header.magic != SNAPSHOT_MAGIC) return false;
+        iarc >> header.seq >> header.base_seq >> header.numprocs;
+        reader(iarc, header);
+        size_t footer = 0;
+        iarc >> footer;
+        fin.pop(); fin.pop();
+        return footer == SNAPSHOT_MAGIC;
+      }
+    } // end of read_snapshot
+
+    /// A reader for read_snapshot() which stops after the header
+    inline void skip_snapshot_body(iarchive& iarc, const snapshot_header&) { }
+
+    /**
+     * Reads only the header of a snapshot file. Returns false if the
+     * file cannot be opened.
+     */
+    inline bool read_snapshot_header(const std::string& fname,
+                                     snapshot_header& header) {
+      read_snapshot(fname, header, skip_snapshot_body);
+      return header.magic == SNAPSHOT_MAGIC;
+    }
+
+    /**
+     * Deletes the local snapshot files with sequence numbers in
+     * [begin, end).  Only supported on POSIX filesystems; snapshots on
+     * HDFS are retained.
+     */
+    inline void remove_snapshots(const std::string& prefix, procid_t procid,
+                                 size_t begin, size_t end) {
+      if (boost::starts_with(prefix, "hdfs://")) return;
+      for (size_t seq = begin; seq < end; ++seq) {
+        std::remove(snapshot_filename(prefix, seq, procid).c_str());
+      }
+    }
+
+  } // namespace snapshot_io
+
+
+
+  /**
+   * \internal
+   * \brief Writes serialized snapshots to disk in a background thread.
+   *
+   * The engine serializes its state into an in-memory oarchive while
+   * the workers are stopped (which is a memory copy), and hands the
+   * buffer to the snapshot_writer.  Compression and the actual file
+   * writes then overlap with the next super-steps.  At most one write
+   * is in flight at a time: a new write waits for the previous one.
+   */
+  class snapshot_writer {
+  public:
+    snapshot_writer() : pending(false), last_ok(true) { }
+
+    ~snapshot_writer() { wait(); }
+
+    /**
+     * \brief Writes the contents of the oarchive buffer to the
+     * snapshot file for sequence number seq and then updates the
+     * manifest.
+     *
+     * Takes ownership of the oarchive buffer (which is freed when the
+     * write completes) and resets the oarchive.  If background is
+     * false, the call returns only after the write is complete.
+     */
+    void write(const std::string& prefix, procid_t procid,
+               size_t seq, size_t base_seq,
+               oarchive& oarc, bool background) {
+      wait();
+      char* buf = oarc.buf;
+      size_t len = oarc.off;
+      oarc.buf = NULL; oarc.off = 0; oarc.len = 0;
+      pending = true;
+      if (background) {
+        writer_thread.launch(boost::bind(&snapshot_writer::write_and_release,
+                                         this, prefix, procid,
+                                         seq, base_seq, buf, len));
+      } else {
+        write_and_release(prefix, procid, seq, base_seq, buf, len);
+        pending = false;
+      }
+    } // end of write
+
+    /**
+     * \brief Waits for the pending write to complete.  Returns false
+     * if the last write failed.
+     */
+    bool wait() {
+      if (pending) {
+        writer_thread.join();
+        pending = false;
+      }
+      return last_ok;
+    }
+
+  private:
+    thread_group writer_thread;
+    bool pending;
+    bool last_ok;
+
+    template <typename OStream>
+    static void write_buffer(OStream& out_file, const char* buf, size_t len) {
+      boost::iostreams::filtering_stream<boost::iostreams::output> fout;
+      fout.push(boost::iostreams::gzip_compressor());
+      fout.push(out_file);
+      fout.write(buf, len);
+      fout.pop();
+      fout.pop();
+    }
+
+    void write_and_release(std::string prefix, procid_t procid,
+                           size_t seq, size_t base_seq,
+                           char* buf, size_t len) {
+      timer ti; ti.start();
+      const std::string fname =
+        snapshot_io::snapshot_filename(prefix, seq, procid);
+      const std::string manifest =
+        snapshot_io::manifest_filename(prefix, procid);
+      last_ok = true;
+      if (boost::starts_with(fname, "hdfs://")) {
+        graphlab::hdfs hdfs;
+        {
+          graphlab::hdfs::fstream out_file(hdfs, fname, true);
+          if (!out_file.good()) last_ok = false;
+          else write_buffer(out_file, buf, len);
+          out_file.close();
+        }
+        if (last_ok) {
+          graphlab::hdfs::fstream out_file(hdfs, manifest, true);
+          std::string contents = tostr(seq) + " " + tostr(base_seq) + "\n";
+          out_file.write(contents.c_str(), contents.length());
+          out_file.close();
+        }
+      } else {
+        {
+          std::ofstream out_file(fname.c_str(),
+                                 std::ios_base::out | std::ios_base::binary);
+          if (!out_file.good()) last_ok = false;
+          else write_buffer(out_file, buf, len);
+          last_ok = last_ok && out_file.good();
+        }
+        if (last_ok) {
+          // write the manifest next to the target and rename it into
+          // place so that it is replaced atomically
+          const std::string tmpname = manifest + ".tmp";
+          {
+            std::ofstream fout(tmpname.c_str());
+            fout << seq << " " << base_seq << "\n";
+            last_ok = fout.good();
+          }
+          last_ok = last_ok && std::rename(tmpname.c_str(), manifest.c_str()) == 0;
+        }
+      }
+      free(buf);
+      if (!last_ok) {
+        logstream(LOG_ERROR) << "Failed to write snapshot " << fname << std::endl;
+      } else {
+        logstream(LOG_INFO) << "Finished writing snapshot " << fname
+                            << " in " << ti.current_time() << "s" << std::endl;
+      }
+    } // end of write_and_release
+  }; // end of snapshot_writer
+
+
+
+
+  /**
+   * \internal
+   * \brief Implements taking and restoring snapshots of a graph and
+   * the associated engine state on behalf of an engine.
+   *
+   * The manager tracks which pages of local vertices were modified
+   * since the previous snapshot (the engine calls mark_dirty() when it
+   * writes vertex data) so that only every full_interval'th snapshot
+   * has to contain the complete graph.  The engine state itself is
+   * written and read through callbacks:
+   * \code
+   *   void save_state(oarchive& oarc);
+   *   void load_state(iarchive& iarc, bool is_base);
+   * \endcode
+   * where load_state is called after the graph (or the delta) has been
+   * applied and is_base indicates that the graph was replaced.
+   */
+  template <typename GraphType>
+  class snapshot_manager {
+  public:
+    /// Every full_interval'th snapshot contains the complete graph
+    size_t full_interval;
+    /// If set, the snapshot files are written in a background thread
+    bool background;
+    /// If set, delta snapshots include all the edge data
+    bool save_edges;
+
+    snapshot_manager() : full_interval(8), background(true),
+                         save_edges(true), seq(0), base_seq(0),
+                         pruned_seq(0), need_base(true) { }
+
+    /// Enables dirty tracking for a graph with nverts local vertices
+    void resize(size_t nverts) {
+      const size_t npages = snapshot_io::num_pages(nverts);
+      // pages which are added have not been written to any snapshot
+      if (dirty_pages.size() != npages) need_base = true;
+      dirty_pages.resize(npages);
+    }
+
+    /// Returns true if resize() was called
+    bool tracking() const { return dirty_pages.size() > 0; }
+
+    /// Records a modification of the vertex data of lvid
+    void mark_dirty(size_t lvid) {
+      if (tracking()) snapshot_io::mark_dirty(dirty_pages, lvid);
+    }
+
+    /**
+     * Forces the next snapshot to contain the complete graph. Used
+     * when the graph may have been modified outside of the engine.
+     */
+    void require_full() { need_base = true; }
+
+    /// Waits for the last snapshot write. Returns false if it failed.
+    bool wait() { return writer.wait(); }
+
+    /**
+     * \brief Takes a snapshot. Must be called on all machines
+     * simultaneously while no vertex data is being modified.
+     */
+    template <typename RMI, typename StateSaver>
+    bool save(RMI& rmi, const GraphType& graph, const std::string& prefix,
+              bool full, StateSaver save_state) {
+      timer ti; ti.start();
+      // Wait for the previous snapshot. If it failed anywhere, the
+      // chain of deltas is broken and a complete snapshot is needed.
+      size_t num_failed = writer.wait() ? 0 : 1;
+      rmi.all_reduce(num_failed);
+      if (num_failed > 0) need_base = true;
+      // All files up to the previous snapshot are complete on all
+      // machines, so everything before its base is no longer needed.
+      if (num_failed == 0 && seq > 0 && pruned_seq < base_seq) {
+        snapshot_io::remove_snapshots(prefix, rmi.procid(),
+                                      pruned_seq, base_seq);
+        pruned_seq = base_seq;
+      }
+      resize(graph.num_local_vertices());
+      // all machines must agree, since reading a complete snapshot
+      // reinitializes the engine
+      size_t num_base = full || need_base || seq - base_seq >= full_interval;
+      rmi.all_reduce(num_base);
+      const bool base = num_base > 0;
+
+      snapshot_io::snapshot_header header;
+      header.seq = seq;
+      header.base_seq = base ? seq : base_seq;
+      header.numprocs = rmi.numprocs();
+      // serialize into memory. This is the only part which stops the
+      // computation; compression and I/O happen in the writer.
+      oarchive oarc;
+      snapshot_io::write_header(oarc, header);
+      if (base) {
+        oarc << graph;
+      } else {
+        snapshot_io::save_vertex_pages(oarc, graph, dirty_pages);
+        oarc << save_edges;
+        if (save_edges) snapshot_io::save_edge_data(oarc, graph);
+      }
+      save_state(oarc);
+      snapshot_io::write_footer(oarc);
+      dirty_pages.clear();
+
+      if (rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Snapshot " << header.seq
+                            << (base ? " (complete)" : " (delta)")
+                            << " taken in " << ti.current_time() << "s"
+                            << std::endl;
+      }
+      writer.write(prefix, rmi.procid(), header.seq, header.base_seq,
+                   oarc, background);
+      base_seq = header.base_seq;
+      need_base = false;
+      ++seq;
+      return num_failed == 0;
+    } // end of save
+
+    /**
+     * \brief Restores the most recent snapshot completed by all
+     * machines. Must be called on all machines simultaneously. Returns
+     * false if there is no such snapshot.
+     */
+    template <typename RMI, typename StateLoader>
+    bool load(RMI& rmi, GraphType& graph, const std::string& prefix,
+              StateLoader load_state) {
+      writer.wait();
+      rmi.full_barrier();
+      size_t latest = 0, latest_base = 0;
+      std::vector<size_t> available(rmi.numprocs(), 0);
+      if (snapshot_io::read_manifest(prefix, rmi.procid(),
+                                     latest, latest_base)) {
+        available[rmi.procid()] = latest + 1;
+      }
+      rmi.all_gather(available);
+      size_t target = *std::min_element(available.begin(), available.end());
+      if (target == 0) {
+        logstream(LOG_WARNING) << "No complete snapshot found at "
+                               << prefix << std::endl;
+        return false;
+      }
+      target -= 1;
+      // a machine may have completed a later snapshot than the others
+      // so the base is read from the header of the target
+      snapshot_io::snapshot_header header;
+      const std::string target_file =
+        snapshot_io::snapshot_filename(prefix, target, rmi.procid());
+      if (!snapshot_io::read_snapshot_header(target_file, header)) {
+        logstream(LOG_FATAL) << "Unable to read snapshot "
+                             << target_file << std::endl;
+      }
+      ASSERT_EQ(header.numprocs, rmi.numprocs());
+      const size_t target_base = header.base_seq;
+      for (size_t s = target_base; s <= target; ++s) {
+        const std::string fname =
+          snapshot_io::snapshot_filename(prefix, s, rmi.procid());
+        reader_args<StateLoader> args(graph, load_state);
+        if (!snapshot_io::read_snapshot(fname, header, args)) {
+          logstream(LOG_FATAL) << "Corrupt snapshot " << fname << std::endl;
+        }
+      }
+      seq = target + 1;
+      base_seq = target_base;
+      pruned_seq = target_base;
+      resize(graph.num_local_vertices());
+      dirty_pages.clear();
+      need_base = false;
+      rmi.full_barrier();
+      if (rmi.procid() == 0) {
+        logstream(LOG_EMPH) << "Restored snapshot " << target << std::endl;
+      }
+      return true;
+    } // end of load
+
+  private:
+    size_t seq;
+    size_t base_seq;
+    size_t pruned_seq;
+    bool need_base;
+    dense_bitset dirty_pages;
+    snapshot_writer writer;
+
+    /// Applies the body of a single base or delta snapshot file
+    template <typename StateLoader>
+    struct reader_args {
+      GraphType& graph;
+      StateLoader& load_state;
+      reader_args(GraphType& graph, StateLoader& load_state) :
+        graph(graph), load_state(load_state) { }
+      void operator()(iarchive& iarc,
+                      const snapshot_io::snapshot_header& header) {
+        if (header.is_base()) {
+          iarc >> graph;
+        } else {
+          snapshot_io::load_vertex_pages(iarc, graph);
+          bool has_edges = false;
+          iarc >> has_edges;
+          if (has_edges) snapshot_io::load_edge_data(iarc, graph);
+        }
+        load_state(iarc, header.is_base());
+      }
+    };
+  }; // end of snapshot_manager
+
+} // namespace graphlab
+
+#endif
@@ -27,6 +27,7 @@
 
 #include <deque>
 #include <boost/bind.hpp>
+#include <boost/type_traits/is_base_of.hpp>
 
 #include <graphlab/engine/iengine.hpp>
 
@@ -35,15 +36,22 @@
 #include <graphlab/vertex_program/context.hpp>
 
 #include <graphlab/engine/execution_status.hpp>
+#include <graphlab/engine/engine_handoff.hpp>
+#include <graphlab/engine/snapshot_io.hpp>
+#include <graphlab/graph/data_fields.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 
 
 
 
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/fiber_control.hpp>
 #include <graphlab/parallel/fiber_barrier.hpp>
+#include <graphlab/parallel/lock_table.hpp>
 #include <graphlab/util/tracepoint.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/paged_vector.hpp>
+#include <graphlab/util/tracked_bitset.hpp>
 
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/distributed_event_log.hpp>
@@ -191,14 +199,53 @@ namespace graphlab {
    * \li \b snapshot_interval If set to a positive value, a snapshot
    * is taken every this number of iterations. If set to 0, a snapshot
    * is taken before the first iteration. If set to a negative value,
-   * no snapshots are taken. Defaults to -1. A snapshot is a binary
-   * dump of the graph.
+   * no snapshots are taken. Defaults to -1. A snapshot contains the
+   * graph as well as the engine state (pending messages, gather caches
+   * and the iteration counter) and can be restored with
+   * \ref graphlab::synchronous_engine::load_snapshot.
    *
    * \li \b snapshot_path If snapshot_interval is set to a value >=0,
    * this option must be specified and should contain a target basename
    * for the snapshot. The path including folder and file prefix in
    * which the snapshots should be saved.
    *
+   * \li \b snapshot_full_interval (default: 8) Only every this number
+   * of snapshots contains a complete copy of the graph.  The snapshots
+   * in between only contain the vertex data pages which were modified
+   * since the previous snapshot.
+   *
+   * \li \b snapshot_async (default: true) If set, snapshots are
+   * compressed and written to disk in a background thread while the
+   * engine continues with the next iterations.
+   *
+   * \li \b snapshot_edges (default: true) If set to false, the edge
+   * data is assumed to be constant and is only written in the complete
+   * snapshots.
+   *
+   * \li \b sparse (default: false) If set, the vertex programs,
+   * messages and gather accumulators are allocated lazily, a page of
+   * vertices at a time, as the vertices are first touched, and the
+   * sets of active vertices are cleared and visited in time
+   * proportional to the number of active vertices instead of the
+   * number of vertices. Intended for running many small computations
+   * (for instance personalized PageRank from a few seeds) by
+   * constructing the engine once and calling signal() and start()
+   * for each one: the pages are kept and reused across runs.
+   *
+   * \li \b lock_table (default: striped) The representation of the
+   * per vertex locks. One of "striped" (a fixed number of cache line
+   * padded locks), "vertex" (one lock per vertex), "bit" (one bit per
+   * vertex) or "none". Locks are always elided when the engine runs
+   * on a single thread in a single process, and "none" is ignored
+   * otherwise.
+   *
+   * \li \b lock_stripes (default: 65536) The number of locks used by
+   * the striped lock table.
+   *
+   * \li \b message_cache_size (default: 1024) The number of slots of
+   * the per thread caches in which signals are combined before they
+   * are merged into the shared message array. Set to 0 to disable.
+   *
    * \see graphlab::omni_engine
    * \see graphlab::async_consistent_engine
    * \see graphlab::semi_synchronous_engine
@@ -383,6 +430,18 @@ namespace graphlab {
     /// \brief The target base name the snapshot is saved in.
     std::string snapshot_path;
 
+    /**
+     * \brief Set by \ref load_snapshot so that the next call to start
+     * continues from the restored iteration.
+     */
+    bool resume_from_snapshot;
+
+    /**
+     * \brief Tracks the vertex pages modified since the last snapshot
+     * and writes the snapshots.
+     */
+    snapshot_manager<graph_type> snapshots;
+
     /**
      * \brief A counter that tracks the current iteration number since
      * start was last invoked.
@@ -404,6 +463,33 @@ namespace graphlab {
      */
     bool sched_allv;
 
+    /**
+     * \brief If set the per vertex state is allocated lazily and the
+     * active sets track their nonzero words.
+     */
+    bool sparse;
+
+    /**
+     * \brief If positive, start() yields once fewer than this
+     * fraction of the vertices have pending messages.
+     */
+    double yield_fraction;
+
+    /**
+     * \brief The requested representation of the vertex locks
+     */
+    lock_table::lock_mode vlock_mode;
+
+    /**
+     * \brief The number of stripes of a striped vertex lock table
+     */
+    size_t lock_stripes;
+
+    /**
+     * \brief The number of slots in each per thread message cache
+     */
+    size_t message_cache_size;
+
     /**
      * \brief Used to stop the engine prematurely
      */
@@ -415,7 +501,7 @@ namespace graphlab {
      * \ref graphlab::synchronous_engine::gather_accum
      * and \ref graphlab::synchronous_engine::messages.
      */
-    std::vector<simple_spinlock> vlocks;
+    lock_table vlocks;
 
 
     /**
@@ -423,9 +509,10 @@ namespace graphlab {
      * scatter.  Technically there is a potential race since gather
      * and scatter can modify edge values and can overlap.  The edge
      * lock ensures that only one gather or scatter occurs on an edge
-     * at a time.
+     * at a time. Since they are rarely contended a striped table
+     * suffices, which does not grow with the number of edges.
      */
-    std::vector<simple_spinlock> elocks;
+    lock_table elocks;
 
 
 
@@ -433,17 +520,45 @@ namespace graphlab {
      * \brief The vertex programs associated with each vertex on this
      * machine.
      */
-    std::vector<vertex_program_type> vertex_programs;
+    paged_vector<vertex_program_type> vertex_programs;
 
     /**
      * \brief Vector of messages associated with each vertex.
      */
-    std::vector<message_type> messages;
+    paged_vector<message_type> messages;
 
     /**
      * \brief Bit indicating whether a message is present for each vertex.
      */
-    dense_bitset has_message;
+    tracked_bitset has_message;
+
+    /**
+     * \brief A direct mapped cache of combined messages owned by one
+     * fiber worker.
+     *
+     * Signals from the vertex programs are combined here without any
+     * locking, since fibers on a worker do not preempt each other, and
+     * are merged into \ref graphlab::synchronous_engine::messages
+     * only on eviction and at the end of each phase. This removes the
+     * contention on the locks of high degree vertices which are
+     * signaled by every thread during scatter.
+     */
+    struct message_cache {
+      /// The lvid held by each slot, or lvid_type(-1) if empty
+      std::vector<lvid_type> lvids;
+      std::vector<message_type> messages;
+    };
+
+    /**
+     * \brief The message cache of each fiber worker
+     */
+    std::vector<message_cache> message_caches;
+
+    /**
+     * \brief Set while the engine threads are running and may combine
+     * signals in the message caches.
+     */
+    bool combine_signals;
 
 
     /**
@@ -455,7 +570,7 @@ namespace graphlab {
      * once and therefore must be guarded by a vertex locks in
      * \ref graphlab::synchronous_engine::vlocks
      */
-    std::vector<gather_type>  gather_accum;
+    paged_vector<gather_type>  gather_accum;
 
     /**
      * \brief Bit indicating if the gather has accumulator contains any
@@ -467,7 +582,7 @@ namespace graphlab {
      * set while holding the lock in
      * \ref graphlab::synchronous_engine::vlocks.
      */
-    dense_bitset has_gather_accum;
+    tracked_bitset has_gather_accum;
 
 
     /**
@@ -477,19 +592,19 @@ namespace graphlab {
      * Caching is done locally and therefore a high-degree vertex may
      * have multiple caches (one per machine).
      */
-    std::vector<gather_type>  gather_cache;
+    paged_vector<gather_type>  gather_cache;
 
     /**
      * \brief A bit indicating if the local gather for that vertex is
      * available.
      */
-    dense_bitset has_cache;
+    tracked_bitset has_cache;
 
     /**
      * \brief A bit (for master vertices) indicating if that vertex is active
      * (received a message on this iteration).
      */
-    dense_bitset active_superstep;
+    tracked_bitset active_superstep;
 
     /**
      * \brief  The number of local vertices (masters) that are active on this
@@ -501,7 +616,7 @@ namespace graphlab {
      * \brief A bit indicating (for all vertices) whether to
      * participate in the current minor-step (gather or scatter).
      */
-    dense_bitset active_minorstep;
+    tracked_bitset active_minorstep;
 
     /**
      * \brief A counter measuring the number of applys that have been completed
@@ -532,10 +647,18 @@ namespace graphlab {
      */
     vprog_exchange_type vprog_exchange;
 
+    /**
+     * \brief Determines what is sent to the mirrors after an apply:
+     * the whole vertex data, or only the changed fields if they were
+     * declared with \ref GRAPHLAB_DATA_FIELDS.
+     */
+    typedef data_sync<vertex_data_type> vdata_sync_type;
+
     /**
      * \brief The pair type used to synchronize vertex across across machines.
      */
-    typedef std::pair<vertex_id_type, vertex_data_type> vid_vdata_pair_type;
+    typedef std::pair<vertex_id_type, typename vdata_sync_type::value_type>
+      vid_vdata_pair_type;
 
     /**
      * \brief The type of the exchange used to synchronize vertex data
@@ -656,6 +779,9 @@ namespace graphlab {
                     const message_type& message = message_type(),
                     const std::string& order = "shuffle");
 
+    // documentation inherited from iengine
+    void clear_gather_caches(const vertex_set& vset);
+
 
     // documentation inherited from iengine
     float elapsed_seconds() const;
@@ -693,6 +819,84 @@ namespace graphlab {
      */
     void init();
 
+    /**
+     * \brief Saves a snapshot of the graph and the engine state.
+     *
+     * The snapshot can be restored with \ref load_snapshot.  This
+     * function must be called on all machines simultaneously and
+     * should not be called while the engine is running.  Snapshots are
+     * also taken automatically by the engine if the
+     * <code>snapshot_interval</code> option is set.
+     *
+     * Unless <code>full</code> is set, only the vertex data modified
+     * since the previous snapshot of this engine is written.  If the
+     * <code>snapshot_async</code> option is set the files are written
+     * in the background and the function returns once the state has
+     * been copied.
+     *
+     * @param [in] prefix the prefix of the snapshot files.
+     * @param [in] full If true, the complete graph is saved.
+     * @return false if an earlier background write failed.
+     */
+    bool save_snapshot(const std::string& prefix, bool full = false);
+
+    /**
+     * \brief Restores the graph and engine state from the most recent
+     * snapshot completed by all machines.
+     *
+     * This function must be called on all machines simultaneously
+     * with the same number of machines used to save the snapshot.  The
+     * graph is replaced by the contents of the snapshot and the next
+     * call to start() continues from the saved iteration with the
+     * saved messages.
+     *
+     * \code
+     * graph_type graph(dc, clopts);
+     * graphlab::synchronous_engine<pagerank> engine(dc, graph, clopts);
+     * if (!engine.load_snapshot(snapshot_path)) {
+     *   graph.load_format(graph_dir, "tsv");
+     *   engine.signal_all();
+     * }
+     * engine.start();
+     * \endcode
+     *
+     * @param [in] prefix the prefix of the snapshot files.
+     * @return true on success and false if no complete snapshot was found.
+     */
+    bool load_snapshot(const std::string& prefix);
+
+    /**
+     * \brief The pending messages and gather caches moved between
+     * engines by export_state() and import_state().
+     */
+    typedef engine_handoff<message_type, gather_type> handoff_type;
+
+    /**
+     * \brief Makes start() yield when the computation becomes sparse.
+     *
+     * If fraction is positive, start() returns
+     * execution_status::YIELDED at the beginning of the first
+     * iteration in which some but fewer than this fraction of the
+     * vertices have pending messages. The messages are left in the
+     * engine and can be moved to another engine with export_state().
+     * Used by the adaptive \ref omni_engine.
+     */
+    void set_yield_threshold(double fraction);
+
+    /**
+     * \brief Moves the pending messages and the gather caches of this
+     * machine into state, leaving the engine empty. Must not be called
+     * while the engine is running.
+     */
+    void export_state(handoff_type& state);
+
+    /**
+     * \brief Adds the messages and gather caches in state to the
+     * engine. The caches are dropped unless caching is enabled. Must
+     * not be called while the engine is running.
+     */
+    void import_state(const handoff_type& state);
+
 
   private:
 
@@ -726,6 +930,21 @@ namespace graphlab {
     void internal_signal(const vertex_type& vertex,
                          const message_type& message = message_type());
 
+    /**
+     * \brief Combines a message into the message of a local vertex
+     * while holding its lock.
+     */
+    void merge_message(lvid_type lvid, const message_type& message);
+
+    /**
+     * \brief Merges all the messages in the cache of a worker into
+     * \ref graphlab::synchronous_engine::messages and empties it.
+     *
+     * Must be called from a fiber on that worker, or after all the
+     * engine threads have finished.
+     */
+    void flush_message_cache(size_t workerid);
+
     /**
      * \brief Called by the context to signal an arbitrary vertex.
      *
@@ -771,6 +990,7 @@ namespace graphlab {
     void thread_launch_wrapped_event_counter(boost::function<void(void)> fn) {
       INCREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
       fn();
+      flush_message_cache(fiber_control::get_worker_id());
       DECREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
     }
 
@@ -795,6 +1015,7 @@ namespace graphlab {
     template<typename MemberFunction>
     void run_synchronous(MemberFunction member_fun) {
       shared_lvid_counter = 0;
+      combine_signals = !message_caches.empty();
       if (ncpus <= 1) {
         INCREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
       }
@@ -810,6 +1031,7 @@ namespace graphlab {
       }
       // Wait for all threads to finish
       threads.join();
+      combine_signals = false;
       rmi.barrier();
       if (ncpus <= 1) {
         DECREMENT_EVENT(EVENT_ACTIVE_CPUS, 1);
@@ -854,6 +1076,33 @@ namespace graphlab {
      */
     void execute_gathers(size_t thread_id);
 
+    /**
+     * \brief Computes the local gather of a vertex over the edges in
+     * gather_dir through the edge iterators of the local graph.
+     *
+     * @param [in,out] accum combined with the result of each edge
+     * @param [in,out] accum_is_set set once accum holds a value
+     * @return the number of edges touched
+     */
+    template <typename VProg>
+    size_t local_gather(lvid_type lvid, const VProg& vprog,
+                        context_type& context, edge_dir_type gather_dir,
+                        gather_type& accum, bool& accum_is_set,
+                        boost::false_type);
+
+    /**
+     * \brief Computes the local gather of a vertex which inherits from
+     * \ref graphlab::IS_BULK_GATHER with a loop over the raw CSR and
+     * CSC adjacency and the data arrays of the local graph. This is a
+     * template so that it is only instantiated for such vertex
+     * programs.
+     */
+    template <typename VProg>
+    size_t local_gather(lvid_type lvid, const VProg& vprog,
+                        context_type& context, edge_dir_type gather_dir,
+                        gather_type& accum, bool& accum_is_set,
+                        boost::true_type);
+
 
 
 
@@ -902,8 +1151,12 @@ namespace graphlab {
      *
      * @param [in] lvid the vertex to sync.  This machine must be the master
      * of that vertex.
+     * @param [in] before the vertex data prior to the apply. Nothing is
+     * sent if it did not change.
      */
-    void sync_vertex_data(lvid_type lvid, size_t thread_id);
+    void sync_vertex_data(lvid_type lvid,
+                          const typename vdata_sync_type::snapshot& before,
+                          size_t thread_id);
 
     /**
      * \brief Receive all incoming vertex data and update the local
@@ -951,6 +1204,19 @@ namespace graphlab {
      */
     void recv_messages();
 
+    // Snapshots ==============================================================
+    /**
+     * \brief Writes the engine state (iteration counter, pending
+     * messages and gather caches) to the archive.
+     */
+    void save_engine_state(oarchive& oarc) const;
+
+    /**
+     * \brief Reads the engine state written by save_engine_state.
+     * If graph_replaced is set the graph was replaced by a complete
+     * snapshot and the engine data structures are reinitialized first.
+     */
+    void load_engine_state(iarchive& iarc, bool graph_replaced);
 
   }; // end of class synchronous engine
 
@@ -1006,8 +1272,13 @@ namespace graphlab {
     ncpus(opts.get_ncpus()),
     threads(2*1024*1024 /* 2MB stack per fiber*/),
     thread_barrier(opts.get_ncpus()),
-    max_iterations(-1), snapshot_interval(-1), iteration_counter(0),
-    timeout(0), sched_allv(false),
+    max_iterations(-1), snapshot_interval(-1), resume_from_snapshot(false),
+    iteration_counter(0),
+    timeout(0), sched_allv(false), sparse(false), yield_fraction(0),
+    vlock_mode(lock_table::STRIPED_LOCKS),
+    lock_stripes(lock_table::DEFAULT_NUM_STRIPES),
+    message_cache_size(1024),
+    combine_signals(false),
     vprog_exchange(dc),
     vdata_exchange(dc),
     gather_exchange(dc),
@@ -1043,11 +1314,55 @@ namespace graphlab {
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: snapshot_path = "
             << snapshot_path << std::endl;
+      } else if (opt == "snapshot_full_interval") {
+        opts.get_engine_args().get_option("snapshot_full_interval",
+                                          snapshots.full_interval);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: snapshot_full_interval = "
+            << snapshots.full_interval << std::endl;
+      } else if (opt == "snapshot_async") {
+        opts.get_engine_args().get_option("snapshot_async",
+                                          snapshots.background);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: snapshot_async = "
+            << snapshots.background << std::endl;
+      } else if (opt == "snapshot_edges") {
+        opts.get_engine_args().get_option("snapshot_edges",
+                                          snapshots.save_edges);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: snapshot_edges = "
+            << snapshots.save_edges << std::endl;
       } else if (opt == "sched_allv") {
         opts.get_engine_args().get_option("sched_allv", sched_allv);
         if (rmi.procid() == 0)
           logstream(LOG_EMPH) << "Engine Option: sched_allv = "
             << sched_allv << std::endl;
+      } else if (opt == "sparse") {
+        opts.get_engine_args().get_option("sparse", sparse);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: sparse = "
+            << sparse << std::endl;
+      } else if (opt == "lock_table") {
+        std::string mode_name;
+        opts.get_engine_args().get_option("lock_table", mode_name);
+        if (!lock_table::parse_mode(mode_name, vlock_mode)) {
+          logstream(LOG_FATAL) << "Unknown lock_table " << mode_name
+            << ". Expected striped, vertex, bit or none" << std::endl;
+        }
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: lock_table = "
+            << mode_name << std::endl;
+      } else if (opt == "lock_stripes") {
+        opts.get_engine_args().get_option("lock_stripes", lock_stripes);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: lock_stripes = "
+            << lock_stripes << std::endl;
+      } else if (opt == "message_cache_size") {
+        opts.get_engine_args().get_option("message_cache_size",
+                                          message_cache_size);
+        if (rmi.procid() == 0)
+          logstream(LOG_EMPH) << "Engine Option: message_cache_size = "
+            << message_cache_size << std::endl;
       } else {
         logstream(LOG_FATAL) << "Unexpected Engine Option: " << opt << std::endl;
       }
@@ -1085,26 +1400,61 @@ namespace graphlab {
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>:: resize() {
     memory_info::log_usage("Before Engine Initialization");
-    // Allocate vertex locks and vertex programs
-    vlocks.resize(graph.num_local_vertices());
-    vertex_programs.resize(graph.num_local_vertices());
+    // Allocate vertex locks and vertex programs. A single worker in a
+    // single process is the only writer of all the per vertex state:
+    // the exchanges are drained by the workers and signals from other
+    // machines cannot arrive.
+    lock_table::lock_mode mode = vlock_mode;
+    const bool single_writer = ncpus <= 1 && rmi.numprocs() == 1;
+    if (single_writer) {
+      mode = lock_table::NO_LOCKS;
+    } else if (mode == lock_table::NO_LOCKS) {
+      logstream(LOG_WARNING)
+        << "lock_table=none requires a single thread and process. "
+        << "Using striped locks." << std::endl;
+      mode = lock_table::STRIPED_LOCKS;
+    }
+    vlocks.resize(graph.num_local_vertices(), mode, lock_stripes);
+    // In sparse mode the per vertex state is only allocated for the
+    // pages of vertices which are touched.
+    const size_t page_size =
+      sparse ? paged_vector<message_type>::DEFAULT_PAGE_SIZE : 0;
+    vertex_programs.resize(graph.num_local_vertices(), page_size);
     // allocate the edge locks
-    //elocks.resize(graph.num_local_edges());
+    //elocks.resize(graph.num_local_edges(), lock_table::STRIPED_LOCKS);
     // Allocate messages and message bitset
-    messages.resize(graph.num_local_vertices(), message_type());
-    has_message.resize(graph.num_local_vertices());
+    messages.resize(graph.num_local_vertices(), page_size);
+    has_message.resize(graph.num_local_vertices(), sparse);
+    // Allocate the per worker message caches. The cache size is
+    // rounded down to a power of two. Without locks there is no
+    // contention to avoid.
+    message_caches.clear();
+    if (message_cache_size > 0 && mode != lock_table::NO_LOCKS) {
+      size_t cache_size = 1;
+      while(2 * cache_size <= message_cache_size) cache_size *= 2;
+      message_caches.resize(fiber_control::get_instance().num_workers());
+      for (size_t i = 0; i < message_caches.size(); ++i) {
+        message_caches[i].lvids.resize(cache_size, lvid_type(-1));
+        message_caches[i].messages.resize(cache_size, message_type());
+      }
+    }
     // Allocate gather accumulators and accumulator bitset
-    gather_accum.resize(graph.num_local_vertices(), gather_type());
-    has_gather_accum.resize(graph.num_local_vertices());
+    gather_accum.resize(graph.num_local_vertices(), page_size);
+    has_gather_accum.resize(graph.num_local_vertices(), sparse);
 
     // If caching is used then allocate cache data-structures
     if (use_cache) {
-      gather_cache.resize(graph.num_local_vertices(), gather_type());
-      has_cache.resize(graph.num_local_vertices());
+      gather_cache.resize(graph.num_local_vertices(), page_size);
+      has_cache.resize(graph.num_local_vertices(), sparse);
     }
     // Allocate bitset to track active vertices on each bitset.
-    active_superstep.resize(graph.num_local_vertices());
-    active_minorstep.resize(graph.num_local_vertices());
+    active_superstep.resize(graph.num_local_vertices(), sparse);
+    active_minorstep.resize(graph.num_local_vertices(), sparse);
+
+    // If snapshots are taken, track the modified vertex pages
+    if (snapshot_interval >= 0) {
+      snapshots.resize(graph.num_local_vertices());
+    }
 
     // Print memory usage after initialization
     memory_info::log_usage("After Engine Initialization");
@@ -1175,15 +1525,53 @@ namespace graphlab {
   internal_signal(const vertex_type& vertex,
                   const message_type& message) {
     const lvid_type lvid = vertex.local_id();
-    vlocks[lvid].lock();
+    const size_t workerid = fiber_control::get_worker_id();
+    if (!combine_signals || workerid >= message_caches.size()) {
+      merge_message(lvid, message);
+      return;
+    }
+    message_cache& cache = message_caches[workerid];
+    const size_t slot = lvid & (cache.lvids.size() - 1);
+    if (cache.lvids[slot] == lvid) {
+      cache.messages[slot] += message;
+    } else {
+      if (cache.lvids[slot] != lvid_type(-1)) {
+        merge_message(cache.lvids[slot], cache.messages[slot]);
+      }
+      cache.lvids[slot] = lvid;
+      cache.messages[slot] = message;
+    }
+  } // end of internal_signal
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  merge_message(lvid_type lvid, const message_type& message) {
+    vlocks.lock(lvid);
     if( has_message.get(lvid) ) {
       messages[lvid] += message;
     } else {
       messages[lvid] = message;
       has_message.set_bit(lvid);
     }
-    vlocks[lvid].unlock();
-  } // end of internal_signal
+    vlocks.unlock(lvid);
+  } // end of merge_message
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  flush_message_cache(size_t workerid) {
+    if (workerid >= message_caches.size()) return;
+    message_cache& cache = message_caches[workerid];
+    for (size_t i = 0; i < cache.lvids.size(); ++i) {
+      if (cache.lvids[i] != lvid_type(-1)) {
+        merge_message(cache.lvids[i], cache.messages[i]);
+        cache.lvids[i] = lvid_type(-1);
+        // release the memory held by the message
+        cache.messages[i] = message_type();
+      }
+    }
+  } // end of flush_message_cache
 
 
   template<typename VertexProgram>
@@ -1200,8 +1588,10 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   internal_signal_rpc(vertex_id_type gvid,
                       const message_type& message) {
+    // rpc handlers may run on the engine workers after they flushed
+    // their caches, so remote signals are merged immediately
     if (graph.is_master(gvid)) {
-      internal_signal(graph.vertex(gvid), message);
+      merge_message(graph.local_vid(gvid), message);
     }
   } // end of internal_signal_rpc
 
@@ -1215,7 +1605,7 @@ namespace graphlab {
     const bool caching_enabled = !gather_cache.empty();
     if(caching_enabled) {
       const lvid_type lvid = vertex.local_id();
-      vlocks[lvid].lock();
+      vlocks.lock(lvid);
       if( has_cache.get(lvid) ) {
         gather_cache[lvid] += delta;
       } else {
@@ -1224,7 +1614,7 @@ namespace graphlab {
         // gather_cache[lvid] = delta;
         // has_cache.set_bit(lvid);
       }
-      vlocks[lvid].unlock();
+      vlocks.unlock(lvid);
     }
   } // end of post_delta
 
@@ -1235,14 +1625,30 @@ namespace graphlab {
     const bool caching_enabled = !gather_cache.empty();
     const lvid_type lvid = vertex.local_id();
     if(caching_enabled && has_cache.get(lvid)) {
-      vlocks[lvid].lock();
+      vlocks.lock(lvid);
       gather_cache[lvid] = gather_type();
       has_cache.clear_bit(lvid);
-      vlocks[lvid].unlock();
+      vlocks.unlock(lvid);
     }
   } // end of clear_gather_cache
 
 
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  clear_gather_caches(const vertex_set& vset) {
+    if (gather_cache.empty()) return;
+    // vertices added since the last run have no cache yet
+    const size_t ncached = has_cache.size();
+    foreach(size_t lvid, vset.get_lvid_bitset(graph)) {
+      if (lvid >= ncached) break;
+      if (has_cache.get(lvid)) {
+        gather_cache[lvid] = gather_type();
+        has_cache.clear_bit(lvid);
+      }
+    }
+  } // end of clear_gather_caches
+
+
 
 
   template<typename VertexProgram>
@@ -1279,7 +1685,14 @@ namespace graphlab {
     // Start the timer
     graphlab::timer timer; timer.start();
     start_time = timer::approx_time_seconds();
-    iteration_counter = 0;
+    // The graph may have been modified since the last run, so the
+    // first snapshot must be complete unless we resume from one.
+    if (resume_from_snapshot) {
+      resume_from_snapshot = false;
+    } else {
+      iteration_counter = 0;
+      snapshots.require_full();
+    }
     force_abort = false;
     execution_status::status_enum termination_reason =
       execution_status::UNSET;
@@ -1290,8 +1703,8 @@ namespace graphlab {
     aggregator.start();
     rmi.barrier();
 
-    if (snapshot_interval == 0) {
-      graph.save_binary(snapshot_path);
+    if (snapshot_interval == 0 && iteration_counter == 0) {
+      save_snapshot(snapshot_path);
     }
 
     float last_print = -5;
@@ -1332,6 +1745,17 @@ namespace graphlab {
        *   1) only master vertices have messages
        */
 
+      // Yield to another engine if the computation became sparse ----------
+      if (yield_fraction > 0) {
+        size_t total_messages = has_message.get_bits().popcount();
+        rmi.all_reduce(total_messages);
+        if (total_messages > 0 &&
+            total_messages < yield_fraction * graph.num_vertices()) {
+          termination_reason = execution_status::YIELDED;
+          break;
+        }
+      }
+
       // Receive Messages ---------------------------------------------------
       // Receive messages to master vertices and then synchronize
       // vertex programs with mirrors if gather is required
@@ -1416,10 +1840,15 @@ namespace graphlab {
       ++iteration_counter;
 
       if (snapshot_interval > 0 && iteration_counter % snapshot_interval == 0) {
-        graph.save_binary(snapshot_path);
+        save_snapshot(snapshot_path);
       }
     }
 
+    // make sure the last snapshot is on disk before returning
+    if (snapshot_interval >= 0 && !snapshots.wait()) {
+      logstream(LOG_ERROR) << "Failed to write the last snapshot" << std::endl;
+    }
+
     if (rmi.procid() == 0) {
       logstream(LOG_EMPH) << iteration_counter
                         << " iterations completed." << std::endl;
@@ -1460,11 +1889,12 @@ namespace graphlab {
     const size_t TRY_RECV_MOD = 100;
     size_t vcount = 0;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
+    tracked_bitset::cursor cursor;
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // claim a word at a time, skipping the words with no bits set
+      size_t lvid_block_start;
+      if (!has_message.next_word(shared_lvid_counter, cursor,
+                                 lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1503,12 +1933,13 @@ namespace graphlab {
     size_t vcount = 0;
     size_t nactive_inc = 0;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
+    tracked_bitset::cursor cursor;
 
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // claim a word at a time, skipping the words with no bits set
+      size_t lvid_block_start;
+      if (!has_message.next_word(shared_lvid_counter, cursor,
+                                 lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = has_message.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1569,12 +2000,13 @@ namespace graphlab {
     timer ti;
 
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // a word-size = 64 bit
+    tracked_bitset::cursor cursor;
 
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // claim a word at a time, skipping the words with no bits set
+      size_t lvid_block_start;
+      if (!active_minorstep.next_word(shared_lvid_counter, cursor,
+                                      lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1596,42 +2028,14 @@ namespace graphlab {
         } else {
           // recompute the local contribution to the gather
           const vertex_program_type& vprog = vertex_programs[lvid];
-          local_vertex_type local_vertex = graph.l_vertex(lvid);
-          const vertex_type vertex(local_vertex);
+          const vertex_type vertex(graph.l_vertex(lvid));
           const edge_dir_type gather_dir = vprog.gather_edges(context, vertex);
-          // Loop over in edges
-          size_t edges_touched = 0;
           vprog.pre_local_gather(accum);
-          if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.in_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
-              }
-              ++edges_touched;
-              // elocks[local_edge.id()].unlock();
-            }
-          } // end of if in_edges/all_edges
-            // Loop over out edges
-          if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
-            foreach(local_edge_type local_edge, local_vertex.out_edges()) {
-              edge_type edge(local_edge);
-              // elocks[local_edge.id()].lock();
-              if(accum_is_set) { // \todo hint likely
-                accum += vprog.gather(context, vertex, edge);
-              } else {
-                accum = vprog.gather(context, vertex, edge);
-                accum_is_set = true;
-              }
-              // elocks[local_edge.id()].unlock();
-              ++edges_touched;
-            }
-            INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
-          } // end of if out_edges/all_edges
+          const size_t edges_touched =
+            local_gather(lvid, vprog, context, gather_dir, accum, accum_is_set,
+                         typename boost::is_base_of<IS_BULK_GATHER,
+                                                    vertex_program_type>::type());
+          INCREMENT_EVENT(EVENT_GATHERS, edges_touched);
           vprog.post_local_gather(accum);
           // If caching is enabled then save the accumulator to the
           // cache for future iterations.  Note that it is possible
@@ -1663,6 +2067,134 @@ namespace graphlab {
   } // end of execute_gathers
 
 
+  template<typename VertexProgram>
+  template<typename VProg>
+  size_t synchronous_engine<VertexProgram>::
+  local_gather(lvid_type lvid, const VProg& vprog,
+               context_type& context, edge_dir_type gather_dir,
+               gather_type& accum, bool& accum_is_set, boost::false_type) {
+    local_vertex_type local_vertex = graph.l_vertex(lvid);
+    const vertex_type vertex(local_vertex);
+    size_t edges_touched = 0;
+    // Loop over in edges
+    if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+      foreach(local_edge_type local_edge, local_vertex.in_edges()) {
+        edge_type edge(local_edge);
+        // elocks.lock(local_edge.id());
+        if(accum_is_set) { // \todo hint likely
+          accum += vprog.gather(context, vertex, edge);
+        } else {
+          accum = vprog.gather(context, vertex, edge);
+          accum_is_set = true;
+        }
+        ++edges_touched;
+        // elocks.unlock(local_edge.id());
+      }
+    } // end of if in_edges/all_edges
+    // Loop over out edges
+    if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+      foreach(local_edge_type local_edge, local_vertex.out_edges()) {
+        edge_type edge(local_edge);
+        // elocks.lock(local_edge.id());
+        if(accum_is_set) { // \todo hint likely
+          accum += vprog.gather(context, vertex, edge);
+        } else {
+          accum = vprog.gather(context, vertex, edge);
+          accum_is_set = true;
+        }
+        // elocks.unlock(local_edge.id());
+        ++edges_touched;
+      }
+    } // end of if out_edges/all_edges
+    return edges_touched;
+  } // end of local_gather
+
+
+  template<typename VertexProgram>
+  template<typename VProg>
+  size_t synchronous_engine<VertexProgram>::
+  local_gather(lvid_type lvid, const VProg& vprog,
+               context_type& context, edge_dir_type gather_dir,
+               gather_type& accum, bool& accum_is_set, boost::true_type) {
+    const typename graph_type::local_graph_type& lgraph =
+      graph.get_local_graph();
+    const vertex_data_type* vdata = lgraph.vertex_data_array();
+    const edge_data_type* edata = lgraph.edge_data_array();
+    const vertex_data_type& self = vdata[lvid];
+    size_t edges_touched = 0;
+    // The first edge initializes the accumulator so that the loops
+    // are free of branches.
+#ifdef USE_DYNAMIC_LOCAL_GRAPH
+    // The adjacency of the dynamic local graph lives in linked blocks
+    // of (neighbor, edge id) pairs which are walked directly.
+    typedef typename graph_type::local_graph_type::adjacency_iterator
+      adjacency_iterator;
+    if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+      const std::pair<adjacency_iterator, adjacency_iterator> range =
+        lgraph.in_adjacency(lvid);
+      adjacency_iterator i = range.first;
+      if (!accum_is_set && i != range.second) {
+        accum = VProg::gather_edge(vdata[i->first], edata[i->second], self);
+        accum_is_set = true;
+        ++i; ++edges_touched;
+      }
+      for (; i != range.second; ++i) {
+        accum += VProg::gather_edge(vdata[i->first], edata[i->second], self);
+        ++edges_touched;
+      }
+    }
+    if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+      const std::pair<adjacency_iterator, adjacency_iterator> range =
+        lgraph.out_adjacency(lvid);
+      adjacency_iterator i = range.first;
+      if (!accum_is_set && i != range.second) {
+        accum = VProg::gather_edge(self, edata[i->second], vdata[i->first]);
+        accum_is_set = true;
+        ++i; ++edges_touched;
+      }
+      for (; i != range.second; ++i) {
+        accum += VProg::gather_edge(self, edata[i->second], vdata[i->first]);
+        ++edges_touched;
+      }
+    }
+#else
+    if(gather_dir == IN_EDGES || gather_dir == ALL_EDGES) {
+      const std::pair<edge_id_type, edge_id_type> range =
+        lgraph.in_edge_range(lvid);
+      const std::pair<lvid_type, edge_id_type>* in = lgraph.csc_sources();
+      edge_id_type i = range.first;
+      if (!accum_is_set && i < range.second) {
+        accum = VProg::gather_edge(vdata[in[i].first],
+                                   edata[in[i].second], self);
+        accum_is_set = true;
+        ++i;
+      }
+      for (; i < range.second; ++i) {
+        accum += VProg::gather_edge(vdata[in[i].first],
+                                    edata[in[i].second], self);
+      }
+      edges_touched += range.second - range.first;
+    }
+    if(gather_dir == OUT_EDGES || gather_dir == ALL_EDGES) {
+      const std::pair<edge_id_type, edge_id_type> range =
+        lgraph.out_edge_range(lvid);
+      const lvid_type* out = lgraph.csr_targets();
+      edge_id_type i = range.first;
+      if (!accum_is_set && i < range.second) {
+        accum = VProg::gather_edge(self, edata[i], vdata[out[i]]);
+        accum_is_set = true;
+        ++i;
+      }
+      for (; i < range.second; ++i) {
+        accum += VProg::gather_edge(self, edata[i], vdata[out[i]]);
+      }
+      edges_touched += range.second - range.first;
+    }
+#endif
+    return edges_touched;
+  } // end of local_gather
+
+
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
   execute_applys(const size_t thread_id) {
@@ -1672,11 +2204,12 @@ namespace graphlab {
     timer ti;
 
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset;  // allocate a word size = 64bits
+    tracked_bitset::cursor cursor;
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // claim a word at a time, skipping the words with no bits set
+      size_t lvid_block_start;
+      if (!active_superstep.next_word(shared_lvid_counter, cursor,
+                                      lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = active_superstep.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1694,13 +2227,15 @@ namespace graphlab {
         // the gather_accum was not set during the gather.
         const gather_type& accum = gather_accum[lvid];
         INCREMENT_EVENT(EVENT_APPLIES, 1);
+        const typename vdata_sync_type::snapshot before(vertex.data());
         vertex_programs[lvid].apply(context, vertex, accum);
+        snapshots.mark_dirty(lvid);
         // record an apply as a completed task
         ++completed_applys;
         // Clear the accumulator to save some memory
         gather_accum[lvid] = gather_type();
         // synchronize the changed vertex data with all mirrors
-        sync_vertex_data(lvid, thread_id);
+        sync_vertex_data(lvid, before, thread_id);
         // determine if a scatter operation is needed
         const vertex_program_type& const_vprog = vertex_programs[lvid];
         const vertex_type const_vertex = vertex;
@@ -1741,11 +2276,12 @@ namespace graphlab {
     context_type context(*this, graph);
     timer ti;
     fixed_dense_bitset<8 * sizeof(size_t)> local_bitset; // allocate a word size = 64 bits
+    tracked_bitset::cursor cursor;
     while (1) {
-      // increment by a word at a time
-      lvid_type lvid_block_start =
-                  shared_lvid_counter.inc_ret_last(8 * sizeof(size_t));
-      if (lvid_block_start >= graph.num_local_vertices()) break;
+      // claim a word at a time, skipping the words with no bits set
+      size_t lvid_block_start;
+      if (!active_minorstep.next_word(shared_lvid_counter, cursor,
+                                      lvid_block_start)) break;
       // get the bit field from has_message
       size_t lvid_bit_block = active_minorstep.containing_word(lvid_block_start);
       if (lvid_bit_block == 0) continue;
@@ -1765,9 +2301,9 @@ namespace graphlab {
         if(scatter_dir == IN_EDGES || scatter_dir == ALL_EDGES) {
           foreach(local_edge_type local_edge, local_vertex.in_edges()) {
             edge_type edge(local_edge);
-            // elocks[local_edge.id()].lock();
+            // elocks.lock(local_edge.id());
             vprog.scatter(context, vertex, edge);
-            // elocks[local_edge.id()].unlock();
+            // elocks.unlock(local_edge.id());
           }
 					++edges_touched;
         } // end of if in_edges/all_edges
@@ -1775,9 +2311,9 @@ namespace graphlab {
         if(scatter_dir == OUT_EDGES || scatter_dir == ALL_EDGES) {
           foreach(local_edge_type local_edge, local_vertex.out_edges()) {
             edge_type edge(local_edge);
-            // elocks[local_edge.id()].lock();
+            // elocks.lock(local_edge.id());
             vprog.scatter(context, vertex, edge);
-            // elocks[local_edge.id()].unlock();
+            // elocks.unlock(local_edge.id());
           }
 					++edges_touched;
         } // end of if out_edges/all_edges
@@ -1811,11 +2347,14 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_vertex_programs() {
     typename vprog_exchange_type::recv_buffer_type recv_buffer;
+    std::vector<lvid_type> lvids;
     while(vprog_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename vprog_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_prog_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+        graph.local_vids(buffer, lvids);
+        for (size_t j = 0; j < buffer.size(); ++j) {
+          const vid_prog_pair_type& pair = buffer[j];
+          const lvid_type lvid = lvids[j];
           //      ASSERT_FALSE(graph.l_is_master(lvid));
           vertex_programs[lvid] = pair.second;
           active_minorstep.set_bit(lvid);
@@ -1827,12 +2366,17 @@ namespace graphlab {
 
   template<typename VertexProgram>
   void synchronous_engine<VertexProgram>::
-  sync_vertex_data(lvid_type lvid, const size_t thread_id) {
+  sync_vertex_data(lvid_type lvid,
+                   const typename vdata_sync_type::snapshot& before,
+                   const size_t thread_id) {
     ASSERT_TRUE(graph.l_is_master(lvid));
     const vertex_id_type vid = graph.global_vid(lvid);
     local_vertex_type vertex = graph.l_vertex(lvid);
+    if (vertex.num_mirrors() == 0) return;
+    typename vdata_sync_type::value_type update;
+    if (!vdata_sync_type::diff(before, vertex.data(), update)) return;
     foreach(const procid_t& mirror, vertex.mirrors()) {
-      vdata_exchange.send(mirror, std::make_pair(vid, vertex.data()));
+      vdata_exchange.send(mirror, std::make_pair(vid, update));
     }
   } // end of sync_vertex_data
 
@@ -1844,13 +2388,17 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_vertex_data() {
     typename vdata_exchange_type::recv_buffer_type recv_buffer;
+    std::vector<lvid_type> lvids;
     while(vdata_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename vdata_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_vdata_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+        graph.local_vids(buffer, lvids);
+        for (size_t j = 0; j < buffer.size(); ++j) {
+          const vid_vdata_pair_type& pair = buffer[j];
+          const lvid_type lvid = lvids[j];
           ASSERT_FALSE(graph.l_is_master(lvid));
-          graph.l_vertex(lvid).data() = pair.second;
+          vdata_sync_type::apply(pair.second, graph.l_vertex(lvid).data());
+          snapshots.mark_dirty(lvid);
         }
       }
     }
@@ -1861,14 +2409,14 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   sync_gather(lvid_type lvid, const gather_type& accum, const size_t thread_id) {
     if(graph.l_is_master(lvid)) {
-      vlocks[lvid].lock();
+      vlocks.lock(lvid);
       if(has_gather_accum.get(lvid)) {
         gather_accum[lvid] += accum;
       } else {
         gather_accum[lvid] = accum;
         has_gather_accum.set_bit(lvid);
       }
-      vlocks[lvid].unlock();
+      vlocks.unlock(lvid);
     } else {
       const procid_t master = graph.l_master(lvid);
       const vertex_id_type vid = graph.global_vid(lvid);
@@ -1880,21 +2428,24 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_gathers() {
     typename gather_exchange_type::recv_buffer_type recv_buffer;
+    std::vector<lvid_type> lvids;
     while(gather_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename gather_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_gather_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+        graph.local_vids(buffer, lvids);
+        for (size_t j = 0; j < buffer.size(); ++j) {
+          const vid_gather_pair_type& pair = buffer[j];
+          const lvid_type lvid = lvids[j];
           const gather_type& accum = pair.second;
           ASSERT_TRUE(graph.l_is_master(lvid));
-          vlocks[lvid].lock();
+          vlocks.lock(lvid);
           if( has_gather_accum.get(lvid) ) {
             gather_accum[lvid] += accum;
           } else {
             gather_accum[lvid] = accum;
             has_gather_accum.set_bit(lvid);
           }
-          vlocks[lvid].unlock();
+          vlocks.unlock(lvid);
         }
       }
     }
@@ -1917,20 +2468,23 @@ namespace graphlab {
   void synchronous_engine<VertexProgram>::
   recv_messages() {
     typename message_exchange_type::recv_buffer_type recv_buffer;
+    std::vector<lvid_type> lvids;
     while(message_exchange.recv(recv_buffer)) {
       for (size_t i = 0;i < recv_buffer.size(); ++i) {
         typename message_exchange_type::buffer_type& buffer = recv_buffer[i].buffer;
-        foreach(const vid_message_pair_type& pair, buffer) {
-          const lvid_type lvid = graph.local_vid(pair.first);
+        graph.local_vids(buffer, lvids);
+        for (size_t j = 0; j < buffer.size(); ++j) {
+          const vid_message_pair_type& pair = buffer[j];
+          const lvid_type lvid = lvids[j];
           ASSERT_TRUE(graph.l_is_master(lvid));
-          vlocks[lvid].lock();
+          vlocks.lock(lvid);
           if( has_message.get(lvid) ) {
             messages[lvid] += pair.second;
           } else {
             messages[lvid] = pair.second;
             has_message.set_bit(lvid);
           }
-          vlocks[lvid].unlock();
+          vlocks.unlock(lvid);
         }
       }
     }
@@ -1938,6 +2492,117 @@ namespace graphlab {
 
 
 
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  save_snapshot(const std::string& prefix, bool full) {
+    bool ret = snapshots.save(rmi, graph, prefix, full,
+                              boost::bind(&synchronous_engine::save_engine_state,
+                                          this, _1));
+    rmi.barrier();
+    return ret;
+  } // end of save_snapshot
+
+
+  template<typename VertexProgram>
+  bool synchronous_engine<VertexProgram>::
+  load_snapshot(const std::string& prefix) {
+    if (!snapshots.load(rmi, graph, prefix,
+                        boost::bind(&synchronous_engine::load_engine_state,
+                                    this, _1, _2))) {
+      return false;
+    }
+    resume_from_snapshot = true;
+    if (rmi.procid() == 0) {
+      logstream(LOG_EMPH) << "Resuming at iteration " << iteration_counter
+                          << std::endl;
+    }
+    return true;
+  } // end of load_snapshot
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  set_yield_threshold(double fraction) {
+    yield_fraction = fraction;
+  } // end of set_yield_threshold
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  export_state(handoff_type& state) {
+    foreach(size_t lvid, has_message.get_bits()) {
+      state.add_message(lvid, messages[lvid]);
+      messages[lvid] = message_type();
+    }
+    has_message.clear();
+    if (!gather_cache.empty()) {
+      foreach(size_t lvid, has_cache.get_bits()) {
+        state.add_cache(lvid, gather_cache[lvid]);
+        gather_cache[lvid] = gather_type();
+      }
+      has_cache.clear();
+    }
+  } // end of export_state
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  import_state(const handoff_type& state) {
+    if (vlocks.size() != graph.num_local_vertices())
+      resize();
+    for (size_t i = 0; i < state.message_lvids.size(); ++i) {
+      merge_message(state.message_lvids[i], state.messages[i]);
+    }
+    if (!gather_cache.empty()) {
+      for (size_t i = 0; i < state.cache_lvids.size(); ++i) {
+        gather_cache[state.cache_lvids[i]] = state.caches[i];
+        has_cache.set_bit(state.cache_lvids[i]);
+      }
+    }
+  } // end of import_state
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  save_engine_state(oarchive& oarc) const {
+    oarc << iteration_counter << has_message;
+    foreach(size_t lvid, has_message.get_bits()) oarc << messages[lvid];
+    const bool caching_enabled = !gather_cache.empty();
+    oarc << caching_enabled;
+    if (caching_enabled) {
+      oarc << has_cache;
+      foreach(size_t lvid, has_cache.get_bits()) oarc << gather_cache[lvid];
+    }
+  } // end of save_engine_state
+
+
+  template<typename VertexProgram>
+  void synchronous_engine<VertexProgram>::
+  load_engine_state(iarchive& iarc, bool graph_replaced) {
+    // size and clear all the engine data structures to the new graph
+    if (graph_replaced) init();
+    iarc >> iteration_counter >> has_message;
+    ASSERT_EQ(has_message.size(), graph.num_local_vertices());
+    foreach(size_t lvid, has_message.get_bits()) iarc >> messages[lvid];
+    bool caching_enabled = false;
+    iarc >> caching_enabled;
+    if (caching_enabled) {
+      dense_bitset saved_cache;
+      iarc >> saved_cache;
+      gather_type accum;
+      foreach(size_t lvid, saved_cache) {
+        iarc >> accum;
+        // the cache is only restored if caching is enabled now
+        if (use_cache) {
+          gather_cache[lvid] = accum;
+          has_cache.set_bit(lvid);
+        }
+      }
+    }
+  } // end of load_engine_state
+
+
+
 
 
 
@@ -39,6 +39,7 @@
 #include <graphlab/util/stl_util.hpp>
 #include <graphlab/logger/logger.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/graph/graph_writer.hpp>
 
 
 
@@ -180,12 +181,15 @@ namespace graphlab {
 #endif
 
     template <typename Graph>
-    struct tsv_writer{
+    struct tsv_writer : public IS_APPEND_WRITER {
       typedef typename Graph::vertex_type vertex_type;
       typedef typename Graph::edge_type edge_type;
-      std::string save_vertex(vertex_type) { return ""; }
-      std::string save_edge(edge_type e) {
-        return tostr(e.source().id()) + "\t" + tostr(e.target().id()) + "\n";
+      void save_vertex(vertex_type, std::string&) { }
+      void save_edge(edge_type e, std::string& out) {
+        append_uint(out, e.source().id());
+        out += '\t';
+        append_uint(out, e.target().id());
+        out += '\n';
       }
     };
 
@@ -193,7 +197,7 @@ namespace graphlab {
 
     
     template <typename Graph>
-    struct graphjrl_writer{
+    struct graphjrl_writer : public IS_APPEND_WRITER {
       typedef typename Graph::vertex_type vertex_type;
       typedef typename Graph::edge_type edge_type;
 
@@ -203,6 +207,16 @@ namespace graphlab {
        * Replaces \\n with \255\0
        */
       static std::string escape_newline(charstream& strm) {
+        std::string ret;
+        escape_newline(strm, ret);
+        return ret;
+      }
+
+      /**
+       * \internal
+       * Like escape_newline(charstream&) but appends to out.
+       */
+      static void escape_newline(charstream& strm, std::string& out) {
         size_t ctr = 0;
         char *ptr = strm->c_str();
         size_t strmlen = strm->size();
@@ -210,27 +224,26 @@ namespace graphlab {
           ctr += (ptr[i] == (char)255 || ptr[i] == '\n');
         }
 
-        std::string ret(ctr + strmlen, 0);
+        size_t target = out.size();
+        out.resize(target + ctr + strmlen);
 
-        size_t target = 0;
         for (size_t i = 0;i < strmlen; ++i, ++ptr) {
           if ((*ptr) == (char)255) {
-            ret[target] = (char)255;
-            ret[target + 1] = 1;
+            out[target] = (char)255;
+            out[target + 1] = 1;
             target += 2;
           }
           else if ((*ptr) == '\n') {
-            ret[target] = (char)255;
-            ret[target + 1] = 0;
+            out[target] = (char)255;
+            out[target + 1] = 0;
             target += 2;
           }
           else {
-            ret[target] = (*ptr);
+            out[target] = (*ptr);
             ++target;
           }
         }
-        assert(target == ctr + strmlen);
-        return ret;
+        assert(target == out.size());
       }
 
       /**
@@ -265,20 +278,22 @@ namespace graphlab {
         return ret;
       }
       
-      std::string save_vertex(vertex_type v) {
+      void save_vertex(vertex_type v, std::string& out) {
         charstream strm(128);
         oarchive oarc(strm);
         oarc << char(0) << v.id() << v.data();
         strm.flush();
-        return escape_newline(strm) + "\n";
+        escape_newline(strm, out);
+        out += '\n';
       }
       
-      std::string save_edge(edge_type e) {
+      void save_edge(edge_type e, std::string& out) {
         charstream strm(128);
         oarchive oarc(strm);
         oarc << char(1) << e.source().id() << e.target().id() << e.data();
         strm.flush();
-        return escape_newline(strm) + "\n";
+        escape_newline(strm, out);
+        out += '\n';
       }
     };
 
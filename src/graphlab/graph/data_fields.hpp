@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_GRAPH_DATA_FIELDS_HPP
+#define GRAPHLAB_GRAPH_DATA_FIELDS_HPP
+
+#include <stdint.h>
+#include <boost/preprocessor.hpp>
+#include <boost/static_assert.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Describes the fields of a vertex or edge data type.
+   *
+   * The trait is empty unless specialized with
+   * \ref GRAPHLAB_DATA_FIELDS, in which case the engines which support
+   * it synchronize mirrors by shipping only the fields which changed.
+   * A specialization provides
+   *
+   * \code
+   * static const bool declared = true;
+   * static const size_t num_fields;
+   * // bit i is set if field i differs between before and after
+   * static uint64_t changed(const T& before, const T& after);
+   * // save, load or copy only the fields in mask
+   * static void save(oarchive& oarc, const T& value, uint64_t mask);
+   * static void load(iarchive& iarc, T& value, uint64_t mask);
+   * static void copy(T& dst, const T& src, uint64_t mask);
+   * \endcode
+   */
+  template <typename T>
+  struct data_fields {
+    static const bool declared = false;
+  };
+
+  /**
+   * \internal
+   * \brief The fields of a value selected by a mask. Only the
+   * selected fields are serialized.
+   */
+  template <typename T>
+  struct field_delta {
+    uint64_t mask;
+    T value;
+    field_delta() : mask(0) { }
+    void save(oarchive& oarc) const {
+      oarc << mask;
+      data_fields<T>::save(oarc, value, mask);
+    }
+    void load(iarchive& iarc) {
+      iarc >> mask;
+      data_fields<T>::load(iarc, value, mask);
+    }
+  }; // end of field_delta
+
+  /**
+   * \internal
+   * \brief Computes what must be sent to bring a replica of a value up
+   * to date after the value was modified.
+   *
+   * The snapshot is taken before the modification. The generic
+   * version remembers nothing and always sends the whole value.
+   */
+  template <typename T, bool Declared = data_fields<T>::declared>
+  struct data_sync {
+    typedef T value_type;
+    struct snapshot {
+      explicit snapshot(const T&) { }
+    };
+    /// Sets update to what must be sent. Returns false if nothing.
+    static bool diff(const snapshot&, const T& after, value_type& update) {
+      update = after;
+      return true;
+    }
+    static void apply(const value_type& update, T& replica) {
+      replica = update;
+    }
+  }; // end of data_sync
+
+  /**
+   * \internal
+   * Sends only the fields which differ from the snapshot, and nothing
+   * at all if no field changed.
+   */
+  template <typename T>
+  struct data_sync<T, true> {
+    typedef field_delta<T> value_type;
+    typedef T snapshot;
+    static bool diff(const snapshot& before, const T& after,
+                     value_type& update) {
+      update.mask = data_fields<T>::changed(before, after);
+      if (update.mask == 0) return false;
+      data_fields<T>::copy(update.value, after, update.mask);
+      return true;
+    }
+    static void apply(const value_type& update, T& replica) {
+      data_fields<T>::copy(replica, update.value, update.mask);
+    }
+  }; // end of data_sync
+
+} // end of namespace graphlab
+
+
+#define __GRAPHLAB_FIELD_BIT__(i) (uint64_t(1) << (i))
+
+#define __GRAPHLAB_FIELD_CHANGED__(r_unused, data_unused, i, field)     \
+  if (!(before.field == after.field)) mask |= __GRAPHLAB_FIELD_BIT__(i);
+
+#define __GRAPHLAB_FIELD_SAVE__(r_unused, data_unused, i, field)        \
+  if (mask & __GRAPHLAB_FIELD_BIT__(i)) oarc << value.field;
+
+#define __GRAPHLAB_FIELD_LOAD__(r_unused, data_unused, i, field)        \
+  if (mask & __GRAPHLAB_FIELD_BIT__(i)) iarc >> value.field;
+
+#define __GRAPHLAB_FIELD_COPY__(r_unused, data_unused, i, field)        \
+  if (mask & __GRAPHLAB_FIELD_BIT__(i)) dst.field = src.field;
+
+/**
+ * \brief Declares the fields of a vertex or edge data type.
+ *
+ * Must be used in the global namespace. Each field must be
+ * serializable and comparable with ==, and at most 64 fields may be
+ * listed. Fields which are not listed are never synchronized.
+ *
+ * \code
+ * struct vertex_data {
+ *   float dist;
+ *   std::vector<vertex_id_type> path;
+ * };
+ * GRAPHLAB_DATA_FIELDS(vertex_data, (dist)(path))
+ * \endcode
+ */
+#define GRAPHLAB_DATA_FIELDS(TYPE, FIELDS)                              \
+  namespace graphlab {                                                  \
+  template <>                                                           \
+  struct data_fields<TYPE> {                                            \
+    static const bool declared = true;                                  \
+    static const size_t num_fields = BOOST_PP_SEQ_SIZE(FIELDS);         \
+    BOOST_STATIC_ASSERT(BOOST_PP_SEQ_SIZE(FIELDS) <= 64);               \
+    static uint64_t changed(const TYPE& before, const TYPE& after) {    \
+      uint64_t mask = 0;                                                \
+      BOOST_PP_SEQ_FOR_EACH_I(__GRAPHLAB_FIELD_CHANGED__, _, FIELDS)    \
+      return mask;                                                      \
+    }                                                                   \
+    static void save(oarchive& oarc, const TYPE& value, uint64_t mask) { \
+      BOOST_PP_SEQ_FOR_EACH_I(__GRAPHLAB_FIELD_SAVE__, _, FIELDS)       \
+    }                                                                   \
+    static void load(iarchive& iarc, TYPE& value, uint64_t mask) {      \
+      BOOST_PP_SEQ_FOR_EACH_I(__GRAPHLAB_FIELD_LOAD__, _, FIELDS)       \
+    }                                                                   \
+    static void copy(TYPE& dst, const TYPE& src, uint64_t mask) {       \
+      BOOST_PP_SEQ_FOR_EACH_I(__GRAPHLAB_FIELD_COPY__, _, FIELDS)       \
+    }                                                                   \
+  };                                                                    \
+  }
+
+#endif
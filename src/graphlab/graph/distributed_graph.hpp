@@ -72,6 +72,7 @@
 
 #include <graphlab/graph/local_graph.hpp>
 #include <graphlab/graph/dynamic_local_graph.hpp>
+#include <graphlab/graph/vid2lvid_index.hpp>
 
 #include <graphlab/graph/graph_gather_apply.hpp>
 #include <graphlab/graph/ingress/distributed_ingress_base.hpp>
@@ -91,6 +92,8 @@
 
 
 #include <graphlab/graph/builtin_parsers.hpp>
+#include <graphlab/graph/graph_writer.hpp>
+#include <graphlab/util/block_output.hpp>
 #include <graphlab/graph/vertex_set.hpp>
 
 #include <graphlab/macros_def.hpp>
@@ -402,6 +405,10 @@ namespace graphlab {
     friend class distributed_oblivious_ingress<VertexData, EdgeData>;
     friend class distributed_constrained_random_ingress<VertexData, EdgeData>;
 
+    // Graphs of other data types may share our structure
+    template <typename OtherVertexData, typename OtherEdgeData>
+    friend class distributed_graph;
+
     typedef graphlab::vertex_id_type vertex_id_type;
     typedef graphlab::lvid_type lvid_type;
     typedef graphlab::edge_id_type edge_id_type;
@@ -603,6 +610,11 @@ namespace graphlab {
      *                Defaults to 50,000. Increasing this number will
      *                decrease partitioning time with a penalty to partitioning
      *                quality.
+     * \li \c pipelined_ingress The number of threads per machine which
+     *                insert received edges into the local graph while
+     *                the graph is being loaded, overlapping loading,
+     *                network transfer and insertion.  Defaults to 0,
+     *                in which case all edges are inserted by finalize().
      *
      * \param [in] dc Distributed controller to associate with
      * \param [in] opts A graphlab::graphlab_options object specifying engine
@@ -619,15 +631,93 @@ namespace graphlab {
 #else
       vertex_exchange(dc), 
 #endif
-      vset_exchange(dc), parallel_ingress(true) {
+      vset_exchange(dc), parallel_ingress(true), pipelined_ingress(0) {
       rpc.barrier();
       set_options(opts);
     }
 
+    /**
+     * \brief Constructs a graph with the structure of an existing
+     * finalized graph but with different vertex and edge data types.
+     *
+     * This is the cheap way to run a second computation which needs
+     * different data over the same topology (for instance edge
+     * weights computed from one algorithm used by another). The
+     * ingress is skipped entirely: the local adjacency (CSR and CSC
+     * indices) is shared with structure rather than copied, and the
+     * vertex and edge data are default constructed. The new graph is
+     * finalized on return. Must be called on all machines. See
+     * share_structure().
+     *
+     * \param [in] dc Distributed controller to associate with
+     * \param [in] structure A finalized graph whose structure to share
+     * \param [in] opts Graph options, as in the constructor above
+     */
+    template <typename OtherVertexData, typename OtherEdgeData>
+    distributed_graph(distributed_control& dc,
+                      const distributed_graph<OtherVertexData,
+                                              OtherEdgeData>& structure,
+                      const graphlab_options& opts = graphlab_options()) :
+      rpc(dc, this), finalized(false), vid2lvid(),
+      nverts(0), nedges(0), local_own_nverts(0), nreplicas(0),
+      ingress_ptr(NULL), 
+#ifdef _OPENMP
+      vertex_exchange(dc, omp_get_max_threads()), 
+#else
+      vertex_exchange(dc), 
+#endif
+      vset_exchange(dc), parallel_ingress(true), pipelined_ingress(0) {
+      rpc.barrier();
+      set_options(opts);
+      share_structure(structure);
+    }
+
     ~distributed_graph() {
       delete ingress_ptr; ingress_ptr = NULL;
     }
 
+    /**
+     * \brief Replaces the contents of this graph with the structure of
+     * a finalized graph with possibly different data types.
+     *
+     * The O(#edges) local adjacency is shared, not copied. The vertex
+     * records and the global to local vertex id map are copied
+     * (O(#local vertices)), as is the set of active machines (see
+     * set_active_procs()), and all vertex and edge data are default
+     * constructed. The shared adjacency is immutable, so either graph
+     * may later be cleared, loaded or destroyed independently. With
+     * the dynamic local graph either graph may also grow: its next
+     * finalize() copies the adjacency before inserting the new edges.
+     */
+    template <typename OtherVertexData, typename OtherEdgeData>
+    void share_structure(const distributed_graph<OtherVertexData,
+                                                 OtherEdgeData>& other) {
+      if (!other.finalized) {
+        logstream(LOG_FATAL)
+          << "\n\tAttempting to share the structure of a graph which"
+          << "\n\thas not been finalized." << std::endl;
+      }
+      clear();
+      local_graph.share_structure(other.local_graph);
+      lvid2record.resize(other.lvid2record.size());
+      for (size_t i = 0; i < lvid2record.size(); ++i) {
+        vertex_record& rec = lvid2record[i];
+        rec.owner = other.lvid2record[i].owner;
+        rec.gvid = other.lvid2record[i].gvid;
+        rec.num_in_edges = other.lvid2record[i].num_in_edges;
+        rec.num_out_edges = other.lvid2record[i].num_out_edges;
+        rec._mirrors = other.lvid2record[i]._mirrors;
+      }
+      vid2lvid = other.vid2lvid;
+      nverts = other.nverts;
+      nedges = other.nedges;
+      local_own_nverts = other.local_own_nverts;
+      nreplicas = other.nreplicas;
+      active_procs = other.active_procs;
+      lock_manager.resize(num_local_vertices());
+      finalized = true;
+    }
+
 
     lock_manager_type& get_lock_manager() {
       return lock_manager;
@@ -650,6 +740,11 @@ namespace graphlab {
           if (!parallel_ingress && rpc.procid() == 0)
             logstream(LOG_EMPH) << "Disable parallel ingress. Graph will be streamed through one node."
               << std::endl;
+        } else if (opt == "pipelined_ingress") {
+          opts.get_graph_args().get_option("pipelined_ingress", pipelined_ingress);
+          if (rpc.procid() == 0)
+            logstream(LOG_EMPH) << "Graph Option: pipelined_ingress = "
+              << pipelined_ingress << std::endl;
         }
         /**
          * These options below are deprecated.
@@ -1687,6 +1782,146 @@ namespace graphlab {
     }
 
 
+    /**
+     * \brief Moves the graph onto a new set of active machines.
+     *
+     * Only the active machines store edges and vertex masters. Machines
+     * which leave the active set hand all their edges and vertices over
+     * to the remaining machines, and machines which join it take over
+     * an even share of the edges, hashed by edge, from the machines
+     * already active. All other edges stay where they are, so only the
+     * edges which change machine are sent over the network. The local
+     * graphs, vid2lvid maps and mirror sets are then rebuilt as in
+     * finalize(), and the vertex data is kept.
+     *
+     * This allows the amount of machines working on the graph to change
+     * between engine runs without reloading it: a job may be started
+     * with the largest number of processes it will need, and machines
+     * are drained or admitted according to an external membership list
+     * (see graphlab::process_membership). Inactive machines still take
+     * part in every collective operation, but own no vertices and have
+     * no work to do.
+     *
+     * Must be called on all machines simultaneously, with the graph
+     * finalized and no engine running. The set of procs of machine 0 is
+     * used. Passing all the machines restores the default placement of
+     * the vertex masters.
+     *
+     * Edges added to the graph afterwards are placed by the ingress
+     * method over all the machines. The active set is not stored by
+     * save_binary(), so it must be set again after load_binary().
+     */
+    void set_active_procs(std::vector<procid_t> procs) {
+      ASSERT_TRUE(finalized);
+      rpc.broadcast(procs, rpc.procid() == 0);
+      std::sort(procs.begin(), procs.end());
+      procs.erase(std::unique(procs.begin(), procs.end()), procs.end());
+      if (procs.empty() || procs.back() >= rpc.numprocs()) {
+        logstream(LOG_FATAL) << "Invalid set of active machines" << std::endl;
+      }
+      std::vector<bool> was_active(rpc.numprocs(), active_procs.empty());
+      foreach(procid_t p, active_procs) was_active[p] = true;
+      if (procs.size() == rpc.numprocs()) procs.clear();
+      active_procs = procs;
+
+      size_t moved_edges = 0;
+      ingress_ptr->resend_graph(
+          elastic_edge_destination(*this, was_active, moved_edges));
+      rpc.all_reduce(moved_edges);
+      if (rpc.procid() == 0) {
+        logstream(LOG_EMPH) << "Moving " << moved_edges << " edges onto "
+                            << (active_procs.empty() ? rpc.numprocs() 
+                                                     : active_procs.size())
+                            << " active machines" << std::endl;
+      }
+      finalize();
+    } // end of set_active_procs
+
+    /**
+     * \brief Moves the edges to reduce the replication factor of the
+     * finalized graph.
+     *
+     * The ingress methods place each edge when it is loaded, before the
+     * degrees of its endpoints are known. rebalance() revisits this
+     * decision with the final degrees: every edge is assigned to its
+     * endpoint of lower degree (as in degree based hashing), and is
+     * placed on the machine which already holds the most edges of that
+     * endpoint. Low degree vertices therefore end up on a single
+     * machine, while the replicas are concentrated on the high degree
+     * vertices, which are replicated widely anyway. Keeping the edges
+     * where most of them already are also keeps the amount of edges
+     * moved low.
+     *
+     * If a machine would receive more than (1 + max_imbalance) times
+     * the average number of edges, the excess edges (chosen by edge
+     * hash) go to the home of their other endpoint instead.
+     *
+     * The edges which change machine are sent in bulk and the local
+     * graphs, vid2lvid maps and mirror sets are rebuilt as in
+     * finalize(). Vertex data and vertex masters are unchanged. The
+     * replication factor before and after is logged on machine 0.
+     *
+     * This is a one time cost roughly equal to a finalize(), and pays
+     * off for iterative computations running many supersteps. Must be
+     * called on all machines simultaneously, with the graph finalized
+     * and no engine running.
+     */
+    void rebalance(double max_imbalance = 0.1) {
+      ASSERT_TRUE(finalized);
+      if (rpc.numprocs() == 1) return;
+      timer ti; ti.start();
+      const double rf_before = double(nreplicas) / std::max<size_t>(nverts, 1);
+
+      // Elect the home of each vertex: the replica with the most edges
+      std::vector<procid_t> home(num_local_vertices(), rpc.procid());
+      graph_gather_apply<distributed_graph, rebalance_vote>
+          home_election(*this, rebalance_vote_gather,
+                        boost::bind(rebalance_vote_apply, _1, _2, _3,
+                                    boost::ref(home)));
+      home_election.exec();
+
+      // Limit the number of edges each machine receives
+      rebalance_edge_destination dest(*this, home);
+      std::vector<std::vector<size_t> > loads(rpc.numprocs());
+      loads[rpc.procid()].resize(rpc.numprocs(), 0);
+      for (lvid_type lvid = 0; lvid < num_local_vertices(); ++lvid) {
+        foreach(const local_edge_type& e, l_vertex(lvid).out_edges()) {
+          ++loads[rpc.procid()][dest.preferred(lvid, e.target().id())];
+        }
+      }
+      rpc.all_gather(loads);
+      const size_t nactive = get_active_procs().size();
+      const double capacity = (1.0 + max_imbalance) * nedges / nactive;
+      for (procid_t p = 0; p < rpc.numprocs(); ++p) {
+        size_t load = 0;
+        for (procid_t q = 0; q < rpc.numprocs(); ++q) load += loads[q][p];
+        if (load > capacity) dest.keep_fraction[p] = capacity / load;
+      }
+
+      ingress_ptr->resend_graph(dest);
+      size_t moved_edges = dest.moved_edges;
+      rpc.all_reduce(moved_edges);
+      finalize();
+      if (rpc.procid() == 0) {
+        logstream(LOG_EMPH) << "Rebalance moved " << moved_edges << " of "
+                            << nedges << " edges in " << ti.current_time() 
+                            << " secs. Replication factor: " << rf_before 
+                            << " -> " << double(nreplicas) / std::max<size_t>(nverts, 1)
+                            << std::endl;
+      }
+    } // end of rebalance
+
+    /**
+     * \brief Returns the machines holding graph data, in increasing order.
+     */
+    std::vector<procid_t> get_active_procs() const {
+      if (!active_procs.empty()) return active_procs;
+      std::vector<procid_t> ret(rpc.numprocs());
+      for (procid_t i = 0; i < rpc.numprocs(); ++i) ret[i] = i;
+      return ret;
+    }
+
+
     /** \brief Load a distributed graph from a native binary format
      * previously saved with save_binary(). This function must be called
      *  simultaneously on all machines.
@@ -1829,17 +2064,14 @@ namespace graphlab {
                          bool save_vertex = true,
                          bool save_edge = true,
                          size_t files_per_machine = 4) {
-      typedef boost::function<void(vertex_type)> vertex_function_type;
-      typedef boost::function<void(edge_type)> edge_function_type;
       typedef std::ofstream base_fstream_type;
-      typedef boost::iostreams::filtering_stream<boost::iostreams::output>
-        boost_fstream_type;
       rpc.full_barrier();
       finalize();
+      if (files_per_machine == 0) files_per_machine = 1;
       // figure out the filenames
       std::vector<std::string> graph_files;
       std::vector<base_fstream_type*> outstreams;
-      std::vector<boost_fstream_type*> booststreams;
+      std::vector<block_output*> outputs;
       graph_files.resize(files_per_machine);
       for(size_t i = 0; i < files_per_machine; ++i) {
         //graph_files[i] = prefix + "_" + tostr(1 + i + rpc.procid() * files_per_machine)
@@ -1848,48 +2080,34 @@ namespace graphlab {
         if (gzip) graph_files[i] += ".gz";
       }
 
-      // create the vector of callbacks
-      std::vector<vertex_function_type> vertex_callbacks(graph_files.size());
-      std::vector<edge_function_type> edge_callbacks(graph_files.size());
-
       for(size_t i = 0; i < graph_files.size(); ++i) {
         logstream(LOG_INFO) << "Saving to file: " << graph_files[i] << std::endl;
         // open the stream
         base_fstream_type* out_file =
           new base_fstream_type(graph_files[i].c_str(),
                                 std::ios_base::out | std::ios_base::binary);
-        // attach gzip if the file is gzip
-        boost_fstream_type* fout = new boost_fstream_type;
-        // Using gzip filter
-        if (gzip) fout->push(boost::iostreams::gzip_compressor());
-        fout->push(*out_file);
-
+        if (!out_file->good()) {
+          logstream(LOG_FATAL) << "\n\tError opening file: "
+                               << graph_files[i] << std::endl;
+        }
         outstreams.push_back(out_file);
-        booststreams.push_back(fout);
-        // construct the callback for the parallel for
-        typedef distributed_graph<vertex_data_type, edge_data_type> graph_type;
-        vertex_callbacks[i] =
-          boost::bind(&graph_type::template save_vertex_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), boost::ref(writer));
-        edge_callbacks[i] =
-          boost::bind(&graph_type::template save_edge_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), boost::ref(writer));
+        outputs.push_back(new block_output(*out_file, gzip));
       }
 
-      if (save_vertex) parallel_for_vertices(vertex_callbacks);
-      if (save_edge) parallel_for_edges(edge_callbacks);
+      save_to_block_outputs(writer, outputs, save_vertex, save_edge);
 
       // cleanup
       for(size_t i = 0; i < graph_files.size(); ++i) {
-        booststreams[i]->pop();
-        if (gzip) booststreams[i]->pop();
-        delete booststreams[i];
+        outputs[i]->finish();
+        if (outputs[i]->fail()) {
+          logstream(LOG_ERROR) << "Error writing file: "
+                               << graph_files[i] << std::endl;
+        }
+        delete outputs[i];
         delete outstreams[i];
       }
-      vertex_callbacks.clear();
-      edge_callbacks.clear();
       outstreams.clear();
-      booststreams.clear();
+      outputs.clear();
       rpc.full_barrier();
     } // end of save to posixfs
 
@@ -1906,17 +2124,17 @@ namespace graphlab {
                       bool save_vertex = true,
                       bool save_edge = true,
                       size_t files_per_machine = 4) {
-      typedef boost::function<void(vertex_type)> vertex_function_type;
-      typedef boost::function<void(edge_type)> edge_function_type;
       typedef graphlab::hdfs::fstream base_fstream_type;
       typedef boost::iostreams::filtering_stream<boost::iostreams::output>
         boost_fstream_type;
       rpc.full_barrier();
       finalize();
+      if (files_per_machine == 0) files_per_machine = 1;
       // figure out the filenames
       std::vector<std::string> graph_files;
       std::vector<base_fstream_type*> outstreams;
       std::vector<boost_fstream_type*> booststreams;
+      std::vector<block_output*> outputs;
       graph_files.resize(files_per_machine);
       for(size_t i = 0; i < files_per_machine; ++i) {
         graph_files[i] = prefix + "_" + tostr(1 + i + rpc.procid() * files_per_machine)
@@ -1932,47 +2150,36 @@ namespace graphlab {
       }
       hdfs& hdfs = hdfs::get_hdfs();
 
-      // create the vector of callbacks
-
-      std::vector<vertex_function_type> vertex_callbacks(graph_files.size());
-      std::vector<edge_function_type> edge_callbacks(graph_files.size());
-
       for(size_t i = 0; i < graph_files.size(); ++i) {
         logstream(LOG_INFO) << "Saving to file: " << graph_files[i] << std::endl;
         // open the stream
         base_fstream_type* out_file = new base_fstream_type(hdfs,
                                                             graph_files[i],
                                                             true);
-        // attach gzip if the file is gzip
+        // the blocks are compressed by block_output
         boost_fstream_type* fout = new boost_fstream_type;
-        // Using gzip filter
-        if (gzip) fout->push(boost::iostreams::gzip_compressor());
         fout->push(*out_file);
 
         outstreams.push_back(out_file);
         booststreams.push_back(fout);
-        // construct the callback for the parallel for
-        typedef distributed_graph<vertex_data_type, edge_data_type> graph_type;
-        vertex_callbacks[i] =
-          boost::bind(&graph_type::template save_vertex_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), writer);
-        edge_callbacks[i] =
-          boost::bind(&graph_type::template save_edge_to_stream<boost_fstream_type, Writer>,
-                      this, _1, boost::ref(*fout), writer);
+        outputs.push_back(new block_output(*fout, gzip));
       }
 
-      if (save_vertex) parallel_for_vertices(vertex_callbacks);
-      if (save_edge) parallel_for_edges(edge_callbacks);
+      save_to_block_outputs(writer, outputs, save_vertex, save_edge);
 
       // cleanup
       for(size_t i = 0; i < graph_files.size(); ++i) {
+        outputs[i]->finish();
+        if (outputs[i]->fail()) {
+          logstream(LOG_ERROR) << "Error writing file: "
+                               << graph_files[i] << std::endl;
+        }
         booststreams[i]->pop();
-        if (gzip) booststreams[i]->pop();
+        delete outputs[i];
         delete booststreams[i];
         delete outstreams[i];
       }
-      vertex_callbacks.clear();
-      edge_callbacks.clear();
+      outputs.clear();
       outstreams.clear();
       booststreams.clear();
       rpc.full_barrier();
@@ -1991,6 +2198,16 @@ namespace graphlab {
      * std::string Writer::save_vertex(graph_type::vertex_type v);
      * std::string Writer::save_edge(graph_type::edge_type e);
      * \endcode
+     * Alternatively, a Writer inheriting from
+     * \ref graphlab::IS_APPEND_WRITER implements
+     * \code
+     * void Writer::save_vertex(graph_type::vertex_type v, std::string& out);
+     * void Writer::save_edge(graph_type::edge_type e, std::string& out);
+     * \endcode
+     * and appends its output to out, which avoids allocating a string
+     * per vertex and edge.
+     *
+     * The Writer is called concurrently from multiple threads.
      *
      * The <code>save_vertex()</code> function will be called on each vertex
      * on the graph, and the output of the function is written to file.
@@ -2036,9 +2253,11 @@ namespace graphlab {
      * \li [prefix].3_of_16.gz
      * \li etc.
      *
-     * To accelerate the saving process, multiple files are be written
-     * per machine in parallel. If the gzip option is not set, the ".gz" suffix
-     * is not added.
+     * All threads on each machine format and compress the output in
+     * parallel. Compressed files are written as a sequence of
+     * independently compressed gzip members which standard gzip tools
+     * read as a single file. If the gzip option is not set, the ".gz"
+     * suffix is not added.
      *
      * For instance, if there are 4 machines, running:
      * \code
@@ -2075,8 +2294,9 @@ namespace graphlab {
      *             appended with the .gz suffix. Defaults to true.
      * \param save_vertex If vertices should be saved. Defaults to true.
      * \param save_edges If edges should be saved. Defaults to true.
-     * \param files_per_machine Number of files to write simultaneously in
-     *                          parallel per machine. Defaults to 4.
+     * \param files_per_machine Number of files to write per machine.
+     *                          Does not affect the parallelism. If 0, a
+     *                          single file is written. Defaults to 4.
      */
     template<typename Writer>
     void save(const std::string& prefix, Writer writer,
@@ -2126,8 +2346,9 @@ namespace graphlab {
      * \param gzip If gzip compression should be used. If set, all files will be
      *             appended with the .gz suffix. Defaults to true. Ignored
      *             if format == "bin".
-     * \param files_per_machine Number of files to write simultaneously in
-     *                          parallel per machine. Defaults to 4. Ignored if
+     * \param files_per_machine Number of files to write per machine. All
+     *                          threads are used regardless. If 0, a single
+     *                          file is written. Defaults to 4. Ignored if
      *                          format == "bin".
      */
     void save_format(const std::string& prefix, const std::string& format,
@@ -2673,12 +2894,35 @@ namespace graphlab {
     /** \internal
      *\brief Convert a global vid to a local vid */
     lvid_type local_vid (const vertex_id_type vid) const {
-      // typename boost::unordered_map<vertex_id_type, lvid_type>::
-      //   const_iterator iter = vid2lvid.find(vid);
-      typename hopscotch_map_type::const_iterator iter = vid2lvid.find(vid);
+      vid2lvid_map_type::const_iterator iter = vid2lvid.find(vid);
       return iter->second;
     } // end of local_vertex_id
 
+    /** \internal
+     * \brief Convert the global vids of a sequence of (vid, value)
+     * pairs to local vids, writing lvids[i] for the i-th pair.
+     *
+     * The lookups are pipelined: the slot of a vid a few positions
+     * ahead is prefetched while the current one is resolved, which
+     * hides most of the cache misses of a large receive buffer.
+     */
+    template <typename PairVector>
+    void local_vids(const PairVector& pairs,
+                    std::vector<lvid_type>& lvids) const {
+      const size_t PREFETCH_DISTANCE = 8;
+      const size_t n = pairs.size();
+      lvids.resize(n);
+      for (size_t i = 0; i < std::min(n, PREFETCH_DISTANCE); ++i) {
+        vid2lvid.prefetch(pairs[i].first);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        if (i + PREFETCH_DISTANCE < n) {
+          vid2lvid.prefetch(pairs[i + PREFETCH_DISTANCE].first);
+        }
+        lvids[i] = vid2lvid.find(pairs[i].first)->second;
+      }
+    } // end of local_vids
+
     /** \internal
      *\brief Convert a local vid to a global vid */
     vertex_id_type global_vid(const lvid_type lvid) const {
@@ -2757,9 +3001,7 @@ namespace graphlab {
      * \brief Returns the internal vertex record of a given global vertex ID
      */
     const vertex_record& get_vertex_record(vertex_id_type vid) const {
-      // typename boost::unordered_map<vertex_id_type, lvid_type>::
-      //   const_iterator iter = vid2lvid.find(vid);
-      typename hopscotch_map_type::const_iterator iter = vid2lvid.find(vid);
+      vid2lvid_map_type::const_iterator iter = vid2lvid.find(vid);
       ASSERT_TRUE(iter != vid2lvid.end());
       return lvid2record[iter->second];
     }
@@ -2785,14 +3027,18 @@ namespace graphlab {
      *        master vertex on this machine and false otherwise.
      */
     bool is_master(vertex_id_type vid) const {
-      const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
-      return (owning_proc == rpc.procid());
+      return (master(vid) == rpc.procid());
     }
 
 
+    /** \internal
+     * \brief Returns the master procid for the global vertex ID vid.
+     * Masters are hashed over the active machines (see set_active_procs()).
+     */
     procid_t master(vertex_id_type vid) const {
-      const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
-      return owning_proc;
+      const size_t hash = graph_hash::hash_vertex(vid);
+      if (active_procs.empty()) return hash % rpc.numprocs();
+      return active_procs[hash % active_procs.size()];
     }
 
     /** \internal
@@ -3135,12 +3381,12 @@ namespace graphlab {
     /** The map from global vertex ids to vertex records */
     std::vector<vertex_record>  lvid2record;
 
-    // boost::unordered_map<vertex_id_type, lvid_type> vid2lvid;
-    /** The map from global vertex ids back to local vertex ids */
+    /** The map used by the ingress to buffer newly seen vertices */
     typedef hopscotch_map<vertex_id_type, lvid_type> hopscotch_map_type;
-    typedef hopscotch_map_type vid2lvid_map_type;
+    /** The map from global vertex ids back to local vertex ids */
+    typedef vid2lvid_index vid2lvid_map_type;
 
-    hopscotch_map_type vid2lvid;
+    vid2lvid_map_type vid2lvid;
 
 
     /** The global number of vertices and edges */
@@ -3164,9 +3410,130 @@ namespace graphlab {
     /** Command option to disable parallel ingress. Used for simulating single node ingress */
     bool parallel_ingress;
 
+    /** Number of receiver threads used for pipelined ingress. 0 if disabled */
+    size_t pipelined_ingress;
+
+    /** The machines which hold graph data, in increasing order. Empty if
+     *  all machines are active. See set_active_procs() */
+    std::vector<procid_t> active_procs;
+
 
     lock_manager_type lock_manager;
 
+    /**
+     * \internal
+     * The machine an edge moves to in set_active_procs(). Each edge is
+     * hashed to a candidate among the active machines. The edge moves if
+     * this machine is no longer active, or if the candidate has just
+     * become active; otherwise it stays.
+     */
+    struct elastic_edge_destination {
+      const distributed_graph& graph;
+      const std::vector<bool>& was_active;
+      size_t& moved_edges;
+      elastic_edge_destination(const distributed_graph& graph,
+                               const std::vector<bool>& was_active,
+                               size_t& moved_edges) :
+        graph(graph), was_active(was_active), moved_edges(moved_edges) { }
+
+      procid_t operator()(vertex_id_type source, vertex_id_type target) {
+        const procid_t me = graph.rpc.procid();
+        const std::vector<procid_t>& active = graph.active_procs;
+        const size_t hash = 
+            graph_hash::hash_edge(std::make_pair(source, target));
+        const procid_t candidate = active.empty() ? 
+            procid_t(hash % graph.rpc.numprocs()) : 
+            active[hash % active.size()];
+        const bool me_active = active.empty() || 
+            std::binary_search(active.begin(), active.end(), me);
+        if (me_active && was_active[candidate]) return me;
+        if (candidate != me) ++moved_edges;
+        return candidate;
+      }
+    };
+
+    /**
+     * \internal
+     * A vote for the home of a vertex in rebalance(): the machine with
+     * the most edges of the vertex, ties broken by lower procid.
+     */
+    struct rebalance_vote : public IS_POD_TYPE {
+      size_t count;
+      procid_t proc;
+      rebalance_vote() : count(0), proc(-1) { }
+      rebalance_vote& operator+=(const rebalance_vote& other) {
+        if (other.count > count || 
+            (other.count == count && other.proc < proc)) {
+          count = other.count; proc = other.proc;
+        }
+        return *this;
+      }
+    };
+
+    static rebalance_vote rebalance_vote_gather(lvid_type lvid, 
+                                                distributed_graph& graph) {
+      rebalance_vote vote;
+      vote.count = graph.l_vertex(lvid).num_in_edges() + 
+                   graph.l_vertex(lvid).num_out_edges();
+      vote.proc = graph.procid();
+      return vote;
+    }
+
+    static void rebalance_vote_apply(lvid_type lvid, const rebalance_vote& vote,
+                                     distributed_graph& graph,
+                                     std::vector<procid_t>& home) {
+      home[lvid] = vote.proc;
+    }
+
+    /**
+     * \internal
+     * The machine an edge moves to in rebalance(): the home of its
+     * endpoint of lower degree, unless that machine is over capacity,
+     * in which case a keep_fraction of its edges stay and the rest go to
+     * the home of the other endpoint.
+     */
+    struct rebalance_edge_destination {
+      const distributed_graph& graph;
+      const std::vector<procid_t>& home;
+      std::vector<double> keep_fraction;
+      size_t moved_edges;
+      rebalance_edge_destination(const distributed_graph& graph,
+                                 const std::vector<procid_t>& home) :
+        graph(graph), home(home), 
+        keep_fraction(graph.rpc.numprocs(), 1.0), moved_edges(0) { }
+
+      size_t degree(lvid_type lvid) const {
+        const vertex_record& rec = graph.lvid2record[lvid];
+        return rec.num_in_edges + rec.num_out_edges;
+      }
+
+      /// Returns true if the source is the endpoint of lower degree
+      bool source_is_lower(lvid_type source, lvid_type target) const {
+        const size_t sdeg = degree(source), tdeg = degree(target);
+        return sdeg < tdeg || (sdeg == tdeg && 
+            graph.lvid2record[source].gvid < graph.lvid2record[target].gvid);
+      }
+
+      procid_t preferred(lvid_type source, lvid_type target) const {
+        return source_is_lower(source, target) ? home[source] : home[target];
+      }
+
+      procid_t operator()(vertex_id_type source, vertex_id_type target) {
+        const lvid_type slvid = graph.local_vid(source);
+        const lvid_type tlvid = graph.local_vid(target);
+        procid_t proc = preferred(slvid, tlvid);
+        if (keep_fraction[proc] < 1.0) {
+          const size_t hash = 
+              graph_hash::hash_edge(std::make_pair(source, target));
+          if (double(hash % 1024) >= keep_fraction[proc] * 1024) {
+            proc = source_is_lower(slvid, tlvid) ? home[tlvid] : home[slvid];
+          }
+        }
+        if (proc != graph.procid()) ++moved_edges;
+        return proc;
+      }
+    };
+
     void set_ingress_method(const std::string& method,
         size_t bufsize = 50000, bool usehash = false, bool userecent = false) {
       if(ingress_ptr != NULL) { delete ingress_ptr; ingress_ptr = NULL; }
@@ -3200,6 +3567,7 @@ namespace graphlab {
         }
         if (rpc.procid() == 0)logstream(LOG_EMPH) << "Automatically determine ingress method: " << ingress_auto << std::endl;
       }
+      ingress_ptr->set_pipelined(pipelined_ingress);
       // batch ingress is deprecated
       // if (method == "batch") {
       //   logstream(LOG_EMPH) << "Use batch ingress, bufsize: " << bufsize
@@ -3242,17 +3610,56 @@ namespace graphlab {
     } // end of load from stream
 
 
-    template<typename Fstream, typename Writer>
-    void save_vertex_to_stream(vertex_type& vertex, Fstream& fout, Writer writer) {
-      fout << writer.save_vertex(vertex);
-    } // end of save_vertex_to_stream
-
-
-    template<typename Fstream, typename Writer>
-    void save_edge_to_stream(edge_type& edge, Fstream& fout, Writer writer) {
-      std::string ret = writer.save_edge(edge);
-      fout << ret;
-    } // end of save_edge_to_stream
+    /**
+     * \internal
+     * Writes the vertices owned by this machine and/or all local edges
+     * to the outputs using the Writer.  All threads format records
+     * into private buffers which are compressed and written in large
+     * blocks, so the parallelism is not limited by the number of
+     * outputs.  Thread i writes to output i % outputs.size().
+     */
+    template<typename Writer>
+    void save_to_block_outputs(Writer& writer,
+                               std::vector<block_output*>& outputs,
+                               bool save_vertex, bool save_edge) {
+      typedef graph_writer_dispatch<Writer> dispatch_type;
+      const int nverts = (int)local_graph.num_vertices();
+      for (int pass = 0; pass < 2; ++pass) {
+        // vertices are written before the edges
+        const bool vertex_pass = (pass == 0);
+        if (vertex_pass ? !save_vertex : !save_edge) continue;
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+#ifdef _OPENMP
+          const size_t threadid = omp_get_thread_num();
+#else
+          const size_t threadid = 0;
+#endif
+          block_output& output = *outputs[threadid % outputs.size()];
+          std::string buffer, scratch;
+          buffer.reserve(block_output::BLOCK_SIZE + 4096);
+#ifdef _OPENMP
+          #pragma omp for schedule(dynamic, 1024)
+#endif
+          for (int i = 0; i < nverts; ++i) {
+            if (vertex_pass) {
+              if (lvid2record[i].owner == rpc.procid()) {
+                dispatch_type::save_vertex(writer, vertex_type(l_vertex(i)),
+                                           buffer);
+              }
+            } else {
+              foreach(const local_edge_type& e, l_vertex(i).in_edges()) {
+                dispatch_type::save_edge(writer, edge_type(e), buffer);
+              }
+            }
+            output.write_if_full(buffer, scratch);
+          }
+          output.write_block(buffer, scratch);
+        }
+      }
+    } // end of save_to_block_outputs
 
 
     void save_bintsv4_to_stream(std::ostream& out) {
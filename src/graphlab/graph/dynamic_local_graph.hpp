@@ -45,6 +45,7 @@
 #include <boost/iterator/counting_iterator.hpp>
 #include <boost/iterator/zip_iterator.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/local_edge_buffer.hpp>
@@ -65,6 +66,20 @@
 
 
 namespace graphlab {
+
+  /**
+   * \internal
+   * The CSR and CSC storage of a dynamic_local_graph. It does not
+   * depend on the vertex and edge data types, so that dynamic local
+   * graphs of different types can share it.
+   */
+  struct dynamic_local_graph_adjacency {
+    typedef dynamic_csr_storage<std::pair<lvid_type, edge_id_type>,
+                                edge_id_type> csr_type;
+    csr_type csr;
+    csr_type csc;
+  };
+
   template<typename VertexData, typename EdgeData>
   class dynamic_local_graph {
   public:
@@ -98,11 +113,34 @@ namespace graphlab {
 
     // CONSTRUCTORS ============================================================>
     /** Create an empty local_graph. */
-    dynamic_local_graph()  { }
+    dynamic_local_graph() : adjacency(new adjacency_type) { }
 
     /** Create a local_graph with nverts vertices. */
     dynamic_local_graph(size_t nverts) :
-      vertices(nverts)  {}
+      vertices(nverts), adjacency(new adjacency_type) {}
+
+    /**
+     * Copying a dynamic_local_graph copies its structure instead of
+     * sharing it
+     */
+    dynamic_local_graph(const dynamic_local_graph& other) :
+      vertices(other.vertices), adjacency(new adjacency_type),
+      edges(other.edges), edge_buffer(other.edge_buffer) {
+      adjacency->csr.copy_from(other.adjacency->csr);
+      adjacency->csc.copy_from(other.adjacency->csc);
+    }
+
+    dynamic_local_graph& operator=(const dynamic_local_graph& other) {
+      if (this != &other) {
+        vertices = other.vertices;
+        edges = other.edges;
+        adjacency.reset(new adjacency_type);
+        adjacency->csr.copy_from(other.adjacency->csr);
+        adjacency->csc.copy_from(other.adjacency->csc);
+        edge_buffer = other.edge_buffer;
+      }
+      return *this;
+    }
 
     // METHODS =================================================================>
 
@@ -116,8 +154,8 @@ namespace graphlab {
     void clear() {
       vertices.clear();
       edges.clear();
-      _csc_storage.clear();
-      _csr_storage.clear();
+      // the structure may be shared with other graphs
+      adjacency.reset(new adjacency_type);
       std::vector<VertexData>().swap(vertices);
       std::vector<EdgeData>().swap(edges);
       edge_buffer.clear();
@@ -295,13 +333,22 @@ namespace graphlab {
       }
       ASSERT_EQ(csc_values.size(), csr_values.size());
 
+      // the storage is modified in place below, so take a private
+      // copy of a structure shared with other graphs
+      if (!adjacency.unique()) {
+        boost::shared_ptr<adjacency_type> copy(new adjacency_type);
+        copy->csr.copy_from(adjacency->csr);
+        copy->csc.copy_from(adjacency->csc);
+        adjacency = copy;
+      }
+
       // fast path with first time insertion.
       if (edges.size() == 0) {
         edges.swap(edge_buffer.data);
         edge_buffer.clear();
         // warp into csr csc storage.
-        _csr_storage.wrap(src_counting_prefix_sum, csr_values);
-        _csc_storage.wrap(dest_counting_prefix_sum, csc_values);
+        adjacency->csr.wrap(src_counting_prefix_sum, csr_values);
+        adjacency->csc.wrap(dest_counting_prefix_sum, csc_values);
       } else {
         // insert edge data
         edges.reserve(edges.size() + edge_buffer.size());
@@ -315,7 +362,7 @@ namespace graphlab {
               ? csr_values.size()
               : src_counting_prefix_sum[i+1];
           if (end > begin) {
-            _csr_storage.insert(i, csr_values.begin()+begin, csr_values.begin()+end);
+            adjacency->csr.insert(i, csr_values.begin()+begin, csr_values.begin()+end);
           }
         }
         for (size_t i = 0; i < dest_counting_prefix_sum.size(); ++i) {
@@ -324,14 +371,14 @@ namespace graphlab {
               ? csc_values.size()
               : dest_counting_prefix_sum[i+1];
           if (end > begin) {
-            _csc_storage.insert(i, csc_values.begin()+begin, csc_values.begin()+end);
+            adjacency->csc.insert(i, csc_values.begin()+begin, csc_values.begin()+end);
           }
         }
-        _csr_storage.repack();
-        _csc_storage.repack();
+        adjacency->csr.repack();
+        adjacency->csc.repack();
       }
-      ASSERT_EQ(_csr_storage.num_values(), _csc_storage.num_values());
-      ASSERT_EQ(_csr_storage.num_values(), edges.size());
+      ASSERT_EQ(adjacency->csr.num_values(), adjacency->csc.num_values());
+      ASSERT_EQ(adjacency->csr.num_values(), edges.size());
 
 #ifdef DEBUG_GRAPH
       logstream(LOG_DEBUG) << "End of finalize." << std::endl;
@@ -340,8 +387,8 @@ namespace graphlab {
                           << " secs" << std::endl;
 
 #ifdef DEBUG_GRAPH
-      _csr_storage.meminfo(std::cerr);
-      _csc_storage.meminfo(std::cerr);
+      adjacency->csr.meminfo(std::cerr);
+      adjacency->csc.meminfo(std::cerr);
 #endif
     } // End of finalize
 
@@ -352,8 +399,8 @@ namespace graphlab {
       // read the vertices
       arc >> vertices
           >> edges
-          >> _csr_storage
-          >> _csc_storage;
+          >> adjacency->csr
+          >> adjacency->csc;
     } // end of load
 
     /** \brief Save the local_graph to an archive */
@@ -361,18 +408,36 @@ namespace graphlab {
       // Write the number of edges and vertices
       arc << vertices
           << edges
-          << _csr_storage
-          << _csc_storage;
+          << adjacency->csr
+          << adjacency->csc;
     } // end of save
 
     /** swap two graphs */
     void swap(dynamic_local_graph& other) {
       std::swap(vertices, other.vertices);
       std::swap(edges, other.edges);
-      std::swap(_csr_storage, other._csr_storage);
-      std::swap(_csc_storage, other._csc_storage);
+      adjacency.swap(other.adjacency);
     } // end of swap
 
+    /**
+     * \brief Resets this graph to the structure of a finalized graph
+     * with possibly different data types, without copying it.
+     *
+     * The CSR and CSC storage is shared with other and all vertex and
+     * edge data are default constructed. The shared structure is
+     * never modified: clearing either graph detaches it, and adding
+     * edges to either graph copies it on the next finalize.
+     */
+    template <typename OtherVertexData, typename OtherEdgeData>
+    void share_structure(const dynamic_local_graph<OtherVertexData,
+                                                   OtherEdgeData>& other) {
+      ASSERT_EQ(other.edge_buffer.size(), 0);
+      clear();
+      adjacency = other.adjacency;
+      vertices.resize(other.num_vertices());
+      edges.resize(other.num_edges());
+    }
+
 
     /** \brief Load the local_graph from a file */
     void load(const std::string& filename) {
@@ -426,14 +491,14 @@ namespace graphlab {
      * \internal
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_in_edges(const lvid_type v) const {
-      return _csc_storage.begin(v).pdistance_to(_csc_storage.end(v));
+      return adjacency->csc.begin(v).pdistance_to(adjacency->csc.end(v));
     }
 
     /**
      * \internal
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_out_edges(const lvid_type v) const {
-      return _csr_storage.begin(v).pdistance_to(_csr_storage.end(v));
+      return adjacency->csr.begin(v).pdistance_to(adjacency->csr.end(v));
     }
 
     /**
@@ -441,9 +506,9 @@ namespace graphlab {
      * \brief Returns a list of in edges of the vertex with the given id. */
     edge_list_type in_edges(lvid_type v) {
       edge_iterator begin = edge_iterator(*this, edge_iterator::CSC,
-                                          _csc_storage.begin(v), v);
+                                          adjacency->csc.begin(v), v);
       edge_iterator end = edge_iterator(*this, edge_iterator::CSC,
-                                        _csc_storage.end(v), v);
+                                        adjacency->csc.end(v), v);
       return boost::make_iterator_range(begin, end);
     }
 
@@ -452,9 +517,9 @@ namespace graphlab {
      * \brief Returns a list of out edges of the vertex with the given id. */
     edge_list_type out_edges(lvid_type v) {
       edge_iterator begin = edge_iterator(*this, edge_iterator::CSR,
-                                          _csr_storage.begin(v), v);
+                                          adjacency->csr.begin(v), v);
       edge_iterator end = edge_iterator(*this, edge_iterator::CSR,
-                                        _csr_storage.end(v), v);
+                                        adjacency->csr.end(v), v);
       return boost::make_iterator_range(begin, end);
     }
 
@@ -475,14 +540,59 @@ namespace graphlab {
       return edges[eid];
     }
 
+    /**
+     * \internal
+     * \brief Iterates over the (neighbor lvid, edge id) pairs of the
+     * adjacency of a vertex without building edge_type objects.
+     */
+    typedef dynamic_local_graph_adjacency::csr_type::const_iterator
+      adjacency_iterator;
+
+    /**
+     * \internal
+     * \brief Returns the (target, edge id) pairs of the out edges of v.
+     */
+    std::pair<adjacency_iterator, adjacency_iterator>
+    out_adjacency(lvid_type v) const {
+      return std::make_pair(adjacency_iterator(adjacency->csr.begin(v)),
+                            adjacency_iterator(adjacency->csr.end(v)));
+    }
+
+    /**
+     * \internal
+     * \brief Returns the (source, edge id) pairs of the in edges of v.
+     */
+    std::pair<adjacency_iterator, adjacency_iterator>
+    in_adjacency(lvid_type v) const {
+      return std::make_pair(adjacency_iterator(adjacency->csc.begin(v)),
+                            adjacency_iterator(adjacency->csc.end(v)));
+    }
+
+    /**
+     * \internal
+     * \brief Returns the contiguous array of vertex data, indexed by lvid.
+     */
+    const VertexData* vertex_data_array() const {
+      return vertices.empty() ? NULL : &vertices[0];
+    }
+
+    /**
+     * \internal
+     * \brief Returns the contiguous array of edge data, indexed by
+     * edge id.
+     */
+    const EdgeData* edge_data_array() const {
+      return edges.empty() ? NULL : &edges[0];
+    }
+
     /**
      * \internal
      * \brief Returns the estimated memory footprint of the local_graph. */
     size_t estimate_sizeof() const {
       const size_t vlist_size = sizeof(vertices) +
         sizeof(VertexData) * vertices.capacity();
-      size_t elist_size = _csr_storage.estimate_sizeof()
-          + _csc_storage.estimate_sizeof()
+      size_t elist_size = adjacency->csr.estimate_sizeof()
+          + adjacency->csc.estimate_sizeof()
           + sizeof(edges) + sizeof(EdgeData)*edges.capacity();
       size_t ebuffer_size = edge_buffer.estimate_sizeof();
       return vlist_size + elist_size + ebuffer_size;
@@ -509,7 +619,8 @@ namespace graphlab {
      * \internal
      * CSR/CSC storage types
      */
-    typedef dynamic_csr_storage<std::pair<lvid_type, edge_id_type>, edge_id_type> csr_type;
+    typedef dynamic_local_graph_adjacency::csr_type csr_type;
+    typedef dynamic_local_graph_adjacency adjacency_type;
 
     typedef typename csr_type::iterator csr_edge_iterator;
 
@@ -519,8 +630,7 @@ namespace graphlab {
     std::vector<VertexData> vertices;
 
     /** Stores the edge data and edge relationships. */
-    csr_type _csr_storage;
-    csr_type _csc_storage;
+    boost::shared_ptr<adjacency_type> adjacency;
     std::vector<EdgeData> edges;
 
     /** The edge data is a vector of edges where each edge stores its
@@ -535,6 +645,8 @@ namespace graphlab {
     /*                                                                        */
     /**************************************************************************/
     friend class local_graph_test;
+    template <typename OtherVertexData, typename OtherEdgeData>
+    friend class dynamic_local_graph;
   }; // End of class dynamic_local_graph
 
 
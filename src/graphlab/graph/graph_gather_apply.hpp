@@ -26,6 +26,7 @@
 #include <boost/bind.hpp>
 #include <graphlab/options/graphlab_options.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/lock_table.hpp>
 #include <graphlab/graph/vertex_set.hpp>
 #include <graphlab/util/memory_info.hpp>
 #include <graphlab/parallel/thread_pool.hpp>
@@ -116,8 +117,9 @@ namespace graphlab {
     /**
      * \brief  The vertex locks protect access to vertex specific data-structrues including
      * \ref graphlab::graph_gather_apply::gather_accum.
+     * Only one lock is held at a time, so a striped table is used.
      */
-    std::vector<simple_spinlock> vlocks;
+    lock_table vlocks;
 
     /**
      * \brief Bit indicating if the gather has accumulator contains any values.
@@ -340,7 +342,7 @@ namespace graphlab {
 
         gather_accum.clear();
         // Allocate vertex locks and vertex programs
-        vlocks.resize(graph.num_local_vertices());
+        vlocks.resize(graph.num_local_vertices(), lock_table::STRIPED_LOCKS);
         // Allocate gather accumulators and accumulator bitset
         gather_accum.resize(graph.num_local_vertices(), gather_type());
         has_gather_accum.resize(graph.num_local_vertices());
@@ -523,14 +525,14 @@ namespace graphlab {
   void graph_gather_apply<Graph,GatherType>::
   sync_gather(lvid_type lvid, const gather_type& accum, const size_t thread_id) {
     if(graph.l_is_master(lvid)) {
-      vlocks[lvid].lock();
+      vlocks.lock(lvid);
       if(has_gather_accum.get(lvid)) {
         gather_accum[lvid] += accum;
       } else {
         gather_accum[lvid] = accum;
         has_gather_accum.set_bit(lvid);
       }
-      vlocks[lvid].unlock();
+      vlocks.unlock(lvid);
     } else {
       const procid_t master = graph.l_master(lvid);
       const vertex_id_type vid = graph.global_vid(lvid);
@@ -559,14 +561,14 @@ namespace graphlab {
         ASSERT_TRUE(graph.vid2lvid.find(pair.first) != graph.vid2lvid.end());
         const lvid_type lvid = graph.local_vid(pair.first);
         const gather_type& accum = pair.second;
-        vlocks[lvid].lock();
+        vlocks.lock(lvid);
         if( has_gather_accum.get(lvid) ) {
           gather_accum[lvid] += accum;
         } else {
           gather_accum[lvid] = accum;
           has_gather_accum.set_bit(lvid);
         }
-        vlocks[lvid].unlock();
+        vlocks.unlock(lvid);
       }
     }
   } // end of recv_gather
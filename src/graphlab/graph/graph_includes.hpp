@@ -25,6 +25,8 @@
 
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/graph/data_fields.hpp>
+#include <graphlab/graph/stream_ingest.hpp>
 #endif
 
 
@@ -24,9 +24,15 @@
 #define GRAPHLAB_GRAPH_JOIN_HPP
 #include <utility>
 #include <boost/unordered_map.hpp>
+#include <algorithm>
 #include <graphlab/util/hopscotch_map.hpp>
+#include <graphlab/util/bloom_filter.hpp>
+#include <graphlab/util/integer_mix.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/graph/distributed_graph.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/rpc/buffered_exchange.hpp>
+#include <graphlab/macros_def.hpp>
 namespace graphlab {
 
 
@@ -63,8 +69,8 @@ namespace graphlab {
  * The join operates by having each vertex in both graph emit an integer key.
  * Vertices with the same key are then combined into the same group. The 
  * semantics of the key depends on the join operation to be performed.
- * Right now, the only join operation supported is the Left Injective Join
- * and the Right Injective Join (see below).
+ * The join operations supported are the Left and Right Injective Joins,
+ * and the general Left and Right Joins (see below).
  *
 *
  *
@@ -166,6 +172,36 @@ namespace graphlab {
  * ## Right Injective Join
  * The right injective join is similar to the left injective join, but
  * with types reversed.
+ *
+ * ## Left Join and Right Join
+ * The general join does not require keys to be unique. Any number of
+ * vertices on either graph may emit the same key, which covers the
+ * many-to-one and one-to-many cases (for instance, attaching the data
+ * of a small "feature" graph to every vertex of a large graph with a
+ * matching attribute). The keys are prepared with:
+ * \code
+ * vjoin.prepare_join(left_emit_key, right_emit_key);
+ * \endcode
+ * after which
+ * \code
+ * vjoin.left_join(join_op);
+ * \endcode
+ * calls join_op on each left vertex once for every right vertex which
+ * emitted the same key. The join_op prototype is the same as for the
+ * left injective join. join_op is never called concurrently on the same
+ * vertex, but when several right vertices match, the order of the calls
+ * is unspecified.
+ *
+ * prepare_join() first shuffles only the keys: every machine sends
+ * each distinct key it holds to the machine owning the hash of the
+ * key, which matches the two sides and tells every machine which
+ * machines hold matching keys on the opposing graph. The vertex data
+ * is then only sent for keys which matched, once per machine holding
+ * the key rather than once per vertex. If only a small fraction of the
+ * keys match, passing use_bloom_filter = true to prepare_join() builds
+ * a bloom filter of the keys of the smaller side on all machines and
+ * drops the keys of the larger side which cannot match before they are
+ * shuffled.
  */
 template <typename LeftGraph, typename RightGraph> 
 class graph_vertex_join {
@@ -204,6 +240,21 @@ class graph_vertex_join {
 
     injective_join_index left_inj_index, right_inj_index;
 
+    struct join_index {
+      // (key, lvid) of every owned vertex participating in the join,
+      // sorted by key
+      std::vector<std::pair<size_t, lvid_type> > key_to_vtx;
+      // (key, proc) for every machine holding a vertex on the opposing
+      // graph which emitted the same key, sorted by key
+      std::vector<std::pair<size_t, procid_t> > opposing_procs;
+    };
+
+    join_index left_index, right_index;
+
+    /// Number of locks protecting the target vertices of a join
+    static const size_t NUM_JOIN_LOCKS = 1024;
+    simple_spinlock join_locks[NUM_JOIN_LOCKS];
+
   public:
     graph_vertex_join(distributed_control& dc,
                       left_graph_type& left,
@@ -333,6 +384,84 @@ class graph_vertex_join {
                      join_op);
     }
 
+
+    /**
+      * \brief Initializes a general join by associating each vertex 
+      * with a key
+      *
+      * \param left_emit_key A function which takes a vertex_type from the
+      *  left graph and emits an integral key value. 
+      * \param right_emit_key A function which takes a vertex_type from the
+      *  right graph and emits an integral key value. 
+      * \param use_bloom_filter If true, keys of the larger side which
+      *  cannot match a key of the smaller side are dropped with a bloom
+      *  filter before the keys are shuffled.
+      *
+      * Unlike prepare_injective_join(), any number of vertices may emit
+      * the same key. A vertex emitting (size_t)(-1) does not participate
+      * in the join. This function must be called by all machines, after
+      * which an arbitrary number of left_join() and right_join() calls may
+      * be made.
+      */
+    template <typename LeftEmitKey, typename RightEmitKey>
+    void prepare_join(LeftEmitKey left_emit_key, 
+                      RightEmitKey right_emit_key,
+                      bool use_bloom_filter = false) {
+      fill_join_index(left_index, left_graph, left_emit_key);
+      fill_join_index(right_index, right_graph, right_emit_key);
+      std::vector<size_t> left_keys = unique_keys(left_index);
+      std::vector<size_t> right_keys = unique_keys(right_index);
+      if (use_bloom_filter) {
+        size_t num_left_keys = left_keys.size();
+        size_t num_right_keys = right_keys.size();
+        rmi.all_reduce(num_left_keys);
+        rmi.all_reduce(num_right_keys);
+        // the filter is built over the smaller side
+        if (num_left_keys <= num_right_keys) {
+          filter_keys(left_keys, num_left_keys, right_keys);
+        } else {
+          filter_keys(right_keys, num_right_keys, left_keys);
+        }
+      }
+      compute_join(left_keys, right_keys);
+    }
+
+    /**
+     * \brief Performs a general join from the right graph to the left graph.
+     * 
+     * \param join_op The joining function. May be a function pointer or a 
+     * lambda matching the prototype
+     * void join_op(LeftGraph::vertex_type& left_vertex, 
+     *              const RightGraph::vertex_data_type right_vertex_data);
+     * 
+     * prepare_join() must be called before hand.
+     * All machines must call this function. join_op will be called on each
+     * left vertex once with the data of every right vertex which emitted the
+     * same key in prepare_join(). 
+     */
+    template <typename JoinOp>
+    void left_join(JoinOp join_op) {
+      general_join(left_index, left_graph, right_index, right_graph, join_op);
+    }
+
+    /**
+     * \brief Performs a general join from the left graph to the right graph.
+     * 
+     * \param join_op The joining function. May be a function pointer or a 
+     * lambda matching the prototype
+     * void join_op(RightGraph::vertex_type& right_vertex, 
+     *              const LeftGraph::vertex_data_type left_vertex_data);
+     * 
+     * prepare_join() must be called before hand.
+     * All machines must call this function. join_op will be called on each
+     * right vertex once with the data of every left vertex which emitted the
+     * same key in prepare_join(). 
+     */
+    template <typename JoinOp>
+    void right_join(JoinOp join_op) {
+      general_join(right_index, right_graph, left_index, left_graph, join_op);
+    }
+
   private:
     template <typename Graph, typename EmitKey>
     void reset_and_fill_injective_index(injective_join_index& idx,
@@ -515,8 +644,233 @@ class graph_vertex_join {
       }
       target_graph.synchronize();
     }
+
+    // The machine which matches the keys of the two graphs for a key.
+    procid_t key_owner(size_t key) const {
+      return integer_mix(uint32_t(key ^ (key >> 32))) % rmi.numprocs();
+    }
+
+    template <typename Graph, typename EmitKey>
+    void fill_join_index(join_index& idx, Graph& graph, EmitKey& emit_key) {
+      idx.key_to_vtx.clear();
+      idx.opposing_procs.clear();
+      for(lvid_type v = 0; v < graph.num_local_vertices(); ++v) {
+        typename Graph::local_vertex_type lv = graph.l_vertex(v);
+        if (lv.owned()) {
+          typename Graph::vertex_type vtx(lv);
+          size_t key = emit_key(vtx);
+          if (key != (size_t)(-1)) idx.key_to_vtx.push_back(std::make_pair(key, v));
+        }
+      }
+      std::sort(idx.key_to_vtx.begin(), idx.key_to_vtx.end());
+    }
+
+    // the distinct keys in the index, in sorted order
+    static std::vector<size_t> unique_keys(const join_index& idx) {
+      std::vector<size_t> keys;
+      for (size_t i = 0; i < idx.key_to_vtx.size(); ++i) {
+        if (keys.empty() || keys.back() != idx.key_to_vtx[i].first) {
+          keys.push_back(idx.key_to_vtx[i].first);
+        }
+      }
+      return keys;
+    }
+
+    // Builds a bloom filter of small_keys over all machines, and removes
+    // the keys in large_keys which are not in the filter.
+    void filter_keys(const std::vector<size_t>& small_keys, 
+                     size_t total_small_keys,
+                     std::vector<size_t>& large_keys) {
+      bloom_filter filter = bloom_filter::for_keys(total_small_keys);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (size_t i = 0; i < small_keys.size(); ++i) {
+        filter.insert(small_keys[i]);
+      }
+      rmi.all_reduce(filter);
+      size_t num_kept = 0;
+      for (size_t i = 0; i < large_keys.size(); ++i) {
+        if (filter.may_contain(large_keys[i])) {
+          large_keys[num_kept++] = large_keys[i];
+        }
+      }
+      size_t num_dropped = large_keys.size() - num_kept;
+      large_keys.resize(num_kept);
+      rmi.all_reduce(num_dropped);
+      if (rmi.procid() == 0) {
+        logstream(LOG_INFO) << "Join bloom filter dropped " << num_dropped 
+                            << " keys before the shuffle" << std::endl;
+      }
+    }
+
+    // Sends every key to the machine owning it. Returns the (key, proc)
+    // pairs received by this machine, sorted by key.
+    std::vector<std::pair<size_t, procid_t> > 
+        shuffle_keys(const std::vector<size_t>& keys) {
+      typedef buffered_exchange<size_t> key_exchange_type;
+      key_exchange_type exchange(rmi.dc());
+      std::vector<std::pair<size_t, procid_t> > received;
+      typename key_exchange_type::buffer_type recv_buffer;
+      procid_t sending_proc;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        exchange.send(key_owner(keys[i]), keys[i]);
+        // drain what has arrived so far so the keys stream through
+        // bounded buffers
+        while(exchange.recv(sending_proc, recv_buffer, true)) {
+          foreach(size_t key, recv_buffer) {
+            received.push_back(std::make_pair(key, sending_proc));
+          }
+          recv_buffer.clear();
+        }
+      }
+      exchange.flush();
+      while(exchange.recv(sending_proc, recv_buffer)) {
+        foreach(size_t key, recv_buffer) {
+          received.push_back(std::make_pair(key, sending_proc));
+        }
+        recv_buffer.clear();
+      }
+      std::sort(received.begin(), received.end());
+      return received;
+    }
+
+    void compute_join(const std::vector<size_t>& left_keys, 
+                      const std::vector<size_t>& right_keys) {
+      typedef std::pair<size_t, procid_t> key_proc_pair;
+      std::vector<key_proc_pair> left_recv = shuffle_keys(left_keys);
+      std::vector<key_proc_pair> right_recv = shuffle_keys(right_keys);
+
+      std::vector<std::vector<key_proc_pair> > left_match(rmi.numprocs());
+      std::vector<std::vector<key_proc_pair> > right_match(rmi.numprocs());
+      // merge the two sorted lists. every machine holding a key on the left
+      // is told about every machine holding it on the right and vice versa
+      size_t l = 0, r = 0;
+      while (l < left_recv.size() && r < right_recv.size()) {
+        const size_t key = left_recv[l].first;
+        if (key < right_recv[r].first) { ++l; continue; }
+        if (right_recv[r].first < key) { ++r; continue; }
+        size_t lend = l, rend = r;
+        while (lend < left_recv.size() && left_recv[lend].first == key) ++lend;
+        while (rend < right_recv.size() && right_recv[rend].first == key) ++rend;
+        for (size_t i = l; i < lend; ++i) {
+          for (size_t j = r; j < rend; ++j) {
+            left_match[left_recv[i].second].push_back(
+                std::make_pair(key, right_recv[j].second));
+            right_match[right_recv[j].second].push_back(
+                std::make_pair(key, left_recv[i].second));
+          }
+        }
+        l = lend; r = rend;
+      }
+      std::vector<key_proc_pair>().swap(left_recv);
+      std::vector<key_proc_pair>().swap(right_recv);
+
+      rmi.all_to_all(left_match);
+      rmi.all_to_all(right_match);
+      flatten_matches(left_match, left_index);
+      flatten_matches(right_match, right_index);
+    }
+
+    static void flatten_matches(
+        std::vector<std::vector<std::pair<size_t, procid_t> > >& match,
+        join_index& idx) {
+      idx.opposing_procs.clear();
+      for (size_t p = 0; p < match.size(); ++p) {
+        idx.opposing_procs.insert(idx.opposing_procs.end(), 
+                                  match[p].begin(), match[p].end());
+        std::vector<std::pair<size_t, procid_t> >().swap(match[p]);
+      }
+      std::sort(idx.opposing_procs.begin(), idx.opposing_procs.end());
+    }
+
+    template <typename TargetGraph, typename JoinOp, typename RecordType>
+    void apply_join_records(join_index& target, 
+                            TargetGraph& target_graph,
+                            const std::vector<RecordType>& records,
+                            JoinOp& joinop) {
+      typedef typename std::vector<std::pair<size_t, lvid_type> >::const_iterator
+          iterator_type;
+      foreach(const RecordType& rec, records) {
+        iterator_type begin = std::lower_bound(target.key_to_vtx.begin(), 
+                                               target.key_to_vtx.end(),
+                                               std::make_pair(rec.first, 
+                                                              lvid_type(0)));
+        ASSERT_TRUE(begin != target.key_to_vtx.end() && begin->first == rec.first);
+        for (iterator_type iter = begin; 
+             iter != target.key_to_vtx.end() && iter->first == rec.first; 
+             ++iter) {
+          typename TargetGraph::local_vertex_type 
+              lvtx = target_graph.l_vertex(iter->second);
+          typename TargetGraph::vertex_type vtx(lvtx);
+          simple_spinlock& lock = join_locks[iter->second % NUM_JOIN_LOCKS];
+          lock.lock();
+          joinop(vtx, rec.second);
+          lock.unlock();
+        }
+      }
+    }
+
+    template <typename TargetGraph, typename SourceGraph, typename JoinOp>
+    void general_join(join_index& target,
+                      TargetGraph& target_graph,
+                      join_index& source,
+                      SourceGraph& source_graph,
+                      JoinOp joinop) {
+      typedef std::pair<size_t, typename SourceGraph::vertex_data_type> 
+          record_type;
+      typedef buffered_exchange<record_type> data_exchange_type;
+#ifdef _OPENMP
+      data_exchange_type exchange(rmi.dc(), omp_get_max_threads());
+#else
+      data_exchange_type exchange(rmi.dc());
+#endif
+      // the data of every source vertex is sent once to each machine
+      // holding a matching key, and records are applied as they arrive.
+      const std::vector<std::pair<size_t, procid_t> >& procs = 
+          source.opposing_procs;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (size_t i = 0; i < procs.size(); ++i) {
+        typename data_exchange_type::buffer_type recv_buffer;
+        procid_t sending_proc;
+        const size_t key = procs[i].first;
+        typename std::vector<std::pair<size_t, lvid_type> >::const_iterator iter = 
+            std::lower_bound(source.key_to_vtx.begin(), 
+                             source.key_to_vtx.end(),
+                             std::make_pair(key, lvid_type(0)));
+        for (; iter != source.key_to_vtx.end() && iter->first == key; ++iter) {
+          const record_type rec(key, source_graph.l_vertex(iter->second).data());
+#ifdef _OPENMP
+          exchange.send(procs[i].second, rec, omp_get_thread_num());
+#else
+          exchange.send(procs[i].second, rec);
+#endif
+        }
+        // apply whatever has arrived
+        while(exchange.recv(sending_proc, recv_buffer, true)) {
+          apply_join_records(target, target_graph, recv_buffer, joinop);
+          recv_buffer.clear();
+        }
+      }
+      exchange.flush();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+        typename data_exchange_type::buffer_type recv_buffer;
+        procid_t sending_proc;
+        while(exchange.recv(sending_proc, recv_buffer)) {
+          apply_join_records(target, target_graph, recv_buffer, joinop);
+          recv_buffer.clear();
+        }
+      }
+      target_graph.synchronize();
+    }
 };
 
 } // namespace graphlab
 
+#include <graphlab/macros_undef.hpp>
 #endif
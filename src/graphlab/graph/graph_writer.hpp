@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_GRAPH_WRITER_HPP
+#define GRAPHLAB_GRAPH_GRAPH_WRITER_HPP
+
+#include <string>
+#include <boost/type_traits/is_base_of.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Inheriting from this type marks a graph Writer as
+   * appending.
+   *
+   * By default a Writer passed to
+   * \ref graphlab::distributed_graph::save returns a new string for
+   * every vertex and edge.  An appending writer instead appends its
+   * output to a buffer which is reused by the saving thread,
+   * avoiding an allocation per record:
+   * \code
+   * struct pagerank_writer : public graphlab::IS_APPEND_WRITER {
+   *   void save_vertex(vertex_type v, std::string& out) {
+   *     graphlab::append_uint(out, v.id());
+   *     out += '\t';
+   *     out += graphlab::tostr(v.data());
+   *     out += '\n';
+   *   }
+   *   void save_edge(edge_type e, std::string& out) { }
+   * };
+   * \endcode
+   */
+  struct IS_APPEND_WRITER { };
+
+  /**
+   * Appends the decimal representation of value to out.
+   */
+  inline void append_uint(std::string& out, size_t value) {
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* ptr = end;
+    do {
+      *(--ptr) = char('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    out.append(ptr, end);
+  } // end of append_uint
+
+  /**
+   * \internal
+   * Calls the Writer interface, appending to out if the Writer
+   * inherits from IS_APPEND_WRITER.
+   */
+  template <typename Writer,
+            bool Append = boost::is_base_of<IS_APPEND_WRITER, Writer>::value>
+  struct graph_writer_dispatch {
+    template <typename VertexType>
+    static void save_vertex(Writer& writer, VertexType vertex,
+                            std::string& out) {
+      out += writer.save_vertex(vertex);
+    }
+    template <typename EdgeType>
+    static void save_edge(Writer& writer, EdgeType edge, std::string& out) {
+      out += writer.save_edge(edge);
+    }
+  };
+
+  template <typename Writer>
+  struct graph_writer_dispatch<Writer, true> {
+    template <typename VertexType>
+    static void save_vertex(Writer& writer, VertexType vertex,
+                            std::string& out) {
+      writer.save_vertex(vertex, out);
+    }
+    template <typename EdgeType>
+    static void save_edge(Writer& writer, EdgeType edge, std::string& out) {
+      writer.save_edge(edge, out);
+    }
+  };
+
+} // namespace graphlab
+
+#endif
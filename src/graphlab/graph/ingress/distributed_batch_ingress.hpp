@@ -174,16 +174,14 @@ namespace graphlab {
         vertex_id_type target = target_arr[i]; 
         lvid_type lvid_source(-1);
         lvid_type lvid_target(-1);
-        // typedef typename boost::unordered_map<vertex_id_type, lvid_type>::iterator 
-          // vid2lvid_iter;
-        typedef typename hopscotch_map<vertex_id_type, lvid_type>::iterator
+        typedef typename graph_type::vid2lvid_map_type::const_iterator
           vid2lvid_iter;
         vid2lvid_iter iter;
 
           iter = base_type::graph.vid2lvid.find(source);
           if (iter == base_type::graph.vid2lvid.end()) {
             lvid_source = base_type::graph.vid2lvid.size();
-            base_type::graph.vid2lvid[source]=lvid_source;
+            base_type::graph.vid2lvid.insert(std::make_pair(source, lvid_source));
             base_type::graph.lvid2record.push_back(vertex_record(source));
           } else {
             lvid_source = iter->second;
@@ -192,7 +190,7 @@ namespace graphlab {
           iter = base_type::graph.vid2lvid.find(target);
           if (iter == base_type::graph.vid2lvid.end()) {
             lvid_target = base_type::graph.vid2lvid.size();
-            base_type::graph.vid2lvid[target]=lvid_target;
+            base_type::graph.vid2lvid.insert(std::make_pair(target, lvid_target));
             base_type::graph.lvid2record.push_back(vertex_record(target));
           } else {
             lvid_target = iter->second;
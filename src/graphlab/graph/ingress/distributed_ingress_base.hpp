@@ -27,7 +27,10 @@
 #include <graphlab/graph/graph_hash.hpp>
 #include <graphlab/graph/ingress/ingress_edge_decision.hpp>
 #include <graphlab/graph/graph_gather_apply.hpp>
+#include <graphlab/graph/local_edge_buffer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/util/memory_info.hpp>
+#include <graphlab/util/timer.hpp>
 #include <graphlab/util/hopscotch_map.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/macros_def.hpp>
@@ -111,14 +114,48 @@ namespace graphlab {
     /// Ingress decision object for computing the edge destination. 
     ingress_edge_decision<VertexData, EdgeData> edge_decision;
 
+    typedef typename graph_type::hopscotch_map_type vid2lvid_map_type;
+    typedef typename graph_type::vid2lvid_map_type graph_vid2lvid_map_type;
+
+    /** 
+     * \internal
+     * State of the pipelined ingress. See set_pipelined().
+     */
+    struct pipeline_state {
+      /// Number of receiver threads. 0 if pipelining is disabled
+      size_t nthreads;
+      /// Set to make the receivers exit once the exchange is drained
+      volatile bool stop;
+      thread_group receivers;
+      /// Protects vid2lvid_buffer
+      mutex vid2lvid_lock;
+      /// Local ids assigned to new vertices during this ingress round
+      vid2lvid_map_type vid2lvid_buffer;
+      /// Existing local vertices which received new edges
+      dense_bitset updated_lvids;
+      /// The received edges, one buffer per receiver thread
+      std::vector<local_edge_buffer<VertexData, EdgeData> > edges;
+      /// Time each receiver thread spent inserting edges
+      std::vector<double> busy_time;
+      /// Started when the ingress round begins
+      timer round_timer;
+      pipeline_state() : nthreads(0), stop(false) { }
+    };
+    pipeline_state pipeline;
+
+    /// True while the data sent by resend_graph() is being finalized
+    bool migrating;
+
   public:
     distributed_ingress_base(distributed_control& dc, graph_type& graph) :
       rpc(dc, this), graph(graph), vertex_exchange(dc), edge_exchange(dc),
-      edge_decision(dc) {
+      edge_decision(dc), migrating(false) {
       rpc.barrier();
     } // end of constructor
 
-    virtual ~distributed_ingress_base() { }
+    virtual ~distributed_ingress_base() { 
+      stop_receivers();
+    }
 
     /** \brief Add an edge to the ingress object. */
     virtual void add_edge(vertex_id_type source, vertex_id_type target,
@@ -132,12 +169,35 @@ namespace graphlab {
 
     /** \brief Add an vertex to the ingress object. */
     virtual void add_vertex(vertex_id_type vid, const VertexData& vdata)  { 
-      const procid_t owning_proc = graph_hash::hash_vertex(vid) % rpc.numprocs();
+      const procid_t owning_proc = graph.master(vid);
       const vertex_buffer_record record(vid, vdata);
       vertex_exchange.send(owning_proc, record);
     } // end of add vertex
 
 
+    /**
+     * \brief Enables pipelined ingress with nthreads receiver threads
+     * per machine, or disables it if nthreads is 0.
+     *
+     * By default edges sent to this machine are only inserted into the
+     * local graph by finalize().  With pipelined ingress, receiver
+     * threads drain the edge exchange while the graph is still being
+     * loaded, assigning local vertex ids and storing the edges in
+     * per-thread buffers, so that network transfer, parsing and
+     * insertion overlap and finalize() only builds the local graph
+     * from the buffers.  Must be called on all machines while no edges
+     * are being added.
+     */
+    void set_pipelined(size_t nthreads) {
+      stop_receivers();
+      for (size_t i = 0; i < pipeline.edges.size(); ++i) {
+        ASSERT_EQ(pipeline.edges[i].size(), 0);
+      }
+      pipeline.nthreads = nthreads;
+      start_receivers();
+    } // end of set_pipelined
+
+
     void set_duplicate_vertex_strategy(
         boost::function<void(vertex_data_type&,
                              const vertex_data_type&)> combine_strategy) {
@@ -198,7 +258,6 @@ namespace graphlab {
        * \internal
        * Buffer storage for new vertices to the local graph.
        */
-      typedef typename graph_type::hopscotch_map_type vid2lvid_map_type;
       vid2lvid_map_type vid2lvid_buffer;
 
       /**
@@ -218,16 +277,30 @@ namespace graphlab {
       /*                       Flush any additional data                        */
       /*                                                                        */
       /**************************************************************************/
+      timer stage_timer; stage_timer.start();
+      if (pipeline.nthreads > 0) {
+        log_stage_time("loading (pipelined)", pipeline.round_timer);
+      }
       edge_exchange.flush(); vertex_exchange.flush();     
+      // all edges have arrived. Let the receivers insert the rest.
+      stop_receivers();
+      size_t pipelined_edges = 0;
+      for (size_t i = 0; i < pipeline.edges.size(); ++i) {
+        pipelined_edges += pipeline.edges[i].size();
+      }
+      log_stage_time("flush", stage_timer);
 
       /**
        * Fast pass for redundant finalization with no graph changes. 
        */
       {
-        size_t changed_size = edge_exchange.size() + vertex_exchange.size();
+        size_t changed_size = edge_exchange.size() + vertex_exchange.size() +
+                              pipelined_edges;
         rpc.all_reduce(changed_size);
         if (changed_size == 0) {
           logstream(LOG_INFO) << "Skipping Graph Finalization because no changes happened..." << std::endl;
+          migrating = false;
+          start_receivers();
           return;
         }
       }
@@ -241,6 +314,27 @@ namespace graphlab {
       /*                         Construct local graph                          */
       /*                                                                        */
       /**************************************************************************/
+      if (pipeline.nthreads > 0) { 
+        // The receivers already assigned the local ids of the edges
+        logstream(LOG_INFO) << "Graph Finalize: constructing local graph from "
+                            << pipelined_edges << " pipelined edges" << std::endl;
+        double busy_time = 0;
+        for (size_t i = 0; i < pipeline.busy_time.size(); ++i) {
+          busy_time += pipeline.busy_time[i];
+        }
+        logstream(LOG_INFO) << "Graph Finalize: receivers were busy for "
+                            << busy_time << "s" << std::endl;
+        vid2lvid_buffer.swap(pipeline.vid2lvid_buffer);
+        updated_lvids = pipeline.updated_lvids;
+        graph.local_graph.reserve_edge_space(pipelined_edges + 1);
+        graph.local_graph.resize(lvid_start + vid2lvid_buffer.size());
+        for (size_t i = 0; i < pipeline.edges.size(); ++i) {
+          graph.local_graph.add_edges(pipeline.edges[i].source_arr,
+                                      pipeline.edges[i].target_arr,
+                                      pipeline.edges[i].data);
+          pipeline.edges[i].clear();
+        }
+      }
       { // Add all the edges to the local graph
         logstream(LOG_INFO) << "Graph Finalize: constructing local graph" << std::endl;
         const size_t nedges = edge_exchange.size()+1;
@@ -251,7 +345,9 @@ namespace graphlab {
           foreach(const edge_buffer_record& rec, edge_buffer) {
             // Get the source_vlid;
             lvid_type source_lvid(-1);
-            if(graph.vid2lvid.find(rec.source) == graph.vid2lvid.end()) {
+            typename graph_vid2lvid_map_type::const_iterator source_iter =
+              graph.vid2lvid.find(rec.source);
+            if(source_iter == graph.vid2lvid.end()) {
               if (vid2lvid_buffer.find(rec.source) == vid2lvid_buffer.end()) {
                 source_lvid = lvid_start + vid2lvid_buffer.size();
                 vid2lvid_buffer[rec.source] = source_lvid;
@@ -259,12 +355,14 @@ namespace graphlab {
                 source_lvid = vid2lvid_buffer[rec.source];
               }
             } else {
-              source_lvid = graph.vid2lvid[rec.source];
+              source_lvid = source_iter->second;
               updated_lvids.set_bit(source_lvid);
             }
             // Get the target_lvid;
             lvid_type target_lvid(-1);
-            if(graph.vid2lvid.find(rec.target) == graph.vid2lvid.end()) {
+            typename graph_vid2lvid_map_type::const_iterator target_iter =
+              graph.vid2lvid.find(rec.target);
+            if(target_iter == graph.vid2lvid.end()) {
               if (vid2lvid_buffer.find(rec.target) == vid2lvid_buffer.end()) {
                 target_lvid = lvid_start + vid2lvid_buffer.size();
                 vid2lvid_buffer[rec.target] = target_lvid;
@@ -272,7 +370,7 @@ namespace graphlab {
                 target_lvid = vid2lvid_buffer[rec.target];
               }
             } else {
-              target_lvid = graph.vid2lvid[rec.target];
+              target_lvid = target_iter->second;
               updated_lvids.set_bit(target_lvid);
             }
             graph.local_graph.add_edge(source_lvid, target_lvid, rec.edata);
@@ -289,7 +387,9 @@ namespace graphlab {
         // Finalize local graph
         logstream(LOG_INFO) << "Graph Finalize: finalizing local graph." 
                             << std::endl;
+        log_stage_time("receive edges", stage_timer);
         graph.local_graph.finalize();
+        log_stage_time("local graph construction", stage_timer);
         logstream(LOG_INFO) << "Local graph info: " << std::endl
                             << "\t nverts: " << graph.local_graph.num_vertices()
                             << std::endl
@@ -314,7 +414,9 @@ namespace graphlab {
         while(vertex_exchange.recv(sending_proc, vertex_buffer)) {
           foreach(const vertex_buffer_record& rec, vertex_buffer) {
             lvid_type lvid(-1);
-            if (graph.vid2lvid.find(rec.vid) == graph.vid2lvid.end()) {
+            typename graph_vid2lvid_map_type::const_iterator iter =
+              graph.vid2lvid.find(rec.vid);
+            if (iter == graph.vid2lvid.end()) {
               if (vid2lvid_buffer.find(rec.vid) == vid2lvid_buffer.end()) {
                 lvid = lvid_start + vid2lvid_buffer.size();
                 vid2lvid_buffer[rec.vid] = lvid;
@@ -322,10 +424,11 @@ namespace graphlab {
                 lvid = vid2lvid_buffer[rec.vid];
               }
             } else {
-              lvid = graph.vid2lvid[rec.vid];
+              lvid = iter->second;
               updated_lvids.set_bit(lvid);
             }
-            if (vertex_combine_strategy && lvid < graph.num_local_vertices()) {
+            if (vertex_combine_strategy && !migrating &&
+                lvid < graph.num_local_vertices()) {
               vertex_combine_strategy(graph.l_vertex(lvid).data(), rec.vdata);
             } else {
               graph.local_graph.add_vertex(lvid, rec.vdata);
@@ -333,6 +436,7 @@ namespace graphlab {
           }
         }
         vertex_exchange.clear();
+        log_stage_time("receive vertex data", stage_timer);
         if(rpc.procid() == 0)         
           memory_info::log_usage("Finished adding vertex data");
       } // end of loop to populate vrecmap
@@ -352,10 +456,11 @@ namespace graphlab {
         foreach(const vid2lvid_pair_type& pair, vid2lvid_buffer) {
             vertex_record& vrec = graph.lvid2record[pair.second];
             vrec.gvid = pair.first;
-            vrec.owner = graph_hash::hash_vertex(pair.first) % rpc.numprocs();
+            vrec.owner = graph.master(pair.first);
         }
         ASSERT_EQ(local_nverts, graph.local_graph.num_vertices());
         ASSERT_EQ(graph.lvid2record.size(), graph.local_graph.num_vertices());
+        log_stage_time("allocate vertex records", stage_timer);
         if(rpc.procid() == 0)       
           memory_info::log_usage("Finihsed allocating lvid2record");
       }
@@ -399,7 +504,9 @@ namespace graphlab {
           procid_t recvid;
           while(vid_buffer.recv(recvid, buffer)) {
             foreach(const vertex_id_type vid, buffer) {
-              if (graph.vid2lvid.find(vid) == graph.vid2lvid.end()) {
+              typename graph_vid2lvid_map_type::const_iterator iter =
+                graph.vid2lvid.find(vid);
+              if (iter == graph.vid2lvid.end()) {
                 if (vid2lvid_buffer.find(vid) == vid2lvid_buffer.end()) {
                   flying_vids_lock.lock();
                   mirror_type& mirrors = flying_vids[vid];
@@ -410,7 +517,7 @@ namespace graphlab {
                   graph.lvid2record[lvid]._mirrors.set_bit(recvid);
                 }
               } else {
-                lvid_type lvid = graph.vid2lvid[vid];
+                lvid_type lvid = iter->second;
                 graph.lvid2record[lvid]._mirrors.set_bit(recvid);
                 updated_lvids.set_bit(lvid);
               }
@@ -434,6 +541,7 @@ namespace graphlab {
           vid2lvid_buffer[gvid] = lvid;
           // std::cout << "proc " << rpc.procid() << " recevies flying vertex " << gvid << std::endl;
         }
+        log_stage_time("master handshake", stage_timer);
       } // end of master handshake
 
       /**************************************************************************/
@@ -442,16 +550,14 @@ namespace graphlab {
       /*                                                                        */
       /**************************************************************************/
       {
-        if (graph.vid2lvid.size() == 0) {
-          graph.vid2lvid.swap(vid2lvid_buffer);
-        } else {
-          graph.vid2lvid.rehash(graph.vid2lvid.size() + vid2lvid_buffer.size());
-          foreach (const typename vid2lvid_map_type::value_type& pair, vid2lvid_buffer) {
-            graph.vid2lvid.insert(pair);
-          }
-          vid2lvid_buffer.clear();
-          // vid2lvid_buffer.swap(vid2lvid_map_type(-1));
-        }
+        // Every new lvid already has its gvid in lvid2record, so the
+        // index is extended from there with all threads.
+        ASSERT_EQ(lvid_start + vid2lvid_buffer.size(), graph.lvid2record.size());
+        vid2lvid_buffer.clear();
+        graph.vid2lvid.insert_parallel(lvid_start, graph.lvid2record.size(),
+                                       boost::bind(&graph_type::global_vid,
+                                                   &graph, _1));
+        log_stage_time("merge vid2lvid", stage_timer);
       }
 
 
@@ -486,15 +592,57 @@ namespace graphlab {
                              boost::bind(&distributed_ingress_base::finalize_gather, this, _1, _2), 
                              boost::bind(&distributed_ingress_base::finalize_apply, this, _1, _2, _3));
         vrecord_sync_gas.exec(changed_vset);
+        log_stage_time("synchronize vertex data", stage_timer);
 
         if(rpc.procid() == 0)       
           memory_info::log_usage("Finished synchronizing vertex (meta)data");
       }
 
       exchange_global_info();
+      log_stage_time("exchange global info", stage_timer);
+      migrating = false;
+      // begin the next ingress round
+      start_receivers();
     } // end of finalize
 
 
+    /**
+     * \internal
+     * \brief Sends every edge and master vertex of the finalized graph
+     * to its new location and clears the local graph, which is rebuilt
+     * from the received data by the next call to finalize().  Must be
+     * called on all machines.
+     *
+     * edge_dest(source, target) returns the machine which stores the
+     * edge from now on.  Vertex data is sent to graph.master(), so
+     * the new vertex placement must already be in effect.  Edges
+     * which stay on this machine are passed through the local
+     * exchange, so only the edges which move cross the network.
+     */
+    template <typename EdgeDestination>
+    void resend_graph(EdgeDestination edge_dest) {
+      // the receivers assign local ids relative to the current graph
+      stop_receivers();
+      migrating = true;
+      for (lvid_type lvid = 0; lvid < graph.num_local_vertices(); ++lvid) {
+        const typename graph_type::vertex_record& vrec = graph.lvid2record[lvid];
+        if (vrec.owner == rpc.procid()) {
+          vertex_exchange.send(graph.master(vrec.gvid),
+                               vertex_buffer_record(vrec.gvid, 
+                                                    graph.l_vertex(lvid).data()));
+        }
+        foreach(const typename graph_type::local_edge_type& e, 
+                graph.l_vertex(lvid).out_edges()) {
+          const vertex_id_type target = e.target().global_id();
+          edge_exchange.send(edge_dest(vrec.gvid, target),
+                             edge_buffer_record(vrec.gvid, target, e.data()));
+        }
+      }
+      graph.clear();
+      start_receivers();
+    } // end of resend_graph
+
+
     /* Exchange graph statistics among all nodes and compute
      * global statistics for the distributed graph. */
     void exchange_global_info () {
@@ -542,6 +690,117 @@ namespace graphlab {
   private:
     boost::function<void(vertex_data_type&, const vertex_data_type&)> vertex_combine_strategy;
 
+    /**
+     * \brief Logs the time since the timer was started for one stage
+     * of the ingress, and restarts the timer.
+     */
+    void log_stage_time(const char* stage, timer& ti) {
+      const double elapsed = ti.current_time();
+      logstream(LOG_INFO) << "Graph Finalize: " << stage << " took "
+                          << elapsed << "s" << std::endl;
+      if (rpc.procid() == 0) {
+        logstream(LOG_EMPH) << "Ingress stage " << stage << ": "
+                            << elapsed << "s" << std::endl;
+      }
+      ti.start();
+    }
+
+    /**
+     * \brief Begins a round of pipelined ingress by launching the
+     * receiver threads. Does nothing if pipelining is disabled.
+     */
+    void start_receivers() {
+      if (pipeline.nthreads == 0) return;
+      pipeline.stop = false;
+      // vertices added in this round get ids after the existing ones
+      pipeline.vid2lvid_buffer.clear();
+      pipeline.updated_lvids.resize(graph.vid2lvid.size());
+      pipeline.updated_lvids.clear();
+      pipeline.edges.resize(pipeline.nthreads);
+      pipeline.busy_time.assign(pipeline.nthreads, 0);
+      pipeline.round_timer.start();
+      for (size_t i = 0; i < pipeline.nthreads; ++i) {
+        pipeline.receivers.launch(
+            boost::bind(&distributed_ingress_base::receive_edges, this, i));
+      }
+    } // end of start_receivers
+
+    /**
+     * \brief Waits for the receiver threads to drain the edge exchange
+     * and exit.
+     */
+    void stop_receivers() {
+      if (pipeline.nthreads == 0) return;
+      pipeline.stop = true;
+      pipeline.receivers.join();
+    } // end of stop_receivers
+
+    /**
+     * \brief Receiver thread main loop. Polls the edge exchange until
+     * stop is set and the exchange is empty.
+     */
+    void receive_edges(size_t threadid) {
+      typename buffered_exchange<edge_buffer_record>::buffer_type buffer;
+      procid_t proc;
+      size_t idle_ms = 0;
+      while(1) {
+        // poll without blocking the senders, but once stopped
+        // everything must be drained
+        const bool stopping = pipeline.stop;
+        if (edge_exchange.recv(proc, buffer, !stopping)) {
+          timer ti; ti.start();
+          insert_received_edges(buffer, pipeline.edges[threadid]);
+          pipeline.busy_time[threadid] += ti.current_time();
+          idle_ms = 0;
+        } else if (stopping) {
+          break;
+        } else {
+          // back off while the exchange is idle
+          idle_ms = std::min<size_t>(2 * idle_ms + 1, 16);
+          timer::sleep_ms(idle_ms);
+        }
+      }
+    } // end of receive_edges
+
+    /**
+     * \brief Assigns local ids to the endpoints of the received edges
+     * and stores the edges in the thread local buffer.
+     */
+    void insert_received_edges(
+        const typename buffered_exchange<edge_buffer_record>::buffer_type& buffer,
+        local_edge_buffer<VertexData, EdgeData>& edges) {
+      const lvid_type lvid_start = graph.vid2lvid.size();
+      pipeline.vid2lvid_lock.lock();
+      foreach(const edge_buffer_record& rec, buffer) {
+        edges.source_arr.push_back(pipelined_lvid(rec.source, lvid_start));
+        edges.target_arr.push_back(pipelined_lvid(rec.target, lvid_start));
+      }
+      pipeline.vid2lvid_lock.unlock();
+      foreach(const edge_buffer_record& rec, buffer) {
+        edges.data.push_back(rec.edata);
+      }
+    } // end of insert_received_edges
+
+    /**
+     * \brief Returns the local id of vid, assigning a new one if the
+     * vertex is not in the local graph.  Must be called with
+     * vid2lvid_lock held.
+     */
+    lvid_type pipelined_lvid(vertex_id_type vid, lvid_type lvid_start) {
+      typename graph_vid2lvid_map_type::const_iterator giter =
+        graph.vid2lvid.find(vid);
+      if (giter != graph.vid2lvid.end()) {
+        pipeline.updated_lvids.set_bit(giter->second);
+        return giter->second;
+      }
+      typename vid2lvid_map_type::const_iterator iter =
+        pipeline.vid2lvid_buffer.find(vid);
+      if (iter != pipeline.vid2lvid_buffer.end()) return iter->second;
+      const lvid_type lvid = lvid_start + pipeline.vid2lvid_buffer.size();
+      pipeline.vid2lvid_buffer[vid] = lvid;
+      return lvid;
+    } // end of pipelined_lvid
+
     /**
      * \brief Gather the vertex distributed meta data.
      */
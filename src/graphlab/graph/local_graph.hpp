@@ -44,6 +44,7 @@
 #include <boost/iterator/counting_iterator.hpp>
 #include <boost/iterator/zip_iterator.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <graphlab/graph/graph_basic_types.hpp>
 #include <graphlab/graph/local_edge_buffer.hpp>
@@ -65,6 +66,17 @@
 
 namespace graphlab { 
 
+  /**
+   * \internal
+   * The CSR and CSC indices of a local_graph. They do not depend on
+   * the vertex and edge data types, so that local graphs of different
+   * types can share the same finalized structure.
+   */
+  struct local_graph_adjacency {
+    csr_storage<lvid_type, edge_id_type> csr;
+    csr_storage<std::pair<lvid_type, edge_id_type>, edge_id_type> csc;
+  };
+
   template<typename VertexData, typename EdgeData>
   class local_graph {
   public:
@@ -165,13 +177,33 @@ namespace graphlab {
     // CONSTRUCTORS ============================================================>
     
     /** Create an empty local_graph. */
-    local_graph() : finalized(false) { }
+    local_graph() : adjacency(new local_graph_adjacency), finalized(false) { }
 
     /** Create a local_graph with nverts vertices. */
     local_graph(size_t nverts) :
       vertices(nverts),
+      adjacency(new local_graph_adjacency),
       finalized(false) { }
 
+    /**
+     * Copying a local_graph copies its structure instead of sharing it
+     */
+    local_graph(const local_graph& other) :
+      vertices(other.vertices), edges(other.edges),
+      adjacency(new local_graph_adjacency(*other.adjacency)),
+      edge_buffer(other.edge_buffer), finalized(other.finalized) { }
+
+    local_graph& operator=(const local_graph& other) {
+      if (this != &other) {
+        vertices = other.vertices;
+        edges = other.edges;
+        adjacency.reset(new local_graph_adjacency(*other.adjacency));
+        edge_buffer = other.edge_buffer;
+        finalized = other.finalized;
+      }
+      return *this;
+    }
+
     // METHODS =================================================================>
     
     static bool is_dynamic() {
@@ -185,8 +217,8 @@ namespace graphlab {
       finalized = false;
       vertices.clear();
       edges.clear();
-      _csc_storage.clear();
-      _csr_storage.clear();
+      // the structure may be shared with other graphs
+      adjacency.reset(new local_graph_adjacency);
       std::vector<VertexData>().swap(vertices);
       std::vector<EdgeData>().swap(edges);
       edge_buffer.clear();
@@ -264,13 +296,14 @@ namespace graphlab {
       // counting_sort(edge_buffer.target_arr, permute);
 
       // warp into csr csc storage.
-      _csr_storage.wrap(src_counting_prefix_sum, edge_buffer.target_arr);
+      if (!adjacency.unique()) adjacency.reset(new local_graph_adjacency);
+      adjacency->csr.wrap(src_counting_prefix_sum, edge_buffer.target_arr);
       std::vector<std::pair<lvid_type, edge_id_type> > csc_value = vector_zip(edge_buffer.source_arr, permute);
       //ASSERT_EQ(csc_value.size(), edge_buffer.size());
-      _csc_storage.wrap(dest_counting_prefix_sum, csc_value); 
+      adjacency->csc.wrap(dest_counting_prefix_sum, csc_value); 
       edges.swap(edge_buffer.data);
-      ASSERT_EQ(_csr_storage.num_values(), _csc_storage.num_values());
-      ASSERT_EQ(_csr_storage.num_values(), edges.size());
+      ASSERT_EQ(adjacency->csr.num_values(), adjacency->csc.num_values());
+      ASSERT_EQ(adjacency->csr.num_values(), edges.size());
 #ifdef DEBGU_GRAPH
       logstream(LOG_DEBUG) << "End of finalize." << std::endl;
 #endif
@@ -423,8 +456,8 @@ namespace graphlab {
       // read the vertices
       arc >> vertices
           >> edges 
-          >> _csr_storage
-          >> _csc_storage
+          >> adjacency->csr
+          >> adjacency->csc
           >> finalized;
     } // end of load
 
@@ -433,18 +466,36 @@ namespace graphlab {
       // Write the number of edges and vertices
       arc << vertices
           << edges
-          << _csr_storage  
-          << _csc_storage
+          << adjacency->csr  
+          << adjacency->csc
           << finalized;
     } // end of save
     
+    /**
+     * \brief Resets this graph to the structure of a finalized graph
+     * with possibly different data types, without copying it.
+     *
+     * The CSR and CSC indices are shared with other and all vertex
+     * and edge data are default constructed. The shared structure is
+     * immutable; clearing or refinalizing either graph detaches it.
+     */
+    template <typename OtherVertexData, typename OtherEdgeData>
+    void share_structure(const local_graph<OtherVertexData,
+                                           OtherEdgeData>& other) {
+      ASSERT_TRUE(other.finalized);
+      clear();
+      adjacency = other.adjacency;
+      vertices.resize(other.num_vertices());
+      edges.resize(other.num_edges());
+      finalized = true;
+    }
+
     /** swap two graphs */
     void swap(local_graph& other) {
       finalized = other.finalized;
       std::swap(vertices, other.vertices);
       std::swap(edges, other.edges);
-      std::swap(_csr_storage, other._csr_storage);
-      std::swap(_csc_storage, other._csc_storage);
+      adjacency.swap(other.adjacency);
       std::swap(finalized, other.finalized);
     } // end of swap
 
@@ -502,7 +553,7 @@ namespace graphlab {
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_in_edges(const lvid_type v) const {
       ASSERT_TRUE(finalized);
-      return (_csc_storage.end(v) - _csc_storage.begin(v));
+      return (adjacency->csc.end(v) - adjacency->csc.begin(v));
     }
 
     /** 
@@ -510,15 +561,15 @@ namespace graphlab {
      * \brief Returns the number of in edges of the vertex with the given id. */
     size_t num_out_edges(const lvid_type v) const {
       ASSERT_TRUE(finalized);
-      return (_csr_storage.end(v) - _csr_storage.begin(v));
+      return (adjacency->csr.end(v) - adjacency->csr.begin(v));
     }
 
     /** 
      * \internal
      * \brief Returns a list of in edges of the vertex with the given id. */
     edge_list_type in_edges(lvid_type v) {
-      edge_iterator begin = edge_iterator(*this, _csc_storage.begin(v), v);
-      edge_iterator end = edge_iterator(*this, _csc_storage.end(v), v);
+      edge_iterator begin = edge_iterator(*this, adjacency->csc.begin(v), v);
+      edge_iterator end = edge_iterator(*this, adjacency->csc.end(v), v);
       return boost::make_iterator_range(begin, end);
     }
 
@@ -527,11 +578,11 @@ namespace graphlab {
      * \brief Returns a list of out edges of the vertex with the given id. */
     edge_list_type out_edges(lvid_type v) {
 
-      csr_type::iterator base_begin = _csr_storage.begin(v);
-      csr_type::iterator base_end = _csr_storage.end(v);
+      csr_type::iterator base_begin = adjacency->csr.begin(v);
+      csr_type::iterator base_end = adjacency->csr.end(v);
 
-      edge_id_type begin_eid = base_begin - _csr_storage.begin(0); 
-      edge_id_type end_eid = base_end - _csr_storage.begin(0); 
+      edge_id_type begin_eid = base_begin - adjacency->csr.begin(0); 
+      edge_id_type end_eid = base_end - adjacency->csr.begin(0); 
 
       boost::counting_iterator<edge_id_type> counter_begin(begin_eid);
       boost::counting_iterator<edge_id_type> counter_end(end_eid);
@@ -561,17 +612,75 @@ namespace graphlab {
      * */
     const EdgeData& edge_data(edge_id_type eid) const {
       ASSERT_LT(eid, num_edges());
-      return edges[eid]; 
+      return edges[eid];
     }
 
-    /** 
+    /**
+     * \internal
+     * \brief Returns the positions [first, second) of the out edges of
+     * v in csr_targets(). The positions are also the edge ids.
+     */
+    std::pair<edge_id_type, edge_id_type> out_edge_range(lvid_type v) const {
+      ASSERT_TRUE(finalized);
+      const csr_type::const_iterator base = adjacency->csr.begin(0);
+      return std::make_pair(edge_id_type(adjacency->csr.begin(v) - base),
+                            edge_id_type(adjacency->csr.end(v) - base));
+    }
+
+    /**
+     * \internal
+     * \brief Returns the positions [first, second) of the in edges of
+     * v in csc_sources().
+     */
+    std::pair<edge_id_type, edge_id_type> in_edge_range(lvid_type v) const {
+      ASSERT_TRUE(finalized);
+      const csc_type::const_iterator base = adjacency->csc.begin(0);
+      return std::make_pair(edge_id_type(adjacency->csc.begin(v) - base),
+                            edge_id_type(adjacency->csc.end(v) - base));
+    }
+
+    /**
+     * \internal
+     * \brief Returns the targets of all out edges ordered by source.
+     */
+    const lvid_type* csr_targets() const {
+      return adjacency->csr.num_values() ? &(*adjacency->csr.begin(0)) : NULL;
+    }
+
+    /**
+     * \internal
+     * \brief Returns the (source, edge id) of all in edges ordered by
+     * target.
+     */
+    const std::pair<lvid_type, edge_id_type>* csc_sources() const {
+      return adjacency->csc.num_values() ? &(*adjacency->csc.begin(0)) : NULL;
+    }
+
+    /**
+     * \internal
+     * \brief Returns the contiguous array of vertex data, indexed by lvid.
+     */
+    const VertexData* vertex_data_array() const {
+      return vertices.empty() ? NULL : &vertices[0];
+    }
+
+    /**
+     * \internal
+     * \brief Returns the contiguous array of edge data, indexed by
+     * edge id.
+     */
+    const EdgeData* edge_data_array() const {
+      return edges.empty() ? NULL : &edges[0];
+    }
+
+    /**
      * \internal
      * \brief Returns the estimated memory footprint of the local_graph. */
     size_t estimate_sizeof() const {
       const size_t vlist_size = sizeof(vertices) + 
         sizeof(VertexData) * vertices.capacity();
-      size_t elist_size = _csr_storage.estimate_sizeof() 
-          + _csc_storage.estimate_sizeof()
+      size_t elist_size = adjacency->csr.estimate_sizeof() 
+          + adjacency->csc.estimate_sizeof()
           + sizeof(edges) + sizeof(EdgeData)*edges.capacity();
       size_t ebuffer_size = edge_buffer.estimate_sizeof();
       // std::cerr << "local_graph: tmplist size: " << (double)elist_size/(1024*1024)
@@ -707,9 +816,8 @@ namespace graphlab {
     std::vector<VertexData> vertices;
 
     /** Stores the edge data and edge relationships. */
-    csr_type _csr_storage;
-    csc_type _csc_storage;
     std::vector<EdgeData> edges;
+    boost::shared_ptr<local_graph_adjacency> adjacency;
 
     /** The edge data is a vector of edges where each edge stores its
         source, destination, and data. Used for temporary storage. The
@@ -729,6 +837,8 @@ namespace graphlab {
     /*                                                                        */
     /**************************************************************************/
     friend class local_graph_test; 
+    template <typename OtherVertexData, typename OtherEdgeData>
+    friend class local_graph;
   }; // End of class local_graph
 
 
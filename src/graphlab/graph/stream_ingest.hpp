@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_GRAPH_STREAM_INGEST_HPP
+#define GRAPHLAB_GRAPH_STREAM_INGEST_HPP
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <boost/function.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/graph/vertex_set.hpp>
+#include <graphlab/engine/execution_status.hpp>
+#include <graphlab/util/line_stream_source.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+  /**
+   * \brief Latency and throughput of a \ref stream_ingest run.
+   *
+   * Latencies are measured on machine 0 from the moment an event is
+   * read off the source until the engine run which incorporates it
+   * completes. Times are in seconds.
+   */
+  struct stream_ingest_metrics : public IS_POD_TYPE {
+    /// The number of micro-batches applied
+    size_t batches;
+    /// The number of edge events applied to the graph
+    size_t events;
+    /// The number of lines which could not be parsed or were rejected
+    size_t rejected;
+    /// The number of vertex programs signaled by the incremental runs
+    size_t signaled;
+    /// Time spent adding the edges and finalizing the graph
+    double ingest_time;
+    /// Time spent in the engine
+    double compute_time;
+    /// Wall clock time from open to the end of the stream
+    double elapsed_time;
+    /// Sum of the end to end latencies of all events
+    double total_latency;
+    /// The largest end to end latency of any event
+    double max_latency;
+
+    stream_ingest_metrics() :
+      batches(0), events(0), rejected(0), signaled(0), ingest_time(0),
+      compute_time(0), elapsed_time(0), total_latency(0), max_latency(0) { }
+
+    /// Events applied per second of wall clock time
+    double throughput() const {
+      return elapsed_time > 0 ? events / elapsed_time : 0;
+    }
+
+    /// The mean end to end latency of an event
+    double mean_latency() const {
+      return events > 0 ? total_latency / events : 0;
+    }
+  }; // end of stream_ingest_metrics
+
+  inline std::ostream& operator<<(std::ostream& out,
+                                  const stream_ingest_metrics& m) {
+    return out << "batches: " << m.batches
+               << "\tevents: " << m.events
+               << "\trejected: " << m.rejected
+               << "\tsignaled: " << m.signaled
+               << "\tthroughput: " << m.throughput() << " events/s"
+               << "\tmean latency: " << m.mean_latency() << " s"
+               << "\tmax latency: " << m.max_latency << " s"
+               << "\tingest: " << m.ingest_time << " s"
+               << "\tcompute: " << m.compute_time << " s";
+  }
+
+
+  /**
+   * \brief Applies a continuous stream of edge events to a dynamic
+   * graph in micro-batches, running an engine incrementally after
+   * each batch.
+   *
+   * Machine 0 reads one edge event per line from a
+   * \ref line_stream_source, which may be a named pipe or a TCP
+   * socket. Events are grouped into a micro-batch until either
+   * batch_size events have arrived or batch_window seconds have passed
+   * since the first one. Every batch is then broadcast, its edges are
+   * added to the graph in parallel by all machines and the graph is
+   * finalized again. Only the endpoints of the new edges, and
+   * optionally their neighbors, are signaled before the engine is
+   * started, so each run costs time proportional to the change rather
+   * than to the graph. The gather caches of the signaled vertices are
+   * dropped first, since they do not include the new edges.
+   *
+   * \code
+   * graphlab::stream_ingest<graph_type> stream(dc, graph);
+   * stream.set_batch_size(10000);
+   * stream.set_batch_window(0.1);
+   * if (stream.open("tcp://localhost:9999")) {
+   *   graphlab::synchronous_engine<pagerank> engine(dc, graph, clopts);
+   *   graphlab::stream_ingest_metrics m = stream.run(engine);
+   *   dc.cout() << m << std::endl;
+   * }
+   * \endcode
+   *
+   * The graph must be dynamic (built with USE_DYNAMIC_LOCAL_GRAPH)
+   * and the engine must adapt to vertices added between runs, as the
+   * synchronous engine does. Vertices created by the stream start out
+   * with default constructed data. Lines which are empty or start
+   * with '#' are skipped. By default a line holds a source and a
+   * target id; set_parser() installs a parser for other formats.
+   * All functions other than the setters must be called on all
+   * machines simultaneously.
+   */
+  template <typename Graph>
+  class stream_ingest {
+  public:
+    typedef Graph graph_type;
+    typedef typename graph_type::edge_data_type edge_data_type;
+
+    /// A single edge arriving on the stream
+    struct edge_event {
+      vertex_id_type source;
+      vertex_id_type target;
+      edge_data_type data;
+      edge_event() : source(0), target(0), data() { }
+      void save(oarchive& oarc) const { oarc << source << target << data; }
+      void load(iarchive& iarc) { iarc >> source >> target >> data; }
+    };
+
+    /**
+     * Parses a line into an edge event, returning false if the line is
+     * malformed.
+     */
+    typedef boost::function<bool(const std::string&, edge_event&)>
+        event_parser_type;
+
+    /**
+     * Called on all machines after a batch was added to the graph,
+     * with the set of vertices about to be signaled.
+     */
+    typedef boost::function<void(const vertex_set&)> batch_callback_type;
+
+    stream_ingest(distributed_control& dc, graph_type& graph) :
+      dc(dc), graph(graph), batch_size(10000), batch_window(0.1),
+      signal_dir(NO_EDGES), parser(&stream_ingest::parse_edge) { }
+
+    /// The largest number of events in a micro-batch
+    void set_batch_size(size_t size) {
+      ASSERT_GT(size, 0);
+      batch_size = size;
+    }
+
+    /// The longest time in seconds a micro-batch stays open
+    void set_batch_window(double seconds) {
+      ASSERT_GT(seconds, 0);
+      batch_window = seconds;
+    }
+
+    /**
+     * Also signal the neighbors of the new edge endpoints along dir.
+     * For instance, the PageRank of every out neighbor of a source
+     * changes when the out degree of the source does.
+     */
+    void set_signal_neighbors(edge_dir_type dir) { signal_dir = dir; }
+
+    /// Replaces the default "source target" line parser
+    void set_parser(event_parser_type new_parser) { parser = new_parser; }
+
+    /**
+     * Installs a function which is run after each batch is added to
+     * the graph and before the engine starts, for instance to refresh
+     * vertex data derived from the graph structure.
+     */
+    void set_batch_callback(batch_callback_type callback) {
+      batch_callback = callback;
+    }
+
+    /**
+     * Opens the source on machine 0. See \ref line_stream_source::open
+     * for the format of spec. Returns false on all machines if the
+     * source could not be opened.
+     */
+    bool open(const std::string& spec) {
+      bool success = true;
+      if (dc.procid() == 0) success = source.open(spec);
+      dc.broadcast(success, dc.procid() == 0);
+      start_timer();
+      return success;
+    }
+
+    /**
+     * Reads from an already open file descriptor on machine 0. The
+     * argument is ignored on the other machines.
+     */
+    void attach(int fd, bool take_ownership = false) {
+      if (dc.procid() == 0) source.attach(fd, take_ownership);
+      dc.barrier();
+      start_timer();
+    }
+
+    /**
+     * Applies micro-batches and runs the engine after each of them
+     * until the producer closes the stream, or until the engine is
+     * aborted. Returns the metrics, which are the same on all
+     * machines.
+     */
+    template <typename Engine>
+    stream_ingest_metrics run(Engine& engine) {
+      if (!graph.is_dynamic()) {
+        logstream(LOG_FATAL)
+          << "Streaming ingest requires a dynamic graph. "
+          << "Please compile with -DUSE_DYNAMIC_LOCAL_GRAPH" << std::endl;
+      }
+      std::vector<edge_event> batch;
+      std::vector<double> arrivals;
+      while (next_batch(batch, arrivals)) {
+        if (batch.empty()) continue;
+        timer ti;
+        ti.start();
+        vertex_set affected = apply(batch);
+        if (batch_callback) batch_callback(affected);
+        metrics.ingest_time += ti.current_time();
+        metrics.signaled += graph.vertex_set_size(affected);
+        ti.start();
+        // gathers cached by the previous run miss the new edges
+        engine.clear_gather_caches(affected);
+        engine.signal_vset(affected);
+        const execution_status::status_enum status = engine.start();
+        metrics.compute_time += ti.current_time();
+        ++metrics.batches;
+        metrics.events += batch.size();
+        if (dc.procid() == 0) record_latencies(arrivals);
+        logstream(LOG_INFO) << "Batch " << metrics.batches << ": "
+                            << batch.size() << " events" << std::endl;
+        if (status == execution_status::FORCED_ABORT ||
+            status == execution_status::EXCEPTION) {
+          logstream(LOG_WARNING) << "Engine stopped with status "
+                                 << execution_status::to_string(status)
+                                 << ". Ending the stream." << std::endl;
+          break;
+        }
+      }
+      metrics.elapsed_time = stream_timer.current_time();
+      dc.broadcast(metrics, dc.procid() == 0);
+      return metrics;
+    }
+
+    /// The metrics collected so far on this machine
+    const stream_ingest_metrics& get_metrics() const { return metrics; }
+
+    /// The default parser: a whitespace separated source and target id
+    static bool parse_edge(const std::string& line, edge_event& event) {
+      const char* begin = line.c_str();
+      char* end = NULL;
+      event.source = strtoul(begin, &end, 10);
+      if (end == begin) return false;
+      begin = end;
+      event.target = strtoul(begin, &end, 10);
+      if (end == begin) return false;
+      event.data = edge_data_type();
+      return true;
+    }
+
+  private:
+    distributed_control& dc;
+    graph_type& graph;
+    line_stream_source source;
+    size_t batch_size;
+    double batch_window;
+    edge_dir_type signal_dir;
+    event_parser_type parser;
+    batch_callback_type batch_callback;
+    stream_ingest_metrics metrics;
+    timer stream_timer;
+
+    void start_timer() {
+      metrics = stream_ingest_metrics();
+      stream_timer.start();
+    }
+
+    /**
+     * Fills batch with the next micro-batch, read on machine 0 and
+     * broadcast to the others. The arrival times are only kept on
+     * machine 0. Returns false once the stream has ended and every
+     * event was returned.
+     */
+    bool next_batch(std::vector<edge_event>& batch,
+                    std::vector<double>& arrivals) {
+      batch.clear();
+      arrivals.clear();
+      bool more = true;
+      if (dc.procid() == 0) more = read_batch(batch, arrivals);
+      dc.broadcast(more, dc.procid() == 0);
+      dc.broadcast(batch, dc.procid() == 0);
+      dc.broadcast(metrics.rejected, dc.procid() == 0);
+      return more || !batch.empty();
+    }
+
+    bool read_batch(std::vector<edge_event>& batch,
+                    std::vector<double>& arrivals) {
+      std::string line;
+      edge_event event;
+      timer window;
+      while (batch.size() < batch_size) {
+        // the window opens with the first event of the batch
+        const double timeout = batch.empty() ?
+            batch_window : batch_window - window.current_time();
+        if (timeout <= 0) break;
+        if (!source.read_line(line, timeout)) break;
+        if (line.empty() || line[0] == '#') continue;
+        if (!parser(line, event) || event.source == event.target ||
+            event.source == vertex_id_type(-1) ||
+            event.target == vertex_id_type(-1)) {
+          ++metrics.rejected;
+          logstream(LOG_WARNING) << "Rejected stream event \""
+                                 << line << "\"" << std::endl;
+          continue;
+        }
+        if (batch.empty()) window.start();
+        batch.push_back(event);
+        arrivals.push_back(stream_timer.current_time());
+      }
+      return !source.eof();
+    }
+
+    /**
+     * Adds the edges of the batch to the graph and returns the set of
+     * vertices to signal.
+     */
+    vertex_set apply(const std::vector<edge_event>& batch) {
+      const procid_t procid = dc.procid();
+      const procid_t numprocs = dc.numprocs();
+      for (size_t i = procid; i < batch.size(); i += numprocs) {
+        graph.add_edge(batch[i].source, batch[i].target, batch[i].data);
+      }
+      graph.finalize();
+      // every machine has the whole batch so each marks its own
+      // replicas of the endpoints, masters and mirrors alike
+      vertex_set affected(false);
+      affected.make_explicit(graph);
+      foreach(const edge_event& event, batch) {
+        if (graph.contains_vertex(event.source)) {
+          affected.set_lvid_unsync(graph.local_vid(event.source));
+        }
+        if (graph.contains_vertex(event.target)) {
+          affected.set_lvid_unsync(graph.local_vid(event.target));
+        }
+      }
+      if (signal_dir != NO_EDGES) {
+        affected |= graph.neighbors(affected, signal_dir);
+      }
+      return affected;
+    }
+
+    void record_latencies(const std::vector<double>& arrivals) {
+      const double now = stream_timer.current_time();
+      foreach(double arrival, arrivals) {
+        const double latency = now - arrival;
+        metrics.total_latency += latency;
+        metrics.max_latency = std::max(metrics.max_latency, latency);
+      }
+    }
+  }; // end of stream_ingest
+
+} // end of namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+#endif
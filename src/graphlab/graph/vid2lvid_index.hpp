@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_GRAPH_VID2LVID_INDEX_HPP
+#define GRAPHLAB_GRAPH_VID2LVID_INDEX_HPP
+
+#ifndef __NO_OPENMP__
+#include <omp.h>
+#endif
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <graphlab/graph/graph_basic_types.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * The map from global vertex ids to local vertex ids of a
+   * distributed_graph.
+   *
+   * The index is an open addressing table with linear probing. Its
+   * capacity is the number of entries divided by the maximum load
+   * factor, rather than the next power of two, and hashes are mapped
+   * onto the table with a multiply-shift. vertex_id_type(-1), which is
+   * not a legal vertex id, marks empty slots.
+   *
+   * Inserts come in two flavors. insert() is single threaded and grows
+   * the table geometrically. insert_concurrent() may be called from many threads at
+   * once, never grows the table, and so requires a prior reserve().
+   * insert_parallel() uses it to index a range of local vids with all
+   * OpenMP threads. Lookups may run concurrently with each other and
+   * with insert_concurrent(). Entries are never erased individually.
+   *
+   * prefetch() issues a software prefetch of the slot a lookup will
+   * touch, so callers resolving a batch of vids can hide the cache
+   * misses; see distributed_graph::local_vids().
+   */
+  class vid2lvid_index {
+  public:
+    typedef vertex_id_type key_type;
+    typedef lvid_type mapped_type;
+    typedef std::pair<vertex_id_type, lvid_type> value_type;
+
+    class const_iterator :
+      public std::iterator<std::forward_iterator_tag, value_type> {
+    public:
+      const_iterator() : table(NULL), idx(0) { }
+      const value_type& operator*() const { return (*table)[idx]; }
+      const value_type* operator->() const { return &(*table)[idx]; }
+      const_iterator& operator++() {
+        ++idx;
+        skip_empty();
+        return *this;
+      }
+      const_iterator operator++(int) {
+        const_iterator ret(*this);
+        ++(*this);
+        return ret;
+      }
+      bool operator==(const const_iterator& other) const {
+        return idx == other.idx;
+      }
+      bool operator!=(const const_iterator& other) const {
+        return idx != other.idx;
+      }
+    private:
+      friend class vid2lvid_index;
+      const std::vector<value_type>* table;
+      size_t idx;
+      const_iterator(const std::vector<value_type>* table, size_t idx)
+        : table(table), idx(idx) { }
+      void skip_empty() {
+        while (idx < table->size() && (*table)[idx].first == empty_vid()) ++idx;
+      }
+    };
+    typedef const_iterator iterator;
+
+    vid2lvid_index() { }
+
+    size_t size() const { return numel.value; }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return table.size(); }
+
+    /// Releases all memory.
+    void clear() {
+      std::vector<value_type>().swap(table);
+      numel.value = 0;
+    }
+
+    /**
+     * Makes room for n entries without growing. Not thread safe.
+     */
+    void reserve(size_t n) {
+      if (n <= max_entries(table.size())) return;
+      std::vector<value_type> old;
+      old.swap(table);
+      table.resize(capacity_for(n), value_type(empty_vid(), lvid_type(-1)));
+      for (size_t i = 0; i < old.size(); ++i) {
+        if (old[i].first != empty_vid()) table[probe_empty(old[i].first)] = old[i];
+      }
+    }
+
+    /// Same as reserve(); kept for the hopscotch_map interface.
+    void rehash(size_t n) { reserve(n); }
+
+    const_iterator begin() const {
+      const_iterator iter(&table, 0);
+      iter.skip_empty();
+      return iter;
+    }
+    const_iterator end() const { return const_iterator(&table, table.size()); }
+
+    const_iterator find(const vertex_id_type vid) const {
+      if (table.empty()) return end();
+      for (size_t i = home(vid); ; i = next(i)) {
+        const vertex_id_type cur = table[i].first;
+        if (cur == vid) {
+          wait_for_value(i);
+          return const_iterator(&table, i);
+        }
+        if (cur == empty_vid()) return end();
+      }
+    }
+
+    size_t count(const vertex_id_type vid) const {
+      return find(vid) != end();
+    }
+
+    /// Prefetches the home slot of vid ahead of a find().
+    void prefetch(const vertex_id_type vid) const {
+      if (!table.empty()) __builtin_prefetch(&table[home(vid)]);
+    }
+
+    /**
+     * Inserts the pair if the key is absent. Not thread safe. Returns
+     * the position of the key and whether it was inserted.
+     */
+    std::pair<const_iterator, bool> insert(const value_type& v) {
+      ASSERT_NE(v.first, empty_vid());
+      const_iterator iter = find(v.first);
+      if (iter != end()) return std::make_pair(iter, false);
+      grow(size() + 1);
+      const size_t i = probe_empty(v.first);
+      table[i] = v;
+      ++numel.value;
+      return std::make_pair(const_iterator(&table, i), true);
+    }
+
+    /**
+     * Thread safe insert. If vid is absent it is mapped to lvid,
+     * otherwise the table is unchanged. Returns the lvid vid maps to.
+     * The caller must have reserved room for the entry.
+     */
+    lvid_type insert_concurrent(const vertex_id_type vid, const lvid_type lvid) {
+      ASSERT_NE(vid, empty_vid());
+      ASSERT_LT(size(), table.size());
+      for (size_t i = home(vid); ; i = next(i)) {
+        vertex_id_type cur = table[i].first;
+        if (cur == empty_vid()) {
+          if (atomic_compare_and_swap(table[i].first, empty_vid(), vid)) {
+            // publish the value after the key; readers wait for it
+            __sync_synchronize();
+            table[i].second = lvid;
+            __sync_synchronize();
+            numel.inc();
+            return lvid;
+          }
+          cur = table[i].first;
+        }
+        if (cur == vid) {
+          wait_for_value(i);
+          return table[i].second;
+        }
+      }
+    }
+
+    /**
+     * Indexes the local vids [begin, end) in parallel. vid_of(lvid)
+     * returns the global id of each. Not thread safe with respect to
+     * other inserts.
+     */
+    template <typename VidOf>
+    void insert_parallel(const lvid_type begin, const lvid_type end,
+                         VidOf vid_of) {
+      if (begin >= end) return;
+      grow(size() + (end - begin));
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t lvid = ssize_t(begin); lvid < ssize_t(end); ++lvid) {
+        insert_concurrent(vid_of(lvid_type(lvid)), lvid_type(lvid));
+      }
+    }
+
+    void swap(vid2lvid_index& other) {
+      table.swap(other.table);
+      const size_t tmp = numel.value;
+      numel.value = other.numel.value;
+      other.numel.value = tmp;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << size();
+      for (const_iterator iter = begin(); iter != end(); ++iter) {
+        oarc << iter->first << iter->second;
+      }
+    }
+
+    void load(iarchive& iarc) {
+      size_t s;
+      iarc >> s;
+      clear();
+      reserve(s);
+      for (size_t i = 0; i < s; ++i) {
+        value_type v;
+        iarc >> v.first >> v.second;
+        insert(v);
+      }
+    }
+
+  private:
+    static vertex_id_type empty_vid() { return vertex_id_type(-1); }
+    /// maximum load factor is MAX_LOAD_NUM / MAX_LOAD_DEN
+    static const size_t MAX_LOAD_NUM = 3, MAX_LOAD_DEN = 4;
+
+    std::vector<value_type> table;
+    atomic<size_t> numel;
+
+    /**
+     * Makes room for n entries, at least doubling the table when it
+     * must grow, so that a sequence of inserts rehashes only
+     * logarithmically many times.
+     */
+    void grow(size_t n) {
+      if (n > max_entries(table.size())) reserve(std::max(n, 2 * size()));
+    }
+
+    static size_t max_entries(size_t capacity) {
+      return capacity * MAX_LOAD_NUM / MAX_LOAD_DEN;
+    }
+
+    static size_t capacity_for(size_t n) {
+      size_t cap = n * MAX_LOAD_DEN / MAX_LOAD_NUM + 1;
+      if (cap < 16) cap = 16;
+      while (max_entries(cap) < n) ++cap;
+      return cap;
+    }
+
+    /// splitmix64 finalizer
+    static uint64_t mix(uint64_t h) {
+      h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+      h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+      h ^= h >> 31;
+      return h;
+    }
+
+    size_t home(const vertex_id_type vid) const {
+      return size_t((__uint128_t(mix(vid)) * table.size()) >> 64);
+    }
+
+    size_t next(size_t i) const {
+      return (i + 1 == table.size()) ? 0 : i + 1;
+    }
+
+    size_t probe_empty(const vertex_id_type vid) const {
+      size_t i = home(vid);
+      while (table[i].first != empty_vid()) i = next(i);
+      return i;
+    }
+
+    /// Waits for a concurrent insert of slot i to publish its value.
+    void wait_for_value(size_t i) const {
+      while (*(volatile const lvid_type*)(&table[i].second) == lvid_type(-1)) {
+        asm volatile("pause\n": : :"memory");
+      }
+    }
+  }; // end of class vid2lvid_index
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,196 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <pthread.h>
+#include <vector>
+#include <graphlab/parallel/epoch_reclaimer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+
+namespace graphlab {
+
+namespace {
+
+  struct retired_object {
+    void* ptr;
+    epoch_reclaimer::deleter_type deleter;
+    size_t epoch;
+  };
+
+  /**
+   * The state of one thread. state is (epoch << 1) | 1 while the
+   * thread is inside a guard and 0 otherwise. Records are never freed:
+   * the record of an exited thread is reused by the next new thread.
+   */
+  struct thread_record {
+    volatile size_t state;
+    size_t nesting;
+    std::vector<retired_object> limbo;
+    bool in_use;
+    thread_record* next;
+    thread_record() : state(0), nesting(0), in_use(false), next(NULL) { }
+  };
+
+  /// Retire this many objects before trying to reclaim.
+  const size_t RECLAIM_THRESHOLD = 128;
+
+  void release_record(void* ptr);
+
+  struct registry_type {
+    volatile size_t global_epoch;
+    /// list of all records; only prepended to, under lock
+    thread_record* volatile head;
+    mutex lock;
+    /// objects retired by threads which have exited; under lock
+    std::vector<retired_object> orphans;
+    pthread_key_t key;
+    registry_type() : global_epoch(2), head(NULL) {
+      pthread_key_create(&key, release_record);
+    }
+  };
+
+  // Never destroyed, so that threads exiting during static
+  // destruction can still hand over their retired objects.
+  registry_type& registry() {
+    static registry_type* reg = new registry_type;
+    return *reg;
+  }
+
+  void release_record(void* ptr) {
+    thread_record* rec = static_cast<thread_record*>(ptr);
+    registry_type& reg = registry();
+    reg.lock.lock();
+    reg.orphans.insert(reg.orphans.end(), rec->limbo.begin(), rec->limbo.end());
+    rec->limbo.clear();
+    rec->nesting = 0;
+    rec->state = 0;
+    rec->in_use = false;
+    reg.lock.unlock();
+  }
+
+  thread_record* get_record() {
+    registry_type& reg = registry();
+    thread_record* rec =
+      static_cast<thread_record*>(pthread_getspecific(reg.key));
+    if (rec != NULL) return rec;
+    reg.lock.lock();
+    for (rec = reg.head; rec != NULL; rec = rec->next) {
+      if (!rec->in_use) break;
+    }
+    if (rec == NULL) {
+      rec = new thread_record;
+      rec->next = reg.head;
+      __sync_synchronize();
+      reg.head = rec;
+    }
+    rec->in_use = true;
+    reg.lock.unlock();
+    pthread_setspecific(reg.key, rec);
+    return rec;
+  }
+
+  /**
+   * Advances the global epoch if every thread inside a guard has
+   * observed the current one.
+   */
+  void try_advance() {
+    registry_type& reg = registry();
+    const size_t epoch = reg.global_epoch;
+    __sync_synchronize();
+    for (thread_record* rec = reg.head; rec != NULL; rec = rec->next) {
+      const size_t state = rec->state;
+      if ((state & 1) && (state >> 1) != epoch) return;
+    }
+    atomic_compare_and_swap(reg.global_epoch, epoch, epoch + 1);
+  }
+
+  /**
+   * Moves the objects of list that are two epochs old into ready.
+   */
+  void collect(std::vector<retired_object>& list, size_t epoch,
+               std::vector<retired_object>& ready) {
+    size_t keep = 0;
+    for (size_t i = 0; i < list.size(); ++i) {
+      if (list[i].epoch + 2 <= epoch) ready.push_back(list[i]);
+      else list[keep++] = list[i];
+    }
+    list.resize(keep);
+  }
+
+} // anonymous namespace
+
+
+void epoch_reclaimer::enter() {
+  thread_record* rec = get_record();
+  if (rec->nesting++ > 0) return;
+  registry_type& reg = registry();
+  size_t epoch;
+  // publish the epoch, and retry if it moved before we were visible
+  do {
+    epoch = reg.global_epoch;
+    rec->state = (epoch << 1) | 1;
+    __sync_synchronize();
+  } while (reg.global_epoch != epoch);
+}
+
+void epoch_reclaimer::exit() {
+  thread_record* rec = get_record();
+  if (--rec->nesting > 0) return;
+  __sync_synchronize();
+  rec->state = 0;
+}
+
+void epoch_reclaimer::retire(void* ptr, deleter_type deleter) {
+  thread_record* rec = get_record();
+  retired_object obj;
+  obj.ptr = ptr;
+  obj.deleter = deleter;
+  obj.epoch = registry().global_epoch;
+  rec->limbo.push_back(obj);
+  if (rec->limbo.size() >= RECLAIM_THRESHOLD) reclaim();
+}
+
+size_t epoch_reclaimer::reclaim() {
+  registry_type& reg = registry();
+  thread_record* rec = get_record();
+  try_advance();
+  const size_t epoch = reg.global_epoch;
+  std::vector<retired_object> ready;
+  collect(rec->limbo, epoch, ready);
+  if (reg.lock.try_lock()) {
+    collect(reg.orphans, epoch, ready);
+    reg.lock.unlock();
+  }
+  // the deleters may retire further objects
+  for (size_t i = 0; i < ready.size(); ++i) {
+    ready[i].deleter(ready[i].ptr);
+  }
+  return ready.size();
+}
+
+size_t epoch_reclaimer::current_epoch() {
+  return registry().global_epoch;
+}
+
+} // namespace graphlab
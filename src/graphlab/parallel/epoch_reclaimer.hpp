@@ -0,0 +1,108 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_EPOCH_RECLAIMER_HPP
+#define GRAPHLAB_EPOCH_RECLAIMER_HPP
+
+#include <cstddef>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Epoch based memory reclamation for lock-free data structures.
+   *
+   * A thread that reads shared nodes of a lock-free structure does so
+   * inside an epoch_reclaimer::guard. A thread that unlinks a node
+   * passes it to retire() instead of deleting it. The node is deleted
+   * only once every thread that was inside a guard at the time of the
+   * retire has left it, so no reader can still hold a pointer to it.
+   * Because retired memory is not reused during that grace period,
+   * the same mechanism also rules out ABA on pointer compare-and-swap.
+   *
+   * \code
+   * {
+   *   epoch_reclaimer::guard g;
+   *   node* head = stack_head;
+   *   ... read head->next, compare and swap stack_head ...
+   * }
+   * epoch_reclaimer::retire(head);
+   * \endcode
+   *
+   * Guards nest and are cheap: a thread local store plus a memory
+   * fence. They are per thread, so a fiber must not yield while it
+   * holds one. Retired nodes are collected per thread and reclaimed in
+   * batches; the nodes of exiting threads are handed over to the
+   * remaining threads.
+   */
+  class epoch_reclaimer {
+  public:
+    typedef void (*deleter_type)(void*);
+
+    /// Pins the calling thread to the current epoch.
+    static void enter();
+
+    /// Unpins the calling thread.
+    static void exit();
+
+    /**
+     * Schedules deleter(ptr) once no thread can still be reading ptr.
+     * May be called inside or outside a guard.
+     */
+    static void retire(void* ptr, deleter_type deleter);
+
+    /// Schedules "delete ptr" once no thread can still be reading ptr.
+    template <typename T>
+    static void retire(T* ptr) {
+      retire(static_cast<void*>(ptr), &delete_object<T>);
+    }
+
+    /**
+     * Tries to advance the global epoch and reclaims whatever the
+     * calling thread (and any exited thread) retired long enough ago.
+     * Returns the number of objects deleted.
+     */
+    static size_t reclaim();
+
+    /// The current global epoch.
+    static size_t current_epoch();
+
+    /// RAII wrapper around enter() and exit().
+    class guard {
+    public:
+      guard() { enter(); }
+      ~guard() { exit(); }
+    private:
+      guard(const guard&);
+      guard& operator=(const guard&);
+    };
+
+  private:
+    template <typename T>
+    static void delete_object(void* ptr) { delete static_cast<T*>(ptr); }
+  };
+
+} // namespace graphlab
+
+#endif
@@ -24,6 +24,7 @@
 #include <boost/bind.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/parallel/fiber_control.hpp>
+#include <graphlab/util/lock_free_pool.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/macros_def.hpp>
@@ -243,6 +244,21 @@ struct trampoline_args {
   boost::function<void(void)> fn;
 };
 
+// Fibers are created and destroyed at a high rate under asynchronous
+// loads, frequently on different workers. The pools are never
+// destroyed since fibers may outlive static destruction.
+static lock_free_object_pool<fiber_control::fiber>& fiber_pool() {
+  static lock_free_object_pool<fiber_control::fiber>* pool =
+    new lock_free_object_pool<fiber_control::fiber>;
+  return *pool;
+}
+
+static lock_free_object_pool<trampoline_args>& trampoline_args_pool() {
+  static lock_free_object_pool<trampoline_args>* pool =
+    new lock_free_object_pool<trampoline_args>;
+  return *pool;
+}
+
 // the trampoline to call the user function. This function never returns
 void fiber_control::trampoline(intptr_t _args) {
   // we may have launched to here by switching in from another fiber.
@@ -256,7 +272,7 @@ void fiber_control::trampoline(intptr_t _args) {
     args->fn();
   } catch (...) {
   }
-  delete args;
+  trampoline_args_pool().destroy(args);
   fiber_control::exit();
 }
 
@@ -270,7 +286,7 @@ size_t fiber_control::launch(boost::function<void(void)> fn,
   ASSERT_LT(b, nworkers);
 
   // allocate a stack
-  fiber* fib = new fiber;
+  fiber* fib = fiber_pool().construct();
   fib->parent = this;
   fib->stack = malloc(stacksize);
   fib->id = fiber_id_counter.inc();
@@ -288,7 +304,7 @@ size_t fiber_control::launch(boost::function<void(void)> fn,
   fib->descheduled = false;
   fib->scheduleable = true;
   // construct the initial context
-  trampoline_args* args = new trampoline_args;
+  trampoline_args* args = trampoline_args_pool().construct();
   args->fn = fn;
   fib->initial_trampoline_args = (intptr_t)(args);
   // stack grows downwards.
@@ -408,7 +424,7 @@ void fiber_control::reschedule_fiber(size_t workerid, fiber* fib) {
     //VALGRIND_STACK_DEREGISTER(fib->stack);
     // delete the fiber local storage if any
     if (fib->fls && flsdeleter) flsdeleter(fib->fls);
-    delete fib;
+    fiber_pool().destroy(fib);
     // if we are out of threads, signal the join
     if (fibers_active.dec() == 0) {
       join_lock.lock();
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_LOCK_TABLE_HPP
+#define GRAPHLAB_LOCK_TABLE_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/cache_line_pad.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A table of locks indexed by element id (typically an lvid or a
+   * local edge id) whose representation can be chosen at runtime.
+   *
+   * \li \c VERTEX_LOCKS One spinlock per element. Adjacent locks
+   *     share cache lines.
+   * \li \c STRIPED_LOCKS A fixed number of spinlocks, each on its own
+   *     cache line. Element i maps to stripe i mod nstripes so that
+   *     neighbouring ids never share a line, and memory does not grow
+   *     with the number of elements. Since distinct elements may share
+   *     a stripe, a thread must not acquire a second lock while
+   *     holding one, except through lock_pair().
+   * \li \c BIT_LOCKS One bit per element. The smallest footprint, at
+   *     the cost of contention between ids in the same word.
+   * \li \c NO_LOCKS All operations are no-ops. Only valid when the
+   *     caller has established that a single thread writes the
+   *     protected data.
+   */
+  class lock_table {
+  public:
+    enum lock_mode { VERTEX_LOCKS, STRIPED_LOCKS, BIT_LOCKS, NO_LOCKS };
+
+    /// The default number of stripes in STRIPED_LOCKS mode (4MB)
+    static const size_t DEFAULT_NUM_STRIPES = 1 << 16;
+
+  private:
+    typedef cache_line_pad<simple_spinlock> padded_lock;
+    lock_mode mode;
+    size_t nelems;
+    size_t stripe_mask;
+    std::vector<simple_spinlock> vertex_locks;
+    std::vector<padded_lock> stripes;
+    std::vector<size_t> bits;
+
+    static size_t next_powerof2(size_t val) {
+      size_t ret = 1;
+      while(ret < val) ret <<= 1;
+      return ret;
+    }
+
+    /// The index of the lock guarding element i, used to order pairs
+    size_t slot(size_t i) const {
+      return mode == STRIPED_LOCKS ? (i & stripe_mask) : i;
+    }
+
+    void lock_bit(size_t i) {
+      volatile size_t* word = &bits[i / (8 * sizeof(size_t))];
+      const size_t mask = size_t(1) << (i % (8 * sizeof(size_t)));
+      while((__sync_fetch_and_or(word, mask) & mask) != 0) {
+        while((*word & mask) != 0) asm volatile("pause\n": : :"memory");
+      }
+    }
+
+    void unlock_bit(size_t i) {
+      volatile size_t* word = &bits[i / (8 * sizeof(size_t))];
+      const size_t mask = size_t(1) << (i % (8 * sizeof(size_t)));
+      __sync_fetch_and_and(word, ~mask);
+    }
+
+    bool try_lock_bit(size_t i) {
+      volatile size_t* word = &bits[i / (8 * sizeof(size_t))];
+      const size_t mask = size_t(1) << (i % (8 * sizeof(size_t)));
+      return (__sync_fetch_and_or(word, mask) & mask) == 0;
+    }
+
+  public:
+    lock_table() : mode(VERTEX_LOCKS), nelems(0), stripe_mask(0) { }
+
+    /**
+     * Prepares the table to guard n elements using the given mode.
+     * nstripes is rounded up to a power of two and is only used by
+     * STRIPED_LOCKS. No lock may be held across a call to resize().
+     */
+    void resize(size_t n, lock_mode m = VERTEX_LOCKS,
+                size_t nstripes = DEFAULT_NUM_STRIPES) {
+      mode = m;
+      nelems = n;
+      std::vector<simple_spinlock>().swap(vertex_locks);
+      std::vector<padded_lock>().swap(stripes);
+      std::vector<size_t>().swap(bits);
+      stripe_mask = 0;
+      if (mode == VERTEX_LOCKS) {
+        vertex_locks.resize(n);
+      } else if (mode == STRIPED_LOCKS) {
+        ASSERT_GT(nstripes, 0);
+        // no point in more stripes than elements
+        const size_t count = next_powerof2(std::min(nstripes,
+                                                    std::max<size_t>(n, 1)));
+        stripes.resize(count);
+        stripe_mask = count - 1;
+      } else if (mode == BIT_LOCKS) {
+        bits.resize(n / (8 * sizeof(size_t)) + 1, 0);
+      }
+    }
+
+    /// Releases all memory
+    void clear() { resize(0, mode); }
+
+    /// The number of elements guarded
+    size_t size() const { return nelems; }
+
+    /// The mode chosen in the last call to resize()
+    lock_mode get_mode() const { return mode; }
+
+    /// The number of bytes used by the locks
+    size_t memory_usage() const {
+      return vertex_locks.size() * sizeof(simple_spinlock) +
+          stripes.size() * sizeof(padded_lock) +
+          bits.size() * sizeof(size_t);
+    }
+
+    /// Acquires the lock guarding element i
+    inline void lock(size_t i) {
+      switch(mode) {
+       case VERTEX_LOCKS: vertex_locks[i].lock(); break;
+       case STRIPED_LOCKS: stripes[i & stripe_mask].value.lock(); break;
+       case BIT_LOCKS: lock_bit(i); break;
+       case NO_LOCKS: break;
+      }
+    }
+
+    /// Releases the lock guarding element i
+    inline void unlock(size_t i) {
+      switch(mode) {
+       case VERTEX_LOCKS: vertex_locks[i].unlock(); break;
+       case STRIPED_LOCKS: stripes[i & stripe_mask].value.unlock(); break;
+       case BIT_LOCKS: unlock_bit(i); break;
+       case NO_LOCKS: break;
+      }
+    }
+
+    /// Non-blocking attempt to acquire the lock guarding element i
+    inline bool try_lock(size_t i) {
+      switch(mode) {
+       case VERTEX_LOCKS: return vertex_locks[i].try_lock();
+       case STRIPED_LOCKS: return stripes[i & stripe_mask].value.try_lock();
+       case BIT_LOCKS: return try_lock_bit(i);
+       case NO_LOCKS: break;
+      }
+      return true;
+    }
+
+    /**
+     * Acquires the locks guarding both a and b in a global order,
+     * taking the lock only once if both map to the same lock.
+     */
+    inline void lock_pair(size_t a, size_t b) {
+      const size_t sa = slot(a), sb = slot(b);
+      if (sa == sb) {
+        lock(a);
+      } else if (sa < sb) {
+        lock(a); lock(b);
+      } else {
+        lock(b); lock(a);
+      }
+    }
+
+    /// Releases the locks acquired by lock_pair(a, b)
+    inline void unlock_pair(size_t a, size_t b) {
+      unlock(a);
+      if (slot(a) != slot(b)) unlock(b);
+    }
+
+    /**
+     * Parses a mode name: "vertex", "striped", "bit" or "none".
+     * Returns false if the name is not recognized.
+     */
+    static bool parse_mode(const std::string& name, lock_mode& ret) {
+      if (name == "vertex") ret = VERTEX_LOCKS;
+      else if (name == "striped") ret = STRIPED_LOCKS;
+      else if (name == "bit") ret = BIT_LOCKS;
+      else if (name == "none") ret = NO_LOCKS;
+      else return false;
+      return true;
+    }
+
+    /// The name of a mode as accepted by parse_mode()
+    static const char* mode_name(lock_mode m) {
+      switch(m) {
+       case VERTEX_LOCKS: return "vertex";
+       case STRIPED_LOCKS: return "striped";
+       case BIT_LOCKS: return "bit";
+       case NO_LOCKS: return "none";
+      }
+      return "unknown";
+    }
+  }; // end of lock_table
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,120 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_RPC_PROCESS_MEMBERSHIP_HPP
+#define GRAPHLAB_RPC_PROCESS_MEMBERSHIP_HPP
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/util/stl_util.hpp>
+#include <graphlab/logger/logger.hpp>
+namespace graphlab {
+
+/**
+ * \ingroup rpc
+ * \brief Maps an external list of member names to the procids of the
+ * running processes.
+ *
+ * Every process is given a name, such as its "ip:port" address
+ * (by default, its procid). An external membership service, such as a
+ * Zookeeper namespace, then decides which of the processes should
+ * hold the graph, and active_procs() turns the current member list
+ * into the set of procids expected by
+ * distributed_graph::set_active_procs():
+ *
+ * \code
+ * zookeeper::server_list zk(zkhosts, jobname, my_address);
+ * zk.join("active");
+ * graphlab::process_membership membership(dc, my_address);
+ * // ... later, between engine runs:
+ * graph.set_active_procs(membership.active_procs(zk, "active"));
+ * \endcode
+ *
+ * The constructor and active_procs() must be called on all
+ * processes simultaneously.
+ */
+class process_membership {
+ private:
+  dc_dist_object<process_membership> rmi;
+  /// The name of each process, indexed by procid
+  std::vector<std::string> names;
+
+ public:
+  /**
+   * Exchanges the names of all processes. If name is empty, the
+   * procid of the process is used.
+   */
+  process_membership(distributed_control& dc, std::string name = "")
+      : rmi(dc, this) {
+    if (name.empty()) name = tostr(dc.procid());
+    names.resize(dc.numprocs());
+    names[dc.procid()] = name;
+    rmi.all_gather(names);
+  }
+
+  /// Returns the name of process p
+  const std::string& name(procid_t p) const {
+    return names[p];
+  }
+
+  /**
+   * Returns the procids of the processes named in members, in
+   * increasing order. Names which match no process are ignored.
+   */
+  std::vector<procid_t> resolve(const std::vector<std::string>& members) const {
+    std::vector<procid_t> procs;
+    for (size_t i = 0; i < members.size(); ++i) {
+      std::vector<std::string>::const_iterator iter =
+          std::find(names.begin(), names.end(), members[i]);
+      if (iter == names.end()) {
+        logstream(LOG_WARNING) << "Member " << members[i]
+                               << " is not a running process" << std::endl;
+      } else {
+        procs.push_back(iter - names.begin());
+      }
+    }
+    std::sort(procs.begin(), procs.end());
+    procs.erase(std::unique(procs.begin(), procs.end()), procs.end());
+    return procs;
+  }
+
+  /**
+   * Reads the members of name_space from list on process 0, and
+   * returns their procids on all processes. ServerList has the
+   * get_all_servers() interface of zookeeper::server_list.
+   */
+  template <typename ServerList>
+  std::vector<procid_t> active_procs(ServerList& list,
+                                     const std::string& name_space) {
+    std::vector<std::string> members;
+    if (rmi.procid() == 0) members = list.get_all_servers(name_space);
+    rmi.broadcast(members, rmi.procid() == 0);
+    return resolve(members);
+  }
+}; // end of process_membership
+
+} // namespace graphlab
+#endif
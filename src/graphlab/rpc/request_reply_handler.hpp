@@ -26,6 +26,7 @@
 #include <string>
 #include <graphlab/parallel/atomic.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/util/lock_free_pool.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 namespace graphlab {
 
@@ -135,6 +136,31 @@ struct basic_reply_container: public ireply_container{
   blob& get_blob() {
     return val;
   }
+
+  /**
+   * Every remote request allocates a reply container, and the reply
+   * is frequently released on a different thread from the one which
+   * issued the request. Containers are therefore drawn from a shared
+   * pool with per-thread caches rather than from the global heap.
+   */
+  static void* operator new(size_t size) {
+    if (size != sizeof(basic_reply_container)) return ::operator new(size);
+    return pool().alloc_raw();
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    if (ptr == NULL) return;
+    if (size != sizeof(basic_reply_container)) ::operator delete(ptr);
+    else pool().free_raw(ptr);
+  }
+
+ private:
+  typedef lock_free_object_pool<basic_reply_container> pool_type;
+  // never destroyed: futures may be released during static destruction
+  static pool_type& pool() {
+    static pool_type* p = new pool_type;
+    return *p;
+  }
 };
 
 
@@ -24,104 +24,408 @@
 #ifndef GRAPHLAB_RPC_SAMPLE_SORT_HPP
 #define GRAPHLAB_RPC_SAMPLE_SORT_HPP
 
+#ifndef __NO_OPENMP__
+#include <omp.h>
+#endif
+
 #include <vector>
 #include <algorithm>
 #include <utility>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_signed.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/rpc/buffered_exchange.hpp>
 #include <graphlab/logger/assertions.hpp>
+#include <graphlab/util/empty.hpp>
 namespace graphlab {
 
 namespace sample_sort_impl {
   template <typename Key, typename Value>
   struct pair_key_comparator {
     bool operator()(const std::pair<Key,Value>& k1,
-                    const std::pair<Key,Value>& k2) {
+                    const std::pair<Key,Value>& k2) const {
       return k1.first < k2.first;
     }
   };
-}
 
-template <typename Key, typename Value>
-class sample_sort {
- private:
-  dc_dist_object<sample_sort<Key, Value> > rmi;
+  /// Extracts the sort key of a key-value pair.
+  template <typename Key, typename Value>
+  struct pair_key {
+    typedef Key key_type;
+    typedef pair_key_comparator<Key, Value> comparator_type;
+    const Key& operator()(const std::pair<Key,Value>& kv) const {
+      return kv.first;
+    }
+  };
 
-  typedef buffered_exchange<std::pair<Key, Value> > key_exchange_type;
+  /// Extracts the sort key of a bare key.
+  template <typename Key>
+  struct identity_key {
+    typedef Key key_type;
+    typedef std::less<Key> comparator_type;
+    const Key& operator()(const Key& k) const { return k; }
+  };
 
-  key_exchange_type key_exchange;
-  std::vector<std::pair<Key, Value> > key_values;
- public:
-  sample_sort(distributed_control& dc): rmi(dc, this), key_exchange(dc) { }
+  inline size_t num_sort_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
 
-  template <typename KeyIterator, typename ValueIterator>
-  void sort(KeyIterator kstart, KeyIterator kend,
-            ValueIterator vstart, ValueIterator vend) {
-    rmi.barrier();
+  inline size_t sort_thread_id() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+  }
 
-    size_t num_entries = std::distance(kstart, kend);
-    ASSERT_EQ(num_entries, std::distance(vstart, vend));
+  /// Maps an integral key onto an unsigned integer with the same order.
+  template <typename Key>
+  inline uint64_t radix_of(const Key& key) {
+    uint64_t ret = uint64_t(key);
+    if (boost::is_signed<Key>::value) {
+      ret ^= uint64_t(1) << (8 * sizeof(Key) - 1);
+      if (sizeof(Key) < 8) ret &= (uint64_t(1) << (8 * sizeof(Key))) - 1;
+    }
+    return ret;
+  }
 
-    // we will sample k * p entries
-    std::vector<std::vector<Key> > sampled_keys(rmi.numprocs());
-    for (size_t i = 0;i < 100 * rmi.numprocs(); ++i) {
-      size_t idx = (rand() % num_entries); 
-      sampled_keys[rmi.procid()].push_back(*(kstart + idx));
+  /**
+   * Sorts data by an integral key with a parallel LSD radix sort over
+   * bytes. Each thread histograms and scatters its own contiguous
+   * chunk so the sort is stable. Passes over bytes which are equal
+   * in every key are skipped.
+   */
+  template <typename T, typename KeyOf>
+  void parallel_radix_sort(std::vector<T>& data, KeyOf keyof) {
+    typedef typename KeyOf::key_type key_type;
+    const size_t n = data.size();
+    const size_t nthreads = num_sort_threads();
+    std::vector<T> tmp(n);
+    std::vector<size_t> hist(nthreads * 256);
+    for (size_t byte = 0; byte < sizeof(key_type); ++byte) {
+      const size_t shift = 8 * byte;
+      std::fill(hist.begin(), hist.end(), 0);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t tid = 0; tid < ssize_t(nthreads); ++tid) {
+        size_t* h = &hist[tid * 256];
+        const size_t begin = n * tid / nthreads, end = n * (tid + 1) / nthreads;
+        for (size_t i = begin; i < end; ++i) {
+          ++h[(radix_of(keyof(data[i])) >> shift) & 0xff];
+        }
+      }
+      // digit major, thread minor exclusive prefix sum
+      bool trivial = false;
+      size_t offset = 0;
+      for (size_t d = 0; d < 256; ++d) {
+        size_t digit_total = 0;
+        for (size_t t = 0; t < nthreads; ++t) {
+          const size_t c = hist[t * 256 + d];
+          hist[t * 256 + d] = offset;
+          offset += c;
+          digit_total += c;
+        }
+        if (digit_total == n) trivial = true;
+      }
+      if (trivial) continue;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t tid = 0; tid < ssize_t(nthreads); ++tid) {
+        size_t* h = &hist[tid * 256];
+        const size_t begin = n * tid / nthreads, end = n * (tid + 1) / nthreads;
+        for (size_t i = begin; i < end; ++i) {
+          tmp[h[(radix_of(keyof(data[i])) >> shift) & 0xff]++] = data[i];
+        }
+      }
+      data.swap(tmp);
     }
+  }
 
-    rmi.all_gather(sampled_keys);
-    // collapse into a single array and sort
-    std::vector<Key> all_sampled_keys;
-    for (size_t i = 0;i < sampled_keys.size(); ++i) {
-      std::copy(sampled_keys[i].begin(), sampled_keys[i].end(),
-                std::inserter(all_sampled_keys, all_sampled_keys.end()));
+  /**
+   * Sorts data with a comparison sort: each thread sorts a chunk and
+   * the chunks are then merged pairwise in parallel.
+   */
+  template <typename T, typename Comparator>
+  void parallel_comparison_sort(std::vector<T>& data, Comparator comp) {
+    const size_t n = data.size();
+    const size_t nchunks = num_sort_threads();
+    std::vector<size_t> bounds(nchunks + 1);
+    for (size_t i = 0; i <= nchunks; ++i) bounds[i] = n * i / nchunks;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (ssize_t i = 0; i < ssize_t(nchunks); ++i) {
+      std::sort(data.begin() + bounds[i], data.begin() + bounds[i + 1], comp);
     }
-    // sort the sampled keys and extract the ranges
-    std::sort(all_sampled_keys.begin(), all_sampled_keys.end());
-    std::vector<Key> ranges(rmi.numprocs());
-    ranges[0] = Key();
-    for(size_t i = 1; i < rmi.numprocs(); ++i) {
-      ranges[i] = all_sampled_keys[sampled_keys[0].size() * i];
+    std::vector<T> tmp(n);
+    for (size_t width = 1; width < nchunks; width *= 2) {
+      const size_t nmerges = (nchunks + 2 * width - 1) / (2 * width);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (ssize_t m = 0; m < ssize_t(nmerges); ++m) {
+        const size_t lo = bounds[2 * width * m];
+        const size_t mid = bounds[std::min(2 * width * m + width, nchunks)];
+        const size_t hi = bounds[std::min(2 * width * (m + 1), nchunks)];
+        std::merge(data.begin() + lo, data.begin() + mid,
+                   data.begin() + mid, data.begin() + hi,
+                   tmp.begin() + lo, comp);
+      }
+      data.swap(tmp);
     }
+  }
 
-    // begin shuffle 
-    KeyIterator kiter = kstart;
-    ValueIterator viter = vstart;
-    if (rmi.numprocs() < 8) {
-      while(kiter != kend) {
-        procid_t target_machine = 0;
-        while (target_machine < rmi.numprocs() - 1  && 
-               ranges[target_machine + 1] < *kiter) ++target_machine;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
-      }
-    } 
-    else {
-      while(kiter != kend) {
-        procid_t target_machine = 
-          std::upper_bound(ranges.begin(), ranges.end(), *kiter) 
-          - ranges.begin() - 1;
-        key_exchange.send(target_machine, std::make_pair(*kiter, *viter));
-        ++kiter; ++viter;
+  template <typename T, typename KeyOf>
+  void parallel_sort(std::vector<T>& data, KeyOf keyof, boost::true_type) {
+    parallel_radix_sort(data, keyof);
+  }
+
+  template <typename T, typename KeyOf>
+  void parallel_sort(std::vector<T>& data, KeyOf keyof, boost::false_type) {
+    parallel_comparison_sort(data, typename KeyOf::comparator_type());
+  }
+
+  /**
+   * Sorts data in parallel by the key extracted with KeyOf. Integral
+   * keys use a radix sort and everything else a comparison sort.
+   */
+  template <typename T, typename KeyOf>
+  void parallel_sort(std::vector<T>& data, KeyOf keyof) {
+    typedef typename KeyOf::key_type key_type;
+    // small inputs are not worth the threads
+    if (data.size() < 65536) {
+      std::sort(data.begin(), data.end(), typename KeyOf::comparator_type());
+      return;
+    }
+    parallel_sort(data, keyof, boost::is_integral<key_type>());
+  }
+
+
+  /**
+   * The machinery shared by the key-value and key-only sorters.
+   *
+   * The sort uses regular sampling: every machine sorts its local
+   * data, contributes evenly spaced samples, and the gathered samples
+   * pick the splitters. Samples and splitters are ordered by (key,
+   * machine, local position), so runs of equal keys are divided
+   * between machines like any other keys. With s samples per machine
+   * no machine receives more than about N/p + N/s elements, whatever
+   * the key distribution.
+   */
+  template <typename T, typename KeyOf>
+  class sample_sort_base {
+   public:
+    typedef typename KeyOf::key_type key_type;
+
+   private:
+    dc_dist_object<sample_sort_base<T, KeyOf> > rmi;
+    typedef buffered_exchange<T> exchange_type;
+    exchange_type exchange;
+    size_t oversampling;
+    KeyOf keyof;
+
+    struct splitter {
+      key_type key;
+      procid_t proc;
+      size_t pos;
+      bool operator<(const splitter& other) const {
+        if (key < other.key) return true;
+        if (other.key < key) return false;
+        if (proc != other.proc) return proc < other.proc;
+        return pos < other.pos;
       }
+    };
+
+   protected:
+    std::vector<T> values;
+
+    sample_sort_base(distributed_control& dc, size_t oversampling)
+      : rmi(dc, this), exchange(dc, num_sort_threads()),
+        oversampling(std::max<size_t>(oversampling, 1)) { }
+
+    /// Position in the sorted local data where splitter s cuts it.
+    size_t cut_position(const std::vector<T>& local, const splitter& s) {
+      typename std::vector<T>::const_iterator lo =
+        std::lower_bound(local.begin(), local.end(), s.key,
+                         element_less_key());
+      typename std::vector<T>::const_iterator hi =
+        std::upper_bound(lo, local.end(), s.key, key_less_element());
+      const size_t lopos = lo - local.begin(), hipos = hi - local.begin();
+      if (rmi.procid() < s.proc) return hipos;
+      if (rmi.procid() > s.proc) return lopos;
+      return std::min(std::max(s.pos + 1, lopos), hipos);
     }
-    key_exchange.flush();
- 
-    // read from key exchange 
-    procid_t recvid;
-    typename key_exchange_type::buffer_type buffer;
-    while(key_exchange.recv(recvid, buffer)) {
-      std::copy(buffer.begin(), buffer.end(), 
-          std::inserter(key_values, key_values.end()));
+
+    struct element_less_key {
+      KeyOf keyof;
+      bool operator()(const T& a, const key_type& b) const {
+        return keyof(a) < b;
+      }
+    };
+
+    struct key_less_element {
+      KeyOf keyof;
+      bool operator()(const key_type& a, const T& b) const {
+        return a < keyof(b);
+      }
+    };
+
+    /**
+     * Sorts local across all machines. On return values holds this
+     * machine's range of the global order. local is consumed.
+     */
+    void distributed_sort(std::vector<T>& local) {
+      rmi.barrier();
+      const procid_t numprocs = rmi.numprocs();
+      parallel_sort(local, keyof);
+
+      // regular samples of the sorted local data
+      std::vector<std::vector<std::pair<key_type, size_t> > >
+        samples(numprocs);
+      const size_t nsamples = std::min(local.size(), oversampling * numprocs);
+      for (size_t i = 0; i < nsamples; ++i) {
+        const size_t pos = (i + 1) * local.size() / (nsamples + 1);
+        samples[rmi.procid()].push_back(std::make_pair(keyof(local[pos]), pos));
+      }
+      rmi.all_gather(samples);
+      std::vector<splitter> all_samples;
+      for (procid_t p = 0; p < numprocs; ++p) {
+        for (size_t i = 0; i < samples[p].size(); ++i) {
+          splitter s;
+          s.key = samples[p][i].first; s.proc = p; s.pos = samples[p][i].second;
+          all_samples.push_back(s);
+        }
+      }
+      std::sort(all_samples.begin(), all_samples.end());
+
+      // cuts[p] .. cuts[p+1] is the slice of local owned by machine p
+      std::vector<size_t> cuts(numprocs + 1, 0);
+      cuts[numprocs] = local.size();
+      for (procid_t p = 1; p < numprocs; ++p) {
+        cuts[p] = all_samples.empty() ? local.size() :
+          cut_position(local, all_samples[all_samples.size() * p / numprocs]);
+        cuts[p] = std::max(cuts[p], cuts[p - 1]);
+      }
+
+      // every thread sends a contiguous chunk of the sorted data
+      const procid_t me = rmi.procid();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+        const size_t tid = sort_thread_id();
+#ifdef _OPENMP
+        const size_t nthreads = omp_get_num_threads();
+#else
+        const size_t nthreads = 1;
+#endif
+        const size_t begin = local.size() * tid / nthreads;
+        const size_t end = local.size() * (tid + 1) / nthreads;
+        procid_t target = std::upper_bound(cuts.begin(), cuts.end(), begin)
+                          - cuts.begin() - 1;
+        for (size_t i = begin; i < end; ++i) {
+          while (i >= cuts[target + 1]) ++target;
+          if (target != me) exchange.send(target, local[i], tid);
+        }
+      }
+      values.assign(local.begin() + cuts[me], local.begin() + cuts[me + 1]);
+      std::vector<T>().swap(local);
+      exchange.flush();
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+        std::vector<T> received;
+        procid_t recvid;
+        typename exchange_type::buffer_type buffer;
+        while(exchange.recv(recvid, buffer)) {
+          received.insert(received.end(), buffer.begin(), buffer.end());
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        values.insert(values.end(), received.begin(), received.end());
+      }
+      parallel_sort(values, keyof);
+      rmi.barrier();
     }
-    std::sort(key_values.begin(), key_values.end(), 
-        sample_sort_impl::pair_key_comparator<Key,Value>());
+  };
+}
 
-    rmi.barrier();
+/**
+ * \ingroup rpc
+ * Sorts key-value pairs distributed across all machines. After sort()
+ * returns, result() on machine i holds the i-th range of the global
+ * order, sorted by key.
+ *
+ * Local sorting, partitioning and sending run on all OpenMP threads,
+ * and integral keys are sorted with a radix sort. The oversampling
+ * parameter is the number of splitter samples each machine
+ * contributes per machine; higher values tighten the balance of the
+ * output ranges. Use sample_sort<Key, empty> to sort bare keys.
+ */
+template <typename Key, typename Value>
+class sample_sort
+  : public sample_sort_impl::sample_sort_base<
+      std::pair<Key, Value>, sample_sort_impl::pair_key<Key, Value> > {
+  typedef sample_sort_impl::sample_sort_base<
+    std::pair<Key, Value>, sample_sort_impl::pair_key<Key, Value> > base_type;
+ public:
+  sample_sort(distributed_control& dc, size_t oversampling = 16)
+    : base_type(dc, oversampling) { }
+
+  template <typename KeyIterator, typename ValueIterator>
+  void sort(KeyIterator kstart, KeyIterator kend,
+            ValueIterator vstart, ValueIterator vend) {
+    const ssize_t num_entries = std::distance(kstart, kend);
+    ASSERT_EQ(num_entries, std::distance(vstart, vend));
+    std::vector<std::pair<Key, Value> > local(num_entries);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (ssize_t i = 0; i < num_entries; ++i) {
+      local[i].first = *(kstart + i);
+      local[i].second = *(vstart + i);
+    }
+    base_type::distributed_sort(local);
   }
 
   std::vector<std::pair<Key, Value> >& result() {
-    return key_values;
+    return base_type::values;
+  }
+};
+
+
+/**
+ * \ingroup rpc
+ * Sorts bare keys distributed across all machines, without carrying
+ * a value vector.
+ */
+template <typename Key>
+class sample_sort<Key, empty>
+  : public sample_sort_impl::sample_sort_base<
+      Key, sample_sort_impl::identity_key<Key> > {
+  typedef sample_sort_impl::sample_sort_base<
+    Key, sample_sort_impl::identity_key<Key> > base_type;
+ public:
+  sample_sort(distributed_control& dc, size_t oversampling = 16)
+    : base_type(dc, oversampling) { }
+
+  template <typename KeyIterator>
+  void sort(KeyIterator kstart, KeyIterator kend) {
+    std::vector<Key> local(kstart, kend);
+    base_type::distributed_sort(local);
+  }
+
+  std::vector<Key>& result() {
+    return base_type::values;
   }
 };
 
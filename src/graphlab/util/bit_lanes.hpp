@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_BIT_LANES_HPP
+#define GRAPHLAB_BIT_LANES_HPP
+
+#include <stdint.h>
+#include <cstddef>
+#include <boost/static_assert.hpp>
+#include <graphlab/serialization/is_pod.hpp>
+#include <graphlab/util/counter_rng.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A fixed number of boolean lanes packed into NWords 64-bit words,
+   * used to run 64 * NWords independent copies of a stochastic
+   * vertex program at once. Lane i holds the state of simulation i,
+   * and every operator acts on all the lanes in a single pass over
+   * the words, which the compiler turns into vector instructions
+   * when NWords > 1.
+   *
+   * operator+= is a bitwise or so that bit_lanes can be used
+   * directly as a gather type:
+   *
+   * \code
+   * typedef graphlab::bit_lanes<4> lanes_type;    // 256 simulations
+   * lanes_type gather(icontext_type& context, const vertex_type& vertex,
+   *                   edge_type& edge) const {
+   *   graphlab::random::counter_rng rng(seed, vertex.id(),
+   *                                     edge.source().id(), step);
+   *   return edge.source().data().infected &
+   *          lanes_type::bernoulli(rng, transmit_prob);
+   * }
+   * \endcode
+   */
+  template <size_t NWords>
+  struct bit_lanes : public IS_POD_TYPE {
+    BOOST_STATIC_ASSERT(NWords > 0);
+    static const size_t NUM_WORDS = NWords;
+    static const size_t NUM_LANES = 64 * NWords;
+
+    uint64_t words[NWords];
+
+    /// All lanes cleared
+    bit_lanes() { clear(); }
+
+    /// All lanes set to value
+    explicit bit_lanes(bool value) { fill(value); }
+
+    inline void clear() {
+      for (size_t i = 0; i < NWords; ++i) words[i] = 0;
+    }
+
+    inline void fill(bool value) {
+      const uint64_t w = value ? ~uint64_t(0) : 0;
+      for (size_t i = 0; i < NWords; ++i) words[i] = w;
+    }
+
+    inline bool get(size_t lane) const {
+      ASSERT_LT(lane, NUM_LANES);
+      return (words[lane / 64] >> (lane % 64)) & 1;
+    }
+
+    inline void set(size_t lane, bool value = true) {
+      ASSERT_LT(lane, NUM_LANES);
+      const uint64_t bit = uint64_t(1) << (lane % 64);
+      if (value) words[lane / 64] |= bit;
+      else words[lane / 64] &= ~bit;
+    }
+
+    /// True if any lane is set
+    inline bool any() const {
+      uint64_t acc = 0;
+      for (size_t i = 0; i < NWords; ++i) acc |= words[i];
+      return acc != 0;
+    }
+
+    /// True if no lane is set
+    inline bool none() const { return !any(); }
+
+    /// The number of lanes which are set
+    inline size_t count() const {
+      size_t ret = 0;
+      for (size_t i = 0; i < NWords; ++i) ret += __builtin_popcountll(words[i]);
+      return ret;
+    }
+
+    inline bit_lanes& operator|=(const bit_lanes& other) {
+      for (size_t i = 0; i < NWords; ++i) words[i] |= other.words[i];
+      return *this;
+    }
+
+    inline bit_lanes& operator&=(const bit_lanes& other) {
+      for (size_t i = 0; i < NWords; ++i) words[i] &= other.words[i];
+      return *this;
+    }
+
+    inline bit_lanes& operator^=(const bit_lanes& other) {
+      for (size_t i = 0; i < NWords; ++i) words[i] ^= other.words[i];
+      return *this;
+    }
+
+    /// Gather combiner: a lane is set if it is set in either operand
+    inline bit_lanes& operator+=(const bit_lanes& other) {
+      return (*this) |= other;
+    }
+
+    /// Clears the lanes which are set in other
+    inline bit_lanes& andnot(const bit_lanes& other) {
+      for (size_t i = 0; i < NWords; ++i) words[i] &= ~other.words[i];
+      return *this;
+    }
+
+    inline bit_lanes operator~() const {
+      bit_lanes ret;
+      for (size_t i = 0; i < NWords; ++i) ret.words[i] = ~words[i];
+      return ret;
+    }
+
+    inline bool operator==(const bit_lanes& other) const {
+      for (size_t i = 0; i < NWords; ++i) {
+        if (words[i] != other.words[i]) return false;
+      }
+      return true;
+    }
+
+    inline bool operator!=(const bit_lanes& other) const {
+      return !((*this) == other);
+    }
+
+    /**
+     * Returns lanes drawn independently with probability p of being
+     * set, consuming the next values of rng.
+     */
+    static inline bit_lanes bernoulli(random::counter_rng& rng, double p) {
+      bit_lanes ret;
+      for (size_t i = 0; i < NWords; ++i) ret.words[i] = rng.bernoulli_bits(p);
+      return ret;
+    }
+  }; // end of bit_lanes
+
+  template <size_t NWords>
+  inline bit_lanes<NWords> operator|(bit_lanes<NWords> a,
+                                     const bit_lanes<NWords>& b) {
+    return a |= b;
+  }
+
+  template <size_t NWords>
+  inline bit_lanes<NWords> operator&(bit_lanes<NWords> a,
+                                     const bit_lanes<NWords>& b) {
+    return a &= b;
+  }
+
+  template <size_t NWords>
+  inline bit_lanes<NWords> operator^(bit_lanes<NWords> a,
+                                     const bit_lanes<NWords>& b) {
+    return a ^= b;
+  }
+
+} // end of namespace graphlab
+
+#endif
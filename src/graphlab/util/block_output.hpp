@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_UTIL_BLOCK_OUTPUT_HPP
+#define GRAPHLAB_UTIL_BLOCK_OUTPUT_HPP
+
+#include <string>
+#include <ostream>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+namespace graphlab {
+
+  /**
+   * Compresses the contents of in into a self contained gzip member
+   * which is appended to out.  A concatenation of gzip members is a
+   * valid gzip file, so blocks compressed independently by different
+   * threads can be written one after the other.
+   */
+  inline void gzip_block(const std::string& in, std::string& out) {
+    boost::iostreams::filtering_ostream fout;
+    fout.push(boost::iostreams::gzip_compressor());
+    fout.push(boost::iostreams::back_inserter(out));
+    fout.write(in.c_str(), in.length());
+    // flushes the compressor and writes the gzip footer
+    fout.reset();
+  } // end of gzip_block
+
+
+  /**
+   * \internal
+   * An output stream which is written to by many threads at once in
+   * blocks.  Each thread accumulates its output in a private buffer
+   * and passes it to write_block() when it becomes large.  If gzip is
+   * set, the block is compressed by the calling thread as an
+   * independent gzip member before it is appended to the stream, so
+   * the compression runs on all the writing threads in parallel and
+   * only the final write is serialized.
+   *
+   * The order of the blocks in the output is unspecified.
+   */
+  class block_output {
+  public:
+    /// Blocks are flushed when the buffer exceeds this size
+    static const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+
+    block_output(std::ostream& out, bool gzip) :
+      out(out), gzip(gzip), written(false), failed(false) { }
+
+    /**
+     * Writes the block to the stream. scratch is used to hold the
+     * compressed data and can be reused across calls to avoid
+     * reallocation.  The block is not modified.
+     */
+    void write_block(const std::string& block, std::string& scratch) {
+      if (block.empty()) return;
+      const std::string* data = &block;
+      if (gzip) {
+        scratch.clear();
+        gzip_block(block, scratch);
+        data = &scratch;
+      }
+      lock.lock();
+      out.write(data->c_str(), data->length());
+      if (out.fail()) failed = true;
+      written = true;
+      lock.unlock();
+    } // end of write_block
+
+    /**
+     * Writes the block if it is larger than BLOCK_SIZE, clearing it.
+     */
+    void write_if_full(std::string& block, std::string& scratch) {
+      if (block.length() >= BLOCK_SIZE) {
+        write_block(block, scratch);
+        block.clear();
+      }
+    }
+
+    /**
+     * Must be called once all blocks are written. If nothing was
+     * written to a compressed stream, writes an empty gzip member so
+     * that the output is still a valid gzip file.
+     */
+    void finish() {
+      if (gzip && !written) {
+        std::string empty_member;
+        gzip_block(std::string(), empty_member);
+        out.write(empty_member.c_str(), empty_member.length());
+        if (out.fail()) failed = true;
+      }
+      out.flush();
+      if (out.fail()) failed = true;
+    }
+
+    /// Returns true if any of the writes failed
+    bool fail() const { return failed; }
+
+  private:
+    std::ostream& out;
+    bool gzip;
+    bool written;
+    bool failed;
+    mutex lock;
+  }; // end of block_output
+
+} // namespace graphlab
+
+#endif
@@ -21,9 +21,29 @@
  */
 
 
-#ifndef BLOOM_FILTER_HPP
-#define BLOOM_FILTER_HPP
+#ifndef GRAPHLAB_UTIL_BLOOM_FILTER_HPP
+#define GRAPHLAB_UTIL_BLOOM_FILTER_HPP
+#include <stdint.h>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * \internal
+   * Generates the probe sequence for a key using double hashing.
+   * The two hashes are taken from the halves of a 64 bit mix of the
+   * key, so only one mix is computed per key.
+   */
+  inline uint64_t bloom_filter_mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+  }
 
 template <size_t len, size_t probes>
 class fixed_bloom_filter {
@@ -36,21 +56,101 @@ class fixed_bloom_filter {
     bits.clear();
   }
   
-  inline void insert(uint64_t i) {
+  inline void insert(uint64_t key) {
+    uint64_t h = bloom_filter_mix(key);
+    uint64_t step = (h >> 32) | 1;
     for (size_t i = 0;i < probes; ++i) {
-      bits.set_bit_unsync(i % len);
-      i = i * 0x9e3779b97f4a7c13LL;
+      bits.set_bit_unsync(h % len);
+      h += step;
     }
   }
   
-  inline bool may_contain(size_t i) {
+  inline bool may_contain(uint64_t key) const {
+    uint64_t h = bloom_filter_mix(key);
+    uint64_t step = (h >> 32) | 1;
     for (size_t i = 0;i < probes; ++i) {
-      if (bits.get_bit_unsync(i % len) == false) return false;
-      i = i * 0x9e3779b97f4a7c13LL;
+      if (bits.get(h % len) == false) return false;
+      h += step;
     }
     return true;
   }
 
 };
 
+
+  /**
+   * \brief A bloom filter whose size is chosen at runtime.
+   *
+   * Insertions are thread safe. Filters of the same size and number
+   * of probes can be combined with operator+= (a union), which makes
+   * the filter usable with distributed_control::all_reduce() to build
+   * the filter of a set of keys spread over all machines.
+   */
+  class bloom_filter {
+   private:
+    dense_bitset bits;
+    size_t probes;
+   public:
+    bloom_filter() : probes(1) { }
+
+    /**
+     * Constructs a filter with the given number of bits and probes
+     * per key. With m bits per expected key, the best number of
+     * probes is about 0.7m.
+     */
+    bloom_filter(size_t numbits, size_t probes) :
+        bits(numbits > 0 ? numbits : 1), probes(probes > 0 ? probes : 1) {
+      bits.clear();
+    }
+
+    /**
+     * Returns a filter sized for the expected number of keys with
+     * roughly a 2% false positive rate.
+     */
+    static bloom_filter for_keys(size_t num_keys) {
+      return bloom_filter(8 * num_keys + 64, 5);
+    }
+
+    inline void clear() { bits.clear(); }
+
+    /// Returns the number of bits in the filter
+    inline size_t size() const { return bits.size(); }
+
+    inline void insert(uint64_t key) {
+      uint64_t h = bloom_filter_mix(key);
+      uint64_t step = (h >> 32) | 1;
+      for (size_t i = 0;i < probes; ++i) {
+        bits.set_bit(h % bits.size());
+        h += step;
+      }
+    }
+
+    inline bool may_contain(uint64_t key) const {
+      uint64_t h = bloom_filter_mix(key);
+      uint64_t step = (h >> 32) | 1;
+      for (size_t i = 0;i < probes; ++i) {
+        if (bits.get(h % bits.size()) == false) return false;
+        h += step;
+      }
+      return true;
+    }
+
+    /// Unions the keys of other into this filter
+    bloom_filter& operator+=(const bloom_filter& other) {
+      ASSERT_EQ(probes, other.probes);
+      bits |= other.bits;
+      return *this;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << probes << bits;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> probes >> bits;
+    }
+  };
+
+} // namespace graphlab
+
 #endif
@@ -0,0 +1,408 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_COUNTER_RNG_HPP
+#define GRAPHLAB_COUNTER_RNG_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+  namespace random {
+
+    /**
+     * \ingroup random
+     * The Philox4x32-10 block function of Salmon et al., "Parallel
+     * Random Numbers: As Easy as 1, 2, 3" (SC 2011).  It maps a 128
+     * bit counter and a 64 bit key to 128 pseudo-random bits with no
+     * internal state, so any element of a stream can be computed
+     * directly from its position.
+     */
+    struct philox4x32 {
+      static const uint32_t M0 = 0xD2511F53u;
+      static const uint32_t M1 = 0xCD9E8D57u;
+      static const uint32_t W0 = 0x9E3779B9u;
+      static const uint32_t W1 = 0xBB67AE85u;
+      static const size_t ROUNDS = 10;
+
+      /// Computes out = philox(ctr, key).  out may alias ctr.
+      static inline void block(const uint32_t ctr[4], const uint32_t key[2],
+                               uint32_t out[4]) {
+        uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (size_t r = 0; r < ROUNDS; ++r) {
+          const uint64_t p0 = uint64_t(M0) * c0;
+          const uint64_t p1 = uint64_t(M1) * c2;
+          const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+          const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+          c1 = uint32_t(p1); c3 = uint32_t(p0);
+          c0 = n0; c2 = n2;
+          k0 += W0; k1 += W1;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+      }
+    }; // end of philox4x32
+
+
+    /**
+     * \ingroup random
+     * A reproducible random stream keyed by (seed, vertex id,
+     * iteration).
+     *
+     * Unlike the thread local generators in random.hpp the stream
+     * holds no shared state and takes no locks: it is a key and a
+     * block counter.  Two streams constructed with the same key
+     * produce the same sequence no matter which thread or fiber runs
+     * them, which makes samplers reproducible under any scheduling.
+     * A vertex program typically builds one on the stack per
+     * invocation:
+     *
+     * \code
+     * graphlab::random::counter_rng rng(seed, vertex.id(), iteration);
+     * const size_t asg = rng.multinomial(prob);
+     * \endcode
+     *
+     * Gathers and scatters that need one stream per edge pass the
+     * full id of the other endpoint as well:
+     *
+     * \code
+     * graphlab::random::counter_rng rng(seed, vertex.id(), other.id(),
+     *                                   iteration);
+     * \endcode
+     *
+     * Streams with distinct keys are statistically independent.  Each
+     * stream may produce up to 2^34 32-bit values.
+     */
+    class counter_rng {
+    public:
+      counter_rng(uint64_t seed = 0, uint64_t vid = 0, uint64_t iteration = 0) {
+        reset(seed, vid, iteration);
+      }
+
+      /// A stream keyed by (seed, vertex id, other id, iteration).
+      counter_rng(uint64_t seed, uint64_t vid, uint64_t other,
+                  uint64_t iteration) {
+        reset(seed, vid, other, iteration);
+      }
+
+      /// Rewinds the stream and rekeys it.
+      inline void reset(uint64_t seed, uint64_t vid, uint64_t iteration) {
+        key[0] = uint32_t(seed);
+        key[1] = uint32_t(seed >> 32);
+        ctr[0] = 0;
+        ctr[1] = uint32_t(iteration);
+        ctr[2] = uint32_t(vid);
+        ctr[3] = uint32_t(vid >> 32) ^ uint32_t(iteration >> 32);
+        pos = 4;
+      }
+
+      /**
+       * Rewinds the stream and rekeys it with a second vertex id.
+       * The other id is hashed into the Philox key so both ids keep
+       * all their 64 bits.
+       */
+      inline void reset(uint64_t seed, uint64_t vid, uint64_t other,
+                        uint64_t iteration) {
+        reset(mix64(seed ^ mix64(other + 1)), vid, iteration);
+      }
+
+      /// Returns the next 32 random bits.
+      inline uint32_t next_u32() {
+        if (pos == 4) refill();
+        return buf[pos++];
+      }
+
+      /// Returns the next 64 random bits.
+      inline uint64_t next_u64() {
+        const uint64_t hi = next_u32();
+        return (hi << 32) | next_u32();
+      }
+
+      /// Returns a double uniformly distributed in [0, 1).
+      inline double rand01() {
+        return double(next_u64() >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+      /**
+       * Generate a random number in the uniform real with range [min,
+       * max) or [min, max] if the number type is discrete.
+       */
+      template<typename NumType>
+      inline NumType uniform(const NumType min, const NumType max) {
+        return uniform_impl(min, max,
+                            typename is_real<NumType>::type());
+      } // end of uniform
+
+      /**
+       * Fills out[0..n) with uniform doubles in [0, 1).  Whole blocks
+       * are generated four at a time into independent lanes so the
+       * compiler can vectorize the rounds; the result is identical
+       * to n calls to rand01().
+       */
+      void fill_uniform(double* out, size_t n) {
+        size_t i = 0;
+        // drain the buffered half-used block first
+        for (; i < n && pos < 4; ++i) out[i] = rand01();
+        uint32_t raw[LANES * 4];
+        for (; i + LANES * 2 <= n; i += LANES * 2) {
+          batch(raw);
+          for (size_t j = 0; j < LANES * 2; ++j) {
+            const uint64_t v = (uint64_t(raw[2*j]) << 32) | raw[2*j + 1];
+            out[i + j] = double(v >> 11) * (1.0 / 9007199254740992.0);
+          }
+        }
+        for (; i < n; ++i) out[i] = rand01();
+      }
+
+      /// Fills out[0..n) with uniform floats in [0, 1).
+      void fill_uniform(float* out, size_t n) {
+        size_t i = 0;
+        for (; i < n && pos < 4; ++i) out[i] = next_float();
+        uint32_t raw[LANES * 4];
+        for (; i + LANES * 4 <= n; i += LANES * 4) {
+          batch(raw);
+          for (size_t j = 0; j < LANES * 4; ++j) {
+            out[i + j] = float(raw[j] >> 8) * (1.0f / 16777216.0f);
+          }
+        }
+        for (; i < n; ++i) out[i] = next_float();
+      }
+
+      /**
+       * Generate a gaussian random variable with the given mean and
+       * standard deviation.
+       */
+      inline double gaussian(const double mean = double(0),
+                             const double stdev = double(1)) {
+        // Box-Muller; 1 - rand01() lies in (0, 1] so the log is finite
+        const double u1 = 1.0 - rand01();
+        const double u2 = rand01();
+        return mean + stdev * std::sqrt(-2.0 * std::log(u1)) *
+          std::cos(6.283185307179586476925286766559 * u2);
+      } // end of gaussian
+
+      /// Draw from a gamma distribution with shape alpha and unit scale.
+      inline double gamma(const double alpha = double(1)) {
+        ASSERT_GT(alpha, 0);
+        if (alpha < 1) {
+          // boost the shape and correct with a power of a uniform
+          const double u = 1.0 - rand01();
+          return gamma(alpha + 1) * std::pow(u, 1.0 / alpha);
+        }
+        // Marsaglia and Tsang
+        const double d = alpha - 1.0 / 3.0;
+        const double c = 1.0 / std::sqrt(9.0 * d);
+        while (true) {
+          double x, v;
+          do {
+            x = gaussian();
+            v = 1.0 + c * x;
+          } while (v <= 0);
+          v = v * v * v;
+          const double u = 1.0 - rand01();
+          if (std::log(u) < 0.5 * x * x + d - d * v + d * std::log(v)) {
+            return d * v;
+          }
+        }
+      } // end of gamma
+
+      inline bool bernoulli(const double p = double(0.5)) {
+        return rand01() < p;
+      } // end of bernoulli
+
+      /**
+       * Returns 64 independent bernoulli draws, one per bit.  p is
+       * rounded to a multiple of 2^-32.  The draws are built from the
+       * binary expansion of p, least significant bit first, at a cost
+       * of one random word per bit of p rather than one per draw.
+       */
+      inline uint64_t bernoulli_bits(const double p) {
+        if (!(p > 0)) return 0;
+        if (p >= 1) return ~uint64_t(0);
+        const uint64_t q = uint64_t(p * 4294967296.0 + 0.5);
+        if (q == 0) return 0;
+        if (q >> 32) return ~uint64_t(0);
+        // P(bit) goes from x to (x + b) / 2 per step, so after
+        // consuming all of q it equals q / 2^32.  Trailing zeros of q
+        // would only halve a probability of zero and are skipped.
+        size_t i = 0;
+        while (((q >> i) & 1) == 0) ++i;
+        uint64_t mask = 0;
+        for (; i < 32; ++i) {
+          const uint64_t r = next_u64();
+          mask = ((q >> i) & 1) ? (r | mask) : (r & mask);
+        }
+        return mask;
+      } // end of bernoulli_bits
+
+      /**
+       * Draw a random number from an unnormalized multinomial.
+       */
+      template<typename Double>
+      size_t multinomial(const std::vector<Double>& prb) {
+        ASSERT_GT(prb.size(), 0);
+        if (prb.size() == 1) { return 0; }
+        Double sum(0);
+        for(size_t i = 0; i < prb.size(); ++i) {
+          ASSERT_GE(prb[i], 0); // Each entry must be P[i] >= 0
+          sum += prb[i];
+        }
+        ASSERT_GT(sum, 0); // Normalizer must be positive
+        // scale the draw instead of normalizing every entry
+        const Double rnd(Double(rand01()) * sum);
+        size_t ind = 0;
+        for(Double cumsum(prb[ind]);
+            rnd >= cumsum && (ind+1) < prb.size();
+            cumsum += prb[++ind]);
+        return ind;
+      } // end of multinomial
+
+      /**
+       * Generate a draw from a multinomial using a CDF.
+       */
+      template<typename Double>
+      inline size_t multinomial_cdf(const std::vector<Double>& cdf) {
+        return std::upper_bound(cdf.begin(), cdf.end(),
+                                Double(rand01())) - cdf.begin();
+      } // end of multinomial_cdf
+
+      /**
+       * Shuffle a range using the begin and end iterators
+       */
+      template<typename Iterator>
+      void shuffle(Iterator begin, Iterator end) {
+        const ptrdiff_t n = end - begin;
+        for (ptrdiff_t i = n - 1; i > 0; --i) {
+          std::iter_swap(begin + i, begin + bounded(uint64_t(i)));
+        }
+      } // end of shuffle
+
+      template<typename T>
+      void shuffle(std::vector<T>& vec) { shuffle(vec.begin(), vec.end()); }
+
+    private:
+      /// number of blocks computed together by batch()
+      static const size_t LANES = 4;
+
+      struct real_tag { };
+      struct int_tag { };
+      template<typename T> struct is_real { typedef int_tag type; };
+
+      uint32_t key[2];
+      uint32_t ctr[4];
+      uint32_t buf[4];
+      size_t pos;
+
+      inline void refill() {
+        philox4x32::block(ctr, key, buf);
+        ++ctr[0];
+        pos = 0;
+      }
+
+      inline float next_float() {
+        return float(next_u32() >> 8) * (1.0f / 16777216.0f);
+      }
+
+      /// Generates the next LANES blocks into raw, lane-major.
+      inline void batch(uint32_t raw[LANES * 4]) {
+        uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+        for (size_t l = 0; l < LANES; ++l) {
+          c0[l] = ctr[0] + uint32_t(l);
+          c1[l] = ctr[1]; c2[l] = ctr[2]; c3[l] = ctr[3];
+        }
+        uint32_t k0 = key[0], k1 = key[1];
+        for (size_t r = 0; r < philox4x32::ROUNDS; ++r) {
+          for (size_t l = 0; l < LANES; ++l) {
+            const uint64_t p0 = uint64_t(philox4x32::M0) * c0[l];
+            const uint64_t p1 = uint64_t(philox4x32::M1) * c2[l];
+            const uint32_t n0 = uint32_t(p1 >> 32) ^ c1[l] ^ k0;
+            const uint32_t n2 = uint32_t(p0 >> 32) ^ c3[l] ^ k1;
+            c1[l] = uint32_t(p1); c3[l] = uint32_t(p0);
+            c0[l] = n0; c2[l] = n2;
+          }
+          k0 += philox4x32::W0; k1 += philox4x32::W1;
+        }
+        for (size_t l = 0; l < LANES; ++l) {
+          raw[4*l] = c0[l]; raw[4*l + 1] = c1[l];
+          raw[4*l + 2] = c2[l]; raw[4*l + 3] = c3[l];
+        }
+        ctr[0] += uint32_t(LANES);
+      }
+
+      /// The splitmix64 finalizer.
+      static inline uint64_t mix64(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+      }
+
+      /// Unbiased integer in [0, range] by rejection.
+      inline uint64_t bounded(uint64_t range) {
+        if (range == std::numeric_limits<uint64_t>::max()) return next_u64();
+        const uint64_t span = range + 1;
+        if (span <= std::numeric_limits<uint32_t>::max()) {
+          const uint32_t s = uint32_t(span);
+          const uint32_t limit = uint32_t(-s) % s;
+          while (true) {
+            const uint64_t m = uint64_t(next_u32()) * s;
+            if (uint32_t(m) >= limit) return m >> 32;
+          }
+        }
+        const uint64_t limit = std::numeric_limits<uint64_t>::max() -
+          (std::numeric_limits<uint64_t>::max() % span);
+        while (true) {
+          const uint64_t v = next_u64();
+          if (v < limit) return v % span;
+        }
+      }
+
+      template<typename NumType>
+      inline NumType uniform_impl(NumType min, NumType max, int_tag) {
+        ASSERT_LE(min, max);
+        return NumType(min + NumType(bounded(uint64_t(max) - uint64_t(min))));
+      }
+
+      template<typename NumType>
+      inline NumType uniform_impl(NumType min, NumType max, real_tag) {
+        return min + (max - min) * NumType(rand01());
+      }
+    }; // end of class counter_rng
+
+    template<> struct counter_rng::is_real<float> { typedef real_tag type; };
+    template<> struct counter_rng::is_real<double> { typedef real_tag type; };
+    template<> struct counter_rng::is_real<long double> {
+      typedef real_tag type;
+    };
+
+  }; // end of random
+}; // end of graphlab
+
+
+#endif
@@ -24,6 +24,7 @@
 
 #include <iostream>
 #include <vector>
+#include <iterator>
 #include <algorithm>
 
 #include <graphlab/util/generics/counting_sort.hpp>
@@ -199,6 +200,30 @@ namespace graphlab {
        values.clear();
      }
 
+     /**
+      * Replaces the content with a packed deep copy of other. The
+      * storage holds raw block pointers, so copies must go through
+      * here rather than the copy constructor.
+      */
+     void copy_from(const dynamic_csr_storage& other) {
+       clear();
+       std::vector<sizetype> valueptr_vec(other.num_keys(), 0);
+       for (size_t i = 1; i < other.num_keys(); ++i) {
+         valueptr_vec[i] = valueptr_vec[i - 1] +
+           other.begin(i - 1).pdistance_to(other.end(i - 1));
+       }
+       std::vector<valuetype> all_values;
+       all_values.reserve(other.num_values());
+       std::copy(other.values.begin(), other.values.end(),
+                 std::back_inserter(all_values));
+       if (all_values.empty()) {
+         value_ptrs.assign(valueptr_vec.size(), values.end());
+       } else {
+         values.assign(all_values.begin(), all_values.end());
+         sizevec2ptrvec(valueptr_vec, value_ptrs);
+       }
+     }
+
      void load(iarchive& iarc) { 
        clear();
        std::vector<sizetype> valueptr_vec;
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_LABEL_HISTOGRAM_HPP
+#define GRAPHLAB_LABEL_HISTOGRAM_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <boost/static_assert.hpp>
+#include <graphlab/util/integer_mix.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A histogram over 32-bit labels, intended as the gather type of
+   * label propagation style vertex programs.
+   *
+   * The counts live in an open-addressed table with linear probing.
+   * The first InlineSlots slots are stored inside the object, so a
+   * histogram built from one edge or merged from a handful of
+   * neighbors never touches the heap. The table moves to the heap
+   * once it is three quarters full. Only the occupied entries are
+   * serialized.
+   *
+   * \code
+   * typedef graphlab::label_histogram<uint32_t> gather_type;
+   * gather_type gather(icontext_type& context, const vertex_type& vertex,
+   *                    edge_type& edge) const {
+   *   return gather_type(get_other_vertex(edge, vertex).data().label, 1);
+   * }
+   * \endcode
+   */
+  template <typename CountType = uint32_t, size_t InlineSlots = 8>
+  class label_histogram {
+  public:
+    typedef uint32_t label_type;
+    typedef CountType count_type;
+
+    /// Marks an empty slot. Cannot be counted.
+    static const label_type NO_LABEL = label_type(-1);
+
+    struct entry {
+      label_type label;
+      count_type count;
+    };
+
+  private:
+    BOOST_STATIC_ASSERT(InlineSlots > 0 &&
+                        (InlineSlots & (InlineSlots - 1)) == 0);
+
+    entry inline_table[InlineSlots];
+    /// Empty until the inline table overflows, a power of two after
+    std::vector<entry> heap_table;
+    size_t nentries;
+
+    inline entry* table() {
+      return heap_table.empty() ? inline_table : &heap_table[0];
+    }
+
+    inline const entry* table() const {
+      return heap_table.empty() ? inline_table : &heap_table[0];
+    }
+
+    static void clear_slots(entry* slots, size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        slots[i].label = NO_LABEL;
+        slots[i].count = count_type(0);
+      }
+    }
+
+    /// The index of the slot holding label, or of the empty slot
+    /// where it belongs
+    static inline size_t probe(const entry* slots, size_t mask,
+                               label_type label) {
+      size_t i = integer_mix(label) & mask;
+      while (slots[i].label != label && slots[i].label != NO_LABEL) {
+        i = (i + 1) & mask;
+      }
+      return i;
+    }
+
+    /// The entry of label, or NULL if absent
+    inline const entry* find(label_type label) const {
+      if (label == NO_LABEL) return NULL;
+      const entry* slots = table();
+      const entry& e = slots[probe(slots, num_slots() - 1, label)];
+      return e.label == NO_LABEL ? NULL : &e;
+    }
+
+    void grow() {
+      std::vector<entry> bigger(num_slots() * 2);
+      clear_slots(&bigger[0], bigger.size());
+      const entry* old = table();
+      const size_t nold = num_slots();
+      for (size_t i = 0; i < nold; ++i) {
+        if (old[i].label != NO_LABEL) {
+          bigger[probe(&bigger[0], bigger.size() - 1, old[i].label)] = old[i];
+        }
+      }
+      heap_table.swap(bigger);
+    }
+
+  public:
+    label_histogram() : nentries(0) {
+      clear_slots(inline_table, InlineSlots);
+    }
+
+    /// A histogram holding a single label
+    label_histogram(label_type label, count_type count) : nentries(0) {
+      clear_slots(inline_table, InlineSlots);
+      add(label, count);
+    }
+
+    /// Removes all labels and releases the heap table
+    void clear() {
+      std::vector<entry>().swap(heap_table);
+      clear_slots(inline_table, InlineSlots);
+      nentries = 0;
+    }
+
+    /// The number of distinct labels
+    inline size_t size() const { return nentries; }
+
+    inline bool empty() const { return nentries == 0; }
+
+    /// True once the table has outgrown the inline slots
+    inline bool on_heap() const { return !heap_table.empty(); }
+
+    /**
+     * The number of slots. Together with slot() this iterates over
+     * the table; unoccupied slots have label NO_LABEL.
+     */
+    inline size_t num_slots() const {
+      return heap_table.empty() ? InlineSlots : heap_table.size();
+    }
+
+    inline const entry& slot(size_t i) const { return table()[i]; }
+
+    /// Adds count to the count of label
+    inline void add(label_type label, count_type count) {
+      ASSERT_NE(label, NO_LABEL);
+      if (4 * (nentries + 1) > 3 * num_slots()) grow();
+      entry& e = table()[probe(table(), num_slots() - 1, label)];
+      if (e.label == NO_LABEL) {
+        e.label = label;
+        ++nentries;
+      }
+      e.count += count;
+    }
+
+    /// The count of label, zero if absent
+    inline count_type get(label_type label) const {
+      const entry* e = find(label);
+      return e == NULL ? count_type(0) : e->count;
+    }
+
+    /// True if label has been added
+    inline bool contains(label_type label) const { return find(label) != NULL; }
+
+    label_histogram& operator+=(const label_histogram& other) {
+      const entry* slots = other.table();
+      const size_t n = other.num_slots();
+      for (size_t i = 0; i < n; ++i) {
+        if (slots[i].label != NO_LABEL) add(slots[i].label, slots[i].count);
+      }
+      return *this;
+    }
+
+    /**
+     * Finds the label with the largest count. Ties go to prefer if it
+     * is among them, and to the smallest label otherwise, so that the
+     * result does not depend on the order of the merges. Returns false
+     * if the histogram is empty.
+     */
+    bool most_frequent(label_type& label, count_type& count,
+                       label_type prefer = NO_LABEL) const {
+      if (nentries == 0) return false;
+      const entry* slots = table();
+      const size_t n = num_slots();
+      label = NO_LABEL;
+      count = count_type(0);
+      for (size_t i = 0; i < n; ++i) {
+        if (slots[i].label == NO_LABEL) continue;
+        if (label == NO_LABEL || count < slots[i].count ||
+            (!(slots[i].count < count) && slots[i].label < label)) {
+          label = slots[i].label;
+          count = slots[i].count;
+        }
+      }
+      const entry* preferred = find(prefer);
+      if (preferred != NULL && !(preferred->count < count)) label = prefer;
+      return true;
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << nentries;
+      const entry* slots = table();
+      const size_t n = num_slots();
+      for (size_t i = 0; i < n; ++i) {
+        if (slots[i].label != NO_LABEL) {
+          oarc << slots[i].label << slots[i].count;
+        }
+      }
+    }
+
+    void load(iarchive& iarc) {
+      clear();
+      size_t n = 0;
+      iarc >> n;
+      for (size_t i = 0; i < n; ++i) {
+        label_type label;
+        count_type count;
+        iarc >> label >> count;
+        add(label, count);
+      }
+    }
+  }; // end of label_histogram
+
+  template <typename CountType, size_t InlineSlots>
+  const typename label_histogram<CountType, InlineSlots>::label_type
+  label_histogram<CountType, InlineSlots>::NO_LABEL;
+
+} // end of namespace graphlab
+
+#endif
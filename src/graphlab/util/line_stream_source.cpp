@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/util/line_stream_source.hpp>
+
+namespace graphlab {
+
+  namespace {
+    /// Splits "host:port", returning false if there is no port
+    bool split_host_port(const std::string& address,
+                         std::string& host, std::string& port) {
+      const size_t colon = address.rfind(':');
+      if (colon == std::string::npos || colon + 1 == address.length()) {
+        return false;
+      }
+      host = address.substr(0, colon);
+      port = address.substr(colon + 1);
+      if (host.empty()) host = "127.0.0.1";
+      return true;
+    }
+
+    int connect_tcp(const std::string& address) {
+      std::string host, port;
+      if (!split_host_port(address, host, port)) {
+        logstream(LOG_ERROR) << "Expected host:port, got \""
+                             << address << "\"" << std::endl;
+        return -1;
+      }
+      struct addrinfo hints;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      struct addrinfo* addrs = NULL;
+      const int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs);
+      if (err != 0) {
+        logstream(LOG_ERROR) << "Unable to resolve " << address << ": "
+                             << gai_strerror(err) << std::endl;
+        return -1;
+      }
+      int sock = -1;
+      for (struct addrinfo* a = addrs; a != NULL; a = a->ai_next) {
+        sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (sock < 0) continue;
+        if (connect(sock, a->ai_addr, a->ai_addrlen) == 0) break;
+        ::close(sock);
+        sock = -1;
+      }
+      freeaddrinfo(addrs);
+      if (sock < 0) {
+        logstream(LOG_ERROR) << "Unable to connect to " << address << ": "
+                             << strerror(errno) << std::endl;
+      }
+      return sock;
+    }
+
+    int accept_tcp(const std::string& port) {
+      const int listener = socket(AF_INET, SOCK_STREAM, 0);
+      if (listener < 0) {
+        logstream(LOG_ERROR) << "Unable to create a socket: "
+                             << strerror(errno) << std::endl;
+        return -1;
+      }
+      int one = 1;
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons((uint16_t)atoi(port.c_str()));
+      if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+          listen(listener, 1) != 0) {
+        logstream(LOG_ERROR) << "Unable to listen on port " << port << ": "
+                             << strerror(errno) << std::endl;
+        ::close(listener);
+        return -1;
+      }
+      logstream(LOG_INFO) << "Waiting for a producer on port "
+                          << port << std::endl;
+      int sock;
+      do {
+        sock = accept(listener, NULL, NULL);
+      } while (sock < 0 && errno == EINTR);
+      if (sock < 0) {
+        logstream(LOG_ERROR) << "Unable to accept a producer: "
+                             << strerror(errno) << std::endl;
+      }
+      ::close(listener);
+      return sock;
+    }
+  } // end of anonymous namespace
+
+
+  bool line_stream_source::open(const std::string& spec) {
+    close();
+    int newfd = -1;
+    if (spec.substr(0, 6) == "tcp://") {
+      newfd = connect_tcp(spec.substr(6));
+    } else if (spec.substr(0, 9) == "listen://") {
+      newfd = accept_tcp(spec.substr(9));
+    } else if (spec == "-") {
+      attach(STDIN_FILENO, false);
+      return true;
+    } else {
+      // opening a named pipe blocks until the producer opens it as well
+      do {
+        newfd = ::open(spec.c_str(), O_RDONLY);
+      } while (newfd < 0 && errno == EINTR);
+      if (newfd < 0) {
+        logstream(LOG_ERROR) << "Unable to open " << spec << ": "
+                             << strerror(errno) << std::endl;
+      }
+    }
+    if (newfd < 0) return false;
+    attach(newfd, true);
+    return true;
+  } // end of open
+
+
+  void line_stream_source::attach(int newfd, bool take_ownership) {
+    close();
+    fd = newfd;
+    owns_fd = take_ownership;
+    at_eof = false;
+    buffer.clear();
+    head = 0;
+  } // end of attach
+
+
+  void line_stream_source::close() {
+    if (fd >= 0 && owns_fd) ::close(fd);
+    fd = -1;
+    owns_fd = false;
+  } // end of close
+
+
+  bool line_stream_source::take_line(std::string& line) {
+    const size_t eol = buffer.find('\n', head);
+    if (eol == std::string::npos) {
+      if (!at_eof || head == buffer.size()) return false;
+      // the last line of the stream has no newline
+      line.assign(buffer, head, std::string::npos);
+      head = buffer.size();
+    } else {
+      line.assign(buffer, head, eol - head);
+      head = eol + 1;
+    }
+    if (!line.empty() && line[line.length() - 1] == '\r') {
+      line.resize(line.length() - 1);
+    }
+    // drop the consumed prefix once it dominates the buffer
+    if (head == buffer.size()) {
+      buffer.clear();
+      head = 0;
+    } else if (head > 4096 && head * 2 > buffer.size()) {
+      buffer.erase(0, head);
+      head = 0;
+    }
+    ++nlines;
+    return true;
+  } // end of take_line
+
+
+  bool line_stream_source::fill(double timeout) {
+    if (fd < 0) {
+      at_eof = true;
+      return false;
+    }
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    const int timeout_ms = timeout < 0 ? -1 : int(timeout * 1000 + 0.5);
+    const int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+      if (errno == EINTR) return true;
+      logstream(LOG_ERROR) << "Error waiting on the stream: "
+                           << strerror(errno) << std::endl;
+      at_eof = true;
+      return false;
+    }
+    if (ready == 0) return false;
+    char chunk[65536];
+    const ssize_t len = ::read(fd, chunk, sizeof(chunk));
+    if (len < 0) {
+      if (errno == EINTR || errno == EAGAIN) return true;
+      logstream(LOG_ERROR) << "Error reading the stream: "
+                           << strerror(errno) << std::endl;
+      at_eof = true;
+      return false;
+    }
+    if (len == 0) {
+      at_eof = true;
+      return false;
+    }
+    buffer.append(chunk, len);
+    nbytes += len;
+    return true;
+  } // end of fill
+
+
+  bool line_stream_source::read_line(std::string& line, double timeout) {
+    timer ti;
+    ti.start();
+    while (true) {
+      if (take_line(line)) return true;
+      if (at_eof) return false;
+      double remaining = -1;
+      if (timeout >= 0) {
+        remaining = timeout - ti.current_time();
+        if (remaining < 0) remaining = 0;
+      }
+      if (!fill(remaining)) {
+        // a timeout, or the end of the stream which may leave a
+        // final unterminated line in the buffer
+        if (at_eof) continue;
+        return false;
+      }
+    }
+  } // end of read_line
+
+} // end of namespace graphlab
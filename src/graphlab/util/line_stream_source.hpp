@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_LINE_STREAM_SOURCE_HPP
+#define GRAPHLAB_LINE_STREAM_SOURCE_HPP
+
+#include <string>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * \brief Reads newline delimited records from a local pipe or a TCP
+   * socket, with a timeout on every read.
+   *
+   * The source is opened from a specification string:
+   * \li <code>tcp://host:port</code> connects to a producer listening
+   *     on the given port.
+   * \li <code>listen://port</code> listens on the given port and
+   *     accepts a single producer connection.
+   * \li <code>-</code> reads from the standard input.
+   * \li anything else is a path which is opened for reading. This is
+   *     typically a named pipe created with mkfifo.
+   *
+   * Alternatively an already open file descriptor, such as one end of
+   * a pipe(), may be attached.
+   *
+   * Unlike an std::istream, read_line() returns once the timeout
+   * expires even if the producer is idle, so that a consumer is able
+   * to close a micro-batch on time. Trailing carriage returns are
+   * dropped, and a final line with no terminating newline is returned
+   * before the end of the stream is reported.
+   */
+  class line_stream_source {
+  public:
+    line_stream_source() : fd(-1), owns_fd(false), at_eof(false),
+                           nbytes(0), nlines(0), head(0) { }
+
+    ~line_stream_source() { close(); }
+
+    /**
+     * Opens the source described by the specification string. Returns
+     * false, after logging the reason, if the source could not be
+     * opened.
+     */
+    bool open(const std::string& spec);
+
+    /**
+     * Reads from an already open file descriptor. If take_ownership is
+     * set, the descriptor is closed with the source.
+     */
+    void attach(int fd, bool take_ownership = false);
+
+    /// Closes the source. Safe to call more than once.
+    void close();
+
+    /// Returns true if the source is open.
+    bool is_open() const { return fd >= 0; }
+
+    /**
+     * Reads the next line into line, waiting at most timeout seconds
+     * for it to arrive. A negative timeout waits forever. Returns
+     * false if no complete line arrived in time, or if the stream has
+     * ended; eof() distinguishes the two.
+     */
+    bool read_line(std::string& line, double timeout = -1);
+
+    /**
+     * Returns true once the producer has closed the stream and every
+     * buffered line has been returned.
+     */
+    bool eof() const { return at_eof && head == buffer.size(); }
+
+    /// The number of bytes received so far.
+    size_t bytes_read() const { return nbytes; }
+
+    /// The number of lines returned so far.
+    size_t lines_read() const { return nlines; }
+
+  private:
+    int fd;
+    bool owns_fd;
+    bool at_eof;
+    size_t nbytes;
+    size_t nlines;
+    /// Received bytes. Those before head have been returned already.
+    std::string buffer;
+    size_t head;
+
+    /// Moves the first buffered line into line, if there is one
+    bool take_line(std::string& line);
+
+    /**
+     * Waits at most timeout seconds for data and appends it to the
+     * buffer. Returns false on a timeout or at the end of the stream.
+     */
+    bool fill(double timeout);
+
+    line_stream_source(const line_stream_source&);
+    line_stream_source& operator=(const line_stream_source&);
+  }; // end of line_stream_source
+
+} // end of namespace graphlab
+
+#endif
@@ -23,10 +23,17 @@
 
 #ifndef LOCK_FREE_POOL_HPP
 #define LOCK_FREE_POOL_HPP
+#include <pthread.h>
 #include <stdint.h>
+#include <cstdlib>
+#include <new>
 #include <vector>
+#include <algorithm>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/epoch_reclaimer.hpp>
 #include <graphlab/util/lock_free_internal.hpp>
 #include <graphlab/util/branch_hints.hpp>
 
@@ -115,5 +122,201 @@ namespace graphlab {
     }
   }; // end of lock free pool
 
+
+  /**
+   * \ingroup util
+   * An unbounded pool of objects of type T with per thread caches.
+   *
+   * Unlike lock_free_pool the pool never falls back to the global
+   * allocator for T: when it runs dry it allocates a further chunk of
+   * slots, each chunk twice the size of the last, and keeps them until
+   * the pool is destroyed. Every thread allocates from and frees into
+   * a private cache of up to 2 * CACHE_SIZE slots. Caches exchange
+   * batches of CACHE_SIZE slots with a shared lock-free stack, so an
+   * object may be freed by a different thread from the one that
+   * allocated it. The nodes of the shared stack are reclaimed through
+   * the epoch_reclaimer, which also makes the stack immune to ABA.
+   *
+   * alloc_raw() / free_raw() hand out uninitialized memory and are
+   * suitable for a class specific operator new and delete. construct()
+   * and destroy() also run the constructor and destructor.
+   */
+  template <typename T, size_t CACHE_SIZE = 64>
+  class lock_free_object_pool {
+  private:
+    union slot {
+      slot* next;
+      char storage[sizeof(T)];
+      // force the alignment of the most demanding fundamental types
+      long double align_ld;
+      void* align_ptr;
+      uint64_t align_int;
+    };
+
+    /// a run of at most CACHE_SIZE free slots on the shared stack
+    struct batch {
+      batch* next;
+      size_t count;
+      slot* slots[CACHE_SIZE];
+    };
+
+    struct thread_cache {
+      lock_free_object_pool* pool;
+      size_t count;
+      slot* slots[2 * CACHE_SIZE];
+    };
+
+    batch* volatile free_batches;
+
+    mutex grow_lock;
+    std::vector<slot*> chunks;
+    size_t next_chunk_size;
+    atomic<size_t> num_slots;
+
+    pthread_key_t cache_key;
+    mutex cache_lock;
+    std::vector<thread_cache*> caches;
+
+    static void release_cache(void* ptr) {
+      thread_cache* cache = static_cast<thread_cache*>(ptr);
+      cache->pool->flush_cache(cache);
+      cache->pool->cache_lock.lock();
+      typename std::vector<thread_cache*>::iterator iter =
+        std::find(cache->pool->caches.begin(), cache->pool->caches.end(), cache);
+      if (iter != cache->pool->caches.end()) cache->pool->caches.erase(iter);
+      cache->pool->cache_lock.unlock();
+      delete cache;
+    }
+
+    thread_cache* get_cache() {
+      thread_cache* cache =
+        static_cast<thread_cache*>(pthread_getspecific(cache_key));
+      if (__likely__(cache != NULL)) return cache;
+      cache = new thread_cache;
+      cache->pool = this;
+      cache->count = 0;
+      cache_lock.lock();
+      caches.push_back(cache);
+      cache_lock.unlock();
+      pthread_setspecific(cache_key, cache);
+      return cache;
+    }
+
+    void push_batch(slot** slots, size_t count) {
+      batch* b = new batch;
+      b->count = count;
+      std::copy(slots, slots + count, b->slots);
+      batch* head;
+      do {
+        head = free_batches;
+        b->next = head;
+      } while(!atomic_compare_and_swap(free_batches, head, b));
+    }
+
+    batch* pop_batch() {
+      batch* head;
+      epoch_reclaimer::guard guard;
+      do {
+        head = free_batches;
+        if (head == NULL) return NULL;
+      } while(!atomic_compare_and_swap(free_batches, head, head->next));
+      return head;
+    }
+
+    /// Fills an empty cache from the shared stack or a new chunk.
+    void refill(thread_cache* cache) {
+      batch* b = pop_batch();
+      if (b != NULL) {
+        std::copy(b->slots, b->slots + b->count, cache->slots);
+        cache->count = b->count;
+        epoch_reclaimer::retire(b);
+        return;
+      }
+      grow_lock.lock();
+      const size_t chunk_size = next_chunk_size;
+      next_chunk_size *= 2;
+      slot* chunk = static_cast<slot*>(malloc(sizeof(slot) * chunk_size));
+      ASSERT_TRUE(chunk != NULL);
+      chunks.push_back(chunk);
+      grow_lock.unlock();
+      num_slots.inc(chunk_size);
+      // keep the first batch and share the rest
+      for (size_t i = 0; i < CACHE_SIZE; ++i) cache->slots[i] = chunk + i;
+      cache->count = CACHE_SIZE;
+      slot* slots[CACHE_SIZE];
+      for (size_t i = CACHE_SIZE; i < chunk_size; i += CACHE_SIZE) {
+        for (size_t j = 0; j < CACHE_SIZE; ++j) slots[j] = chunk + i + j;
+        push_batch(slots, CACHE_SIZE);
+      }
+    }
+
+    /// Returns all the slots of a cache to the shared stack.
+    void flush_cache(thread_cache* cache) {
+      while (cache->count > 0) {
+        const size_t count = std::min(cache->count, CACHE_SIZE);
+        cache->count -= count;
+        push_batch(cache->slots + cache->count, count);
+      }
+    }
+
+  public:
+    /// first_chunk_size is rounded up to a multiple of CACHE_SIZE
+    explicit lock_free_object_pool(size_t first_chunk_size = 16 * CACHE_SIZE)
+      : free_batches(NULL),
+        next_chunk_size(std::max<size_t>(1, (first_chunk_size + CACHE_SIZE - 1)
+                                         / CACHE_SIZE) * CACHE_SIZE) {
+      pthread_key_create(&cache_key, release_cache);
+    }
+
+    /**
+     * Releases all the memory of the pool. Objects which are still
+     * allocated are not destroyed.
+     */
+    ~lock_free_object_pool() {
+      pthread_key_delete(cache_key);
+      for (size_t i = 0; i < caches.size(); ++i) delete caches[i];
+      while (free_batches != NULL) {
+        batch* b = free_batches;
+        free_batches = b->next;
+        delete b;
+      }
+      for (size_t i = 0; i < chunks.size(); ++i) free(chunks[i]);
+    }
+
+    /// Returns uninitialized memory for a T.
+    void* alloc_raw() {
+      thread_cache* cache = get_cache();
+      if (__unlikely__(cache->count == 0)) refill(cache);
+      return cache->slots[--cache->count];
+    }
+
+    /// Returns memory obtained from alloc_raw() to the pool.
+    void free_raw(void* ptr) {
+      if (ptr == NULL) return;
+      thread_cache* cache = get_cache();
+      cache->slots[cache->count++] = static_cast<slot*>(ptr);
+      if (__unlikely__(cache->count == 2 * CACHE_SIZE)) {
+        cache->count -= CACHE_SIZE;
+        push_batch(cache->slots + cache->count, CACHE_SIZE);
+      }
+    }
+
+    /// Allocates and default constructs a T.
+    T* construct() { return new (alloc_raw()) T(); }
+
+    /// Allocates a T and copy constructs it from other.
+    T* construct(const T& other) { return new (alloc_raw()) T(other); }
+
+    /// Destroys and frees an object obtained from construct().
+    void destroy(T* ptr) {
+      if (ptr == NULL) return;
+      ptr->~T();
+      free_raw(ptr);
+    }
+
+    /// The number of slots allocated so far.
+    size_t capacity() const { return num_slots.value; }
+  }; // end of lock_free_object_pool
+
 }; // end of graphlab namespace
 #endif
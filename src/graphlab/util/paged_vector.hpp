@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_PAGED_VECTOR_HPP
+#define GRAPHLAB_PAGED_VECTOR_HPP
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <graphlab/parallel/atomic_ops.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A fixed size array of default constructed elements whose storage
+   * is optionally allocated lazily, one page at a time, on first
+   * access.
+   *
+   * With a page size of 0 all elements are allocated by resize() and
+   * the array behaves like a std::vector. Otherwise resize() only
+   * allocates a table of page pointers, and memory is proportional to
+   * the number of distinct pages accessed, which suits state indexed
+   * by vertex id where only a few vertices are ever touched.
+   *
+   * Concurrent calls to the non-const operator[] are safe: the first
+   * access to a page allocates it and races are resolved with a
+   * compare and swap. Concurrent access to the same element must
+   * still be synchronized by the caller. Pages are kept until
+   * clear() or resize(), so an array can be reused by resetting
+   * the elements which were modified.
+   */
+  template <typename T>
+  class paged_vector : boost::noncopyable {
+  public:
+    /// A reasonable page size for lazily allocated arrays
+    static const size_t DEFAULT_PAGE_SIZE = 256;
+
+  private:
+    std::vector<T*> pages;
+    size_t len;
+    size_t page_shift;
+    size_t page_mask;
+    size_t nallocated;
+
+    T* allocate_page(size_t p) {
+      T* page = new T[page_mask + 1];
+      if (atomic_compare_and_swap(pages[p], (T*)NULL, page)) {
+        __sync_fetch_and_add(&nallocated, 1);
+      } else {
+        delete [] page;
+      }
+      return pages[p];
+    }
+
+  public:
+    paged_vector() : len(0), page_shift(0), page_mask(0), nallocated(0) { }
+
+    ~paged_vector() { clear(); }
+
+    /**
+     * Releases all elements and makes room for n default constructed
+     * elements. page_size is rounded up to a power of two. If it is
+     * 0, all the elements are allocated immediately in a single page.
+     */
+    void resize(size_t n, size_t page_size = 0) {
+      clear();
+      len = n;
+      if (n == 0) return;
+      if (page_size == 0) {
+        // a single page which no index can shift out of
+        page_shift = 8 * sizeof(size_t) - 1;
+        page_mask = size_t(-1);
+        pages.resize(1, NULL);
+        pages[0] = new T[n];
+        nallocated = 1;
+      } else {
+        page_shift = 0;
+        while((size_t(1) << page_shift) < page_size) ++page_shift;
+        page_mask = (size_t(1) << page_shift) - 1;
+        pages.resize(((n - 1) >> page_shift) + 1, NULL);
+      }
+    }
+
+    /// Releases all memory
+    void clear() {
+      for (size_t i = 0; i < pages.size(); ++i) delete [] pages[i];
+      std::vector<T*>().swap(pages);
+      len = 0;
+      nallocated = 0;
+    }
+
+    /// The number of elements
+    size_t size() const { return len; }
+
+    /// Returns true if the array has no elements
+    bool empty() const { return len == 0; }
+
+    /// Returns true if the elements are allocated lazily
+    bool is_lazy() const { return page_shift < 8 * sizeof(size_t) - 1; }
+
+    /// The number of pages which have been allocated
+    size_t num_allocated_pages() const { return nallocated; }
+
+    /// The number of bytes used by the elements and the page table
+    size_t memory_usage() const {
+      const size_t page_len = is_lazy() ? page_mask + 1 : len;
+      return nallocated * page_len * sizeof(T) +
+          pages.size() * sizeof(T*);
+    }
+
+    /// Returns element i, allocating its page if necessary
+    inline T& operator[](size_t i) {
+      DASSERT_LT(i, len);
+      T* page = pages[i >> page_shift];
+      if (__builtin_expect(page == NULL, 0)) page = allocate_page(i >> page_shift);
+      return page[i & page_mask];
+    }
+
+    /// Returns element i, which must be on an allocated page
+    inline const T& operator[](size_t i) const {
+      DASSERT_LT(i, len);
+      DASSERT_TRUE(pages[i >> page_shift] != NULL);
+      return pages[i >> page_shift][i & page_mask];
+    }
+  }; // end of paged_vector
+
+} // end of namespace graphlab
+
+#endif
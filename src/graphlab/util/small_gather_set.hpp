@@ -0,0 +1,226 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+#ifndef GRAPHLAB_SMALL_GATHER_SET_HPP
+#define GRAPHLAB_SMALL_GATHER_SET_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include <graphlab/util/small_set.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \brief A set of values to accumulate in a gather, which stores up
+   * to MAX_INLINE values without any heap allocation.
+   *
+   * Up to MAX_INLINE values are kept sorted in an inline small_set.
+   * Larger sets spill into a heap allocated vector to which inserts
+   * and unions append in constant time, so that accumulating the d
+   * neighbors of a vertex one at a time costs O(d) rather than the
+   * O(d^2) of a sorted insert. The spilled values are sorted and made
+   * unique by normalize(), which must be called before the contents
+   * of a spilled set are read. normalize() is a no-op on inline sets.
+   *
+   * A typical gather returns a set with the value of one edge, the
+   * sets are combined with +=, and apply() normalizes a copy of the
+   * result:
+   * \code
+   * typedef small_gather_set<16, vertex_id_type> gather_type;
+   * gather_type gather(icontext_type& context, const vertex_type& vertex,
+   *                    edge_type& edge) const {
+   *   return gather_type(edge.target().id());
+   * }
+   * void apply(icontext_type& context, vertex_type& vertex,
+   *            const gather_type& total) {
+   *   vertex.data().neighbors = total;
+   *   vertex.data().neighbors.normalize();
+   * }
+   * \endcode
+   *
+   * T must be a POD type with a total order, such as an integer id or
+   * color. Sets are serialized as a count followed by the values.
+   */
+  template<size_t MAX_INLINE, typename T>
+  class small_gather_set {
+  public:
+    typedef T value_type;
+    typedef const T* iterator;
+    typedef const T* const_iterator;
+
+    //! Construct an empty set
+    small_gather_set() : sorted(true) { }
+
+    //! Construct a set with one element
+    explicit small_gather_set(const T& elem) : values(elem), sorted(true) { }
+
+    //! Returns true if the values are stored inline
+    inline bool is_inline() const { return spill.empty(); }
+
+    //! Returns true if the values can be read without normalize()
+    inline bool is_normalized() const { return sorted; }
+
+    //! Insert an element into the set
+    void insert(const T& elem) {
+      if (is_inline()) {
+        if (values.contains(elem)) return;
+        if (values.size() < MAX_INLINE) { values += elem; return; }
+        move_to_spill();
+      }
+      if (sorted && !spill.empty() && !(spill.back() < elem)) sorted = false;
+      spill.push_back(elem);
+    }
+
+    //! Add the elements of the other set to this set
+    small_gather_set& operator+=(const small_gather_set& other) {
+      if (other.is_inline()) {
+        if (is_inline() && values.size() + other.values.size() <= MAX_INLINE) {
+          values += other.values;
+        } else {
+          foreach(const T& elem, other.values) insert(elem);
+        }
+      } else {
+        if (is_inline()) move_to_spill();
+        spill.insert(spill.end(), other.spill.begin(), other.spill.end());
+        sorted = false;
+      }
+      return *this;
+    }
+
+    //! Sort the spilled values and remove duplicates
+    void normalize() {
+      if (sorted) return;
+      std::sort(spill.begin(), spill.end());
+      spill.erase(std::unique(spill.begin(), spill.end()), spill.end());
+      sorted = true;
+    }
+
+    //! Remove all elements, releasing the spilled values
+    void clear() {
+      values = small_set<MAX_INLINE, T>();
+      std::vector<T>().swap(spill);
+      sorted = true;
+    }
+
+    //! The number of elements in the (normalized) set
+    inline size_t size() const {
+      ASSERT_TRUE(sorted);
+      return is_inline() ? values.size() : spill.size();
+    }
+
+    //! Returns true if there are no elements in the set
+    inline bool empty() const { return is_inline() && values.empty(); }
+
+    //! The first element of the (normalized) set, in increasing order
+    inline const T* begin() const {
+      ASSERT_TRUE(sorted);
+      return is_inline() ? values.begin() : &spill[0];
+    }
+
+    //! The end of the (normalized) set
+    inline const T* end() const {
+      return is_inline() ? values.end() : &spill[0] + spill.size();
+    }
+
+    //! Returns 1 if the (normalized) set contains elem and 0 otherwise
+    size_t count(const T& elem) const {
+      return std::binary_search(begin(), end(), elem);
+    }
+
+    //! Returns true if the (normalized) set contains elem
+    bool contains(const T& elem) const { return count(elem) > 0; }
+
+    void save(oarchive& oarc) const {
+      const uint32_t nelems = is_inline() ? values.size() : spill.size();
+      oarc << sorted << nelems;
+      if (is_inline()) serialize(oarc, values.begin(), nelems * sizeof(T));
+      else serialize(oarc, &spill[0], nelems * sizeof(T));
+    }
+
+    void load(iarchive& iarc) {
+      clear();
+      uint32_t nelems = 0;
+      iarc >> sorted >> nelems;
+      if (nelems <= MAX_INLINE && sorted) {
+        T buffer[MAX_INLINE > 0 ? MAX_INLINE : 1];
+        deserialize(iarc, buffer, nelems * sizeof(T));
+        for (size_t i = 0; i < nelems; ++i) values += buffer[i];
+      } else {
+        spill.resize(nelems);
+        deserialize(iarc, &spill[0], nelems * sizeof(T));
+      }
+    }
+
+  private:
+    //! The values while there are at most MAX_INLINE of them
+    small_set<MAX_INLINE, T> values;
+    //! The values once there are more than MAX_INLINE of them
+    std::vector<T> spill;
+    //! False if the spilled values may be unsorted or contain duplicates
+    bool sorted;
+
+    void move_to_spill() {
+      spill.reserve(2 * MAX_INLINE + 2);
+      spill.assign(values.begin(), values.end());
+      values = small_set<MAX_INLINE, T>();
+    }
+  }; // end of small_gather_set
+
+
+  /**
+   * \brief Returns the number of elements in both (normalized) sets.
+   *
+   * Merges the sets if they have similar sizes, and otherwise looks up
+   * each element of the smaller set in the larger one.
+   */
+  template<size_t N1, size_t N2, typename T>
+  size_t intersection_size(const small_gather_set<N1, T>& a,
+                           const small_gather_set<N2, T>& b) {
+    const T* s_begin = a.begin(); const T* s_end = a.end();
+    const T* l_begin = b.begin(); const T* l_end = b.end();
+    if (s_end - s_begin > l_end - l_begin) {
+      std::swap(s_begin, l_begin); std::swap(s_end, l_end);
+    }
+    size_t count = 0;
+    if (8 * (s_end - s_begin) < l_end - l_begin) {
+      for (; s_begin != s_end; ++s_begin) {
+        l_begin = std::lower_bound(l_begin, l_end, *s_begin);
+        if (l_begin == l_end) break;
+        count += !(*s_begin < *l_begin);
+      }
+    } else {
+      while (s_begin != s_end && l_begin != l_end) {
+        if (*s_begin < *l_begin) ++s_begin;
+        else if (*l_begin < *s_begin) ++l_begin;
+        else { ++count; ++s_begin; ++l_begin; }
+      }
+    }
+    return count;
+  }
+
+}; // end of graphlab namespace
+#include <graphlab/macros_undef.hpp>
+#endif
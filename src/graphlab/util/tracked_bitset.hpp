@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_TRACKED_BITSET_HPP
+#define GRAPHLAB_TRACKED_BITSET_HPP
+
+#include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A dense bitset which can optionally track which of its words may
+   * contain set bits, so that clearing it and visiting its set bits
+   * cost time proportional to the number of words touched instead of
+   * to its size.
+   *
+   * The summary keeps one bit per word of the bitset and is a
+   * superset of the nonzero words: set_bit() marks the word and
+   * clear_bit() does not unmark it. Without tracking the bitset
+   * behaves exactly like a dense_bitset.
+   *
+   * Blocks of set bits are visited in parallel with next_word():
+   *
+   * \code
+   * atomic<size_t> counter;  // shared by all threads, starts at 0
+   * tracked_bitset::cursor cursor;  // one per thread
+   * size_t block_start;
+   * while(bits.next_word(counter, cursor, block_start)) {
+   *   size_t word = bits.containing_word(block_start);
+   *   // bit i of word is bit block_start + i of the bitset
+   * }
+   * \endcode
+   */
+  class tracked_bitset {
+  public:
+    static const size_t WORD_BITS = 8 * sizeof(size_t);
+
+    /// The per thread position of a next_word() traversal
+    struct cursor {
+      size_t base;
+      size_t pending;
+      cursor() : base(0), pending(0) { }
+    };
+
+  private:
+    dense_bitset bits;
+    dense_bitset words;
+    bool track;
+
+    void rebuild_summary() {
+      words.clear();
+      for (size_t b = 0; b < bits.size(); b += WORD_BITS) {
+        if (bits.containing_word(b) != 0) words.set_bit(b / WORD_BITS);
+      }
+    }
+
+  public:
+    tracked_bitset() : track(false) { }
+
+    /**
+     * Resizes the bitset to n bits, which are all cleared. If track
+     * is set the words with set bits are tracked.
+     */
+    void resize(size_t n, bool track_words = false) {
+      track = track_words;
+      bits.resize(n);
+      bits.clear();
+      if (track) {
+        words.resize((n + WORD_BITS - 1) / WORD_BITS);
+        words.clear();
+      } else {
+        words.resize(0);
+      }
+    }
+
+    /// Returns true if the words with set bits are tracked
+    bool tracking() const { return track; }
+
+    /// The number of bits
+    size_t size() const { return bits.size(); }
+
+    /// Clears all bits. Only the tracked words are visited.
+    void clear() {
+      if (!track) {
+        bits.clear();
+        return;
+      }
+      for (size_t s = 0; s < words.size(); s += WORD_BITS) {
+        size_t pending = words.containing_word(s);
+        while (pending != 0) {
+          const size_t w = s + __builtin_ctzl(pending);
+          pending &= pending - 1;
+          bits.get_containing_word_and_zero(w * WORD_BITS);
+        }
+      }
+      words.clear();
+    }
+
+    /// Sets all bits
+    void fill() {
+      bits.fill();
+      if (track) words.fill();
+    }
+
+    /// Returns the value of bit b
+    inline bool get(size_t b) const { return bits.get(b); }
+
+    /// Atomically sets bit b, returning its previous value
+    inline bool set_bit(size_t b) {
+      if (track && !words.get(b / WORD_BITS)) words.set_bit(b / WORD_BITS);
+      return bits.set_bit(b);
+    }
+
+    /// Atomically clears bit b, returning its previous value
+    inline bool clear_bit(size_t b) { return bits.clear_bit(b); }
+
+    /// Returns the value of the word containing bit b
+    inline size_t containing_word(size_t b) { return bits.containing_word(b); }
+
+    /**
+     * Claims the next block of WORD_BITS bits which may contain set
+     * bits, returning its first bit in block_start, or returns false
+     * if there are none left. Blocks are claimed through a counter
+     * shared by all threads, which must be 0 at the start of the
+     * traversal and must not be used by anything else during it.
+     * Without tracking every block is visited.
+     */
+    inline bool next_word(atomic<size_t>& counter, cursor& c,
+                          size_t& block_start) {
+      if (!track) {
+        block_start = counter.inc_ret_last(WORD_BITS);
+        return block_start < bits.size();
+      }
+      // claim a word of the summary at a time
+      while (c.pending == 0) {
+        const size_t s = counter.inc_ret_last(1) * WORD_BITS;
+        if (s >= words.size()) return false;
+        c.pending = words.containing_word(s);
+        c.base = s;
+      }
+      const size_t w = c.base + __builtin_ctzl(c.pending);
+      c.pending &= c.pending - 1;
+      block_start = w * WORD_BITS;
+      return true;
+    }
+
+    /// The underlying bitset, for iteration over the set bits
+    const dense_bitset& get_bits() const { return bits; }
+
+    void save(oarchive& oarc) const { oarc << bits; }
+
+    void load(iarchive& iarc) {
+      iarc >> bits;
+      if (track) {
+        words.resize((bits.size() + WORD_BITS - 1) / WORD_BITS);
+        rebuild_summary();
+      }
+    }
+  }; // end of tracked_bitset
+
+} // end of namespace graphlab
+
+#endif
@@ -25,10 +25,14 @@
 #include <graphlab/util/binary_parser.hpp>
 #include <graphlab/util/timer.hpp>
 #include <graphlab/util/random.hpp>
+#include <graphlab/util/counter_rng.hpp>
+#include <graphlab/util/bit_lanes.hpp>
 #include <graphlab/util/small_set.hpp>
+#include <graphlab/util/small_gather_set.hpp>
 // #include <graphlab/util/charstream.hpp>
 // #include <graphlab/util/cache.hpp>
 #include <graphlab/util/fs_util.hpp>
+#include <graphlab/util/line_stream_source.hpp>
 #include <graphlab/util/hdfs.hpp>
 #include <graphlab/util/mpi_tools.hpp>
 #include <graphlab/util/empty.hpp>
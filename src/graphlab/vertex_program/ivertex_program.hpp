@@ -45,7 +45,42 @@
 
 
 namespace graphlab {
-  
+
+  /**
+   * \brief Vertex programs inheriting from IS_BULK_GATHER declare that
+   * their gather is a pure function of the data of the source vertex,
+   * the edge and the target vertex.
+   *
+   * Such a vertex program provides, in addition to the regular gather,
+   *
+   * \code
+   * static gather_type gather_edge(const vertex_data_type& source,
+   *                                const edge_data_type& edge,
+   *                                const vertex_data_type& target);
+   * \endcode
+   *
+   * which must return the same value as gather on that edge. The
+   * \ref graphlab::synchronous_engine then computes the local gather of
+   * each vertex with a tight loop over the raw adjacency arrays of the
+   * local graph rather than through the edge iterators, which lets the
+   * compiler unroll and vectorize the reduction.  gather_edges,
+   * pre_local_gather and post_local_gather are still called as usual.
+   *
+   * \code
+   * struct sum_in_neighbors :
+   *     public graphlab::ivertex_program<graph_type, double>,
+   *     public graphlab::IS_POD_TYPE,
+   *     public graphlab::IS_BULK_GATHER {
+   *   static double gather_edge(const double& source, const empty& edge,
+   *                             const double& target) {
+   *     return source;
+   *   }
+   *   ...
+   * };
+   * \endcode
+   */
+  struct IS_BULK_GATHER { };
+
   /**
    * \brief The ivertex_program class defines the vertex program
    * interface that all vertex programs should extend and implement.
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <vector>
+#include <graphlab/util/bit_lanes.hpp>
+
+using namespace graphlab;
+
+typedef bit_lanes<1> lanes64;
+typedef bit_lanes<4> lanes256;
+
+class BitLanesTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_lane_ops() {
+    lanes256 a, b;
+    TS_ASSERT(a.none());
+    TS_ASSERT_EQUALS(lanes256::NUM_LANES, 256);
+    a.set(3); a.set(70); a.set(255);
+    b.set(70); b.set(128);
+    TS_ASSERT(a.get(70) && !a.get(71));
+    TS_ASSERT_EQUALS(a.count(), 3);
+    TS_ASSERT_EQUALS((a & b).count(), 1);
+    TS_ASSERT_EQUALS((a | b).count(), 4);
+    TS_ASSERT_EQUALS((a ^ b).count(), 3);
+    TS_ASSERT_EQUALS((~a).count(), 253);
+    lanes256 c(a);
+    c.andnot(b);
+    TS_ASSERT(c.get(3) && !c.get(70) && c.get(255));
+    // += is the gather combiner
+    c += b;
+    TS_ASSERT(c == (a | b));
+    c.set(3, false);
+    TS_ASSERT(c != (a | b));
+    TS_ASSERT_EQUALS(lanes64(true).count(), 64);
+  }
+
+  void test_bernoulli() {
+    random::counter_rng rng(5, 1, 2), same(5, 1, 2);
+    TS_ASSERT(lanes256::bernoulli(rng, 0).none());
+    TS_ASSERT_EQUALS(lanes256::bernoulli(rng, 1).count(), 256);
+    // the same key yields the same lanes
+    rng.reset(5, 1, 2);
+    TS_ASSERT(lanes256::bernoulli(rng, 0.3) == lanes256::bernoulli(same, 0.3));
+    size_t total = 0;
+    std::vector<size_t> per_lane(256, 0);
+    const size_t n = 2000;
+    for (size_t i = 0; i < n; ++i) {
+      const lanes256 draw = lanes256::bernoulli(rng, 0.3);
+      total += draw.count();
+      for (size_t l = 0; l < 256; ++l) per_lane[l] += draw.get(l);
+    }
+    TS_ASSERT_DELTA(double(total) / (256 * n), 0.3, 0.005);
+    for (size_t l = 0; l < 256; ++l) {
+      TS_ASSERT_DELTA(double(per_lane[l]) / n, 0.3, 0.06);
+    }
+  }
+};
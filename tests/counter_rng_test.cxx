@@ -0,0 +1,178 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <boost/bind.hpp>
+
+#include <graphlab/util/counter_rng.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using graphlab::random::counter_rng;
+
+// Draws one value per vertex in [begin, end) with a stride, so that
+// different threads touch the vertices in a different order.
+struct stream_worker {
+  std::vector<double>* out;
+  size_t begin, stride;
+  void run() {
+    for (size_t v = begin; v < out->size(); v += stride) {
+      counter_rng rng(42, v, 7);
+      (*out)[v] = rng.rand01() + rng.uniform<int>(0, 100);
+    }
+  }
+};
+
+class CounterRNGTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_philox_known_answers() {
+    // Known answer vectors from the Random123 distribution
+    const uint32_t ctr_a[4] = {0, 0, 0, 0}, key_a[2] = {0, 0};
+    const uint32_t ans_a[4] = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    const uint32_t ctr_b[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    const uint32_t key_b[2] = {0xa4093822, 0x299f31d0};
+    const uint32_t ans_b[4] = {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+    uint32_t out[4];
+    graphlab::random::philox4x32::block(ctr_a, key_a, out);
+    for (size_t i = 0; i < 4; ++i) TS_ASSERT_EQUALS(out[i], ans_a[i]);
+    graphlab::random::philox4x32::block(ctr_b, key_b, out);
+    for (size_t i = 0; i < 4; ++i) TS_ASSERT_EQUALS(out[i], ans_b[i]);
+  }
+
+  void test_streams_are_keyed() {
+    counter_rng a(1, 10, 0), b(1, 10, 0), c(1, 11, 0), d(1, 10, 1), e(2, 10, 0);
+    bool differs_c = false, differs_d = false, differs_e = false;
+    for (size_t i = 0; i < 100; ++i) {
+      const uint32_t va = a.next_u32();
+      TS_ASSERT_EQUALS(va, b.next_u32());
+      differs_c |= (va != c.next_u32());
+      differs_d |= (va != d.next_u32());
+      differs_e |= (va != e.next_u32());
+    }
+    TS_ASSERT(differs_c && differs_d && differs_e);
+    a.reset(1, 10, 0);
+    b.reset(1, 10, 0);
+    TS_ASSERT_EQUALS(a.next_u64(), b.next_u64());
+  }
+
+  void test_edge_streams_use_full_ids() {
+    // 64-bit vertex ids which only differ in the high or low half
+    const uint64_t doc = uint64_t(-3), w1 = 5, w2 = 5 | (uint64_t(1) << 40);
+    counter_rng a(1, doc, w1, 0), b(1, doc, w1, 0), c(1, doc, w2, 0),
+      d(1, doc, w1 + 1, 0), e(1, w1, doc, 0);
+    bool differs_c = false, differs_d = false, differs_e = false;
+    for (size_t i = 0; i < 100; ++i) {
+      const uint32_t va = a.next_u32();
+      TS_ASSERT_EQUALS(va, b.next_u32());
+      differs_c |= (va != c.next_u32());
+      differs_d |= (va != d.next_u32());
+      differs_e |= (va != e.next_u32());
+    }
+    TS_ASSERT(differs_c && differs_d && differs_e);
+  }
+
+  void test_thread_placement() {
+    const size_t nverts = 10000;
+    std::vector<double> serial(nverts), parallel(nverts);
+    stream_worker w = { &serial, 0, 1 };
+    w.run();
+    std::vector<stream_worker> workers(7);
+    graphlab::thread_group threads;
+    for (size_t i = 0; i < workers.size(); ++i) {
+      workers[i].out = &parallel;
+      workers[i].begin = workers.size() - 1 - i;
+      workers[i].stride = workers.size();
+      threads.launch(boost::bind(&stream_worker::run, &workers[i]));
+    }
+    threads.join();
+    for (size_t v = 0; v < nverts; ++v) TS_ASSERT_EQUALS(serial[v], parallel[v]);
+  }
+
+  void test_fill_uniform() {
+    const size_t n = 1001;
+    std::vector<double> batch(n);
+    std::vector<float> fbatch(n);
+    counter_rng a(3, 4, 5), b(3, 4, 5);
+    // leave a partially consumed block behind before the batch
+    a.next_u64(); b.next_u64();
+    a.fill_uniform(&batch[0], n);
+    for (size_t i = 0; i < n; ++i) TS_ASSERT_EQUALS(batch[i], b.rand01());
+    a.fill_uniform(&fbatch[0], n);
+    for (size_t i = 0; i < n; ++i) {
+      const float expected = float(b.next_u32() >> 8) * (1.0f / 16777216.0f);
+      TS_ASSERT_EQUALS(fbatch[i], expected);
+    }
+  }
+
+  void test_distributions() {
+    counter_rng rng(9, 0, 0);
+    const size_t n = 100000;
+    std::vector<size_t> counts(4, 0);
+    std::vector<double> prb(4);
+    prb[0] = 1; prb[1] = 2; prb[2] = 3; prb[3] = 4;
+    double sum = 0, sumsq = 0, gsum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const double u = rng.rand01();
+      TS_ASSERT(u >= 0 && u < 1);
+      sum += u; sumsq += u * u;
+      const int k = rng.uniform<int>(-3, 3);
+      TS_ASSERT(k >= -3 && k <= 3);
+      ++counts[rng.multinomial(prb)];
+      gsum += rng.gamma(2.5);
+    }
+    TS_ASSERT_DELTA(sum / n, 0.5, 0.01);
+    TS_ASSERT_DELTA(sumsq / n - (sum / n) * (sum / n), 1.0 / 12, 0.01);
+    TS_ASSERT_DELTA(gsum / n, 2.5, 0.05);
+    for (size_t i = 0; i < 4; ++i) {
+      TS_ASSERT_DELTA(double(counts[i]) / n, prb[i] / 10, 0.01);
+    }
+    std::vector<int> perm(50);
+    for (size_t i = 0; i < perm.size(); ++i) perm[i] = int(i);
+    rng.shuffle(perm);
+    std::vector<int> sorted(perm);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) TS_ASSERT_EQUALS(sorted[i], int(i));
+  }
+
+  void test_bernoulli_bits() {
+    counter_rng rng(11, 0, 0);
+    TS_ASSERT_EQUALS(rng.bernoulli_bits(0), 0);
+    TS_ASSERT_EQUALS(rng.bernoulli_bits(1), ~uint64_t(0));
+    const double probs[3] = {0.5, 0.1, 0.73};
+    const size_t n = 5000;
+    for (size_t k = 0; k < 3; ++k) {
+      size_t ones = 0, lane0 = 0;
+      for (size_t i = 0; i < n; ++i) {
+        const uint64_t bits = rng.bernoulli_bits(probs[k]);
+        ones += __builtin_popcountll(bits);
+        lane0 += bits & 1;
+      }
+      TS_ASSERT_DELTA(double(ones) / (64 * n), probs[k], 0.005);
+      TS_ASSERT_DELTA(double(lane0) / n, probs[k], 0.03);
+    }
+  }
+};
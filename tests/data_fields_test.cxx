@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <sstream>
+#include <vector>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/graph/data_fields.hpp>
+
+struct path_data {
+  float dist;
+  size_t nupdates;
+  std::vector<int> path;
+  path_data() : dist(1), nupdates(0) { }
+};
+
+GRAPHLAB_DATA_FIELDS(path_data, (dist)(nupdates)(path))
+
+using namespace graphlab;
+
+class DataFieldsTestSuite: public CxxTest::TestSuite {
+ public:
+  void test_changed_fields() {
+    path_data a, b;
+    TS_ASSERT_EQUALS(data_fields<path_data>::num_fields, 3);
+    TS_ASSERT_EQUALS(data_fields<path_data>::changed(a, b), 0);
+    b.path.push_back(3);
+    TS_ASSERT_EQUALS(data_fields<path_data>::changed(a, b), 4);
+    b.dist = 2;
+    TS_ASSERT_EQUALS(data_fields<path_data>::changed(a, b), 5);
+  }
+
+  void test_delta_sync() {
+    typedef data_sync<path_data> sync_type;
+    path_data before, after;
+    after.path.push_back(3);
+    after.path.push_back(4);
+    sync_type::value_type update;
+    TS_ASSERT(!sync_type::diff(before, before, update));
+    TS_ASSERT(sync_type::diff(before, after, update));
+
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << update;
+    strm.flush();
+    iarchive iarc(strm);
+    sync_type::value_type received;
+    iarc >> received;
+
+    // unchanged fields of the replica are left alone
+    path_data replica;
+    replica.nupdates = 7;
+    sync_type::apply(received, replica);
+    TS_ASSERT_EQUALS(replica.nupdates, 7);
+    TS_ASSERT_EQUALS(replica.dist, 1);
+    TS_ASSERT_EQUALS(replica.path.size(), 2);
+    TS_ASSERT_EQUALS(replica.path[1], 4);
+  }
+
+  void test_undeclared_type() {
+    // types without a field list are always sent whole
+    typedef data_sync<double> sync_type;
+    sync_type::value_type update;
+    TS_ASSERT(sync_type::diff(sync_type::snapshot(1.0), 1.0, update));
+    double replica = 0;
+    sync_type::apply(update, replica);
+    TS_ASSERT_EQUALS(replica, 1.0);
+  }
+};
@@ -21,8 +21,11 @@
  */
 
 
+#include <vector>
+#include <algorithm>
 #include <cxxtest/TestSuite.h>
 #include <graphlab/util/dense_bitset.hpp>
+#include <graphlab/util/tracked_bitset.hpp>
 #include <graphlab/macros_def.hpp>
 using namespace graphlab;
 
@@ -158,5 +161,62 @@ public:
   }
 
 
+  // visits the blocks returned by next_word from a single thread
+  std::vector<size_t> visit_blocks(tracked_bitset& d) {
+    std::vector<size_t> blocks;
+    atomic<size_t> counter;
+    tracked_bitset::cursor cursor;
+    size_t block_start;
+    while(d.next_word(counter, cursor, block_start)) {
+      blocks.push_back(block_start);
+    }
+    return blocks;
+  }
+
+  void test_trackedbitset(void) {
+    size_t probelocations[5] = {3, 70, 71, 5000, 9999};
+    for (size_t track = 0; track < 2; ++track) {
+      tracked_bitset d;
+      d.resize(10000, track);
+      TS_ASSERT_EQUALS(d.tracking(), track == 1);
+      for (size_t i = 0; i < 5; ++i) d.set_bit(probelocations[i]);
+      size_t ctr = 0;
+      size_t iter;
+      foreach(iter, d.get_bits()) {
+        TS_ASSERT_EQUALS(iter, probelocations[ctr]);
+        ++ctr;
+      }
+      TS_ASSERT_EQUALS(ctr, 5);
+      // every word with a set bit is visited, and with tracking only those
+      std::vector<size_t> blocks = visit_blocks(d);
+      for (size_t i = 0; i < 5; ++i) {
+        const size_t block = probelocations[i] - probelocations[i] % 64;
+        TS_ASSERT(std::find(blocks.begin(), blocks.end(), block) != blocks.end());
+      }
+      const size_t expected_blocks = track ? 4 : (10000 + 63) / 64;
+      TS_ASSERT_EQUALS(blocks.size(), expected_blocks);
+
+      // the summary survives serialization
+      std::stringstream strm;
+      graphlab::oarchive oarc(strm);
+      oarc << d;
+      strm.flush();
+      graphlab::iarchive iarc(strm);
+      tracked_bitset d2;
+      d2.resize(0, track);
+      iarc >> d2;
+      for (size_t i = 0; i < 10000; ++i) TS_ASSERT_EQUALS(d2.get(i), d.get(i));
+      TS_ASSERT_EQUALS(visit_blocks(d2).size(), blocks.size());
+
+      d.clear();
+      TS_ASSERT_EQUALS(d.get_bits().popcount(), 0);
+      if (track) {
+        TS_ASSERT_EQUALS(visit_blocks(d).size(), 0);
+      }
+      d.fill();
+      TS_ASSERT_EQUALS(d.get_bits().popcount(), 10000);
+      TS_ASSERT_EQUALS(visit_blocks(d).size(), (10000 + 63) / 64);
+    }
+  }
 };
 
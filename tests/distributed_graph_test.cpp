@@ -104,6 +104,38 @@ class distributed_graph_test  {
      }
    }
 
+   /**
+    * Test rebalancing edges
+    */
+   void test_rebalance() {
+     graphlab::distributed_graph<vertex_data, edge_data> g(*dc);
+     test_add_edge_impl(g, 1000, false, true);
+     test_add_edge_impl(g, 10000, false, true);
+     test_rebalance_skewed_impl(g, 10000);
+     dc->cout() << "\n+ Pass test: graph rebalance. :) \n";
+   }
+
+   /**
+    * Test sharing the structure with a graph of other data types
+    */
+   void test_share_structure() {
+     graphlab::distributed_graph<vertex_data, edge_data> g(*dc);
+     for (size_t i = 0; i < 1000; ++i) {
+       if (i % dc->numprocs() == dc->procid()) {
+         g.add_edge(i, (i * 7 + 1) % 1000, edge_data(i, (i * 7 + 1) % 1000));
+         g.add_edge(i, (i + 1) % 1000, edge_data(i, (i + 1) % 1000));
+       }
+     }
+     g.finalize();
+     test_share_structure_impl(g);
+     if (dc->numprocs() > 1) {
+       // the copy places masters on the same machines after a shrink
+       g.set_active_procs(std::vector<graphlab::procid_t>(1, 0));
+       test_share_structure_impl(g);
+     }
+     dc->cout() << "\n+ Pass test: graph share structure. :) \n";
+   }
+
    /**
     * Test save load
     */
@@ -155,7 +187,8 @@ class distributed_graph_test  {
        }
 
    template<typename Graph>
-       void test_add_edge_impl(Graph& g, size_t nedges, bool use_dynamic = false) {
+       void test_add_edge_impl(Graph& g, size_t nedges, bool use_dynamic = false,
+                               bool rebalance = false) {
          typedef typename Graph::vertex_id_type vertex_id_type;
          srand(0);
          g.clear();
@@ -198,6 +231,90 @@ class distributed_graph_test  {
          check_adjacency(g, in_edges, out_edges, all_edges.size());
          check_edge_data(g);
          check_vertex_info(g);
+         if (rebalance) {
+           const double rf_before = replication_factor(g);
+           g.rebalance();
+           ASSERT_LE(replication_factor(g), rf_before);
+           check_adjacency(g, in_edges, out_edges, all_edges.size());
+           check_edge_data(g);
+           check_vertex_info(g);
+         }
+       }
+
+   /**
+    * A few hubs, each leaf linked to two hubs and to the next leaf,
+    * with the edges dealt to the machines in turn. The leaves start
+    * replicated on several machines, and after rebalancing only the
+    * hubs should be.
+    */
+   template<typename Graph>
+       void test_rebalance_skewed_impl(Graph& g, size_t nleaves) {
+         typedef typename Graph::vertex_id_type vertex_id_type;
+         const vertex_id_type nhubs = 4;
+         g.clear();
+         size_t count = 0;
+         for (vertex_id_type leaf = nhubs; leaf < nhubs + nleaves; ++leaf) {
+           vertex_id_type targets[3] = { leaf % nhubs, (leaf + 1) % nhubs,
+                                         leaf + 1 };
+           const size_t ntargets = leaf + 1 < nhubs + nleaves ? 3 : 2;
+           for (size_t i = 0; i < ntargets; ++i) {
+             if (count++ % dc->numprocs() == dc->procid()) {
+               g.add_edge(leaf, targets[i], edge_data(leaf, targets[i]));
+             }
+           }
+         }
+         g.finalize();
+         const double rf_before = replication_factor(g);
+         g.rebalance();
+         const double rf_after = replication_factor(g);
+         dc->cout() << "Skewed graph replication factor: " << rf_before
+                    << " -> " << rf_after << std::endl;
+         if (dc->numprocs() > 1) ASSERT_LT(rf_after, rf_before);
+         else ASSERT_EQ(rf_after, rf_before);
+         ASSERT_EQ(g.num_edges(), count);
+         check_edge_data(g);
+         check_vertex_info(g);
+       }
+
+   template<typename Graph>
+       double replication_factor(const Graph& g) {
+         return double(g.num_replicas()) / g.num_vertices();
+       }
+
+   template<typename Graph>
+       void test_share_structure_impl(Graph& g) {
+         typedef graphlab::distributed_graph<int, float> other_graph_type;
+         typedef typename Graph::local_edge_list_type local_edge_list_type;
+         typedef other_graph_type::local_edge_list_type other_edge_list_type;
+         other_graph_type g2(*dc, g);
+         ASSERT_EQ(g2.num_vertices(), g.num_vertices());
+         ASSERT_EQ(g2.num_edges(), g.num_edges());
+         ASSERT_EQ(g2.num_local_vertices(), g.num_local_vertices());
+         ASSERT_EQ(g2.num_local_edges(), g.num_local_edges());
+         ASSERT_TRUE(g2.get_active_procs() == g.get_active_procs());
+         for (size_t i = 0; i < g.num_local_vertices(); ++i) {
+           ASSERT_EQ(g2.global_vid(i), g.global_vid(i));
+           ASSERT_EQ(g2.master(g.global_vid(i)), g.master(g.global_vid(i)));
+           ASSERT_EQ(g2.l_get_vertex_record(i).owner,
+                     g.l_get_vertex_record(i).owner);
+           ASSERT_EQ(g2.l_get_vertex_record(i).num_mirrors(),
+                     g.l_get_vertex_record(i).num_mirrors());
+           ASSERT_EQ(g2.l_vertex(i).data(), 0);
+           const local_edge_list_type& in = g.l_in_edges(i);
+           const other_edge_list_type& in2 = g2.l_in_edges(i);
+           ASSERT_EQ(in2.size(), in.size());
+           for (size_t j = 0; j < in.size(); ++j) {
+             ASSERT_EQ(in2[j].source().id(), in[j].source().id());
+             ASSERT_EQ(in2[j].target().id(), in[j].target().id());
+           }
+           const local_edge_list_type& out = g.l_out_edges(i);
+           const other_edge_list_type& out2 = g2.l_out_edges(i);
+           ASSERT_EQ(out2.size(), out.size());
+           for (size_t j = 0; j < out.size(); ++j) {
+             ASSERT_EQ(out2[j].source().id(), out[j].source().id());
+             ASSERT_EQ(out2[j].target().id(), out[j].target().id());
+           }
+         }
        }
 
    template<typename Graph>
@@ -505,6 +622,8 @@ int main(int argc, char** argv) {
   testsuit.test_add_vertex();
   testsuit.test_add_edge();
   testsuit.test_dynamic_add_edge();
+  testsuit.test_rebalance();
+  testsuit.test_share_structure();
   testsuit.test_save_load();
 
   delete(dc);
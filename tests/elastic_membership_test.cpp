@@ -0,0 +1,139 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include <graphlab.hpp>
+#include <graphlab/rpc/process_membership.hpp>
+
+typedef graphlab::distributed_graph<int,int> graph_type;
+
+/**
+ * Stands in for zookeeper::server_list: the member list of every
+ * namespace is set by the test.
+ */
+struct fixed_server_list {
+  std::vector<std::string> servers;
+  std::vector<std::string> get_all_servers(std::string name_space) {
+    return servers;
+  }
+};
+
+
+void init_vertex(graph_type::vertex_type vtx) {
+  vtx.data() = vtx.id() % 97;
+}
+
+void init_edge(graph_type::edge_type e) {
+  e.data() = (e.source().id() + 3 * e.target().id()) % 89;
+}
+
+size_t vertex_checksum(graph_type::vertex_type vtx) {
+  return vtx.id() * vtx.data();
+}
+
+size_t edge_checksum(graph_type::edge_type e) {
+  return e.source().id() * e.data() + e.target().id();
+}
+
+size_t vertex_degree(graph_type::vertex_type vtx) {
+  return vtx.num_in_edges() + vtx.num_out_edges();
+}
+
+
+void check_graph(graph_type& graph, size_t nverts, size_t nedges,
+                 size_t vsum, size_t esum) {
+  ASSERT_EQ(graph.num_vertices(), nverts);
+  ASSERT_EQ(graph.num_edges(), nedges);
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_checksum), vsum);
+  ASSERT_EQ(graph.map_reduce_edges<size_t>(edge_checksum), esum);
+  // degrees are only correct if the mirrors were rebuilt
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_degree), 2 * nedges);
+}
+
+
+void check_inactive(graph_type& graph, graphlab::distributed_control& dc) {
+  std::vector<graphlab::procid_t> active = graph.get_active_procs();
+  if (!std::binary_search(active.begin(), active.end(), dc.procid())) {
+    ASSERT_EQ(graph.num_local_vertices(), 0);
+    ASSERT_EQ(graph.num_local_edges(), 0);
+  }
+}
+
+
+int main(int argc, char** argv) {
+  global_logger().set_log_level(LOG_INFO);
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+
+  graph_type graph(dc);
+  graph.load_synthetic_powerlaw(20000);
+  graph.finalize();
+  graph.transform_vertices(init_vertex);
+  graph.transform_edges(init_edge);
+
+  const size_t nverts = graph.num_vertices();
+  const size_t nedges = graph.num_edges();
+  const size_t vsum = graph.map_reduce_vertices<size_t>(vertex_checksum);
+  const size_t esum = graph.map_reduce_edges<size_t>(edge_checksum);
+
+  graphlab::process_membership membership(dc, "node" + graphlab::tostr(dc.procid()));
+  fixed_server_list zk;
+  for (size_t i = 0; i < dc.numprocs(); ++i) {
+    zk.servers.push_back("node" + graphlab::tostr(i));
+  }
+  zk.servers.push_back("unknown");
+
+  // drain the last machine
+  if (dc.numprocs() > 1) zk.servers.erase(zk.servers.begin() + dc.numprocs() - 1);
+  graph.set_active_procs(membership.active_procs(zk, "active"));
+  dc.cout() << graph.get_active_procs().size() << " active machines\n";
+  check_inactive(graph, dc);
+  check_graph(graph, nverts, nedges, vsum, esum);
+
+  // admit it again, and drain the first machine
+  if (dc.numprocs() > 1) {
+    zk.servers.push_back("node" + graphlab::tostr(dc.numprocs() - 1));
+    zk.servers.erase(zk.servers.begin());
+  }
+  graph.set_active_procs(membership.active_procs(zk, "active"));
+  dc.cout() << graph.get_active_procs().size() << " active machines\n";
+  check_inactive(graph, dc);
+  check_graph(graph, nverts, nedges, vsum, esum);
+
+  // shrink to machine 0 alone
+  graph.set_active_procs(std::vector<graphlab::procid_t>(1, 0));
+  ASSERT_EQ(graph.get_active_procs().size(), 1);
+  check_inactive(graph, dc);
+  check_graph(graph, nverts, nedges, vsum, esum);
+
+  // back to all machines
+  std::vector<graphlab::procid_t> all;
+  for (size_t i = 0; i < dc.numprocs(); ++i) all.push_back(i);
+  graph.set_active_procs(all);
+  ASSERT_EQ(graph.get_active_procs().size(), dc.numprocs());
+  check_graph(graph, nverts, nedges, vsum, esum);
+
+  dc.cout() << "Elastic membership test passed\n";
+  graphlab::mpi_tools::finalize();
+}
@@ -0,0 +1,146 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+/*
+ * Benchmarks the general graph_vertex_join.
+ *
+ * The left graph has nleft vertices where vertex v emits the key
+ * v % nkeys, so every key is shared by nleft / nkeys vertices. The
+ * right graph has nright vertices where vertex v emits the key
+ * v * stride, so only about 1 / stride of the left keys match and most
+ * right keys match nothing. The left join is then many-to-one and the
+ * right join one-to-many. The join is prepared with and without the
+ * bloom filter pre-pass and the results of both joins are checked.
+ */
+#include <vector>
+#include <iostream>
+#include <graphlab.hpp>
+#include <graphlab/graph/graph_vertex_join.hpp>
+
+typedef graphlab::distributed_graph<size_t, graphlab::empty> left_graph_type;
+typedef graphlab::distributed_graph<size_t, graphlab::empty> right_graph_type;
+typedef graphlab::graph_vertex_join<left_graph_type, right_graph_type> join_type;
+
+size_t nkeys = 100000;
+size_t stride = 10;
+
+size_t left_key(const left_graph_type::vertex_type& vtx) {
+  return vtx.id() % nkeys;
+}
+
+size_t right_key(const right_graph_type::vertex_type& vtx) {
+  return size_t(vtx.id()) * stride;
+}
+
+// many-to-one: each matching left vertex receives one right vertex,
+// whose data is its own id
+void left_join_op(left_graph_type::vertex_type& vtx, const size_t& rdata) {
+  vtx.data() += rdata + 1;
+}
+
+// one-to-many: each matching right vertex receives every left vertex
+// with its key
+void right_join_op(right_graph_type::vertex_type& vtx, const size_t& ldata) {
+  vtx.data() += 1;
+}
+
+size_t count_bad_left(size_t nright,
+                      const left_graph_type::vertex_type& vtx) {
+  const size_t key = vtx.id() % nkeys;
+  const bool matched = (key % stride == 0) && (key / stride < nright);
+  const size_t expected = matched ? key / stride + 1 : 0;
+  return vtx.data() != expected;
+}
+
+size_t count_bad_right(size_t nleft,
+                       const right_graph_type::vertex_type& vtx) {
+  const size_t key = size_t(vtx.id()) * stride;
+  size_t expected = vtx.id();
+  if (key < nkeys) expected += nleft / nkeys + (key < nleft % nkeys);
+  return vtx.data() != expected;
+}
+
+void reset_left(left_graph_type::vertex_type& vtx) {
+  vtx.data() = 0;
+}
+
+void reset_right(right_graph_type::vertex_type& vtx) {
+  vtx.data() = vtx.id();
+}
+
+int main(int argc, char** argv) {
+  global_logger().set_log_level(LOG_INFO);
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+
+  size_t nleft = 1000000;
+  size_t nright = 1000000;
+  graphlab::command_line_options clopts("Benchmark the graph vertex join.");
+  clopts.attach_option("nleft", nleft, "Number of vertices in the left graph");
+  clopts.attach_option("nright", nright, "Number of vertices in the right graph");
+  clopts.attach_option("nkeys", nkeys, "Number of distinct left keys");
+  clopts.attach_option("stride", stride, 
+                       "Right vertex v emits the key v * stride");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  ASSERT_GT(nkeys, 0);
+  ASSERT_GT(stride, 0);
+
+  left_graph_type left(dc, clopts);
+  right_graph_type right(dc, clopts);
+  for (size_t i = dc.procid(); i < nleft; i += dc.numprocs()) {
+    left.add_vertex(i, 0);
+  }
+  for (size_t i = dc.procid(); i < nright; i += dc.numprocs()) {
+    right.add_vertex(i, 0);
+  }
+  left.finalize();
+  right.finalize();
+
+  join_type vjoin(dc, left, right);
+  for (size_t use_bloom = 0; use_bloom < 2; ++use_bloom) {
+    left.transform_vertices(reset_left);
+    right.transform_vertices(reset_right);
+    graphlab::timer ti;
+    vjoin.prepare_join(left_key, right_key, use_bloom);
+    const double prepare_time = ti.current_time();
+    ti.start();
+    vjoin.left_join(left_join_op);
+    const double left_time = ti.current_time();
+    ti.start();
+    vjoin.right_join(right_join_op);
+    const double right_time = ti.current_time();
+    dc.cout() << (use_bloom ? "With" : "Without") << " bloom filter: "
+              << "prepare " << prepare_time << "s, "
+              << "left join " << left_time << "s, "
+              << "right join " << right_time << "s" << std::endl;
+
+    ASSERT_EQ(left.map_reduce_vertices<size_t>(
+        boost::bind(count_bad_left, nright, _1)), 0);
+    ASSERT_EQ(right.map_reduce_vertices<size_t>(
+        boost::bind(count_bad_right, nleft, _1)), 0);
+  }
+  dc.cout() << "Join results verified." << std::endl;
+  graphlab::mpi_tools::finalize();
+}
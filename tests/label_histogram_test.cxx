@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <map>
+#include <sstream>
+#include <graphlab/util/label_histogram.hpp>
+#include <graphlab/util/random.hpp>
+
+using namespace graphlab;
+
+typedef label_histogram<uint32_t, 4> histogram_type;
+
+class LabelHistogramTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_inline_counts() {
+    histogram_type h(7, 1);
+    h += histogram_type(3, 2);
+    h += histogram_type(7, 1);
+    TS_ASSERT_EQUALS(h.size(), 2);
+    TS_ASSERT(!h.on_heap());
+    TS_ASSERT_EQUALS(h.get(7), 2);
+    TS_ASSERT_EQUALS(h.get(3), 2);
+    TS_ASSERT_EQUALS(h.get(5), 0);
+    TS_ASSERT(!h.contains(5));
+    uint32_t label, count;
+    // ties go to the smallest label unless the preferred one is tied
+    TS_ASSERT(h.most_frequent(label, count));
+    TS_ASSERT_EQUALS(label, 3);
+    TS_ASSERT_EQUALS(count, 2);
+    TS_ASSERT(h.most_frequent(label, count, 7));
+    TS_ASSERT_EQUALS(label, 7);
+    h.add(3, 1);
+    TS_ASSERT(h.most_frequent(label, count, 7));
+    TS_ASSERT_EQUALS(label, 3);
+    h.clear();
+    TS_ASSERT(!h.most_frequent(label, count));
+  }
+
+  void test_against_map() {
+    histogram_type h;
+    std::map<uint32_t, uint32_t> reference;
+    for (size_t i = 0; i < 5000; ++i) {
+      const uint32_t label = random::fast_uniform<uint32_t>(0, 300);
+      h += histogram_type(label, 1);
+      ++reference[label];
+    }
+    TS_ASSERT(h.on_heap());
+    TS_ASSERT_EQUALS(h.size(), reference.size());
+    size_t occupied = 0;
+    for (size_t i = 0; i < h.num_slots(); ++i) {
+      if (h.slot(i).label == histogram_type::NO_LABEL) continue;
+      ++occupied;
+      TS_ASSERT_EQUALS(h.slot(i).count, reference[h.slot(i).label]);
+    }
+    TS_ASSERT_EQUALS(occupied, reference.size());
+
+    // round trip through serialization
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << h;
+    strm.flush();
+    iarchive iarc(strm);
+    histogram_type loaded;
+    iarc >> loaded;
+    TS_ASSERT_EQUALS(loaded.size(), h.size());
+    std::map<uint32_t, uint32_t>::const_iterator it = reference.begin();
+    for (; it != reference.end(); ++it) {
+      TS_ASSERT_EQUALS(loaded.get(it->first), it->second);
+    }
+  }
+};
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#include <string>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <boost/bind.hpp>
+#include <graphlab/util/line_stream_source.hpp>
+#include <graphlab/util/net_util.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+
+// The local stand-in for a producer: writes the lines in pieces
+// which do not line up with the line boundaries
+void produce(int fd, std::string data, size_t piece, bool close_fd) {
+  for (size_t i = 0; i < data.length(); i += piece) {
+    const size_t len = std::min(piece, data.length() - i);
+    TS_ASSERT_EQUALS(write(fd, data.c_str() + i, len), (ssize_t)len);
+    usleep(1000);
+  }
+  if (close_fd) close(fd);
+}
+
+// Accepts a single consumer on the listening socket and sends data
+void serve(int listener, std::string data) {
+  const int sock = accept(listener, NULL, NULL);
+  TS_ASSERT_LESS_THAN_EQUALS(0, sock);
+  produce(sock, data, 5, true);
+}
+
+std::string numbered_lines(size_t n) {
+  std::stringstream strm;
+  for (size_t i = 0; i < n; ++i) strm << i << " " << i + 1 << "\n";
+  return strm.str();
+}
+
+void check_numbered_lines(line_stream_source& source, size_t n) {
+  std::string line;
+  for (size_t i = 0; i < n; ++i) {
+    TS_ASSERT(source.read_line(line));
+    std::stringstream strm;
+    strm << i << " " << i + 1;
+    TS_ASSERT_EQUALS(line, strm.str());
+  }
+  TS_ASSERT(!source.read_line(line));
+  TS_ASSERT(source.eof());
+  TS_ASSERT_EQUALS(source.lines_read(), n);
+}
+
+class LineStreamSourceTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_pipe() {
+    int fds[2];
+    TS_ASSERT_EQUALS(pipe(fds), 0);
+    const std::string data = numbered_lines(1000);
+    thread producer;
+    producer.launch(boost::bind(produce, fds[1], data, 7, true));
+    line_stream_source source;
+    source.attach(fds[0], true);
+    check_numbered_lines(source, 1000);
+    TS_ASSERT_EQUALS(source.bytes_read(), data.length());
+    producer.join();
+  }
+
+  void test_unterminated_line() {
+    int fds[2];
+    TS_ASSERT_EQUALS(pipe(fds), 0);
+    produce(fds[1], "1 2\r\n\n3 4", 100, true);
+    line_stream_source source;
+    source.attach(fds[0], true);
+    std::string line;
+    TS_ASSERT(source.read_line(line));
+    TS_ASSERT_EQUALS(line, "1 2");
+    TS_ASSERT(source.read_line(line));
+    TS_ASSERT_EQUALS(line, "");
+    TS_ASSERT(source.read_line(line));
+    TS_ASSERT_EQUALS(line, "3 4");
+    TS_ASSERT(!source.read_line(line));
+    TS_ASSERT(source.eof());
+  }
+
+  void test_timeout() {
+    int fds[2];
+    TS_ASSERT_EQUALS(pipe(fds), 0);
+    line_stream_source source;
+    source.attach(fds[0], true);
+    std::string line;
+    // an idle producer times out without ending the stream
+    timer ti;
+    ti.start();
+    TS_ASSERT(!source.read_line(line, 0.05));
+    TS_ASSERT_LESS_THAN_EQUALS(0.04, ti.current_time());
+    TS_ASSERT(!source.eof());
+    // a partial line is held back until it is complete
+    produce(fds[1], "5 6", 100, false);
+    TS_ASSERT(!source.read_line(line, 0.01));
+    produce(fds[1], "\n", 100, false);
+    TS_ASSERT(source.read_line(line, 0.01));
+    TS_ASSERT_EQUALS(line, "5 6");
+    close(fds[1]);
+    TS_ASSERT(!source.read_line(line, 1));
+    TS_ASSERT(source.eof());
+  }
+
+  void test_tcp() {
+    std::pair<size_t, int> port = get_free_tcp_port();
+    TS_ASSERT_EQUALS(listen(port.second, 1), 0);
+    const std::string data = numbered_lines(500);
+    thread producer;
+    producer.launch(boost::bind(serve, port.second, data));
+    std::stringstream spec;
+    spec << "tcp://127.0.0.1:" << port.first;
+    line_stream_source source;
+    TS_ASSERT(source.open(spec.str()));
+    check_numbered_lines(source, 500);
+    producer.join();
+    close(port.second);
+  }
+
+  void test_missing_source() {
+    line_stream_source source;
+    TS_ASSERT(!source.open("/nonexistent/stream/path"));
+    TS_ASSERT(!source.is_open());
+    TS_ASSERT(!source.open("tcp://nohostport"));
+  }
+};
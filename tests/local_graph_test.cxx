@@ -131,7 +131,184 @@ public:
     std::cout << "\n+ Pass test: grid dynamic graph test. :) \n";
   }
 
-private: 
+  /**
+   * The raw CSR/CSC arrays must describe the same edges as the edge
+   * iterators.
+   */
+  void test_raw_adjacency() {
+    typedef graphlab::local_graph<vertex_data, edge_data> graph_type;
+    typedef graphlab::lvid_type lvid_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    graph_type g;
+    const size_t nverts = 100;
+    g.resize(nverts);
+    for (size_t i = 0; i < nverts; ++i) g.vertex_data(i) = vertex_data(i);
+    for (size_t i = 0; i < nverts; ++i) {
+      for (size_t j = 1; j <= i % 7; ++j) {
+        const size_t target = (i * 13 + j) % nverts;
+        if (target != i) g.add_edge(i, target, edge_data(i, target));
+      }
+    }
+    g.finalize();
+    const vertex_data* vdata = g.vertex_data_array();
+    const edge_data* edata = g.edge_data_array();
+    const lvid_type* targets = g.csr_targets();
+    const std::pair<lvid_type, edge_id_type>* sources = g.csc_sources();
+    size_t total_out = 0, total_in = 0;
+    for (lvid_type v = 0; v < nverts; ++v) {
+      TS_ASSERT_EQUALS(vdata[v].value, v);
+      std::pair<edge_id_type, edge_id_type> out = g.out_edge_range(v);
+      TS_ASSERT_EQUALS(out.second - out.first, g.num_out_edges(v));
+      for (edge_id_type i = out.first; i < out.second; ++i) {
+        TS_ASSERT_EQUALS(edata[i].from, (int)v);
+        TS_ASSERT_EQUALS(edata[i].to, (int)targets[i]);
+      }
+      std::pair<edge_id_type, edge_id_type> in = g.in_edge_range(v);
+      TS_ASSERT_EQUALS(in.second - in.first, g.num_in_edges(v));
+      for (edge_id_type i = in.first; i < in.second; ++i) {
+        TS_ASSERT_EQUALS(edata[sources[i].second].from, (int)sources[i].first);
+        TS_ASSERT_EQUALS(edata[sources[i].second].to, (int)v);
+      }
+      total_out += out.second - out.first;
+      total_in += in.second - in.first;
+    }
+    TS_ASSERT_EQUALS(total_out, g.num_edges());
+    TS_ASSERT_EQUALS(total_in, g.num_edges());
+  }
+
+  /**
+   * The adjacency pairs of the dynamic local graph must describe the
+   * same edges as the edge iterators, also after edges were inserted
+   * into existing blocks.
+   */
+  void test_dynamic_adjacency() {
+    typedef graphlab::dynamic_local_graph<vertex_data, edge_data> graph_type;
+    typedef graphlab::lvid_type lvid_type;
+    typedef graph_type::adjacency_iterator adjacency_iterator;
+    graph_type g;
+    const size_t nverts = 100;
+    g.resize(nverts);
+    for (size_t round = 0; round < 2; ++round) {
+      for (size_t i = 0; i < nverts; ++i) {
+        for (size_t j = 1; j <= (i + round) % 7; ++j) {
+          const size_t target = (i * (13 + round) + j) % nverts;
+          if (target != i) g.add_edge(i, target, edge_data(i, target));
+        }
+      }
+      g.finalize();
+    }
+    const graph_type& cg = g;
+    const edge_data* edata = cg.edge_data_array();
+    size_t total_out = 0, total_in = 0;
+    for (lvid_type v = 0; v < nverts; ++v) {
+      std::pair<adjacency_iterator, adjacency_iterator> out = cg.out_adjacency(v);
+      size_t nout = 0;
+      for (adjacency_iterator i = out.first; i != out.second; ++i, ++nout) {
+        TS_ASSERT_EQUALS(edata[i->second].from, (int)v);
+        TS_ASSERT_EQUALS(edata[i->second].to, (int)i->first);
+      }
+      TS_ASSERT_EQUALS(nout, g.num_out_edges(v));
+      std::pair<adjacency_iterator, adjacency_iterator> in = cg.in_adjacency(v);
+      size_t nin = 0;
+      for (adjacency_iterator i = in.first; i != in.second; ++i, ++nin) {
+        TS_ASSERT_EQUALS(edata[i->second].from, (int)i->first);
+        TS_ASSERT_EQUALS(edata[i->second].to, (int)v);
+      }
+      TS_ASSERT_EQUALS(nin, g.num_in_edges(v));
+      total_out += nout;
+      total_in += nin;
+    }
+    TS_ASSERT_EQUALS(total_out, g.num_edges());
+    TS_ASSERT_EQUALS(total_in, g.num_edges());
+  }
+
+  void test_share_structure() {
+    typedef graphlab::local_graph<vertex_data, edge_data> graph_type;
+    typedef graphlab::local_graph<float, double> view_type;
+    typedef graphlab::lvid_type lvid_type;
+    graph_type g;
+    const size_t nverts = 50;
+    g.resize(nverts);
+    for (size_t i = 0; i < nverts; ++i) {
+      g.add_edge(i, (i + 1) % nverts, edge_data(i, (i + 1) % nverts));
+      g.add_edge(i, (i + 7) % nverts, edge_data(i, (i + 7) % nverts));
+    }
+    g.finalize();
+    view_type view;
+    view.share_structure(g);
+    TS_ASSERT_EQUALS(view.num_vertices(), g.num_vertices());
+    TS_ASSERT_EQUALS(view.num_edges(), g.num_edges());
+    // the indices are shared, not copied
+    TS_ASSERT_EQUALS((const void*)view.csr_targets(),
+                     (const void*)g.csr_targets());
+    for (lvid_type v = 0; v < nverts; ++v) {
+      TS_ASSERT_EQUALS(view.out_edge_range(v), g.out_edge_range(v));
+      TS_ASSERT_EQUALS(view.in_edge_range(v), g.in_edge_range(v));
+      TS_ASSERT_EQUALS(view.vertex_data(v), 0.0f);
+    }
+    // the data are independent
+    for (size_t i = 0; i < view.num_edges(); ++i) view.edge_data(i) = i;
+    for (lvid_type v = 0; v < nverts; ++v) {
+      std::pair<size_t, size_t> out = g.out_edge_range(v);
+      for (size_t i = out.first; i < out.second; ++i) {
+        TS_ASSERT_EQUALS(g.edge_data_array()[i].from, (int)v);
+      }
+    }
+    // clearing the original leaves the view intact
+    g.clear();
+    TS_ASSERT_EQUALS(view.num_edges(), 2 * nverts);
+    TS_ASSERT_EQUALS(view.num_out_edges(3), 2);
+    TS_ASSERT_EQUALS(view.num_in_edges(3), 2);
+  }
+
+  void test_dynamic_share_structure() {
+    typedef graphlab::dynamic_local_graph<vertex_data, edge_data> graph_type;
+    typedef graphlab::dynamic_local_graph<float, double> view_type;
+    typedef graphlab::lvid_type lvid_type;
+    graph_type g;
+    const size_t nverts = 50;
+    g.resize(nverts);
+    for (size_t i = 0; i < nverts; ++i) {
+      g.add_edge(i, (i + 1) % nverts, edge_data(i, (i + 1) % nverts));
+      g.add_edge(i, (i + 7) % nverts, edge_data(i, (i + 7) % nverts));
+    }
+    g.finalize();
+    view_type view;
+    view.share_structure(g);
+    TS_ASSERT_EQUALS(view.num_vertices(), g.num_vertices());
+    TS_ASSERT_EQUALS(view.num_edges(), g.num_edges());
+    const view_type& cview = view;
+    const graph_type& cg = g;
+    for (lvid_type v = 0; v < nverts; ++v) {
+      // the storage is shared, not copied
+      TS_ASSERT(cview.out_adjacency(v) == cg.out_adjacency(v));
+      TS_ASSERT(cview.in_adjacency(v) == cg.in_adjacency(v));
+      TS_ASSERT_EQUALS(view.vertex_data(v), 0.0f);
+    }
+    // growing the view copies the structure first
+    view.add_edge(3, 20, 1.0);
+    view.finalize();
+    TS_ASSERT_EQUALS(view.num_out_edges(3), 3);
+    TS_ASSERT_EQUALS(g.num_out_edges(3), 2);
+    TS_ASSERT_EQUALS(g.num_in_edges(20), 2);
+    for (lvid_type v = 0; v < nverts; ++v) {
+      std::pair<graph_type::adjacency_iterator,
+                graph_type::adjacency_iterator> out = cg.out_adjacency(v);
+      for (graph_type::adjacency_iterator i = out.first; i != out.second; ++i) {
+        TS_ASSERT_EQUALS(g.edge_data(i->second).from, (int)v);
+        TS_ASSERT_EQUALS(g.edge_data(i->second).to, (int)i->first);
+      }
+    }
+    // clearing the original leaves a view which shares it intact
+    view_type view2;
+    view2.share_structure(g);
+    g.clear();
+    TS_ASSERT_EQUALS(view2.num_edges(), 2 * nverts);
+    TS_ASSERT_EQUALS(view2.num_out_edges(3), 2);
+    TS_ASSERT_EQUALS(view2.num_in_edges(3), 2);
+  }
+
+private:
   template<typename Graph>
   void test_add_vertex_impl(Graph& g, size_t nverts) {
     g.clear();
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/parallel/lock_table.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+
+const size_t NUM_ELEMENTS = 1000;
+const size_t NUM_THREADS = 8;
+const size_t NUM_ITERATIONS = 100000;
+
+// each thread increments the counters of (i, i+1) and of i
+void increment_exec(lock_table* locks, std::vector<size_t>* counters,
+                    size_t threadid) {
+  for (size_t i = 0; i < NUM_ITERATIONS; ++i) {
+    const size_t a = (i * 7 + threadid) % NUM_ELEMENTS;
+    const size_t b = (a + 1) % NUM_ELEMENTS;
+    locks->lock_pair(a, b);
+    ++(*counters)[a];
+    ++(*counters)[b];
+    locks->unlock_pair(a, b);
+    locks->lock(a);
+    ++(*counters)[a];
+    locks->unlock(a);
+  }
+}
+
+size_t run_increments(lock_table& locks) {
+  std::vector<size_t> counters(NUM_ELEMENTS, 0);
+  thread_group g;
+  for (size_t i = 0; i < NUM_THREADS; ++i) {
+    g.launch(boost::bind(increment_exec, &locks, &counters, i));
+  }
+  g.join();
+  size_t total = 0;
+  for (size_t i = 0; i < counters.size(); ++i) total += counters[i];
+  return total;
+}
+
+class LockTableTestSuite: public CxxTest::TestSuite {
+ public:
+  void test_vertex_locks() {
+    lock_table locks;
+    locks.resize(NUM_ELEMENTS, lock_table::VERTEX_LOCKS);
+    TS_ASSERT_EQUALS(locks.size(), NUM_ELEMENTS);
+    TS_ASSERT_EQUALS(run_increments(locks), 3 * NUM_THREADS * NUM_ITERATIONS);
+  }
+
+  void test_striped_locks() {
+    lock_table locks;
+    // few stripes so that pairs frequently share a lock
+    locks.resize(NUM_ELEMENTS, lock_table::STRIPED_LOCKS, 3);
+    TS_ASSERT_EQUALS(locks.memory_usage(), 4 * 64);
+    TS_ASSERT_EQUALS(run_increments(locks), 3 * NUM_THREADS * NUM_ITERATIONS);
+    // the stripes are capped at the number of elements, which is then
+    // rounded up to a power of two: 10 elements get 16 stripes
+    locks.resize(10, lock_table::STRIPED_LOCKS);
+    TS_ASSERT_EQUALS(locks.memory_usage(), 16 * 64);
+  }
+
+  void test_bit_locks() {
+    lock_table locks;
+    locks.resize(NUM_ELEMENTS, lock_table::BIT_LOCKS);
+    TS_ASSERT_LESS_THAN_EQUALS(locks.memory_usage(), NUM_ELEMENTS / 8 + 8);
+    TS_ASSERT_EQUALS(run_increments(locks), 3 * NUM_THREADS * NUM_ITERATIONS);
+    TS_ASSERT(locks.try_lock(5));
+    TS_ASSERT(!locks.try_lock(5));
+    TS_ASSERT(locks.try_lock(6));
+    locks.unlock(5);
+    locks.unlock(6);
+  }
+
+  void test_no_locks() {
+    lock_table locks;
+    locks.resize(NUM_ELEMENTS, lock_table::NO_LOCKS);
+    TS_ASSERT_EQUALS(locks.memory_usage(), 0);
+    locks.lock_pair(3, 3);
+    TS_ASSERT(locks.try_lock(3));
+    locks.unlock_pair(3, 3);
+  }
+
+  void test_parse_mode() {
+    lock_table::lock_mode mode;
+    TS_ASSERT(lock_table::parse_mode("bit", mode));
+    TS_ASSERT_EQUALS(mode, lock_table::BIT_LOCKS);
+    TS_ASSERT(lock_table::parse_mode(
+        lock_table::mode_name(lock_table::STRIPED_LOCKS), mode));
+    TS_ASSERT_EQUALS(mode, lock_table::STRIPED_LOCKS);
+    TS_ASSERT(!lock_table::parse_mode("fast", mode));
+  }
+};
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/util/paged_vector.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+
+const size_t NUM_ELEMENTS = 100000;
+const size_t NUM_THREADS = 8;
+
+// every thread writes its id into a disjoint set of elements
+void write_exec(paged_vector<size_t>* vec, size_t threadid) {
+  for (size_t i = threadid; i < NUM_ELEMENTS; i += NUM_THREADS) {
+    (*vec)[i] = threadid + 1;
+  }
+}
+
+class PagedVectorTestSuite: public CxxTest::TestSuite {
+ public:
+  void test_dense() {
+    paged_vector<size_t> vec;
+    vec.resize(1000);
+    TS_ASSERT(!vec.is_lazy());
+    TS_ASSERT_EQUALS(vec.size(), 1000);
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), 1);
+    for (size_t i = 0; i < vec.size(); ++i) TS_ASSERT_EQUALS(vec[i], 0);
+    vec[999] = 5;
+    TS_ASSERT_EQUALS(vec[999], 5);
+  }
+
+  void test_lazy() {
+    paged_vector<size_t> vec;
+    vec.resize(NUM_ELEMENTS, 100);
+    TS_ASSERT(vec.is_lazy());
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), 0);
+    // pages are rounded up to 128 elements
+    vec[0] = 1;
+    vec[127] = 2;
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), 1);
+    vec[128] = 3;
+    vec[NUM_ELEMENTS - 1] = 4;
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), 3);
+    TS_ASSERT_LESS_THAN(vec.memory_usage(), NUM_ELEMENTS * sizeof(size_t) / 10);
+    const paged_vector<size_t>& cvec = vec;
+    TS_ASSERT_EQUALS(cvec[127], 2);
+    TS_ASSERT_EQUALS(cvec[129], 0);
+    vec.clear();
+    TS_ASSERT(vec.empty());
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), 0);
+  }
+
+  void test_concurrent_allocation() {
+    paged_vector<size_t> vec;
+    vec.resize(NUM_ELEMENTS, 64);
+    thread_group g;
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+      g.launch(boost::bind(write_exec, &vec, i));
+    }
+    g.join();
+    TS_ASSERT_EQUALS(vec.num_allocated_pages(), (NUM_ELEMENTS + 63) / 64);
+    for (size_t i = 0; i < NUM_ELEMENTS; ++i) {
+      TS_ASSERT_EQUALS(vec[i], i % NUM_THREADS + 1);
+    }
+  }
+};
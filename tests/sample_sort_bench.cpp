@@ -0,0 +1,106 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/*
+ * Benchmarks the distributed sample_sort.
+ *
+ * Every machine generates n random 64 bit keys. With --distinct the
+ * keys are drawn from only that many values, which stresses the
+ * splitting of long runs of equal keys. The keys are sorted once with
+ * a value of the same size and once bare, and the throughput of each
+ * sort is reported in GB of input per second per machine together
+ * with the ratio of the largest output range to the mean.
+ */
+#include <vector>
+#include <numeric>
+#include <iostream>
+#include <graphlab.hpp>
+#include <graphlab/rpc/sample_sort.hpp>
+#include <graphlab/util/counter_rng.hpp>
+
+template <typename T>
+double report(graphlab::distributed_control& dc, const char* name,
+              size_t nbytes, double elapsed, const std::vector<T>& result) {
+  std::vector<size_t> sizes(dc.numprocs());
+  sizes[dc.procid()] = result.size();
+  dc.all_gather(sizes);
+  const size_t total = std::accumulate(sizes.begin(), sizes.end(), size_t(0));
+  const size_t largest = *std::max_element(sizes.begin(), sizes.end());
+  const double imbalance = total == 0 ? 1.0 :
+    double(largest) * dc.numprocs() / total;
+  dc.cout() << name << ": " << elapsed << "s, "
+            << nbytes / elapsed / 1e9 << " GB/s per machine, "
+            << "max/mean output " << imbalance << std::endl;
+  return imbalance;
+}
+
+int main(int argc, char** argv) {
+  global_logger().set_log_level(LOG_INFO);
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+
+  size_t n = 10000000;
+  size_t distinct = 0;
+  size_t oversampling = 16;
+  graphlab::command_line_options clopts("Benchmark the sample sort.");
+  clopts.attach_option("n", n, "Number of keys on each machine");
+  clopts.attach_option("distinct", distinct,
+                       "Number of distinct keys. 0 for unrestricted keys");
+  clopts.attach_option("oversampling", oversampling,
+                       "Splitter samples per machine per machine");
+  if(!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint64_t> keys(n);
+  graphlab::random::counter_rng rng(1, dc.procid());
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = distinct > 0 ? rng.uniform<uint64_t>(0, distinct - 1)
+                           : rng.next_u64();
+  }
+
+  {
+    graphlab::sample_sort<uint64_t, uint64_t> sorter(dc, oversampling);
+    graphlab::timer ti;
+    sorter.sort(keys.begin(), keys.end(), keys.begin(), keys.end());
+    report(dc, "key-value", n * 2 * sizeof(uint64_t), ti.current_time(),
+           sorter.result());
+    const std::vector<std::pair<uint64_t, uint64_t> >& result = sorter.result();
+    for (size_t i = 1; i < result.size(); ++i) {
+      ASSERT_LE(result[i - 1].first, result[i].first);
+    }
+  }
+  {
+    graphlab::sample_sort<uint64_t, graphlab::empty> sorter(dc, oversampling);
+    graphlab::timer ti;
+    sorter.sort(keys.begin(), keys.end());
+    report(dc, "key only", n * sizeof(uint64_t), ti.current_time(),
+           sorter.result());
+    const std::vector<uint64_t>& result = sorter.result();
+    for (size_t i = 1; i < result.size(); ++i) {
+      ASSERT_LE(result[i - 1], result[i]);
+    }
+  }
+  graphlab::mpi_tools::finalize();
+}
@@ -0,0 +1,119 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <set>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/util/small_gather_set.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+using namespace graphlab;
+
+#include <graphlab/macros_def.hpp>
+class test_small_gather_set : public CxxTest::TestSuite {
+public:
+  typedef small_gather_set<4, size_t> set_type;
+
+  template<typename Set>
+  void check_equal(Set& set, const std::set<size_t>& truth) {
+    set.normalize();
+    TS_ASSERT_EQUALS(set.size(), truth.size());
+    TS_ASSERT(std::equal(truth.begin(), truth.end(), set.begin()));
+    foreach(size_t v, truth) TS_ASSERT(set.contains(v));
+  }
+
+  void test_inline_union() {
+    set_type set;
+    set += set_type(3);
+    set += set_type(1);
+    set += set_type(3);
+    set.insert(2);
+    TS_ASSERT(set.is_inline());
+    std::set<size_t> truth;
+    truth.insert(1); truth.insert(2); truth.insert(3);
+    check_equal(set, truth);
+    TS_ASSERT(!set.contains(4));
+  }
+
+  void test_spill() {
+    set_type set;
+    std::set<size_t> truth;
+    // accumulate in decreasing order with duplicates, as a gather would
+    for (size_t i = 0; i < 100; ++i) {
+      set += set_type(1000 - (i % 37) * 7);
+      truth.insert(1000 - (i % 37) * 7);
+    }
+    TS_ASSERT(!set.is_inline());
+    TS_ASSERT(!set.is_normalized());
+    check_equal(set, truth);
+    // union of two spilled sets
+    set_type other;
+    for (size_t i = 0; i < 20; ++i) {
+      other.insert(i);
+      truth.insert(i);
+    }
+    set += other;
+    check_equal(set, truth);
+    set.clear();
+    TS_ASSERT(set.empty() && set.is_inline());
+  }
+
+  void test_intersection() {
+    set_type a, b;
+    for (size_t i = 0; i < 200; i += 2) a.insert(i);
+    for (size_t i = 0; i < 200; i += 3) b.insert(i);
+    a.normalize(); b.normalize();
+    TS_ASSERT_EQUALS(intersection_size(a, b), 34);
+    set_type c(6);
+    c.insert(7);
+    TS_ASSERT_EQUALS(intersection_size(c, a), 1);
+    TS_ASSERT_EQUALS(intersection_size(a, c), 1);
+    TS_ASSERT_EQUALS(intersection_size(c, set_type()), 0);
+  }
+
+  void test_serialize() {
+    set_type small, large;
+    small.insert(5); small.insert(2);
+    for (size_t i = 50; i > 0; --i) large.insert(i);
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << small << large;
+    strm.flush();
+    iarchive iarc(strm);
+    set_type small2, large2;
+    iarc >> small2 >> large2;
+    TS_ASSERT(small2.is_inline());
+    std::set<size_t> truth;
+    truth.insert(2); truth.insert(5);
+    check_equal(small2, truth);
+    truth.clear();
+    for (size_t i = 50; i > 0; --i) truth.insert(i);
+    check_equal(large2, truth);
+  }
+};
+
+#include <graphlab/macros_undef.hpp>
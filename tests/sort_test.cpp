@@ -35,5 +35,30 @@ int main(int argc, char** argv) {
     }
     dc.cout() << std::endl;
   }
+
+  // key only sort of heavily duplicated signed keys. Runs of equal
+  // keys must still be split evenly between the machines.
+  std::vector<int> dup_keys;
+  for (size_t i = 0;i < 1000000; ++i) dup_keys.push_back(int(rand() % 5) - 2);
+  sample_sort<int, empty> key_sorter(dc);
+  key_sorter.sort(dup_keys.begin(), dup_keys.end());
+  std::vector<std::vector<int> > key_result(dc.numprocs());
+  std::swap(key_result[dc.procid()], key_sorter.result());
+  dc.gather(key_result, 0);
+  if (dc.procid() == 0) {
+    int last = -2;
+    size_t total = 0;
+    for (size_t i = 0;i < key_result.size(); ++i) {
+      dc.cout() << key_result[i].size() << ",";
+      ASSERT_LE(key_result[i].size(), 1000000 * 5 / 4);
+      total += key_result[i].size();
+      for (size_t j = 0; j < key_result[i].size(); ++j) {
+        ASSERT_GE(key_result[i][j], last);
+        last = key_result[i][j];
+      }
+    }
+    ASSERT_EQ(total, 1000000 * dc.numprocs());
+    dc.cout() << std::endl;
+  }
   mpi_tools::finalize();
 }
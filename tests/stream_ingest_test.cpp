@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <set>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+#include <boost/bind.hpp>
+
+#include <graphlab.hpp>
+#include <graphlab/util/union_find.hpp>
+
+/*
+ * Streams the edges of a random graph through a pipe and maintains its
+ * connected components incrementally. The label of a vertex is one
+ * more than the smallest vertex id in its component, so that the
+ * default constructed data of a vertex created by the stream means
+ * "not labeled yet". The engine caches gathers, which the deltas keep
+ * up to date within a run, so the result is only right if the stream
+ * drops the caches that miss the new edges.
+ */
+typedef graphlab::distributed_graph<graphlab::vertex_id_type,
+                                    graphlab::empty> graph_type;
+
+const size_t NVERTS = 2000;
+const size_t NEDGES = 1500;
+
+graphlab::vertex_id_type label_of(const graph_type::vertex_type& vertex) {
+  return vertex.data() == 0 ? vertex.id() + 1 : vertex.data();
+}
+
+// The gather sum is the smallest label of the neighbors
+struct min_id : public graphlab::IS_POD_TYPE {
+  graphlab::vertex_id_type value;
+  min_id(graphlab::vertex_id_type value = -1) : value(value) { }
+  min_id& operator+=(const min_id& other) {
+    value = std::min(value, other.value);
+    return *this;
+  }
+};
+
+class min_label :
+  public graphlab::ivertex_program<graph_type, min_id>,
+  public graphlab::IS_POD_TYPE {
+  bool changed;
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type
+  gather(icontext_type& context, const vertex_type& vertex,
+         edge_type& edge) const {
+    return label_of(edge.source().id() == vertex.id() ?
+                    edge.target() : edge.source());
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    const graphlab::vertex_id_type label =
+        std::min(label_of(vertex), total.value);
+    changed = (label != vertex.data());
+    vertex.data() = label;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = edge.source().id() == vertex.id() ?
+        edge.target() : edge.source();
+    context.post_delta(other, min_id(vertex.data()));
+    if (label_of(other) > vertex.data()) context.signal(other);
+  }
+}; // end of min_label
+
+
+std::vector<std::pair<size_t, size_t> > random_edges() {
+  std::set<std::pair<size_t, size_t> > edges;
+  graphlab::random::generator gen;
+  gen.seed(7);
+  while (edges.size() < NEDGES) {
+    const size_t src = gen.fast_uniform<size_t>(0, NVERTS - 1);
+    const size_t dst = gen.fast_uniform<size_t>(0, NVERTS - 1);
+    if (src != dst) edges.insert(std::make_pair(src, dst));
+  }
+  return std::vector<std::pair<size_t, size_t> >(edges.begin(), edges.end());
+}
+
+// The local stand-in for a producer: writes the edges in bursts, with
+// comments, a self edge and a malformed line mixed in
+void produce(int fd, std::vector<std::pair<size_t, size_t> > edges) {
+  std::stringstream strm;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    if (i % 250 == 0) strm << "# burst " << i / 250 << "\n";
+    strm << edges[i].first << "\t" << edges[i].second << "\n";
+    if (i == 100) strm << "5 5\n" << "not an edge\n";
+    if (i % 250 == 249 || i + 1 == edges.size()) {
+      const std::string data = strm.str();
+      ASSERT_EQ(write(fd, data.c_str(), data.length()),
+                (ssize_t)data.length());
+      strm.str("");
+      usleep(50000);
+    }
+  }
+  close(fd);
+}
+
+std::vector<graphlab::vertex_id_type> expected_labels;
+
+void check_label(graph_type::vertex_type& vertex) {
+  ASSERT_EQ(vertex.data(), expected_labels[vertex.id()]);
+}
+
+int main(int argc, char** argv) {
+  ///! Initialize control plain using mpi
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::dc_init_param rpc_parameters;
+  graphlab::init_param_from_mpi(rpc_parameters);
+  graphlab::distributed_control dc(rpc_parameters);
+
+  graphlab::command_line_options clopts("Test code.");
+  clopts.get_engine_args().set_option("use_cache", true);
+  graph_type graph(dc, clopts);
+  if (!graph.is_dynamic()) {
+    std::cout << "Graph does not support dynamic. "
+              << "Please compile with -DUSE_DYNAMIC_LOCAL_GRAPH" << std::endl;
+    graphlab::mpi_tools::finalize();
+    return 0;
+  }
+  graph.finalize();
+
+  const std::vector<std::pair<size_t, size_t> > edges = random_edges();
+  graphlab::union_find<size_t, size_t> components;
+  components.init(NVERTS);
+  std::vector<graphlab::vertex_id_type> smallest(NVERTS, NVERTS);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    components.merge(edges[i].first, edges[i].second);
+  }
+  for (size_t i = 0; i < NVERTS; ++i) {
+    const size_t root = components.find(i);
+    smallest[root] = std::min<graphlab::vertex_id_type>(smallest[root], i);
+  }
+  expected_labels.resize(NVERTS);
+  for (size_t i = 0; i < NVERTS; ++i) {
+    expected_labels[i] = smallest[components.find(i)] + 1;
+  }
+
+  int fds[2] = {-1, -1};
+  graphlab::thread producer;
+  if (dc.procid() == 0) {
+    ASSERT_EQ(pipe(fds), 0);
+    producer.launch(boost::bind(produce, fds[1], edges));
+  }
+
+  graphlab::stream_ingest<graph_type> stream(dc, graph);
+  stream.set_batch_size(200);
+  stream.set_batch_window(0.02);
+  stream.attach(fds[0], true);
+  graphlab::synchronous_engine<min_label> engine(dc, graph, clopts);
+  const graphlab::stream_ingest_metrics metrics = stream.run(engine);
+  if (dc.procid() == 0) producer.join();
+  dc.cout() << metrics << std::endl;
+
+  ASSERT_EQ(metrics.events, NEDGES);
+  ASSERT_EQ(metrics.rejected, 2);
+  ASSERT_GE(metrics.batches, NEDGES / 250);
+  ASSERT_GE(metrics.max_latency, metrics.mean_latency());
+  ASSERT_EQ(graph.num_edges(), NEDGES);
+  graph.transform_vertices(check_label);
+  dc.cout() << "\n+ Pass test: streaming connected components. :) \n";
+
+  graphlab::mpi_tools::finalize();
+} // end of main
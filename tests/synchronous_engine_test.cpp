@@ -318,6 +318,326 @@ void test_count_aggregators(graphlab::distributed_control& dc,
 
 
 
+class count_iterations :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ++vertex.data();
+    context.signal(vertex);
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of count iterations
+
+void set_zero(graph_type::vertex_type& vertex) { vertex.data() = 0; }
+
+int vertex_value(const graph_type::vertex_type& vertex) {
+  return vertex.data();
+}
+
+void test_snapshots(graphlab::distributed_control& dc,
+                    graphlab::command_line_options& clopts,
+                    graph_type& graph) {
+  std::cout << "Testing snapshots" << std::endl;
+  typedef graphlab::synchronous_engine<count_iterations> engine_type;
+  graphlab::graphlab_options opts = clopts;
+  opts.engine_args.set_option("snapshot_interval", 3);
+  opts.engine_args.set_option("snapshot_full_interval", 2);
+  opts.engine_args.set_option("snapshot_path", "sync_engine_test_snapshot");
+  graph.transform_vertices(set_zero);
+  {
+    // snapshots are taken after iteration 3 (complete), 6 (delta)
+    // and 9 (complete)
+    engine_type engine(dc, graph, opts);
+    engine.signal_all();
+    engine.start();
+    ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value),
+              10 * int(graph.num_vertices()));
+  }
+  graph.transform_vertices(set_zero);
+  {
+    engine_type engine(dc, graph, opts);
+    ASSERT_TRUE(engine.load_snapshot("sync_engine_test_snapshot"));
+    ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value),
+              9 * int(graph.num_vertices()));
+    // the restored messages continue the last iteration
+    engine.start();
+    ASSERT_EQ(engine.iteration(), 10);
+    ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value),
+              10 * int(graph.num_vertices()));
+  }
+  std::cout << "Finished" << std::endl;
+}
+
+class count_to_five :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ++vertex.data();
+    if (context.iteration() < 4) context.signal(vertex);
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of count to five
+
+void test_sparse(graphlab::distributed_control& dc,
+                 graphlab::command_line_options& clopts,
+                 graph_type& graph) {
+  std::cout << "Testing sparse engine state" << std::endl;
+  typedef graphlab::synchronous_engine<count_to_five> engine_type;
+  graphlab::graphlab_options opts = clopts;
+  opts.engine_args.set_option("sparse", true);
+  graph.transform_vertices(set_zero);
+  // the same engine runs several small computations in turn
+  engine_type engine(dc, graph, opts);
+  for (int i = 0; i < 3; ++i) {
+    engine.signal(i * 17);
+    engine.start();
+    ASSERT_EQ(engine.iteration(), 5);
+    ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value), 5 * (i + 1));
+  }
+  std::cout << "Finished" << std::endl;
+}
+
+// Every edge signals the other endpoint several times in the first
+// iteration, so each vertex receives three messages per adjacent edge.
+class count_signals :
+  public graphlab::ivertex_program<graph_type, int, int>,
+  public graphlab::IS_POD_TYPE {
+  int message_value;
+public:
+  void init(icontext_type& context, const vertex_type& vertex,
+            const message_type& msg) {
+    message_value = msg;
+  }
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    if (context.iteration() == 0) return;
+    ASSERT_EQ(message_value,
+              3 * int(vertex.num_in_edges() + vertex.num_out_edges()));
+    vertex.data() = message_value;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return context.iteration() == 0 ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other =
+      edge.source().id() == vertex.id() ? edge.target() : edge.source();
+    for (int i = 0; i < 3; ++i) context.signal(other, 1);
+  }
+}; // end of count signals
+
+void test_message_cache(graphlab::distributed_control& dc,
+                        graphlab::command_line_options& clopts,
+                        graph_type& graph) {
+  std::cout << "Testing a small message cache" << std::endl;
+  typedef graphlab::synchronous_engine<count_signals> engine_type;
+  graphlab::graphlab_options opts = clopts;
+  // a few slots, so the high degree vertices keep evicting each other
+  // and most messages are still cached when the workers finish
+  opts.engine_args.set_option("message_cache_size", 4);
+  graph.transform_vertices(set_zero);
+  engine_type engine(dc, graph, opts);
+  engine.signal_all(0);
+  engine.start();
+  ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value),
+            int(6 * graph.num_edges()));
+  std::cout << "Finished" << std::endl;
+}
+
+class reach :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+  bool reached;
+public:
+  reach() : reached(false) { }
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    reached = vertex.data() == 0;
+    vertex.data() = 1;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return reached ? graphlab::OUT_EDGES : graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    if (edge.target().data() == 0) context.signal(edge.target());
+  }
+}; // end of reach
+
+// Vertex 0 signals the vertices 1 to BURST - 1, which then take a
+// while each, so the activity rises after the switch to the
+// asynchronous engine. Every vertex counts its runs.
+const int BURST = 1000;
+class burst :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    ++vertex.data();
+    if (vertex.id() == 0) {
+      for (int i = 1; i < BURST; ++i) context.signal_vid(i);
+    } else {
+      graphlab::timer::sleep_ms(1);
+    }
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of burst
+
+void test_adaptive(graphlab::distributed_control& dc,
+                   graphlab::command_line_options& clopts,
+                   graph_type& graph) {
+  std::cout << "Testing the adaptive engine" << std::endl;
+  graphlab::graphlab_options opts = clopts;
+  opts.engine_args.set_option("max_iterations", 1000);
+  graph.transform_vertices(set_zero);
+  {
+    graphlab::omni_engine<reach> engine(dc, graph, "synchronous", opts);
+    engine.signal(0);
+    engine.start();
+  }
+  const int expected = graph.map_reduce_vertices<int>(vertex_value);
+  // a single seed is well below adaptive_async_below, so the
+  // execution must switch to the asynchronous engine, which checks
+  // often whether to return to the synchronous engine. The striped
+  // lock table is for the synchronous engine only.
+  opts.engine_args.set_option("adaptive_async_below", 0.5);
+  opts.engine_args.set_option("adaptive_sync_above", 0.9);
+  opts.engine_args.set_option("adaptive_check_interval", 0.01);
+  opts.engine_args.set_option("lock_table", "striped");
+  graph.transform_vertices(set_zero);
+  {
+    graphlab::omni_engine<reach> engine(dc, graph, "adaptive", opts);
+    engine.signal(0);
+    ASSERT_EQ(engine.start(), graphlab::execution_status::TASK_DEPLETION);
+    ASSERT_GT(engine.num_updates(), 0);
+    ASSERT_GE(engine.num_switches(), 1);
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value), expected);
+
+  // the burst is well above adaptive_sync_above, so the execution
+  // must also return to the synchronous engine
+  opts.engine_args.set_option("adaptive_async_below", 0.03);
+  opts.engine_args.set_option("adaptive_sync_above", 0.03);
+  ASSERT_GT(0.03 * graph.num_vertices(), 1);
+  ASSERT_LT(0.03 * graph.num_vertices(), BURST / 2);
+  graph.transform_vertices(set_zero);
+  {
+    graphlab::omni_engine<burst> engine(dc, graph, "adaptive", opts);
+    engine.signal(0);
+    ASSERT_EQ(engine.start(), graphlab::execution_status::TASK_DEPLETION);
+    ASSERT_GE(engine.num_switches(), 2);
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<int>(vertex_value), BURST);
+  std::cout << "Finished" << std::endl;
+}
+
+// Sums a function of the data of both endpoints and the edge over all
+// edges. It is asymmetric so that a swapped source and target show.
+class edge_function_sum :
+  public graphlab::ivertex_program<graph_type, int>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type
+  gather_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  gather_type
+  gather(icontext_type& context, const vertex_type& vertex,
+         edge_type& edge) const {
+    return gather_edge(edge.source().data(), edge.data(),
+                       edge.target().data());
+  }
+  static int gather_edge(const int& source, const int& edge,
+                         const int& target) {
+    return source * edge + 2 * target;
+  }
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex.data() = total;
+  }
+  edge_dir_type
+  scatter_edges(icontext_type& context, const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of edge function sum
+
+// The same computation through the bulk gather of the engine
+class bulk_edge_function_sum :
+  public edge_function_sum,
+  public graphlab::IS_BULK_GATHER { };
+
+void set_small_id(graph_type::vertex_type& vertex) {
+  vertex.data() = vertex.id() % 7 + 1;
+}
+
+void set_edge_weight(graph_type::edge_type& edge) {
+  edge.data() = (edge.source().id() + edge.target().id()) % 5 + 1;
+}
+
+size_t vertex_checksum(const graph_type::vertex_type& vertex) {
+  return (vertex.id() + 1) * size_t(vertex.data());
+}
+
+void test_bulk_gather(graphlab::distributed_control& dc,
+                      graphlab::command_line_options& clopts,
+                      graph_type& graph) {
+  std::cout << "Testing the bulk gather" << std::endl;
+  graph.transform_edges(set_edge_weight);
+  graph.transform_vertices(set_small_id);
+  {
+    graphlab::synchronous_engine<edge_function_sum> engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+  }
+  const size_t expected = graph.map_reduce_vertices<size_t>(vertex_checksum);
+  graph.transform_vertices(set_small_id);
+  {
+    graphlab::synchronous_engine<bulk_edge_function_sum>
+      engine(dc, graph, clopts);
+    engine.signal_all();
+    engine.start();
+  }
+  ASSERT_EQ(graph.map_reduce_vertices<size_t>(vertex_checksum), expected);
+  std::cout << "Finished" << std::endl;
+}
+
+
 int main(int argc, char** argv) {
   ///! Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
@@ -336,6 +656,11 @@ int main(int argc, char** argv) {
   test_all_neighbors(dc, clopts, graph);
   test_messages(dc, clopts, graph);
   test_count_aggregators(dc, clopts, graph);
+  test_snapshots(dc, clopts, graph);
+  test_sparse(dc, clopts, graph);
+  test_message_cache(dc, clopts, graph);
+  test_adaptive(dc, clopts, graph);
+  test_bulk_gather(dc, clopts, graph);
 
   graphlab::mpi_tools::finalize();
 } // end of main
@@ -21,7 +21,10 @@
  */
 
 
+#include <set>
+#include <boost/bind.hpp>
 #include <graphlab/util/lock_free_pool.hpp>
+#include <graphlab/parallel/epoch_reclaimer.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/logger/assertions.hpp>
 
@@ -43,6 +46,42 @@ void exec() {
   }
 }
 
+lock_free_object_pool<std::vector<size_t>, 8> object_pool(16);
+atomic<size_t> live_objects;
+
+// Allocates objects in bursts and frees them in reverse order.
+
+void object_pool_exec(size_t threadid) {
+  std::vector<std::vector<size_t>*> mine;
+  for (size_t round = 0; round < 200; ++round) {
+    for (size_t i = 0; i < 256; ++i) {
+      std::vector<size_t>* v = object_pool.construct();
+      live_objects.inc();
+      v->push_back(threadid);
+      mine.push_back(v);
+    }
+    while(!mine.empty()) {
+      TS_ASSERT_EQUALS(mine.back()->size(), 1);
+      TS_ASSERT_EQUALS(mine.back()->front(), threadid);
+      object_pool.destroy(mine.back());
+      live_objects.dec();
+      mine.pop_back();
+    }
+  }
+}
+
+struct counted {
+  static atomic<size_t> deleted;
+  ~counted() { deleted.inc(); }
+};
+atomic<size_t> counted::deleted;
+
+void retire_exec() {
+  for (size_t i = 0; i < 10000; ++i) {
+    epoch_reclaimer::guard guard;
+    epoch_reclaimer::retire(new counted);
+  }
+}
 
 class LockFreePoolTestSuite: public CxxTest::TestSuite {
  public:  
@@ -71,4 +110,44 @@ class LockFreePoolTestSuite: public CxxTest::TestSuite {
     }
     TS_ASSERT_EQUALS(total, 10000000 * nthreads);
   }
+
+  void test_lock_free_object_pool() {
+    thread_group g;
+    for (size_t i = 0; i < 8; ++i) {
+      g.launch(boost::bind(object_pool_exec, i));
+    }
+    g.join();
+    TS_ASSERT_EQUALS(live_objects.value, 0);
+    // the pool grew past its first chunk but stays near the peak use
+    TS_ASSERT_LESS_THAN(16, object_pool.capacity());
+    TS_ASSERT_LESS_THAN_EQUALS(object_pool.capacity(), 4 * 8 * 256);
+    // every slot is distinct
+    std::set<std::vector<size_t>*> seen;
+    std::vector<std::vector<size_t>*> all;
+    for (size_t i = 0; i < object_pool.capacity(); ++i) {
+      all.push_back(object_pool.construct());
+      TS_ASSERT(seen.insert(all.back()).second);
+    }
+    for (size_t i = 0; i < all.size(); ++i) object_pool.destroy(all[i]);
+  }
+
+  void test_epoch_reclaimer() {
+    const size_t start_epoch = epoch_reclaimer::current_epoch();
+    counted* pinned = new counted;
+    {
+      // an object retired while this thread holds a guard survives
+      // until the guard is released
+      epoch_reclaimer::guard guard;
+      epoch_reclaimer::retire(pinned);
+      for (size_t i = 0; i < 10; ++i) epoch_reclaimer::reclaim();
+      TS_ASSERT_EQUALS(counted::deleted.value, 0);
+    }
+    thread_group g;
+    for (size_t i = 0; i < 4; ++i) g.launch(retire_exec);
+    g.join();
+    for (size_t i = 0; i < 10; ++i) epoch_reclaimer::reclaim();
+    // everything retired, including by the exited threads, is deleted
+    TS_ASSERT_EQUALS(counted::deleted.value, 4 * 10000 + 1);
+    TS_ASSERT_LESS_THAN(start_epoch, epoch_reclaimer::current_epoch());
+  }
 };
@@ -115,6 +115,27 @@ void test_save_load(graphlab::distributed_control& dc) {
   ASSERT_EQ(graph.num_vertices(), graph3.num_vertices());
   ASSERT_EQ(graph.num_edges(), graph3.num_edges());
 
+  // a single file per machine written by all threads
+  graph.save_format("data/plawtest_single_jrl", "graphjrl", true, 0);
+  graphlab::distributed_graph<size_t, size_t> graph4(dc);
+  graph4.load_format("data/plawtest_single_jrl", "graphjrl");
+  graph4.finalize();
+  ASSERT_EQ(graph.num_vertices(), graph4.num_vertices());
+  ASSERT_EQ(graph.num_edges(), graph4.num_edges());
+}
+
+
+void test_pipelined_ingress(graphlab::distributed_control& dc) {
+  graphlab::distributed_graph<size_t, size_t> graph(dc);
+  graph.load_format("data/plawtest_tsv", "tsv");
+  graph.finalize();
+  graphlab::graphlab_options opts;
+  opts.graph_args.set_option("pipelined_ingress", 2);
+  graphlab::distributed_graph<size_t, size_t> graph2(dc, opts);
+  graph2.load_format("data/plawtest_tsv", "tsv");
+  graph2.finalize();
+  ASSERT_EQ(graph.num_vertices(), graph2.num_vertices());
+  ASSERT_EQ(graph.num_edges(), graph2.num_edges());
 }
 
 
@@ -125,5 +146,6 @@ int main(int argc, char** argv) {
   test_tsv(dc);
   test_powerlaw(dc);
   test_save_load(dc);
+  test_pipelined_ingress(dc);
 };
 
@@ -0,0 +1,143 @@
+/*  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <vector>
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include <cxxtest/TestSuite.h>
+
+#include <graphlab/graph/vid2lvid_index.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+
+// a sparse, scattered set of global ids
+static vertex_id_type gvid_of(lvid_type lvid) {
+  return vertex_id_type(lvid) * 7919 + 13;
+}
+
+static void concurrent_inserter(vid2lvid_index* index, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    TS_ASSERT_EQUALS(index->insert_concurrent(gvid_of(i), i), lvid_type(i));
+  }
+}
+
+class vid2lvid_index_test : public CxxTest::TestSuite {
+public:
+  void test_insert_and_grow() {
+    vid2lvid_index index;
+    TS_ASSERT(index.empty());
+    TS_ASSERT(index.find(5) == index.end());
+    const size_t n = 100000;
+    for (size_t i = 0; i < n; ++i) {
+      TS_ASSERT(index.insert(std::make_pair(gvid_of(i), lvid_type(i))).second);
+    }
+    TS_ASSERT(!index.insert(std::make_pair(gvid_of(3), lvid_type(0))).second);
+    TS_ASSERT_EQUALS(index.size(), n);
+    // capacity follows the number of entries, not a power of two; a
+    // growth at most doubles the entries the table has room for
+    TS_ASSERT_LESS_THAN(index.capacity(), n * 3);
+    for (size_t i = 0; i < n; ++i) {
+      TS_ASSERT_EQUALS(index.find(gvid_of(i))->second, lvid_type(i));
+      TS_ASSERT_EQUALS(index.count(gvid_of(i) + 1), 0);
+    }
+    size_t visited = 0;
+    for (vid2lvid_index::const_iterator iter = index.begin();
+         iter != index.end(); ++iter) {
+      TS_ASSERT_EQUALS(iter->first, gvid_of(iter->second));
+      ++visited;
+    }
+    TS_ASSERT_EQUALS(visited, n);
+  }
+
+  void test_sequential_inserts_rehash_rarely() {
+    const size_t n = 100000;
+    vid2lvid_index index;
+    size_t rehashes = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const size_t capacity = index.capacity();
+      index.insert(std::make_pair(gvid_of(i), lvid_type(i)));
+      rehashes += index.capacity() != capacity;
+    }
+    // the table doubles, so about log2(n / 12) rehashes
+    TS_ASSERT_LESS_THAN(rehashes, 20);
+    // so do batches of local vids, as in repeated finalize() calls
+    vid2lvid_index batched;
+    rehashes = 0;
+    for (size_t i = 0; i < n; i += 10) {
+      const size_t capacity = batched.capacity();
+      batched.insert_parallel(i, i + 10, gvid_of);
+      rehashes += batched.capacity() != capacity;
+    }
+    TS_ASSERT_LESS_THAN(rehashes, 20);
+    TS_ASSERT_EQUALS(batched.size(), n);
+  }
+
+  void test_parallel_build() {
+    const size_t n = 200000;
+    vid2lvid_index index;
+    index.insert_parallel(0, n / 2, gvid_of);
+    index.insert_parallel(n / 2, n, gvid_of);
+    TS_ASSERT_EQUALS(index.size(), n);
+    for (size_t i = 0; i < n; ++i) {
+      index.prefetch(gvid_of(i + 1));
+      TS_ASSERT_EQUALS(index.find(gvid_of(i))->second, lvid_type(i));
+    }
+  }
+
+  void test_concurrent_insert() {
+    // every thread inserts the same keys; each key is stored once
+    const size_t n = 50000;
+    vid2lvid_index index;
+    index.reserve(n);
+    thread_group group;
+    for (size_t t = 0; t < 4; ++t) {
+      group.launch(boost::bind(concurrent_inserter, &index, n));
+    }
+    group.join();
+    TS_ASSERT_EQUALS(index.size(), n);
+  }
+
+  void test_serialize() {
+    vid2lvid_index index, loaded;
+    for (size_t i = 0; i < 1000; ++i) {
+      index.insert(std::make_pair(gvid_of(i), lvid_type(i)));
+    }
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << index;
+    strm.flush();
+    iarchive iarc(strm);
+    iarc >> loaded;
+    TS_ASSERT_EQUALS(loaded.size(), index.size());
+    for (size_t i = 0; i < 1000; ++i) {
+      TS_ASSERT_EQUALS(loaded.find(gvid_of(i))->second, lvid_type(i));
+    }
+    loaded.swap(index);
+    loaded.clear();
+    TS_ASSERT(loaded.empty());
+    TS_ASSERT_EQUALS(index.size(), 1000);
+  }
+};
@@ -20,180 +20,490 @@
  *
  */
 
+/**
+ * \file
+ *
+ * Spectral clustering in a single program. The pipeline runs on one
+ * distributed_control and keeps every intermediate result in memory:
+ *
+ *  1. The data points are loaded into a fully connected graph and the
+ *     edge weights are turned into the normalized affinity matrix
+ *     I + D^-1/2 A D^-1/2 (as in graph_laplacian_for_sc).
+ *  2. The Lanczos method, with full reorthogonalization, computes the
+ *     leading eigenvectors of this matrix directly on the graph. Each
+ *     matrix-vector product is one synchronous engine run.
+ *  3. The rows of the eigenvector matrix are normalized and stored as
+ *     the points of the vertices, which are then clustered by k-means.
+ *
+ * With --pre-kmeans-clusters, the points are first grouped by k-means,
+ * the cluster centers are clustered spectrally, and each point takes
+ * the label of its center.
+ */
+
 #include <string>
 #include <vector>
 #include <map>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include <limits>
+#include <time.h>
+
+#include <boost/config/warning_disable.hpp>
+#include <boost/spirit/include/qi.hpp>
+#include <boost/spirit/include/phoenix_core.hpp>
+#include <boost/spirit/include/phoenix_operator.hpp>
+#include <boost/spirit/include/phoenix_stl.hpp>
+
+#include <Eigen/Dense>
 
 #include <graphlab.hpp>
 
-#include <graphlab/util/fs_util.hpp>
-#include <boost/filesystem.hpp>
-
-//remove assigned options from arguments
-std::string get_arg_str_without(int argc, char** argv,
-    std::vector<std::string> remove_opts) {
-  std::stringstream strm;
-  bool skip_next = false;
-  for (int i = 1; i < argc; ++i) {
-    bool skip = false;
-    for (size_t j = 0; j < remove_opts.size(); ++j) {
-      std::string with_equal = remove_opts[j] + "=";
-      if (strncmp(with_equal.c_str(), argv[i], with_equal.size()) == 0) {
-        skip = true;
-      } else if (strncmp(remove_opts[j].c_str(), argv[i], remove_opts[j].size())
-          == 0) {
-        skip = true;
-        skip_next = true;
-      }
-    }
-    if (skip == false && skip_next == false) {
-      strm << argv[i] << " ";
-    } else if (skip == false && skip_next == true) {
-      skip_next = false;
-    }
+//shared parameters
+float gaussian_kernel_scale_parameter = 1.0;
+float threshold_to_discard_small_similarities = 0.0;
+size_t number_of_nearest_neighbors = 30;
+size_t num_orthogonalizations = 2;
+
+//data point
+struct vertex_data {
+  //the input point, replaced by its spectral embedding
+  std::vector<float> x;
+  float D_ii;
+  //the current Lanczos vector and the product with the matrix
+  double v, w;
+  size_t best_cluster;
+  double best_distance;
+  bool changed;
+  vertex_data() : D_ii(0.0), v(0.0), w(0.0), best_cluster(-1),
+      best_distance(std::numeric_limits<double>::infinity()), changed(false) {}
+  explicit vertex_data(const std::vector<float>& x_in) : x(x_in), D_ii(0.0),
+      v(0.0), w(0.0), best_cluster(-1),
+      best_distance(std::numeric_limits<double>::infinity()), changed(false) {}
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << x << D_ii << v << w << best_cluster << best_distance << changed;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> x >> D_ii >> v >> w >> best_cluster >> best_distance >> changed;
+  }
+};
+
+//similarity
+struct edge_data {
+  float A_ij;
+  bool nearest;
+  edge_data() : A_ij(0.0), nearest(false) {}
+  void save(graphlab::oarchive& oarc) const {
+    oarc << A_ij << nearest;
   }
-  return strm.str();
+  void load(graphlab::iarchive& iarc) {
+    iarc >> A_ij >> nearest;
+  }
+};
+
+typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
+
+
+/**************************************************************************/
+/*                                                                        */
+/*                         data loading                                   */
+/*                                                                        */
+/**************************************************************************/
+
+bool parse_point(const std::string& line, size_t& id, vertex_data& vtx) {
+  namespace qi = boost::spirit::qi;
+  namespace ascii = boost::spirit::ascii;
+  namespace phoenix = boost::phoenix;
+  return qi::phrase_parse
+    (line.begin(), line.end(),
+     //  Begin grammar
+     (
+      qi::ulong_[phoenix::ref(id) = qi::_1] >> -qi::char_(",") >>
+      (qi::float_[phoenix::push_back(phoenix::ref(vtx.x), qi::_1)] % -qi::char_(",") )
+      )
+     ,
+     //  End grammar
+     ascii::space);
 }
 
-bool call_graph_laplacian_construction(const std::string& mpi_args,
-    const std::string& filename, const float sigma, const float epsilon,
-    const size_t num_nearests, const std::string& args) {
-  std::stringstream strm;
-  if (mpi_args.length() > 0)
-    strm << "mpiexec " << mpi_args << " ";
-  strm << "./graph_laplacian_for_sc ";
-  strm << " --data=" << filename;
-  strm << " --sigma=" << sigma;
-  strm << " --similarity-thres=" << epsilon;
-  strm << " --t-nearest=" << num_nearests;
-  strm << " " << args;
-  std::cout << "CALLING >" << strm.str() << std::endl;
-  int sys_ret = system(strm.str().c_str());
-  if (sys_ret != 0) {
-    std::cout << "system call fails" << std::endl;
-    return false;
+//[vertex_id] [element1] [element2] [element3] ...
+//connects the point to all points with a smaller id
+bool line_parser(graph_type& graph, const std::string& filename,
+    const std::string& line) {
+  if (line.empty()) return true;
+  size_t id = 0;
+  vertex_data vtx;
+  if (!parse_point(line, id, vtx)) return false;
+  graph.add_vertex(id, vtx);
+  for(size_t i=1;i<id;++i){
+    graph.add_edge(i, id);
   }
+  return true;
+}
 
+//loads the points only, used by k-means preprocessing
+bool point_parser(graph_type& graph, const std::string& filename,
+    const std::string& line) {
+  if (line.empty()) return true;
+  size_t id = 0;
+  vertex_data vtx;
+  if (!parse_point(line, id, vtx)) return false;
+  graph.add_vertex(id, vtx);
   return true;
 }
 
-void make_initial_vector_file(const std::string& filename, const size_t num_data){
-  std::ofstream ofs((filename + ".init").c_str());
-  for(size_t i=0;i<num_data;++i){
-    ofs << 0.1*((i+1)%10)/10.0 << "\n";
+
+/**************************************************************************/
+/*                                                                        */
+/*                     graph Laplacian construction                       */
+/*                                                                        */
+/**************************************************************************/
+
+// helper function to compute similarity between points
+float similarity(const std::vector<float>& v1, const std::vector<float>& v2) {
+  float ret = 0.0;
+  for (size_t i = 0; i < v1.size(); ++i) {
+    float tmp = v1[i] - v2[i];
+    ret += tmp * tmp;
   }
-  ofs.close();
+  return exp(-ret / gaussian_kernel_scale_parameter);
 }
 
-bool call_svd(const std::string& mpi_args, const std::string& filename,
-    const std::string& svd_dir, const size_t num_clusters, const size_t rank,
-    const size_t num_data, const std::string& args) {
-  make_initial_vector_file(filename, num_data+1);
-  std::stringstream strm;
-  if (mpi_args.length() > 0)
-    strm << "mpiexec " << mpi_args << " ";
-  strm << svd_dir << "svd " + filename + ".glap";
-  strm << " --rows=" << num_data+1;
-  strm << " --cols=" << num_data;
-  strm << " --nsv=" << num_clusters;
-  strm << " --nv=" << rank;
-//  strm << " --tol=1e-10";
-//  strm << " --max_iter=20";
-  strm << " --quiet=1";
-  strm << " --save_vectors=1";
-  strm << " --ortho_repeats=3";
-  strm << " --id=1";
-  strm << " --prediction=" << filename << ".";
-  strm << " --initial_vector=" << filename + ".init";
-  strm << " " << args;
-  std::cout << "CALLING >" << strm.str() << std::endl;
-  int sys_ret = system(strm.str().c_str());
-  if (sys_ret != 0) {
-    std::cout << "system call fails" << std::endl;
-    return false;
+//calculate similarities between data points
+void calc_similarities(graph_type::edge_type& edata) {
+  edata.data().A_ij = similarity(edata.source().data().x, edata.target().data().x);
+}
+
+//discard small similarities (Optional)
+void discard_small_similarity(graph_type::edge_type& edata) {
+  if(edata.data().A_ij < threshold_to_discard_small_similarities)
+    edata.data().A_ij = 0.0;
+}
+
+//gather T-nearest neighbor (Optional)
+struct top_t_similarity{
+  std::vector<size_t> ids;
+  std::vector<float> sims;
+  top_t_similarity(): ids(number_of_nearest_neighbors, std::numeric_limits<size_t>::max()),
+      sims(number_of_nearest_neighbors, -1.0){}
+  top_t_similarity(size_t id, float sim): ids(number_of_nearest_neighbors, std::numeric_limits<size_t>::max()),
+      sims(number_of_nearest_neighbors, -1.0){
+    ids[0] = id;
+    sims[0] = sim;
   }
 
-  return true;
+  top_t_similarity& operator+=(const top_t_similarity& other){
+    std::vector<size_t> new_ids;
+    std::vector<float> new_sims;
+    size_t pos1=0;
+    size_t pos2=0;
+    while(pos1+pos2 < number_of_nearest_neighbors){
+      if(sims[pos1] >= other.sims[pos2]){
+        new_ids.push_back(ids[pos1]);
+        new_sims.push_back(sims[pos1]);
+        pos1++;
+      }else{
+        new_ids.push_back(other.ids[pos2]);
+        new_sims.push_back(other.sims[pos2]);
+        pos2++;
+      }
+    }
+    ids = new_ids;
+    sims = new_sims;
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << ids << sims;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> ids >> sims;
+  }
+};
+
+//get T-nearest neighbor and discard others (Optional)
+class t_nearest: public graphlab::ivertex_program<graph_type,
+  top_t_similarity>, public graphlab::IS_POD_TYPE {
+private:
+  float threshold;
+
+public:
+  t_nearest():threshold(0.0){}
+
+  edge_dir_type gather_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  top_t_similarity gather(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    if(edge.target().id() == vertex.id()){//in edge
+      return top_t_similarity(edge.source().id(), edge.data().A_ij);
+    }else{//out edge
+      return top_t_similarity(edge.target().id(), edge.data().A_ij);
+    }
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+      const gather_type& total) {
+    threshold = total.sims[number_of_nearest_neighbors-1];
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+      return graphlab::ALL_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    if(edge.data().A_ij >= threshold)
+      edge.data().nearest = true;
+  }
+};
+
+//discard similarities which are not among the t-nearest (Optional)
+void make_other_similarities_zero(graph_type::edge_type& edata) {
+  if(edata.data().nearest == false)
+    edata.data().A_ij = 0.0;
 }
 
-bool call_eigen_vector_normalization(const std::string& mpi_args,
-    const std::string& filename, const std::string& graph_analytics_dir,
-    const size_t num_clusters, const size_t rank, const size_t num_data,
-    const std::string& args) {
-  std::stringstream strm;
-  if (mpi_args.length() > 0)
-    strm << "mpiexec " << mpi_args << " ";
-  strm << graph_analytics_dir << "eigen_vector_normalization";
-  strm << " --data=" << filename;
-  strm << " --clusters=" << num_clusters;
-  strm << " --rank=" << rank;
-  strm << " --data-num=" << num_data;
-  strm << " " << args;
-  std::cout << "CALLING >" << strm.str() << std::endl;
-  int sys_ret = system(strm.str().c_str());
-  if (sys_ret != 0) {
-    std::cout << "system call fails" << std::endl;
-    return false;
+//compute sums over rows and then take inverse square root
+class calc_degrees: public graphlab::ivertex_program<graph_type,
+    float>, public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+  float gather(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    return edge.data().A_ij;
   }
 
-  return true;
+  void apply(icontext_type& context, vertex_type& vertex,
+      const gather_type& total) {
+    vertex.data().D_ii = 1.0 / sqrt(total);
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+  }
+};
+
+//multiply D^-1/2
+void mult_D(graph_type::edge_type& edata) {
+  edata.data().A_ij = edata.data().A_ij * edata.source().data().D_ii * edata.target().data().D_ii;
+}
+
+//the input points are not needed once the similarities are computed
+void clear_point(graph_type::vertex_type& vertex) {
+  std::vector<float>().swap(vertex.data().x);
 }
 
-bool call_kmeans(const std::string& mpi_args, const std::string& filename,
-    const std::string& kmeans_dir, const size_t num_clusters,
-    const std::string& args) {
-  //call svd
-  std::stringstream strm;
-  if (mpi_args.length() > 0)
-    strm << "mpiexec " << mpi_args << " ";
-  strm << kmeans_dir << "kmeans ";
-  strm << " --data " << filename << ".compressed";
-  strm << " --clusters " << num_clusters;
-  strm << " --output-data " << filename << ".result";
-  strm << " --id=1";
-  strm << " " << args;
-  std::cout << "CALLING >" << strm.str() << std::endl;
-  int sys_ret = system(strm.str().c_str());
-  if (sys_ret != 0) {
-    std::cout << "system call fails" << std::endl;
-    return false;
+//turns the edge weights into the normalized affinities D^-1/2 A D^-1/2
+void construct_graph_laplacian(graphlab::distributed_control& dc,
+    graph_type& graph, graphlab::command_line_options& clopts) {
+  const size_t data_num = graph.num_vertices();
+  graph.transform_edges(calc_similarities);
+  graph.transform_vertices(clear_point);
+
+  //if t is set, use only t-nearest similarities
+  if(number_of_nearest_neighbors > 0){
+    if(number_of_nearest_neighbors > data_num-1)
+      number_of_nearest_neighbors = data_num-1;
+    dc.cout() << "use only the " << number_of_nearest_neighbors
+        << "-nearest similarities for each datapoint\n";
+    graphlab::omni_engine<t_nearest> engine_nearest(dc, graph, "sync", clopts);
+    engine_nearest.signal_all();
+    engine_nearest.start();
+    graph.transform_edges(make_other_similarities_zero);
   }
-  return true;
+  //if threshold is set, discard similarities less then the threshold
+  if(threshold_to_discard_small_similarities > 0.0){
+    dc.cout() << "discard small similarities less than "
+        << threshold_to_discard_small_similarities << "\n";
+    graph.transform_edges(discard_small_similarity);
+  }
+
+  //sum elements over rows (calculate the degree matrix D)
+  graphlab::omni_engine<calc_degrees> engine(dc, graph, "sync", clopts);
+  engine.signal_all();
+  engine.start();
+  graph.transform_edges(mult_D);
 }
 
 
-bool call_kmeans_as_preprocess(const std::string& mpi_args, const std::string& filename,
-    const std::string& kmeans_dir, const size_t num_clusters,
-    const std::string& args) {
-  //call svd
-  std::stringstream strm;
-  if (mpi_args.length() > 0)
-    strm << "mpiexec " << mpi_args << " ";
-  strm << kmeans_dir << "kmeans ";
-  strm << " --data " << filename;
-  strm << " --clusters " << num_clusters;
-  strm << " --output-data " << filename << ".pre.labels";
-  strm << " --output-clusters " << filename << ".pre.centers";
-  strm << " --id=1";
-  strm << " " << args;
-  std::cout << "CALLING >" << strm.str() << std::endl;
-  int sys_ret = system(strm.str().c_str());
-  if (sys_ret != 0) {
-    std::cout << "system call fails" << std::endl;
-    return false;
+/**************************************************************************/
+/*                                                                        */
+/*                           Lanczos method                               */
+/*                                                                        */
+/**************************************************************************/
+
+//Lanczos vectors of the master vertices, indexed by local vertex id
+std::vector<std::vector<double> > LANCZOS_BASIS;
+//coefficients of the current Lanczos step
+double LANCZOS_ALPHA = 0.0;
+double LANCZOS_BETA = 0.0;
+std::vector<double> LANCZOS_COEFS;
+//the eigenvectors of the tridiagonal matrix used to form the Ritz vectors
+Eigen::MatrixXd RITZ_COEFS;
+
+//multiplies the current Lanczos vector v by I + D^-1/2 A D^-1/2
+class lanczos_multiply: public graphlab::ivertex_program<graph_type,
+    double>, public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
   }
-  return true;
+  double gather(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+    const vertex_type& other =
+        edge.source().id() == vertex.id() ? edge.target() : edge.source();
+    return edge.data().A_ij * other.data().v;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+      const gather_type& total) {
+    vertex.data().w = vertex.data().v + total;
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+      const vertex_type& vertex) const {
+      return graphlab::NO_EDGES;
+  }
+  void scatter(icontext_type& context, const vertex_type& vertex,
+      edge_type& edge) const {
+  }
+};
+
+//sums a vector of dot products over the vertices
+struct vector_sum {
+  std::vector<double> values;
+  vector_sum& operator+=(const vector_sum& other) {
+    if (values.empty()) values = other.values;
+    else for (size_t i = 0; i < other.values.size(); ++i) values[i] += other.values[i];
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << values;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> values;
+  }
+};
+
+void lanczos_init(graph_type::vertex_type& vertex) {
+  vertex.data().w = 0.1*((vertex.id()+1)%10)/10.0 + 1e-3;
 }
 
+double lanczos_w_dot_v(const graph_type::vertex_type& vertex) {
+  return vertex.data().w * vertex.data().v;
+}
+
+double lanczos_w_norm(const graph_type::vertex_type& vertex) {
+  return vertex.data().w * vertex.data().w;
+}
+
+//w -= alpha * v_j + beta * v_{j-1}
+void lanczos_three_term(graph_type::vertex_type& vertex) {
+  const std::vector<double>& basis = LANCZOS_BASIS[vertex.local_id()];
+  vertex.data().w -= LANCZOS_ALPHA * vertex.data().v;
+  if (basis.size() > 1)
+    vertex.data().w -= LANCZOS_BETA * basis[basis.size() - 2];
+}
+
+vector_sum lanczos_w_dot_basis(const graph_type::vertex_type& vertex) {
+  vector_sum ret;
+  ret.values = LANCZOS_BASIS[vertex.local_id()];
+  for (size_t i = 0; i < ret.values.size(); ++i) ret.values[i] *= vertex.data().w;
+  return ret;
+}
+
+//removes the components of w along the previous Lanczos vectors
+void lanczos_reorthogonalize(graph_type::vertex_type& vertex) {
+  const std::vector<double>& basis = LANCZOS_BASIS[vertex.local_id()];
+  for (size_t i = 0; i < basis.size(); ++i)
+    vertex.data().w -= LANCZOS_COEFS[i] * basis[i];
+}
+
+//v_{j+1} = w / beta
+void lanczos_next_vector(graph_type::vertex_type& vertex) {
+  vertex.data().v = vertex.data().w / LANCZOS_BETA;
+  LANCZOS_BASIS[vertex.local_id()].push_back(vertex.data().v);
+}
+
+//forms the normalized row of the Ritz vectors for this vertex
+void lanczos_embedding(graph_type::vertex_type& vertex) {
+  std::vector<double>& basis = LANCZOS_BASIS[vertex.local_id()];
+  std::vector<float>& x = vertex.data().x;
+  x.assign(RITZ_COEFS.cols(), 0.0);
+  float sum = 0.0;
+  for (size_t k = 0; k < x.size(); ++k) {
+    double val = 0.0;
+    for (size_t i = 0; i < basis.size(); ++i) val += basis[i] * RITZ_COEFS(i, k);
+    x[k] = val;
+    sum += x[k] * x[k];
+  }
+  sum = sqrt(sum);
+  if (sum > 0)
+    for (size_t k = 0; k < x.size(); ++k) x[k] /= sum;
+  std::vector<double>().swap(basis);
+}
+
+/**
+ * Computes the leading num_clusters eigenvectors of the affinity matrix
+ * by rank steps of the Lanczos method, and replaces the point of each
+ * vertex by the normalized row of the eigenvector matrix.
+ */
+void spectral_embedding(graphlab::distributed_control& dc, graph_type& graph,
+    size_t num_clusters, size_t rank, graphlab::command_line_options& clopts) {
+  rank = std::min(rank, graph.num_vertices());
+  LANCZOS_BASIS.clear();
+  LANCZOS_BASIS.resize(graph.num_local_vertices());
+  graph.transform_vertices(lanczos_init);
+  LANCZOS_BETA = sqrt(graph.map_reduce_vertices<double>(lanczos_w_norm));
+  graph.transform_vertices(lanczos_next_vector);
+
+  std::vector<double> alpha, beta;
+  graphlab::omni_engine<lanczos_multiply> engine(dc, graph, "sync", clopts);
+  for (size_t j = 0; j < rank; ++j) {
+    engine.signal_all();
+    engine.start();
+    LANCZOS_ALPHA = graph.map_reduce_vertices<double>(lanczos_w_dot_v);
+    alpha.push_back(LANCZOS_ALPHA);
+    graph.transform_vertices(lanczos_three_term);
+    for (size_t r = 0; r < num_orthogonalizations; ++r) {
+      LANCZOS_COEFS = graph.map_reduce_vertices<vector_sum>(lanczos_w_dot_basis).values;
+      graph.transform_vertices(lanczos_reorthogonalize);
+    }
+    LANCZOS_BETA = sqrt(graph.map_reduce_vertices<double>(lanczos_w_norm));
+    if (j + 1 == rank || LANCZOS_BETA < 1e-10) break;
+    beta.push_back(LANCZOS_BETA);
+    graph.transform_vertices(lanczos_next_vector);
+  }
+  dc.cout() << "Lanczos method ran " << alpha.size() << " steps\n";
+
+  //eigenvectors of the tridiagonal matrix with the largest eigenvalues
+  const size_t m = alpha.size();
+  Eigen::MatrixXd T = Eigen::MatrixXd::Zero(m, m);
+  for (size_t i = 0; i < m; ++i) {
+    T(i, i) = alpha[i];
+    if (i + 1 < m) T(i, i + 1) = T(i + 1, i) = beta[i];
+  }
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(T);
+  const size_t k = std::min(num_clusters, m);
+  RITZ_COEFS = solver.eigenvectors().rightCols(k).rowwise().reverse();
+  dc.cout() << "Largest eigenvalues:";
+  for (size_t i = 0; i < k; ++i) dc.cout() << " " << solver.eigenvalues()(m - 1 - i);
+  dc.cout() << "\n";
+  graph.transform_vertices(lanczos_embedding);
+  LANCZOS_BASIS.clear();
+}
 
 //select good value of rank (TODO)
-int get_lanczos_rank(const size_t num_clusters, const size_t num_data) {
+size_t get_lanczos_rank(const size_t num_clusters, const size_t num_data) {
   size_t rank = 1;
   if (num_data < 1000) {
     if (num_clusters + 10 <= num_data)
@@ -210,75 +520,253 @@ int get_lanczos_rank(const size_t num_clusters, const size_t num_data) {
     rank = num_clusters + 300;
   }
   return rank;
-//  return num_clusters+2;
 }
 
-void read_pairs_with_prefix(std::vector<std::vector<size_t> >& ret, const std::string& prefix){
-  std::string directory_name;
-  std::string original_path(prefix);
-  boost::filesystem::path path(prefix);
-  std::string search_prefix;
-  if (boost::filesystem::is_directory(path)) {
-    // if this is a directory
-    // force a "/" at the end of the path
-    // make sure to check that the path is non-empty. (you do not
-    // want to make the empty path "" the root path "/" )
-    directory_name = path.native();
-  }
-  else {
-    directory_name = path.parent_path().native();
-    search_prefix = path.filename().native();
-    directory_name = (directory_name.empty() ? "." : directory_name);
-  }
-  std::vector<std::string> files;
-  graphlab::fs_util::list_files_with_prefix(directory_name, search_prefix, files);
-  if (files.size() == 0) {
-    logstream(LOG_WARNING) << "No files found matching " << original_path << std::endl;
-  }
-  for(size_t i = 0; i < files.size(); ++i) {
-    std::ifstream ifs(files[i].c_str());
-    if (!ifs) {
-      std::cout << "can't read " << files[i] << std::endl;
-      return;
+
+/**************************************************************************/
+/*                                                                        */
+/*                               k-means                                  */
+/*                                                                        */
+/**************************************************************************/
+
+std::vector<std::vector<double> > CENTERS;
+// the current cluster to initialize
+size_t KMEANS_INITIALIZATION = 0;
+
+double sqr_distance(const std::vector<float>& a, const std::vector<double>& b) {
+  double total = 0;
+  for (size_t i = 0;i < a.size(); ++i) {
+    double d = a[i] - b[i];
+    total += d * d;
+  }
+  return total;
+}
+
+/*
+ * Draws a random sample from the data points that is
+ * proportionate to the "best distance" stored in the vertex.
+ */
+struct random_sample_reducer {
+  std::vector<float> vtx;
+  double weight;
+
+  random_sample_reducer():weight(0) { }
+  random_sample_reducer(const std::vector<float>& vtx,
+                        double weight):vtx(vtx),weight(weight) { }
+
+  static random_sample_reducer get_weight(const graph_type::vertex_type& v) {
+    if (v.data().best_cluster == (size_t)(-1)) {
+      return random_sample_reducer(v.data().x, 1);
+    }
+    else {
+      return random_sample_reducer(v.data().x, v.data().best_distance);
     }
-    while( !ifs.eof() ) {
-      std::vector<size_t> pair;
-      size_t id = 0;
-      size_t label = 0;
-      ifs >> id;
-//      ifs.ignore(1);
-      ifs >> label;
-      if(id > 0 && label > 0){
-        pair.push_back(id);
-        pair.push_back(label);
-        ret.push_back(pair);
+  }
+
+  random_sample_reducer& operator+=(const random_sample_reducer& other) {
+    double totalweight = weight + other.weight;
+    if (totalweight <= 0) return *this;
+    double myp = weight / totalweight;
+    if (!graphlab::random::bernoulli(myp)) vtx = other.vtx;
+    weight = totalweight;
+    return *this;
+  }
+
+  void save(graphlab::oarchive &oarc) const {
+    oarc << vtx << weight;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> vtx >> weight;
+  }
+};
+
+void kmeans_reset(graph_type::vertex_type& v) {
+  v.data().best_cluster = -1;
+  v.data().best_distance = std::numeric_limits<double>::infinity();
+}
+
+void kmeans_pp_initialization(graph_type::vertex_type& v) {
+  double d = sqr_distance(v.data().x, CENTERS[KMEANS_INITIALIZATION]);
+  if (v.data().best_distance > d) {
+    v.data().best_distance = d;
+    v.data().best_cluster = KMEANS_INITIALIZATION;
+  }
+}
+
+//assigns the point to the closest non-empty center
+void kmeans_iteration(graph_type::vertex_type& v) {
+  size_t prev_asg = v.data().best_cluster;
+  v.data().best_distance = std::numeric_limits<double>::infinity();
+  for (size_t i = 0;i < CENTERS.size(); ++i) {
+    if (CENTERS[i].empty()) continue;
+    double d = sqr_distance(v.data().x, CENTERS[i]);
+    if (d < v.data().best_distance) {
+      v.data().best_distance = d;
+      v.data().best_cluster = i;
+    }
+  }
+  v.data().changed = (prev_asg != v.data().best_cluster);
+}
+
+//sums the points of each cluster
+struct cluster_center_reducer {
+  std::vector<std::vector<double> > sums;
+  std::vector<size_t> counts;
+  size_t num_changed;
+  double cost;
+
+  cluster_center_reducer(): num_changed(0), cost(0) { }
+
+  static cluster_center_reducer get_center(const graph_type::vertex_type& v) {
+    cluster_center_reducer cc;
+    cc.sums.resize(CENTERS.size());
+    cc.counts.resize(CENTERS.size(), 0);
+    const size_t c = v.data().best_cluster;
+    cc.sums[c].assign(v.data().x.begin(), v.data().x.end());
+    cc.counts[c] = 1;
+    cc.num_changed = v.data().changed;
+    cc.cost = v.data().best_distance;
+    return cc;
+  }
+
+  cluster_center_reducer& operator+=(const cluster_center_reducer& other) {
+    if (sums.empty()) {
+      sums = other.sums;
+      counts = other.counts;
+    } else {
+      for (size_t i = 0;i < other.sums.size(); ++i) {
+        if (counts[i] == 0) sums[i] = other.sums[i];
+        else for (size_t j = 0; j < other.sums[i].size(); ++j) sums[i][j] += other.sums[i][j];
+        counts[i] += other.counts[i];
       }
     }
+    num_changed += other.num_changed;
+    cost += other.cost;
+    return *this;
+  }
+
+  void save(graphlab::oarchive& oarc) const {
+    oarc << sums << counts << num_changed << cost;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> sums >> counts >> num_changed >> cost;
+  }
+};
+
+/**
+ * Clusters the points of the vertices into num_clusters clusters with
+ * k-means++ initialization. The cluster of each vertex is left in
+ * best_cluster, and the centers in CENTERS.
+ */
+void run_kmeans(graphlab::distributed_control& dc, graph_type& graph,
+    size_t num_clusters, size_t max_iteration) {
+  CENTERS.clear();
+  CENTERS.resize(num_clusters);
+  graph.transform_vertices(kmeans_reset);
+  for (KMEANS_INITIALIZATION = 0; KMEANS_INITIALIZATION < num_clusters;
+       ++KMEANS_INITIALIZATION) {
+    random_sample_reducer rs = graph.map_reduce_vertices<random_sample_reducer>
+                                   (random_sample_reducer::get_weight);
+    CENTERS[KMEANS_INITIALIZATION].assign(rs.vtx.begin(), rs.vtx.end());
+    graph.transform_vertices(kmeans_pp_initialization);
+  }
+
+  for (size_t iteration = 0; max_iteration == 0 || iteration < max_iteration;
+       ++iteration) {
+    cluster_center_reducer cc = graph.map_reduce_vertices<cluster_center_reducer>
+                                    (cluster_center_reducer::get_center);
+    if (iteration > 0) {
+      dc.cout() << "Kmeans iteration " << iteration << ": "
+                << "# points with changed assignments = " << cc.num_changed
+                << " total cost: " << cc.cost << std::endl;
+      if (cc.num_changed == 0) break;
+    }
+    for (size_t i = 0;i < num_clusters; ++i) {
+      CENTERS[i].swap(cc.sums[i]);
+      for (size_t j = 0; j < CENTERS[i].size(); ++j) CENTERS[i][j] /= cc.counts[i];
+    }
+    graph.transform_vertices(kmeans_iteration);
   }
 }
 
-int recover_labels(const std::string& prefix){
-  const std::string kmeans_result_prefix = prefix + ".pre.labels";
-  const std::string spectral_result_prefix = prefix + ".pre.centers.result";
-  const std::string outfile = prefix + ".result_1_of_1";
 
-  std::vector<std::vector<size_t> > kmeans_result;
-  read_pairs_with_prefix(kmeans_result, kmeans_result_prefix);
-  std::vector<std::vector<size_t> > spectral_result;
-  read_pairs_with_prefix(spectral_result, spectral_result_prefix);
+/**************************************************************************/
+/*                                                                        */
+/*                    k-means preprocessing and output                    */
+/*                                                                        */
+/**************************************************************************/
+
+//the spectral cluster of each k-means center
+std::vector<size_t> CENTER_LABELS;
+
+//collects the spectral cluster of each center, indexed by center
+struct center_label_reducer {
+  std::vector<size_t> labels;
+
+  static center_label_reducer get_label(const graph_type::vertex_type& v) {
+    center_label_reducer ret;
+    ret.labels.resize(CENTER_LABELS.size(), 0);
+    ret.labels[v.id() - 1] = v.data().best_cluster;
+    return ret;
+  }
+
+  center_label_reducer& operator+=(const center_label_reducer& other) {
+    if (labels.empty()) labels = other.labels;
+    else for (size_t i = 0; i < other.labels.size(); ++i) labels[i] += other.labels[i];
+    return *this;
+  }
 
-  std::map<size_t, size_t> label_map;
-  for(size_t i=0;i<spectral_result.size();++i){
-    label_map.insert(std::make_pair(spectral_result[i][0], spectral_result[i][1]));
+  void save(graphlab::oarchive& oarc) const {
+    oarc << labels;
   }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> labels;
+  }
+};
+
+void assign_center_label(graph_type::vertex_type& v) {
+  v.data().best_cluster = CENTER_LABELS[v.data().best_cluster];
+}
+
+struct cluster_writer {
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t" << v.data().best_cluster + 1 << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+};
+
+/**
+ * Runs the spectral clustering of the graph, which holds the points of
+ * line_parser(), and leaves the cluster of each vertex in best_cluster.
+ */
+void spectral_clustering(graphlab::distributed_control& dc, graph_type& graph,
+    size_t num_clusters, size_t sv, size_t max_iteration,
+    std::vector<std::pair<std::string, time_t> >& times,
+    graphlab::command_line_options& clopts) {
+  time_t start, end;
+  time(&start);
+  construct_graph_laplacian(dc, graph, clopts);
+  time(&end);
+  times.push_back(std::make_pair(std::string("graph laplacian"), end - start));
 
-  std::ofstream ofs(outfile.c_str());
-  for(size_t i=0;i<kmeans_result.size();++i){
-    ofs << kmeans_result[i][0] << "\t";
-    ofs << label_map[kmeans_result[i][1]] << "\n";
+  time(&start);
+  //determine the sv of Lanczos method
+  if(sv == 0){
+    sv = get_lanczos_rank(num_clusters, graph.num_vertices());
+  }else{
+    if(sv < num_clusters)
+      sv = num_clusters;
   }
+  spectral_embedding(dc, graph, num_clusters, sv, clopts);
+  time(&end);
+  times.push_back(std::make_pair(std::string("eigen decomposition"), end - start));
 
-  return 0;
+  time(&start);
+  run_kmeans(dc, graph, num_clusters, max_iteration);
+  time(&end);
+  times.push_back(std::make_pair(std::string("kmeans"), end - start));
 }
 
 int main(int argc, char** argv) {
@@ -288,16 +776,10 @@ int main(int argc, char** argv) {
   time(&start);
 
   std::string datafile;
-  std::string graph_analytics_dir = "../graph_analytics/";
-  std::string svd_dir = "../collaborative_filtering/";
-  std::string kmeans_dir = "./";
-  std::string mpi_args;
   size_t num_clusters = 0;
-  size_t num_nearests = 30;
-  float sigma = 1.0;
-  float epsilon = 0.0;
   size_t pre_kmeans_clusters = 0;
   size_t sv = 0;
+  size_t max_iteration = 0;
   //parse command line
   graphlab::command_line_options clopts(
           "Spectral clustering. The input data file is provided by the "
@@ -311,26 +793,21 @@ int main(int argc, char** argv) {
           "or comma separated numeric vector");
   clopts.attach_option("clusters", num_clusters,
           "The number of clusters to create");
-  clopts.attach_option("sigma", sigma,
+  clopts.attach_option("sigma", gaussian_kernel_scale_parameter,
           "Scale parameter for Gaussian kernel");
-  clopts.attach_option("t-nearest", num_nearests,
+  clopts.attach_option("t-nearest", number_of_nearest_neighbors,
           "Number of nearest neighbors (=t). Will use only the t-nearest similarities "
           "for each datapoint. If set at 0, will use all similarities.");
-  clopts.attach_option("similarity-thres", epsilon,
+  clopts.attach_option("similarity-thres", threshold_to_discard_small_similarities,
           "Threshold to discard small similarities");
-  clopts.attach_option("svd-dir", svd_dir,
-          "Path to the directory where Graphlab svd is located");
-  clopts.attach_option("kmeans-dir", kmeans_dir,
-          "Path to the directory where Graphlab kmeans is located");
-  clopts.attach_option("graph-analytics-dir", graph_analytics_dir,
-          "Path to the directory where Graphlab eigen_vector_normalization is located");
   clopts.attach_option("pre-kmeans-clusters", pre_kmeans_clusters,
           "If set, will perform kmeans as a preprocess with the given cluster number.");
-  clopts.attach_option("mpi-args", mpi_args,
-          "If set, will execute mipexec with the given arguments. "
-          "For example, --mpi-args=\"-n [N machines] --hostfile [host file]\"");
   clopts.attach_option("sv", sv,
           "Number of vectors in each iteration in the Lanczos svd.");
+  clopts.attach_option("ortho-repeats", num_orthogonalizations,
+          "Number of reorthogonalizations of each Lanczos vector.");
+  clopts.attach_option("max-iteration", max_iteration,
+          "The max number of kmeans iterations. 0 means no limit.");
   if (!clopts.parse(argc, argv))
     return EXIT_FAILURE;
   if (datafile == "") {
@@ -341,99 +818,78 @@ int main(int argc, char** argv) {
     std::cout << "--cluster is not optional\n";
     return EXIT_FAILURE;
   }
-
-  std::vector<std::string> remove_opts;
-  remove_opts.push_back("--data");
-  remove_opts.push_back("--svd-dir");
-  remove_opts.push_back("--graph-analytics-dir");
-  remove_opts.push_back("--kmeans-dir");
-  remove_opts.push_back("--clusters");
-  remove_opts.push_back("--sigma");
-  remove_opts.push_back("--similarity-thres");
-  remove_opts.push_back("--mpi-args");
-  remove_opts.push_back("--t-nearest");
-  remove_opts.push_back("--pre-kmeans-clusters");
-  remove_opts.push_back("--sv");
-  std::string other_args = get_arg_str_without(argc, argv, remove_opts);
-
-  //preprocess by kmeans for fast clustering
-  if(pre_kmeans_clusters > 0){
-    if(pre_kmeans_clusters < num_clusters){
-      std::cout << "the number of --pre-kmeans-clusters must be bigger than the number of clusters\n";
-      return EXIT_FAILURE;
-    }
-    time(&mid);
-    if(call_kmeans_as_preprocess(mpi_args, datafile, kmeans_dir, pre_kmeans_clusters, other_args) == false)
-      return EXIT_FAILURE;
-    //modify settings
-    datafile = datafile + ".pre.centers";
-    num_nearests = 0;
-    time(&end);
-    times.push_back(std::pair<std::string, time_t>("kmeans preprocess",(end - mid)));
-  }
-
-  //construct graph laplacian
-  time(&mid);
-  if (call_graph_laplacian_construction(mpi_args, datafile, sigma, epsilon,
-      num_nearests, other_args) == false) {
+  if(pre_kmeans_clusters > 0 && pre_kmeans_clusters < num_clusters){
+    std::cout << "the number of --pre-kmeans-clusters must be bigger than the number of clusters\n";
     return EXIT_FAILURE;
   }
-  time(&end);
-  times.push_back(std::pair<std::string, time_t>("graph laplacian",(end - mid)));
-
-  //eigen value decomposition
-  //read number of data
-  size_t num_data = 0;
-  const std::string datanum_filename = datafile + ".datanum";
-  std::ifstream ifs(datanum_filename.c_str());
-  if (!ifs) {
-    std::cout << "can't read number of data." << std::endl;
-    return EXIT_FAILURE;
-  }
-  ifs >> num_data;
-  //determine the sv of Lanczos method
-  if(sv == 0){
-    sv = get_lanczos_rank(num_clusters, num_data);
-  }else{
-    if(sv < num_clusters)
-      sv = num_clusters;
-  }
-  time(&mid);
-  if (call_svd(mpi_args, datafile, svd_dir, num_clusters, sv, num_data,
-      other_args) == false) {
-    return EXIT_FAILURE;
-  }
-  if (call_eigen_vector_normalization(mpi_args, datafile, graph_analytics_dir,
-      num_clusters, sv, num_data, other_args) == false) {
-    return EXIT_FAILURE;
-  }
-  time(&end);
-  times.push_back(std::pair<std::string, time_t>("eigen decomposition",(end - mid)));
+  gaussian_kernel_scale_parameter *= 2.0*gaussian_kernel_scale_parameter;
+
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
 
-  //run kmeans
+  graph_type graph(dc, clopts);
   time(&mid);
-  if (call_kmeans(mpi_args, datafile, kmeans_dir, num_clusters, other_args)
-      == false) {
+  graph.load(datafile, pre_kmeans_clusters > 0 ? point_parser : line_parser);
+  graph.finalize();
+  time(&end);
+  times.push_back(std::make_pair(std::string("load"), end - mid));
+  dc.cout() << "Number of datapoints: " << graph.num_vertices() << std::endl;
+  if (graph.num_vertices() < num_clusters) {
+    dc.cout() << "More clusters than datapoints! Cannot proceed" << std::endl;
     return EXIT_FAILURE;
   }
-  time(&end);
-  times.push_back(std::pair<std::string, time_t>("kmeans",(end - mid)));
 
-  //recover cluster membership if preprocess with kmeans was done
   if(pre_kmeans_clusters > 0){
-    //remove ".pre.centers"
-    datafile = datafile.substr(0, datafile.size() - 12);
-    recover_labels(datafile);
+    //preprocess by kmeans for fast clustering
+    time(&mid);
+    run_kmeans(dc, graph, pre_kmeans_clusters, max_iteration);
+    time(&end);
+    times.push_back(std::make_pair(std::string("kmeans preprocess"), end - mid));
+
+    //cluster the non-empty centers, which are connected to each other
+    std::vector<size_t> center_ids(CENTERS.size(), 0);
+    size_t num_centers = 0;
+    for (size_t i = 0; i < CENTERS.size(); ++i) {
+      if (!CENTERS[i].empty()) center_ids[i] = ++num_centers;
+    }
+    graph_type center_graph(dc, clopts);
+    if (dc.procid() == 0) {
+      for (size_t i = 0; i < CENTERS.size(); ++i) {
+        const size_t id = center_ids[i];
+        if (id == 0) continue;
+        center_graph.add_vertex(id,
+            vertex_data(std::vector<float>(CENTERS[i].begin(), CENTERS[i].end())));
+        for (size_t j = 1; j < id; ++j) center_graph.add_edge(j, id);
+      }
+    }
+    center_graph.finalize();
+    number_of_nearest_neighbors = 0;
+    spectral_clustering(dc, center_graph, num_clusters, sv, max_iteration,
+                        times, clopts);
+
+    CENTER_LABELS.assign(num_centers, 0);
+    CENTER_LABELS = center_graph.map_reduce_vertices<center_label_reducer>
+                        (center_label_reducer::get_label).labels;
+    //index the labels by k-means cluster, in place since center_ids[i] <= i + 1
+    CENTER_LABELS.resize(CENTERS.size());
+    for (size_t i = CENTERS.size(); i > 0; --i) {
+      CENTER_LABELS[i - 1] = center_ids[i - 1] > 0 ? CENTER_LABELS[center_ids[i - 1] - 1] : 0;
+    }
+    graph.transform_vertices(assign_center_label);
+  } else {
+    spectral_clustering(dc, graph, num_clusters, sv, max_iteration,
+                        times, clopts);
   }
 
+  graph.save(datafile + ".result", cluster_writer(), false, true, false, 1);
   time(&end);
 
-  std::cout << "computation times:\n";
+  dc.cout() << "computation times:\n";
   for(size_t i=0;i<times.size();++i){
-    std::cout << "process " << i+1 << "\t" << times[i].first << "\t" << times[i].second << " sec\n";
+    dc.cout() << "process " << i+1 << "\t" << times[i].first << "\t" << times[i].second << " sec\n";
   }
-  std::cout << "Overall processing time of spectral clustering is " << (end - start) << " sec\n";
+  dc.cout() << "Overall processing time of spectral clustering is " << (end - start) << " sec\n";
 
+  graphlab::mpi_tools::finalize();
   return EXIT_SUCCESS;
 }
-
@@ -43,6 +43,7 @@
 
 // This file defines the serialization code for the eigen types.
 #include "eigen_serialization.hpp"
+#include "latent_dimension.hpp"
 
 #include <graphlab.hpp>
 #include <graphlab/util/stl_util.hpp>
@@ -56,21 +57,20 @@ const int SAFE_NEG_OFFSET = 2; //add 2 to negative node id
 
 
 /**
- * \brief We use the eigen library's vector type to represent
- * mathematical vectors.
- */
-typedef Eigen::VectorXd vec_type;
-
-/**
- * \brief We use the eigen library's matrix type to represent
- * matrices.
+ * \brief A shared "constant" that specifies the number of latent
+ * values to use.
+ *
+ * The ALS types below are templated on the latent dimension D. For
+ * the common values of NLATENT (see latent_dimension.hpp) D equals
+ * NLATENT and the factors and Xy are fixed size Eigen types which
+ * never allocate. XtX is fixed size only up to
+ * MAX_FIXED_MATRIX_DIMENSION, since the engines keep a gather
+ * accumulator per vertex. For any other NLATENT, D is Eigen::Dynamic.
  */
-typedef Eigen::MatrixXd mat_type;
-
+size_t NLATENT = 20;
 
 
-
-/** 
+/**
  * \ingroup toolkit_matrix_factorization
  *
  * \brief the vertex data type which contains the latent factor.
@@ -82,12 +82,9 @@ typedef Eigen::MatrixXd mat_type;
  * parameters such that the non-zero entries in the matrix can be
  * predicted by taking the dot product of the row and column factors.
  */
+template <int D>
 struct vertex_data {
-  /**
-   * \brief A shared "constant" that specifies the number of latent
-   * values to use.
-   */
-  static size_t NLATENT;
+  typedef typename latent_types<D>::vec_type vec_type;
   /** \brief The number of times this vertex has been updated. */
   uint32_t nupdates;
   /** \brief The most recent L1 change in the factor value */
@@ -112,8 +109,6 @@ struct vertex_data {
 }; // end of vertex data
 
 
-size_t vertex_data::NLATENT = 20;
-
 /**
  * \brief The edge data stores the entry in the matrix.
  *
@@ -143,15 +138,10 @@ struct edge_data : public graphlab::IS_POD_TYPE {
 }; // end of edge data
 
 
-/**
- * \brief The graph type is defined in terms of the vertex and edge
- * data.
- */ 
-typedef graphlab::distributed_graph<vertex_data, edge_data> graph_type;
-
 #include "implicit.hpp"
 
-stats_info count_edges(const graph_type::edge_type & edge){
+template <typename Graph>
+stats_info count_edges(const typename Graph::edge_type & edge){
   stats_info ret;
 
   if (edge.data().role == edge_data::TRAIN)
@@ -169,9 +159,10 @@ stats_info count_edges(const graph_type::edge_type & edge){
  * \brief Given a vertex and an edge return the other vertex in the
  * edge.
  */
-inline graph_type::vertex_type
-get_other_vertex(graph_type::edge_type& edge, 
-                 const graph_type::vertex_type& vertex) {
+template <typename Graph>
+inline typename Graph::vertex_type
+get_other_vertex(typename Graph::edge_type& edge,
+                 const typename Graph::vertex_type& vertex) {
   return vertex.id() == edge.source().id()? edge.target() : edge.source();
 }; // end of get_other_vertex
 
@@ -192,11 +183,20 @@ get_other_vertex(graph_type::edge_type& edge,
  * To do this in the Gather-Apply-Scatter model the gather function
  * computes and returns a pair consisting of XtX and Xy which are then
  * added. The gather type represents that tuple and provides the
- * necessary gather_type::operator+= operation.
+ * necessary als_gather::operator+= operation.
  *
+ * has_data marks a non-empty sum, since the fixed size matrices
+ * cannot signal emptiness by their size.
  */
-class gather_type {
+template <int D>
+class als_gather {
 public:
+  typedef typename latent_types<D>::vec_type vec_type;
+  typedef typename latent_types<D>::mat_type mat_type;
+
+  /** \brief Whether anything has been added */
+  bool has_data;
+
   /**
    * \brief Stores the current sum of nbr.factor.transpose() *
    * nbr.factor
@@ -209,49 +209,74 @@ public:
   vec_type Xy;
 
   /** \brief basic default constructor */
-  gather_type() { }
+  als_gather() : has_data(false) { }
 
   /**
    * \brief This constructor computes XtX and Xy and stores the result
    * in XtX and Xy
    */
-  gather_type(const vec_type& X, const double y) :
-    XtX(X.size(), X.size()), Xy(X.size()) {
-    XtX.triangularView<Eigen::Upper>() = X * X.transpose();
+  als_gather(const vec_type& X, const double y) :
+    has_data(true), XtX(X.size(), X.size()), Xy(X.size()) {
+    XtX.template triangularView<Eigen::Upper>() = X * X.transpose();
     Xy = X * y;
   } // end of constructor for gather type
 
   /** \brief Save the values to a binary archive */
-  void save(graphlab::oarchive& arc) const { arc << XtX << Xy; }
+  void save(graphlab::oarchive& arc) const {
+    arc << has_data;
+    if(has_data) arc << XtX << Xy;
+  }
 
   /** \brief Read the values from a binary archive */
-  void load(graphlab::iarchive& arc) { arc >> XtX >> Xy; }  
+  void load(graphlab::iarchive& arc) {
+    arc >> has_data;
+    if(has_data) arc >> XtX >> Xy;
+  }
 
-  /** 
+  /**
    * \brief Computes XtX += other.XtX and Xy += other.Xy updating this
    * tuples value
    */
-  gather_type& operator+=(const gather_type& other) {
-    if(other.Xy.size() == 0) {
-      ASSERT_EQ(other.XtX.rows(), 0);
-      ASSERT_EQ(other.XtX.cols(), 0);
-    } else {
-      if(Xy.size() == 0) {
-        ASSERT_EQ(XtX.rows(), 0); 
-        ASSERT_EQ(XtX.cols(), 0);
+  als_gather& operator+=(const als_gather& other) {
+    if(other.has_data) {
+      if(!has_data) {
         XtX = other.XtX; Xy = other.Xy;
+        has_data = true;
       } else {
-        XtX.triangularView<Eigen::Upper>() += other.XtX;  
+        XtX.template triangularView<Eigen::Upper>() += other.XtX;
         Xy += other.Xy;
       }
     }
     return *this;
   } // end of operator+=
 
-}; // end of gather type
+}; // end of als_gather
 
 
 
+/**
+ * \brief The parameters of the ALS update, shared by all latent
+ * dimensions.
+ */
+struct als_settings {
+  /** The convergence tolerance */
+  static double TOLERANCE;
+  static double LAMBDA;
+  static size_t MAX_UPDATES;
+  static double MAXVAL;
+  static double MINVAL;
+  static int    REGNORMAL; //regularization type
+}; // end of als settings
+
+/**
+ * \brief The types of the ALS graph of latent dimension D.
+ */
+template <int D>
+struct als_types {
+  typedef graphlab::distributed_graph<vertex_data<D>, edge_data> graph_type;
+};
+
+
 /**
  * \brief ALS vertex program implements the alternating least squares
  * algorithm in the Gather-Apply-Scatter abstraction.
@@ -279,20 +304,26 @@ public:
  *      vertex has changed sufficiently and the edge is not well
  *      predicted.
  *
- * 
- */ 
-class als_vertex_program : 
-  public graphlab::ivertex_program<graph_type, gather_type,
+ *
+ */
+template <int D>
+class als_vertex_program :
+  public graphlab::ivertex_program<typename als_types<D>::graph_type,
+                                   als_gather<D>,
                                    graphlab::messages::sum_priority>,
-  public graphlab::IS_POD_TYPE {
+  public graphlab::IS_POD_TYPE,
+  public als_settings {
 public:
-  /** The convergence tolerance */
-  static double TOLERANCE;
-  static double LAMBDA;
-  static size_t MAX_UPDATES;
-  static double MAXVAL;
-  static double MINVAL;
-  static int    REGNORMAL; //regularization type
+  typedef typename als_types<D>::graph_type graph_type;
+  typedef graphlab::ivertex_program<graph_type, als_gather<D>,
+                                    graphlab::messages::sum_priority> base;
+  typedef typename base::icontext_type icontext_type;
+  typedef typename base::vertex_type vertex_type;
+  typedef typename base::edge_type edge_type;
+  typedef typename base::edge_dir_type edge_dir_type;
+  typedef typename base::gather_type gather_type;
+  typedef typename latent_types<D>::vec_type vec_type;
+  typedef typename latent_types<D>::mat_type mat_type;
 
   /** The set of edges to gather along */
   edge_dir_type gather_edges(icontext_type& context, 
@@ -304,7 +335,7 @@ public:
   gather_type gather(icontext_type& context, const vertex_type& vertex, 
                      edge_type& edge) const {
     if(edge.data().role == edge_data::TRAIN) {
-      const vertex_type other_vertex = get_other_vertex(edge, vertex);
+      const vertex_type other_vertex = get_other_vertex<graph_type>(edge, vertex);
       return gather_type(other_vertex.data().factor, edge.data().obs);
     } else return gather_type();
   } // end of gather function
@@ -313,10 +344,10 @@ public:
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& sum) {
     // Get and reset the vertex data
-    vertex_data& vdata = vertex.data(); 
+    vertex_data<D>& vdata = vertex.data();
     // Determine the number of neighbors.  Each vertex has only in or
     // out edges depending on which side of the graph it is located
-    if(sum.Xy.size() == 0) { vdata.residual = 0; ++vdata.nupdates; return; }
+    if(!sum.has_data) { vdata.residual = 0; ++vdata.nupdates; return; }
     mat_type XtX = sum.XtX;
     vec_type Xy = sum.Xy;
     // Add regularization
@@ -327,7 +358,7 @@ public:
       XtX(i,i) += regularization; 
     // Solve the least squares problem using eigen ----------------------------
     const vec_type old_factor = vdata.factor;
-    vdata.factor = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
+    vdata.factor = XtX.template selfadjointView<Eigen::Upper>().ldlt().solve(Xy);
     // Compute the residual change in the factor factor -----------------------
     vdata.residual = (vdata.factor - old_factor).cwiseAbs().sum() / XtX.rows();
     ++vdata.nupdates;
@@ -344,9 +375,9 @@ public:
                edge_type& edge) const {
     edge_data& edata = edge.data();
     if(edata.role == edge_data::TRAIN) {
-      const vertex_type other_vertex = get_other_vertex(edge, vertex);
-      const vertex_data& vdata = vertex.data();
-      const vertex_data& other_vdata = other_vertex.data();
+      const vertex_type other_vertex = get_other_vertex<graph_type>(edge, vertex);
+      const vertex_data<D>& vdata = vertex.data();
+      const vertex_data<D>& other_vdata = other_vertex.data();
       const double pred = vdata.factor.dot(other_vdata.factor);
       const float error = std::fabs(edata.obs - pred);
       const double priority = (error * vdata.residual); 
@@ -376,7 +407,8 @@ public:
  * \brief The graph loader function is a line parser used for
  * distributed graph construction.
  */
-inline bool graph_loader(graph_type& graph, 
+template <typename Graph>
+inline bool graph_loader(Graph& graph,
                          const std::string& filename,
                          const std::string& line) {
   ASSERT_FALSE(line.empty()); 
@@ -388,7 +420,7 @@ inline bool graph_loader(graph_type& graph,
   if(boost::ends_with(filename,".validate")) role = edge_data::VALIDATE;
   else if(boost::ends_with(filename, ".predict")) role = edge_data::PREDICT;
   // Parse the line
-  graph_type::vertex_id_type source_id(-1), target_id(-1);
+  graphlab::vertex_id_type source_id(-1), target_id(-1);
   float obs(0); 
   const bool success = qi::phrase_parse
     (line.begin(), line.end(),       
@@ -405,8 +437,8 @@ inline bool graph_loader(graph_type& graph,
   if(!success) return false;
 
   if(role == edge_data::TRAIN || role == edge_data::VALIDATE){
-    if (obs < als_vertex_program::MINVAL || obs > als_vertex_program::MAXVAL)
-      logstream(LOG_FATAL)<<"Rating values should be between " << als_vertex_program::MINVAL << " and " << als_vertex_program::MAXVAL << ". Got value: " << obs << " [ user: " << source_id << " to item: " <<target_id << " ] " << std::endl; 
+    if (obs < als_settings::MINVAL || obs > als_settings::MAXVAL)
+      logstream(LOG_FATAL)<<"Rating values should be between " << als_settings::MINVAL << " and " << als_settings::MAXVAL << ". Got value: " << obs << " [ user: " << source_id << " to item: " <<target_id << " ] " << std::endl; 
   }
  
   // map target id into a separate number space
@@ -421,22 +453,23 @@ inline bool graph_loader(graph_type& graph,
 /**
  * \brief Given an edge compute the error associated with that edge
  */
-double extract_l2_error(const graph_type::edge_type & edge) {
+template <typename Graph>
+double extract_l2_error(const typename Graph::edge_type & edge) {
   double pred = 
     edge.source().data().factor.dot(edge.target().data().factor);
-  pred = std::min(als_vertex_program::MAXVAL, pred);
-  pred = std::max(als_vertex_program::MINVAL, pred);
+  pred = std::min(als_settings::MAXVAL, pred);
+  pred = std::max(als_settings::MINVAL, pred);
   return (edge.data().obs - pred) * (edge.data().obs - pred);
 } // end of extract_l2_error
 
 
 
-double als_vertex_program::TOLERANCE = 1e-3;
-double als_vertex_program::LAMBDA = 0.01;
-size_t als_vertex_program::MAX_UPDATES = -1;
-double als_vertex_program::MAXVAL = 1e+100;
-double als_vertex_program::MINVAL = -1e+100;
-int    als_vertex_program::REGNORMAL = 1;
+double als_settings::TOLERANCE = 1e-3;
+double als_settings::LAMBDA = 0.01;
+size_t als_settings::MAX_UPDATES = -1;
+double als_settings::MAXVAL = 1e+100;
+double als_settings::MINVAL = -1e+100;
+int    als_settings::REGNORMAL = 1;
 
 
 
@@ -451,9 +484,11 @@ int    als_vertex_program::REGNORMAL = 1;
  * error_aggregators and are used by the engine.add_edge_aggregator
  * api.
  */
+template <int D>
 struct error_aggregator : public graphlab::IS_POD_TYPE {
-  typedef als_vertex_program::icontext_type icontext_type;
-  typedef graph_type::edge_type edge_type;
+  typedef typename als_vertex_program<D>::icontext_type icontext_type;
+  typedef typename als_types<D>::graph_type graph_type;
+  typedef typename graph_type::edge_type edge_type;
   double train_error, validation_error;
   error_aggregator() : 
     train_error(0), validation_error(0) { }
@@ -462,12 +497,12 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
     validation_error += other.validation_error;
     return *this;
   }
-  static error_aggregator map(icontext_type& context, const graph_type::edge_type& edge) {
+  static error_aggregator map(icontext_type& context, const edge_type& edge) {
     error_aggregator agg;
     if(edge.data().role == edge_data::TRAIN) {
-      agg.train_error = extract_l2_error(edge); 
+      agg.train_error = extract_l2_error<graph_type>(edge); 
     } else if(edge.data().role == edge_data::VALIDATE) {
-      agg.validation_error = extract_l2_error(edge);
+      agg.validation_error = extract_l2_error<graph_type>(edge);
     }
     return agg;
   }
@@ -490,9 +525,10 @@ struct error_aggregator : public graphlab::IS_POD_TYPE {
  * \brief The prediction saver is used by the graph.save routine to
  * output the final predictions back to the filesystem.
  */
+template <typename Graph>
 struct prediction_saver {
-  typedef graph_type::vertex_type vertex_type;
-  typedef graph_type::edge_type   edge_type;
+  typedef typename Graph::vertex_type vertex_type;
+  typedef typename Graph::edge_type   edge_type;
   std::string save_vertex(const vertex_type& vertex) const {
     return ""; //nop
   }
@@ -510,16 +546,17 @@ struct prediction_saver {
 }; // end of prediction_saver
 
 
+template <typename Graph>
 struct linear_model_saver_U {
-  typedef graph_type::vertex_type vertex_type;
-  typedef graph_type::edge_type   edge_type;
+  typedef typename Graph::vertex_type vertex_type;
+  typedef typename Graph::edge_type   edge_type;
   /* save the linear model, using the format:
      nodeid factor1 factor2 ... factorNLATENT \n
   */
   std::string save_vertex(const vertex_type& vertex) const {
     if (vertex.num_out_edges() > 0){
       std::string ret = boost::lexical_cast<std::string>(vertex.id()) + " ";
-      for (uint i=0; i< vertex_data::NLATENT; i++)
+      for (uint i=0; i< NLATENT; i++)
         ret += boost::lexical_cast<std::string>(vertex.data().factor[i]) + " ";
         ret += "\n";
       return ret;
@@ -531,16 +568,17 @@ struct linear_model_saver_U {
   }
 }; 
 
+template <typename Graph>
 struct linear_model_saver_V {
-  typedef graph_type::vertex_type vertex_type;
-  typedef graph_type::edge_type   edge_type;
+  typedef typename Graph::vertex_type vertex_type;
+  typedef typename Graph::edge_type   edge_type;
   /* save the linear model, using the format:
      nodeid factor1 factor2 ... factorNLATENT \n
   */
   std::string save_vertex(const vertex_type& vertex) const {
     if (vertex.num_out_edges() == 0){
       std::string ret = boost::lexical_cast<std::string>(-vertex.id()-SAFE_NEG_OFFSET) + " ";
-      for (uint i=0; i< vertex_data::NLATENT; i++)
+      for (uint i=0; i< NLATENT; i++)
         ret += boost::lexical_cast<std::string>(vertex.data().factor[i]) + " ";
         ret += "\n";
       return ret;
@@ -555,14 +593,146 @@ struct linear_model_saver_V {
 
 
 /**
- * \brief The engine type used by the ALS matrix factorization
- * algorithm.
+ * \brief Loads the matrix and runs ALS with latent dimension D.
  *
- * The ALS matrix factorization algorithm currently uses the
- * synchronous engine.  However we plan to add support for alternative
- * engines in the future.
+ * main() parses the options and picks D through
+ * dispatch_latent_dimension().
  */
-typedef graphlab::omni_engine<als_vertex_program> engine_type;
+struct als_runner {
+  graphlab::distributed_control& dc;
+  graphlab::command_line_options& clopts;
+  std::string input_dir;
+  std::string predictions;
+  size_t interval;
+  std::string exec_type;
+
+  template <int D>
+  int run() {
+    /**
+     * \brief The engine type used by the ALS matrix factorization
+     * algorithm.
+     *
+     * The ALS matrix factorization algorithm currently uses the
+     * synchronous engine.  However we plan to add support for alternative
+     * engines in the future.
+     */
+    typedef graphlab::omni_engine<als_vertex_program<D> > engine_type;
+    typedef typename als_types<D>::graph_type graph_type;
+
+    if (D != Eigen::Dynamic) {
+      dc.cout() << "Using fixed size latent factors of dimension " << D
+                << std::endl;
+      // the fixed size accumulators live on the fiber stacks of the
+      // asynchronous engine, up to about 70KB per fiber at D = 32.
+      // The synchronous engine rejects the option so only set it when
+      // the asynchronous engine may run.
+      std::string engine_type = exec_type;
+      clopts.get_engine_args().get_option("type", engine_type);
+      const bool uses_fibers = engine_type == "async" ||
+        engine_type == "asynchronous" || engine_type == "adaptive";
+      size_t stacksize = 0;
+      if (uses_fibers &&
+          !clopts.get_engine_args().get_option("stacksize", stacksize)) {
+        clopts.get_engine_args().set_option("stacksize",
+            std::max<size_t>(16384, 8 * sizeof(als_gather<D>)));
+      }
+    }
+
+    dc.cout() << "Loading graph." << std::endl;
+    graphlab::timer timer; 
+    graph_type graph(dc, clopts);  
+    graph.load(input_dir, graph_loader<graph_type>); 
+    dc.cout() << "Loading graph. Finished in " 
+              << timer.current_time() << std::endl;
+
+    if (dc.procid() == 0) 
+      add_implicit_edges<edge_data>(implicitratingtype, graph, dc);
+  
+    dc.cout() << "Finalizing graph." << std::endl;
+    timer.start();
+    graph.finalize();
+    dc.cout() << "Finalizing graph. Finished in " 
+              << timer.current_time() << std::endl;
+
+    if (!graph.num_edges() || !graph.num_vertices())
+      logstream(LOG_FATAL)<< "Failed to load graph. Check your input path: " << input_dir << std::endl;     
+
+
+    dc.cout() 
+        << "========== Graph statistics on proc " << dc.procid() 
+        << " ==============="
+        << "\n Num vertices: " << graph.num_vertices()
+        << "\n Num edges: " << graph.num_edges()
+        << "\n Num replica: " << graph.num_replicas()
+        << "\n Replica to vertex ratio: " 
+        << float(graph.num_replicas())/graph.num_vertices()
+        << "\n --------------------------------------------" 
+        << "\n Num local own vertices: " << graph.num_local_own_vertices()
+        << "\n Num local vertices: " << graph.num_local_vertices()
+        << "\n Replica to own ratio: " 
+        << (float)graph.num_local_vertices()/graph.num_local_own_vertices()
+        << "\n Num local edges: " << graph.num_local_edges()
+        //<< "\n Begin edge id: " << graph.global_eid(0)
+        << "\n Edge balance ratio: " 
+        << float(graph.num_local_edges())/graph.num_edges()
+        << std::endl;
+ 
+    dc.cout() << "Creating engine" << std::endl;
+    engine_type engine(dc, graph, exec_type, clopts);
+
+    // Add error reporting to the engine
+    const bool success = engine.template add_edge_aggregator<error_aggregator<D> >
+      ("error", error_aggregator<D>::map, error_aggregator<D>::finalize) &&
+      engine.aggregate_periodic("error", interval);
+    ASSERT_TRUE(success);
+  
+
+    // Signal all vertices on the vertices on the left (liberals) 
+    engine.template map_reduce_vertices<graphlab::empty>(als_vertex_program<D>::signal_left);
+    info = graph.template map_reduce_edges<stats_info>(count_edges<graph_type>);
+    dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
+
+    // Run ALS ---------------------------------------------------------
+    dc.cout() << "Running ALS" << std::endl;
+    timer.start();
+    engine.start();  
+
+    const double runtime = timer.current_time();
+    dc.cout() << "----------------------------------------------------------"
+              << std::endl
+              << "Final Runtime (seconds):   " << runtime 
+              << std::endl
+              << "Updates executed: " << engine.num_updates() << std::endl
+              << "Update Rate (updates/second): " 
+              << engine.num_updates() / runtime << std::endl;
+
+    // Compute the final training error -----------------------------------------
+    dc.cout() << "Final error: " << std::endl;
+    engine.aggregate_now("error");
+
+    // Make predictions ---------------------------------------------------------
+    if(!predictions.empty()) {
+      std::cout << "Saving predictions" << std::endl;
+      const bool gzip_output = false;
+      const bool save_vertices = false;
+      const bool save_edges = true;
+      const size_t threads_per_machine = 2;
+
+      //save the predictions
+      graph.save(predictions, prediction_saver<graph_type>(),
+                 gzip_output, save_vertices, 
+                 save_edges, threads_per_machine);
+      //save the linear model
+      graph.save(predictions + ".U", linear_model_saver_U<graph_type>(),
+                 gzip_output, save_edges, save_vertices, threads_per_machine);
+      graph.save(predictions + ".V", linear_model_saver_V<graph_type>(),
+                 gzip_output, save_edges, save_vertices, threads_per_machine);
+  
+    }
+    return EXIT_SUCCESS;
+  }
+}; // end of als_runner
+
 
 int main(int argc, char** argv) {
   global_logger().set_log_level(LOG_INFO);
@@ -579,23 +749,24 @@ int main(int argc, char** argv) {
   clopts.attach_option("matrix", input_dir,
                        "The directory containing the matrix file");
   clopts.add_positional("matrix");
-  clopts.attach_option("D",  vertex_data::NLATENT,
-                       "Number of latent parameters to use.");
-  clopts.attach_option("max_iter", als_vertex_program::MAX_UPDATES,
+  clopts.attach_option("D",  NLATENT,
+                       "Number of latent parameters to use. 8, 16, 32, 64 "
+                       "and 128 use fixed size factors.");
+  clopts.attach_option("max_iter", als_settings::MAX_UPDATES,
                        "The maxumum number of udpates allowed for a vertex");
-  clopts.attach_option("lambda", als_vertex_program::LAMBDA, 
+  clopts.attach_option("lambda", als_settings::LAMBDA, 
                        "ALS regularization weight"); 
-  clopts.attach_option("tol", als_vertex_program::TOLERANCE,
+  clopts.attach_option("tol", als_settings::TOLERANCE,
                        "residual termination threshold");
-  clopts.attach_option("maxval", als_vertex_program::MAXVAL, "max allowed value");
-  clopts.attach_option("minval", als_vertex_program::MINVAL, "min allowed value");
+  clopts.attach_option("maxval", als_settings::MAXVAL, "max allowed value");
+  clopts.attach_option("minval", als_settings::MINVAL, "min allowed value");
   clopts.attach_option("interval", interval, 
                        "The time in seconds between error reports");
   clopts.attach_option("predictions", predictions,
                        "The prefix (folder and filename) to save predictions.");
   clopts.attach_option("engine", exec_type, 
                        "The engine type synchronous or asynchronous");
-  clopts.attach_option("regnormal", als_vertex_program::REGNORMAL, 
+  clopts.attach_option("regnormal", als_settings::REGNORMAL, 
                        "regularization type. 1 = weighted according to neighbors num. 0 = no weighting - just lambda");
   
   parse_implicit_command_line(clopts);
@@ -611,104 +782,10 @@ int main(int argc, char** argv) {
   ///! Initialize control plain using mpi
   graphlab::mpi_tools::init(argc, argv);
   graphlab::distributed_control dc;
-  
-  dc.cout() << "Loading graph." << std::endl;
-  graphlab::timer timer; 
-  graph_type graph(dc, clopts);  
-  graph.load(input_dir, graph_loader); 
-  dc.cout() << "Loading graph. Finished in " 
-            << timer.current_time() << std::endl;
-
-  if (dc.procid() == 0) 
-    add_implicit_edges<edge_data>(implicitratingtype, graph, dc);
-  
-  dc.cout() << "Finalizing graph." << std::endl;
-  timer.start();
-   graph.finalize();
-  dc.cout() << "Finalizing graph. Finished in " 
-            << timer.current_time() << std::endl;
-
-  if (!graph.num_edges() || !graph.num_vertices())
-     logstream(LOG_FATAL)<< "Failed to load graph. Check your input path: " << input_dir << std::endl;     
-
-
-  dc.cout() 
-      << "========== Graph statistics on proc " << dc.procid() 
-      << " ==============="
-      << "\n Num vertices: " << graph.num_vertices()
-      << "\n Num edges: " << graph.num_edges()
-      << "\n Num replica: " << graph.num_replicas()
-      << "\n Replica to vertex ratio: " 
-      << float(graph.num_replicas())/graph.num_vertices()
-      << "\n --------------------------------------------" 
-      << "\n Num local own vertices: " << graph.num_local_own_vertices()
-      << "\n Num local vertices: " << graph.num_local_vertices()
-      << "\n Replica to own ratio: " 
-      << (float)graph.num_local_vertices()/graph.num_local_own_vertices()
-      << "\n Num local edges: " << graph.num_local_edges()
-      //<< "\n Begin edge id: " << graph.global_eid(0)
-      << "\n Edge balance ratio: " 
-      << float(graph.num_local_edges())/graph.num_edges()
-      << std::endl;
- 
-  dc.cout() << "Creating engine" << std::endl;
-  engine_type engine(dc, graph, exec_type, clopts);
-
-  // Add error reporting to the engine
-  const bool success = engine.add_edge_aggregator<error_aggregator>
-    ("error", error_aggregator::map, error_aggregator::finalize) &&
-    engine.aggregate_periodic("error", interval);
-  ASSERT_TRUE(success);
-  
-
-  // Signal all vertices on the vertices on the left (liberals) 
-  engine.map_reduce_vertices<graphlab::empty>(als_vertex_program::signal_left);
-  info = graph.map_reduce_edges<stats_info>(count_edges);
-  dc.cout()<<"Training edges: " << info.training_edges << " validation edges: " << info.validation_edges << std::endl;
-
-  // Run ALS ---------------------------------------------------------
-  dc.cout() << "Running ALS" << std::endl;
-  timer.start();
-  engine.start();  
-
-  const double runtime = timer.current_time();
-  dc.cout() << "----------------------------------------------------------"
-            << std::endl
-            << "Final Runtime (seconds):   " << runtime 
-            << std::endl
-            << "Updates executed: " << engine.num_updates() << std::endl
-            << "Update Rate (updates/second): " 
-            << engine.num_updates() / runtime << std::endl;
-
-  // Compute the final training error -----------------------------------------
-  dc.cout() << "Final error: " << std::endl;
-  engine.aggregate_now("error");
-
-  // Make predictions ---------------------------------------------------------
-  if(!predictions.empty()) {
-    std::cout << "Saving predictions" << std::endl;
-    const bool gzip_output = false;
-    const bool save_vertices = false;
-    const bool save_edges = true;
-    const size_t threads_per_machine = 2;
-
-    //save the predictions
-    graph.save(predictions, prediction_saver(),
-               gzip_output, save_vertices, 
-               save_edges, threads_per_machine);
-    //save the linear model
-    graph.save(predictions + ".U", linear_model_saver_U(),
-		gzip_output, save_edges, save_vertices, threads_per_machine);
-    graph.save(predictions + ".V", linear_model_saver_V(),
-		gzip_output, save_edges, save_vertices, threads_per_machine);
-  
-  }
-             
 
+  als_runner runner = { dc, clopts, input_dir, predictions, interval, exec_type };
+  const int ret = dispatch_latent_dimension(NLATENT, runner);
 
   graphlab::mpi_tools::finalize();
-  return EXIT_SUCCESS;
+  return ret;
 } // end of main
-
-
-
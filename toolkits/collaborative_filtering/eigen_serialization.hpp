@@ -88,6 +88,55 @@ BEGIN_OUT_OF_PLACE_LOAD(arc, Eigen::MatrixXd, mat) {
 
 
 
+/**
+ * \brief Serialization for every other Eigen::Matrix instantiation.
+ *
+ * Fixed size matrices, such as the ones from latent_dimension.hpp,
+ * are written as their raw coefficients with no size prefix. Other
+ * dynamic matrices are prefixed with their rows and columns.
+ */
+namespace graphlab {
+  namespace archive_detail {
+
+    template <typename OutArcType, typename Scalar, int Rows, int Cols,
+              int Options, int MaxRows, int MaxCols>
+    struct serialize_impl<OutArcType,
+                          Eigen::Matrix<Scalar, Rows, Cols, Options,
+                                        MaxRows, MaxCols>, false> {
+      typedef Eigen::Matrix<Scalar, Rows, Cols, Options,
+                            MaxRows, MaxCols> matrix_type;
+      static void exec(OutArcType& arc, const matrix_type& mat) {
+        if (Rows == Eigen::Dynamic || Cols == Eigen::Dynamic) {
+          const typename matrix_type::Index rows = mat.rows();
+          const typename matrix_type::Index cols = mat.cols();
+          arc << rows << cols;
+        }
+        graphlab::serialize(arc, mat.data(), mat.size() * sizeof(Scalar));
+      }
+    };
+
+    template <typename InArcType, typename Scalar, int Rows, int Cols,
+              int Options, int MaxRows, int MaxCols>
+    struct deserialize_impl<InArcType,
+                            Eigen::Matrix<Scalar, Rows, Cols, Options,
+                                          MaxRows, MaxCols>, false> {
+      typedef Eigen::Matrix<Scalar, Rows, Cols, Options,
+                            MaxRows, MaxCols> matrix_type;
+      static void exec(InArcType& arc, matrix_type& mat) {
+        if (Rows == Eigen::Dynamic || Cols == Eigen::Dynamic) {
+          typename matrix_type::Index rows = 0, cols = 0;
+          arc >> rows >> cols;
+          mat.resize(rows, cols);
+        }
+        graphlab::deserialize(arc, mat.data(), mat.size() * sizeof(Scalar));
+      }
+    };
+
+  } // end of namespace archive_detail
+} // end of namespace graphlab
+
+
+
 
 
 
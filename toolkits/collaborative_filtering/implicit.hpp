@@ -37,8 +37,8 @@ double implicitratingvalue;
 double implicitratingpercentage;
 int    implicitratingtype;
 
-template<typename als_edge_type>
-uint add_implicit_edges4(int type, graph_type & graph, graphlab::distributed_control & dc){
+template<typename als_edge_type, typename Graph>
+uint add_implicit_edges4(int type, Graph & graph, graphlab::distributed_control & dc){
 
   switch(type){
     case IMPLICIT_RATING_DISABLED: return 0;
@@ -62,8 +62,8 @@ uint add_implicit_edges4(int type, graph_type & graph, graphlab::distributed_con
   return added;
 };
 
-template<typename als_edge_type>
-uint add_implicit_edges(int type, graph_type & graph, graphlab::distributed_control & dc){
+template<typename als_edge_type, typename Graph>
+uint add_implicit_edges(int type, Graph & graph, graphlab::distributed_control & dc){
 
   switch(type){
     case IMPLICIT_RATING_DISABLED: return 0;
@@ -0,0 +1,111 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef LATENT_DIMENSION_HPP
+#define LATENT_DIMENSION_HPP
+
+#include <Eigen/Dense>
+
+/**
+ * \brief The largest latent dimension whose D x D matrices are fixed
+ * size.
+ *
+ * A fixed D x D matrix takes 8 * D * D bytes wherever it is stored,
+ * even when empty: 8KB at D = 32, but 32KB at D = 64 and 128KB at
+ * D = 128. The synchronous engine keeps a gather accumulator (and,
+ * with use_cache, a gather cache entry) for every local vertex, so
+ * above this dimension the matrices stay on the heap, where an unused
+ * accumulator costs a few bytes.
+ */
+const int MAX_FIXED_MATRIX_DIMENSION = 32;
+
+template <int D, bool Fixed = (D <= MAX_FIXED_MATRIX_DIMENSION)>
+struct latent_matrix_type {
+  typedef Eigen::Matrix<double, D, D, Eigen::DontAlign> type;
+};
+
+template <int D>
+struct latent_matrix_type<D, false> {
+  typedef Eigen::MatrixXd type;
+};
+
+/**
+ * \brief The vector and matrix types of latent factors of dimension D.
+ *
+ * When D is a compile time constant the vectors are fixed size: they
+ * are stored inline in the vertex data and gather accumulators, never
+ * touch the heap, and serialize as raw coefficients (see
+ * eigen_serialization.hpp). The matrices are fixed size only up to
+ * MAX_FIXED_MATRIX_DIMENSION. latent_types<Eigen::Dynamic> falls back
+ * to VectorXd and MatrixXd for the other dimensions.
+ *
+ * The fixed types are unaligned since graphlab containers do not honor
+ * the alignment Eigen would otherwise require.
+ */
+template <int D>
+struct latent_types {
+  typedef Eigen::Matrix<double, D, 1, Eigen::DontAlign> vec_type;
+  typedef typename latent_matrix_type<D>::type mat_type;
+};
+
+template <>
+struct latent_types<Eigen::Dynamic> {
+  typedef Eigen::VectorXd vec_type;
+  typedef Eigen::MatrixXd mat_type;
+};
+
+
+/**
+ * \brief Runs runner.run<D>() for the dimension d.
+ *
+ * A toolkit templated on the latent dimension gets a fixed size
+ * instantiation for each d in {8, 16, 32, 64, 128}, and the
+ * Eigen::Dynamic instantiation for any other d:
+ *
+ * \code
+ * struct runner {
+ *   template <int D> int run() { ... typename latent_types<D>::vec_type ... }
+ * };
+ * runner r;
+ * return dispatch_latent_dimension(NLATENT, r);
+ * \endcode
+ *
+ * Defining LATENT_DIMENSION_DYNAMIC_ONLY builds only the dynamic
+ * instantiation, which keeps compile times down while developing.
+ */
+template <typename Runner>
+int dispatch_latent_dimension(size_t d, Runner& runner) {
+#ifndef LATENT_DIMENSION_DYNAMIC_ONLY
+  switch (d) {
+   case 8: return runner.template run<8>();
+   case 16: return runner.template run<16>();
+   case 32: return runner.template run<32>();
+   case 64: return runner.template run<64>();
+   case 128: return runner.template run<128>();
+   default: break;
+  }
+#endif
+  return runner.template run<Eigen::Dynamic>();
+}
+
+#endif
@@ -45,5 +45,6 @@ lockfree_push_back<std::vector<gas_op_descriptor> >
 
 
 var vars::empty_var;
+field_schema global_field_schema;
 }
 }
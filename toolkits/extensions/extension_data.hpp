@@ -6,6 +6,9 @@
 #include <Eigen/Dense>
 #include <string>
 #include <map>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
 #include "../collaborative_filtering/eigen_serialization.hpp"
 #include "MurmurHash3.h"
 
@@ -121,13 +124,112 @@ inline key_id_type get_id_from_name(key_id_type key) {
 
 
 
+/**
+ * The schema maps every field name used by the program to a slot index.
+ * Slots are assigned in the order in which fields are first used, are
+ * local to the process and never change once assigned, so a field name
+ * only needs to be resolved once.
+ *
+ * The mapping is copied on write: assigning a slot publishes a new
+ * table, and snapshot() hands out the current one so that a reader
+ * resolving many fields takes the lock once.
+ */
+class field_schema {
+ public:
+  typedef uint32_t slot_type;
+
+  /// An immutable copy of the mapping
+  struct table {
+    boost::unordered_map<key_id_type, slot_type> key_to_slot;
+    std::vector<key_id_type> slot_to_key;
+
+    /// Finds the slot of the key. Returns false if the key has no slot.
+    bool find(key_id_type key, slot_type& ret) const {
+      boost::unordered_map<key_id_type, slot_type>::const_iterator iter = 
+          key_to_slot.find(key);
+      if (iter == key_to_slot.end()) return false;
+      ret = iter->second;
+      return true;
+    }
+  };
+  typedef boost::shared_ptr<const table> table_ptr;
+
+  field_schema() : current(new table) { }
+
+  /// Returns the slot of the key, assigning a new slot if necessary
+  slot_type slot(key_id_type key) {
+    lock.lock();
+    slot_type ret;
+    if (!current->find(key, ret)) {
+      boost::shared_ptr<table> next(new table(*current));
+      ret = next->slot_to_key.size();
+      next->key_to_slot[key] = ret;
+      next->slot_to_key.push_back(key);
+      current = next;
+    }
+    lock.unlock();
+    return ret;
+  }
+
+  /// Finds the slot of the key. Returns false if the key has no slot.
+  bool find(key_id_type key, slot_type& ret) const {
+    return snapshot()->find(key, ret);
+  }
+
+  /// Returns the key stored in a slot
+  key_id_type key(slot_type slot) const {
+    return snapshot()->slot_to_key[slot];
+  }
+
+  /// Returns the number of slots assigned
+  size_t size() const {
+    return snapshot()->slot_to_key.size();
+  }
+
+  /// Returns the current mapping, which later slots do not change
+  table_ptr snapshot() const {
+    lock.lock();
+    table_ptr ret = current;
+    lock.unlock();
+    return ret;
+  }
+
+ private:
+  mutable simple_spinlock lock;
+  table_ptr current;
+};
+
+extern field_schema global_field_schema;
+
+
+/**
+ * A field name resolved to its slot in the schema. Accessing a vars
+ * through a field_id is a direct array index.
+ */
+struct field_id {
+  field_schema::slot_type slot;
+  explicit field_id(field_schema::slot_type slot = 0): slot(slot) { }
+};
+
+template <typename KeyType>
+inline field_id get_field(const KeyType& key) {
+  return field_id(global_field_schema.slot(get_id_from_name(key)));
+}
+
+
+
 /**
  * A dynamic struct storing mappings from string->var where var
  * is a variant.
  * fields can be accessed with operator() or ".field()"
+ *
+ * Fields are stored in an array indexed by the slot of the field in the
+ * global_field_schema, so a field is at the same position in every vars.
+ * References returned by field() are invalidated when a field which has
+ * never been used before is created.
  */
 struct vars {
-  std::vector<std::pair<key_id_type, var*> > table;
+  std::vector<var> values;
   static var empty_var;
   simple_spinlock lock;
   vars() { }
@@ -136,36 +238,40 @@ struct vars {
 
   void clear() {
     lock.lock();
-    for(const std::pair<key_id_type, var*>& p: table) {
-      delete p.second;
-    }
-    table.clear();
+    values.clear();
     lock.unlock();
   }
 
   vars& operator=(const vars& v) {
-    clear();
-    for (size_t i = 0;i < v.table.size(); ++i) {
-      field(v.table[i].first) = *(v.table[i].second);
-    }
+    lock.lock();
+    values = v.values;
+    lock.unlock();
     return *this;
   }
 
   void save(oarchive& oarc) const {
+    // slots are local to the process, so the keys are written instead
+    const field_schema::table_ptr schema = global_field_schema.snapshot();
     lock.lock();
-    oarc << (size_t)table.size();
-    for(const std::pair<key_id_type, var*>& p: table) {
-      oarc << p.first << (*p.second);
+    oarc << (size_t)values.size();
+    for (size_t i = 0;i < values.size(); ++i) {
+      oarc << schema->slot_to_key[i] << values[i];
     }
     lock.unlock();
   }
   
   void load(iarchive& iarc) {
+    field_schema::table_ptr schema = global_field_schema.snapshot();
     size_t tsize;
     iarc >> tsize;
     for (size_t i = 0;i < tsize; ++i) {
       key_id_type key; iarc >> key;
-      iarc >> field(key);
+      field_schema::slot_type slot;
+      if (!schema->find(key, slot)) {
+        slot = global_field_schema.slot(key);
+        schema = global_field_schema.snapshot();
+      }
+      iarc >> field(field_id(slot));
     }
   }
 
@@ -187,6 +293,12 @@ struct vars {
   const var& operator()(key_id_type key) const {
     return field(key);
   }
+  var& operator()(field_id f) {
+    return field(f);
+  }
+  const var& operator()(field_id f) const {
+    return field(f);
+  }
 
   var& field(const std::string& _key) {
     key_id_type key = get_id_from_name(_key);
@@ -208,32 +320,43 @@ struct vars {
   }
    
   var& field(key_id_type key) {
-    lock.lock();
-
-    for(std::pair<key_id_type , var*>& p: table) {
-      if (p.first == key) {
-        lock.unlock();
-        return *(p.second);
-      }
-    }
-    var* ret = new var;
-    // force slow resize to limit memory usage
-    // assume that field creation is not a common operation.
-    table.reserve(table.size() + 1);
-    table.push_back(std::make_pair(key, ret));
-    lock.unlock();
-    return *ret;
+    return field(field_id(global_field_schema.slot(key)));
   }
 
   const var& field(key_id_type key) const {
-    for(const std::pair<key_id_type , var*>& p: table) {
-      if (p.first == key) {
-        return *(p.second);
+    field_schema::slot_type slot;
+    if (global_field_schema.find(key, slot)) return field(field_id(slot));
+    return empty_var;
+  }
+
+  var& field(field_id f) {
+    if (f.slot >= values.size()) {
+      lock.lock();
+      // make room for every field known so far to limit resizes.
+      // assume that field creation is not a common operation.
+      if (f.slot >= values.size()) {
+        values.resize(std::max<size_t>(f.slot + 1, global_field_schema.size()));
       }
+      lock.unlock();
     }
+    return values[f.slot];
+  }
+
+  const var& field(field_id f) const {
+    if (f.slot < values.size()) return values[f.slot];
     return empty_var;
   }
 
+  /**
+   * Returns a double field without visiting the variant.
+   */
+  double& scalar(field_id f) {
+    return get<double>(field(f));
+  }
+  const double& scalar(field_id f) const {
+    return get<double>(field(f));
+  }
+
 }; 
 
 
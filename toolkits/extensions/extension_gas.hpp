@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <graphlab/vertex_program/ivertex_program.hpp>
+#include <graphlab/parallel/lockfree_push_back.hpp>
 #include "extension_data.hpp"
 #include "extension_gas_base_types.hpp"
 
@@ -1,8 +1,10 @@
 #ifndef GRAPHLAB_EXTENSION_GRAPH_HPP
 #define GRAPHLAB_EXTENSION_GRAPH_HPP
 
+#include <graphlab/engine/synchronous_engine.hpp>
 #include "extension_data.hpp"
 #include "extension_gas.hpp"
+#include "extension_scalar_gas.hpp"
 #include "extension_gas_lambda_wrapper.hpp"
 #include "extension_main.hpp"
 namespace graphlab {
@@ -88,10 +90,13 @@ class extension_graph {
     lock.lock();
     if (!finalized) {
       internal_graph.finalize();
-      internal_graph.transform_vertices([] (internal_graph_type::vertex_type& v) {
-                                        v.data().field("in_degree") = (double)v.num_in_edges();
-                                        v.data().field("out_degree") = (double)v.num_out_edges();
+      const field_id IN_DEG = get_field("in_degree");
+      const field_id OUT_DEG = get_field("out_degree");
+      internal_graph.transform_vertices([=] (internal_graph_type::vertex_type& v) {
+                                        v.data().field(IN_DEG) = (double)v.num_in_edges();
+                                        v.data().field(OUT_DEG) = (double)v.num_out_edges();
                                         });
+      finalized = true;
     }
     lock.unlock();
   }
@@ -108,35 +113,16 @@ class extension_graph {
              ApplyType apply,
              ScatterType scatter,
              size_t iterations = 0) {
-      finalize();
-      generic_gather<GatherType> g;
-      g.gt = &gather;
-
-      generic_combiner<CombinerType> c;
-      c.ct = &combiner;
-
-      generic_apply<ApplyType> a;
-      a.at = &apply;
-
-      generic_scatter<ScatterType> s;
-      s.st = &scatter;
-
-      gas_op_descriptor gd;
-      gd.gather_select_op = NULL;
-      gd.gather_op = &g;
-      gd.combiner_op = &c;
-      gd.apply_op = &a;
-      gd.scatter_select_op = NULL;
-      gd.scatter_op = &s;
-
-      lock.lock();
-      descriptor_id_type descid = descriptor_access.push_back(gd);
-      lock.unlock();
-
-      synchronous_dispatch_new_engine(descid);
+      all_edges_select gatherselect, scatterselect;
+      GAS(gatherselect, gather, combiner, apply, scatterselect, scatter,
+          iterations);
     }
 
-  /// Regular GAS
+  /**
+   * Regular GAS. If the gather returns a double and the combiner
+   * combines doubles, the program runs on the scalar fast path
+   * (see extension_scalar_gas.hpp). Otherwise the gather result is a var.
+   */
   template <typename GatherSelectType,
            typename GatherType,
            typename CombinerType,
@@ -151,6 +137,50 @@ class extension_graph {
              ScatterType scatter,
              size_t iterations = 0) {
       finalize();
+      dispatch_gas(gatherselect, gather, combiner, apply, 
+                   scatterselect, scatter,
+                   typename is_scalar_gas<GatherType, CombinerType>::type());
+    }
+
+ private:
+  template <typename GatherSelectType,
+           typename GatherType,
+           typename CombinerType,
+           typename ApplyType,
+           typename ScatterSelectType,
+           typename ScatterType>
+    void dispatch_gas(GatherSelectType& gatherselect,
+                      GatherType& gather,
+                      CombinerType& combiner,
+                      ApplyType& apply,
+                      ScatterSelectType& scatterselect,
+                      ScatterType& scatter,
+                      std::true_type /* scalar */) {
+      typedef scalar_gas_ops<GatherSelectType, GatherType, CombinerType,
+                             ApplyType, ScatterSelectType, ScatterType> ops_type;
+      ops_type ops = {&gatherselect, &gather, &combiner, 
+                      &apply, &scatterselect, &scatter};
+      ops_type::active = &ops;
+      synchronous_engine<scalar_update_functor<ops_type> > 
+          sync_engine(rmi.dc(), internal_graph, __glopts);
+      sync_engine.signal_all();
+      sync_engine.start();
+      ops_type::active = NULL;
+    }
+
+  template <typename GatherSelectType,
+           typename GatherType,
+           typename CombinerType,
+           typename ApplyType,
+           typename ScatterSelectType,
+           typename ScatterType>
+    void dispatch_gas(GatherSelectType& gatherselect,
+                      GatherType& gather,
+                      CombinerType& combiner,
+                      ApplyType& apply,
+                      ScatterSelectType& scatterselect,
+                      ScatterType& scatter,
+                      std::false_type /* scalar */) {
       generic_gather_select<GatherSelectType> gs;
       gs.gt = &gatherselect;
 
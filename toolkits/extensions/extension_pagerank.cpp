@@ -8,31 +8,31 @@ void pagerank(extension_graph& graph,
               double tolerance) {
   const std::string PR_CHANGE_NAME = PR_FIELD_NAME + "_change";
 
-  key_id_type PR_FIELD = get_id_from_name(PR_FIELD_NAME);
-  key_id_type PR_CHANGE = get_id_from_name(PR_CHANGE_NAME);
-  key_id_type OUT_DEG = get_id_from_name("out_degree");
+  // resolve the fields once. The gather and combine work on doubles,
+  // so the GAS runs on the scalar fast path.
+  const field_id PR_FIELD = get_field(PR_FIELD_NAME);
+  const field_id PR_CHANGE = get_field(PR_CHANGE_NAME);
+  const field_id OUT_DEG = get_field("out_degree");
 
-  graph.transform_field(PR_FIELD, [](var v){ return 0.15; });    
+  graph.transform_field(PR_FIELD_NAME, [](var v){ return 0.15; });    
   timer ti;
   graph.GAS(
       [](const vars&) { return graphlab::IN_EDGES; },             // gather_edges
-      [=](const vars&, vars&, const vars& other, edge_direction) { // gather
-          return get<double>(other(PR_FIELD)) / 
-                get<double>(other(OUT_DEG)) ;
+      [=](const vars&, vars&, const vars& other, edge_direction) -> double { // gather
+          return other.scalar(PR_FIELD) / other.scalar(OUT_DEG);
       }, 
-      [](var& a, const var& b) {                                  // combine
-          get<double>(a) += get<double>(b); 
+      [](double& a, const double& b) {                            // combine
+          a += b; 
       }, 
-      [=](vars& v, const var& result) -> bool {                    // apply
-          double pr = 0.15 + 0.85 * get<double>(result); 
-          v(PR_CHANGE) = 
-              std::fabs(pr - get<double>(v(PR_FIELD))) / 
-              get<double>(v(OUT_DEG));
-          v(PR_FIELD) = pr;         
+      [=](vars& v, double result) -> bool {                        // apply
+          double pr = 0.15 + 0.85 * result; 
+          v.scalar(PR_CHANGE) = 
+              std::fabs(pr - v.scalar(PR_FIELD)) / v.scalar(OUT_DEG);
+          v.scalar(PR_FIELD) = pr;         
           return false; 
       }, 
       [=](const vars& v) {                                        // scatter_edges
-          return get<double>(v.field(PR_CHANGE)) > tolerance ? 
+          return v.scalar(PR_CHANGE) > tolerance ? 
                                 graphlab::OUT_EDGES : graphlab::NO_EDGES; 
       },
       [](const vars&, const vars&, const vars&, edge_direction) {// scatter 
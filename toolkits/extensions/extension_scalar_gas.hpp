@@ -0,0 +1,152 @@
+#ifndef GRAPHLAB_EXTENSION_SCALAR_GAS_HPP
+#define GRAPHLAB_EXTENSION_SCALAR_GAS_HPP
+
+#include <type_traits>
+#include <utility>
+#include <graphlab/vertex_program/ivertex_program.hpp>
+#include "extension_data.hpp"
+#include "extension_gas_base_types.hpp"
+
+/*
+  A fast path for GAS programs whose gather produces a double.
+  When the gather returns a double and the combiner accepts
+  (double&, const double&), extension_graph::GAS runs a vertex program
+  which is compiled against the user functors directly: the gather
+  result is a plain double, and no variant or virtual call is made
+  between the engine and the user functions.
+*/
+
+namespace graphlab {
+namespace extension {
+
+/// Select functor used when the GAS call does not provide one
+struct all_edges_select {
+  edge_dir_type operator()(const vars& center) const {
+    return ALL_EDGES;
+  }
+};
+
+
+/**
+ * is_scalar_gas<GatherType, CombinerType>::type is std::true_type if
+ * the gather returns a double and the combiner can combine doubles.
+ */
+template <typename GatherType, typename CombinerType>
+struct is_scalar_gas {
+  template <typename G, typename C>
+  static auto test(int) -> 
+      decltype(std::declval<C&>()(std::declval<double&>(), 
+                                  std::declval<const double&>()),
+               std::is_same<
+                   typename std::decay<
+                       decltype(std::declval<G&>()(std::declval<const vars&>(),
+                                                   std::declval<vars&>(),
+                                                   std::declval<const vars&>(),
+                                                   IN_EDGE))>::type,
+                   double>());
+
+  template <typename G, typename C>
+  static std::false_type test(...);
+
+  typedef decltype(test<GatherType, CombinerType>(0)) type;
+};
+
+
+/**
+ * The user functors of a scalar GAS call. Each call site has its own
+ * functor types, and so its own instantiation; active points to the
+ * functors of the running engine.
+ */
+template <typename GatherSelectType,
+          typename GatherType,
+          typename CombinerType,
+          typename ApplyType,
+          typename ScatterSelectType,
+          typename ScatterType>
+struct scalar_gas_ops {
+  GatherSelectType* gather_select;
+  GatherType* gather;
+  CombinerType* combiner;
+  ApplyType* apply;
+  ScatterSelectType* scatter_select;
+  ScatterType* scatter;
+  static scalar_gas_ops* active;
+};
+
+template <typename GatherSelectType, typename GatherType, 
+          typename CombinerType, typename ApplyType,
+          typename ScatterSelectType, typename ScatterType>
+scalar_gas_ops<GatherSelectType, GatherType, CombinerType, 
+               ApplyType, ScatterSelectType, ScatterType>* 
+scalar_gas_ops<GatherSelectType, GatherType, CombinerType, 
+               ApplyType, ScatterSelectType, ScatterType>::active = NULL;
+
+
+// the gather type of the scalar vertex program
+template <typename Ops>
+struct scalar_gather: public graphlab::IS_POD_TYPE {
+  double value;
+  scalar_gather(double value = 0): value(value) { }
+  scalar_gather& operator+=(const scalar_gather& other) {
+    (*Ops::active->combiner)(value, other.value);
+    return *this;
+  }
+};
+
+
+template <typename Ops>
+struct scalar_update_functor: 
+    public graphlab::ivertex_program<internal_graph_type, scalar_gather<Ops> >,
+    public graphlab::IS_POD_TYPE {
+  typedef graphlab::ivertex_program<internal_graph_type, 
+                                    scalar_gather<Ops> > parent_type;
+  typedef typename parent_type::icontext_type icontext_type;
+  typedef typename parent_type::vertex_type vertex_type;
+  typedef typename parent_type::edge_type edge_type;
+  typedef typename parent_type::gather_type gather_type;
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return (*Ops::active->gather_select)(vertex.data());
+  }
+
+  inline gather_type gather(icontext_type& context, 
+                            const vertex_type& vertex,
+                            edge_type& edge) const {
+    const bool out_edge = edge.source().id() == vertex.id();
+    vertex_type other_vertex = out_edge ? edge.target() : edge.source();
+    return gather_type((*Ops::active->gather)(vertex.data(), 
+                                              edge.data(), 
+                                              other_vertex.data(),
+                                              out_edge ? OUT_EDGE : IN_EDGE));
+  }
+
+  inline void apply(icontext_type& context, vertex_type& vertex,
+                    const gather_type& total) {
+    if ((*Ops::active->apply)(vertex.data(), total.value)) {
+      context.signal(vertex);
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return (*Ops::active->scatter_select)(vertex.data());
+  }
+
+  inline void scatter(icontext_type& context, const vertex_type& vertex,
+                      edge_type& edge) const {
+    const bool out_edge = edge.source().id() == vertex.id();
+    vertex_type other_vertex = out_edge ? edge.target() : edge.source();
+    if ((*Ops::active->scatter)(vertex.data(), 
+                                edge.data(), 
+                                other_vertex.data(),
+                                out_edge ? OUT_EDGE : IN_EDGE)) {
+      context.signal(other_vertex);
+    }
+  }
+};
+
+} // namespace extension
+} // namespace graphlab
+
+#endif
@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+#include <graphlab.hpp>
+#include <graphlab/util/label_histogram.hpp>
+#include <graphlab/macros_def.hpp>
+
+/**
+ * Community detection on large graphs.
+ *
+ * Labels are interned into a global dictionary and handled as 32-bit
+ * ids, and each vertex gathers its neighborhood into a small
+ * open-addressed histogram, so no strings cross the network once the
+ * graph is loaded. Three modes are provided:
+ *
+ * \li \c classic Label propagation (Raghavan et al. 2007). Each vertex
+ *     takes the most frequent label among its neighbors.
+ * \li \c semi Semi-supervised label propagation. Labeled vertices are
+ *     fixed seeds and only unlabeled vertices adopt labels.
+ * \li \c louvain The local moving phase of the Louvain method (Blondel
+ *     et al. 2008). Each vertex starts in its own community and moves
+ *     to the neighboring community with the largest modularity gain,
+ *     in rounds, until few vertices move.
+ *
+ * The "labeled" input format has one vertex per line:
+ * \verbatim
+ *   [vertex id] [label] [neighbor id] [neighbor id] ...
+ * \endverbatim
+ * where a label of "-" marks an unlabeled vertex. With any other
+ * format all vertices start unlabeled, and classic mode starts every
+ * vertex with its own id as its label.
+ */
+
+/// The label of vertices which have none
+const uint32_t NO_LABEL = graphlab::label_histogram<>::NO_LABEL;
+
+struct vertex_data : public graphlab::IS_POD_TYPE {
+  /// A dictionary id, or the id of the founding vertex of the community
+  uint32_t label;
+  /// The number of adjacent edges
+  uint32_t degree;
+  /// semi: seeds never change label
+  bool fixed;
+  /// louvain: the vertex changed community in the last round
+  bool moved;
+  vertex_data() : label(NO_LABEL), degree(0),
+                  fixed(false), moved(false) { }
+};
+
+typedef graphlab::distributed_graph<vertex_data, graphlab::empty> graph_type;
+
+inline graph_type::vertex_type
+get_other_vertex(const graph_type::edge_type& edge,
+                 const graph_type::vertex_type& vertex) {
+  return vertex.id() == edge.source().id()? edge.target() : edge.source();
+}
+
+
+/**
+ * \brief Maps label strings to dense 32-bit ids shared by all
+ * machines.
+ *
+ * While loading, each machine interns the labels it parses under a
+ * provisional id, (local index) * numprocs + procid, which is unique
+ * across machines and may therefore travel with the vertex data to
+ * another machine. finalize() exchanges the label strings once and
+ * numbers them in sorted order; global_id() then translates the
+ * provisional ids.
+ */
+class label_dictionary {
+  graphlab::mutex lock;
+  size_t procid, numprocs;
+  boost::unordered_map<std::string, uint32_t> local_ids;
+  std::vector<std::string> local_labels;
+  std::vector<std::string> labels;
+  /// for every machine, the global id of each of its local labels
+  std::vector<std::vector<uint32_t> > remap;
+
+public:
+  label_dictionary() : procid(0), numprocs(1) { }
+
+  void init(graphlab::distributed_control& dc) {
+    procid = dc.procid();
+    numprocs = dc.numprocs();
+  }
+
+  /// Returns the provisional id of label. Thread safe.
+  uint32_t intern(const std::string& label) {
+    lock.lock();
+    boost::unordered_map<std::string, uint32_t>::const_iterator iter =
+      local_ids.find(label);
+    uint32_t index;
+    if (iter == local_ids.end()) {
+      index = local_labels.size();
+      local_ids[label] = index;
+      local_labels.push_back(label);
+    } else {
+      index = iter->second;
+    }
+    lock.unlock();
+    const uint64_t id = uint64_t(index) * numprocs + procid;
+    if (id >= NO_LABEL) {
+      logstream(LOG_FATAL) << "Too many distinct labels" << std::endl;
+    }
+    return uint32_t(id);
+  }
+
+  /// Assigns the global ids. Must be called on all machines.
+  void finalize(graphlab::distributed_control& dc) {
+    std::vector<std::vector<std::string> > all_labels(numprocs);
+    all_labels[procid].swap(local_labels);
+    dc.all_gather(all_labels);
+    labels.clear();
+    for (size_t i = 0; i < all_labels.size(); ++i) {
+      labels.insert(labels.end(), all_labels[i].begin(), all_labels[i].end());
+    }
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+    remap.resize(numprocs);
+    for (size_t i = 0; i < all_labels.size(); ++i) {
+      remap[i].resize(all_labels[i].size());
+      for (size_t j = 0; j < all_labels[i].size(); ++j) {
+        remap[i][j] = std::lower_bound(labels.begin(), labels.end(),
+                                       all_labels[i][j]) - labels.begin();
+      }
+    }
+    local_ids.clear();
+  }
+
+  uint32_t global_id(uint32_t provisional) const {
+    return remap[provisional % numprocs][provisional / numprocs];
+  }
+
+  /// The number of distinct labels. Valid after finalize().
+  size_t size() const { return labels.size(); }
+
+  const std::string& label(uint32_t id) const { return labels[id]; }
+}; // end of label_dictionary
+
+label_dictionary DICTIONARY;
+/// Whether labels are dictionary ids rather than vertex ids
+bool NAMED_LABELS = false;
+/// Whether labeled vertices keep their label
+bool FIX_SEEDS = false;
+
+
+bool labeled_line_parser(graph_type& graph, const std::string& filename,
+                         const std::string& textline) {
+  std::stringstream strm(textline);
+  graphlab::vertex_id_type vid;
+  std::string label;
+  strm >> vid >> label;
+  if (strm.fail()) return true;
+  vertex_data vdata;
+  if (label != "-") vdata.label = DICTIONARY.intern(label);
+  graph.add_vertex(vid, vdata);
+  while(1) {
+    graphlab::vertex_id_type other_vid;
+    strm >> other_vid;
+    if (strm.fail()) break;
+    graph.add_edge(vid, other_vid);
+  }
+  return true;
+}
+
+/// Translates provisional label ids and records degrees
+void initialize_labeled(graph_type::vertex_type& vertex) {
+  vertex_data& vdata = vertex.data();
+  if (vdata.label != NO_LABEL) vdata.label = DICTIONARY.global_id(vdata.label);
+  vdata.fixed = FIX_SEEDS && vdata.label != NO_LABEL;
+  vdata.degree = vertex.num_in_edges() + vertex.num_out_edges();
+}
+
+/// Starts every vertex in a community of its own
+void initialize_own_label(graph_type::vertex_type& vertex) {
+  vertex_data& vdata = vertex.data();
+  if (vertex.id() >= graphlab::vertex_id_type(NO_LABEL)) {
+    logstream(LOG_FATAL) << "Vertex id " << vertex.id()
+                         << " does not fit a 32-bit label" << std::endl;
+  }
+  vdata.label = uint32_t(vertex.id());
+  vdata.fixed = false;
+  vdata.degree = vertex.num_in_edges() + vertex.num_out_edges();
+}
+
+
+/**
+ * Label propagation. Fixed vertices keep their label; every other
+ * vertex takes the most frequent label of its neighbors, keeping its
+ * own label when it is tied for the lead.
+ */
+class label_propagation :
+  public graphlab::ivertex_program<graph_type,
+                                   graphlab::label_histogram<uint32_t> >,
+  public graphlab::IS_POD_TYPE {
+  bool changed;
+
+public:
+  label_propagation() : changed(false) { }
+
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return vertex.data().fixed ? graphlab::NO_EDGES : graphlab::ALL_EDGES;
+  }
+
+  gather_type gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    const uint32_t label = get_other_vertex(edge, vertex).data().label;
+    return label == NO_LABEL ? gather_type() : gather_type(label, 1);
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    changed = false;
+    if (vertex.data().fixed) return;
+    uint32_t label, count;
+    if (total.most_frequent(label, count, vertex.data().label) &&
+        label != vertex.data().label) {
+      vertex.data().label = label;
+      changed = true;
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return changed ? graphlab::ALL_EDGES : graphlab::NO_EDGES;
+  }
+
+  void scatter(icontext_type& context, const vertex_type& vertex,
+               edge_type& edge) const {
+    const vertex_type other = get_other_vertex(edge, vertex);
+    if (!other.data().fixed) context.signal(other);
+  }
+}; // end of label_propagation
+
+
+/// The total degree and the number of members of a community
+struct community_info : public graphlab::IS_POD_TYPE {
+  uint64_t total;
+  uint32_t members;
+  community_info() : total(0), members(0) { }
+  community_info(uint64_t total, uint32_t members) :
+    total(total), members(members) { }
+  community_info& operator+=(const community_info& other) {
+    total += other.total;
+    members += other.members;
+    return *this;
+  }
+};
+
+/**
+ * \brief The louvain community totals, partitioned across machines.
+ *
+ * The totals of community C live on machine C % numprocs, which sums
+ * the partial totals sent by every machine for its master vertices.
+ * Each machine then fetches only the totals of the communities its
+ * local vertices, masters and mirrors, belong to, so no machine holds
+ * the totals of all communities. Gathers read the totals of neighbor
+ * communities where the neighbor is local and carry them to the
+ * master.
+ */
+class community_table {
+  typedef boost::unordered_map<uint32_t, community_info> map_type;
+  typedef std::pair<uint32_t, community_info> entry_type;
+
+  graphlab::dc_dist_object<community_table> rpc;
+  graphlab::mutex lock;
+  /// the communities owned by this machine
+  map_type owned;
+  /// the communities of the local vertices
+  map_type local;
+
+  size_t owner(uint32_t label) const { return label % rpc.numprocs(); }
+
+  void add(const std::vector<entry_type>& partial) {
+    lock.lock();
+    for (size_t i = 0; i < partial.size(); ++i) {
+      owned[partial[i].first] += partial[i].second;
+    }
+    lock.unlock();
+  }
+
+  std::vector<community_info> lookup(const std::vector<uint32_t>& labels) {
+    std::vector<community_info> ret(labels.size());
+    lock.lock();
+    for (size_t i = 0; i < labels.size(); ++i) {
+      map_type::const_iterator iter = owned.find(labels[i]);
+      if (iter != owned.end()) ret[i] = iter->second;
+    }
+    lock.unlock();
+    return ret;
+  }
+
+public:
+  community_table(graphlab::distributed_control& dc) : rpc(dc, this) {
+    rpc.barrier();
+  }
+
+  /// Recomputes the totals from the current labels. Must be called on
+  /// all machines.
+  void update(graph_type& graph) {
+    owned.clear();
+    local.clear();
+    rpc.barrier();
+    std::vector<map_type> partial(rpc.numprocs());
+    std::vector<std::vector<uint32_t> > needed(rpc.numprocs());
+    for (size_t i = 0; i < graph.num_local_vertices(); ++i) {
+      const graph_type::local_vertex_type lvertex = graph.l_vertex(i);
+      const uint32_t label = lvertex.data().label;
+      if (lvertex.owned()) {
+        partial[owner(label)][label] +=
+          community_info(lvertex.data().degree, 1);
+      }
+      if (local.insert(std::make_pair(label, community_info())).second) {
+        needed[owner(label)].push_back(label);
+      }
+    }
+    for (size_t p = 0; p < partial.size(); ++p) {
+      const std::vector<entry_type> entries(partial[p].begin(),
+                                            partial[p].end());
+      if (p == rpc.procid()) add(entries);
+      else rpc.remote_call(p, &community_table::add, entries);
+    }
+    rpc.full_barrier();
+    for (size_t p = 0; p < needed.size(); ++p) {
+      if (needed[p].empty()) continue;
+      const std::vector<community_info> infos = p == rpc.procid() ?
+        lookup(needed[p]) :
+        rpc.remote_request(p, &community_table::lookup, needed[p]);
+      for (size_t i = 0; i < infos.size(); ++i) {
+        local[needed[p][i]] = infos[i];
+      }
+    }
+    rpc.barrier();
+  }
+
+  /// The community of a local vertex, as of the last update(). Labels
+  /// adopted since then are missing, so the vertices may only move
+  /// all at once between updates, as in the synchronous engine.
+  const community_info& get(uint32_t label) const {
+    map_type::const_iterator iter = local.find(label);
+    ASSERT_TRUE(iter != local.end());
+    return iter->second;
+  }
+
+  /// The sum of the squared community totals, and the number of
+  /// communities. Must be called on all machines.
+  std::pair<double, size_t> summarize() {
+    std::pair<double, size_t> ret(0, owned.size());
+    foreach(const map_type::value_type& entry, owned) {
+      ret.first += double(entry.second.total) * entry.second.total;
+    }
+    rpc.all_reduce(ret.first);
+    rpc.all_reduce(ret.second);
+    return ret;
+  }
+}; // end of community_table
+
+community_table* COMMUNITIES = NULL;
+/// Twice the number of edges
+double TOTAL_WEIGHT = 0;
+
+/**
+ * The edges into each neighboring community, and for each, its total
+ * and its number of members times those edges. The totals are read on
+ * the machine of the edge, where the neighbor is a local vertex.
+ */
+struct louvain_gather {
+  graphlab::label_histogram<uint32_t> links;
+  graphlab::label_histogram<uint64_t, 4> totals;
+  graphlab::label_histogram<uint64_t, 4> members;
+
+  louvain_gather& operator+=(const louvain_gather& other) {
+    links += other.links;
+    totals += other.totals;
+    members += other.members;
+    return *this;
+  }
+  void save(graphlab::oarchive& oarc) const {
+    oarc << links << totals << members;
+  }
+  void load(graphlab::iarchive& iarc) {
+    iarc >> links >> totals >> members;
+  }
+};
+
+/**
+ * One round of the louvain local moving phase. Each vertex moves to
+ * the neighboring community C maximizing
+ *
+ *   links(C) - total(C) * degree / (2m)
+ *
+ * where the vertex's own degree is first removed from the total of
+ * its current community. Since all vertices move at once, a vertex
+ * alone in its community only joins another lone vertex with a
+ * smaller label, which prevents pairs from swapping forever.
+ */
+class louvain :
+  public graphlab::ivertex_program<graph_type, louvain_gather>,
+  public graphlab::IS_POD_TYPE {
+public:
+  edge_dir_type gather_edges(icontext_type& context,
+                             const vertex_type& vertex) const {
+    return graphlab::ALL_EDGES;
+  }
+
+  gather_type gather(icontext_type& context, const vertex_type& vertex,
+                     edge_type& edge) const {
+    const uint32_t label = get_other_vertex(edge, vertex).data().label;
+    const community_info& info = COMMUNITIES->get(label);
+    gather_type ret;
+    ret.links.add(label, 1);
+    ret.totals.add(label, info.total);
+    ret.members.add(label, info.members);
+    return ret;
+  }
+
+  void apply(icontext_type& context, vertex_type& vertex,
+             const gather_type& total) {
+    vertex_data& vdata = vertex.data();
+    const uint32_t current = vdata.label;
+    const double degree = vdata.degree;
+    vdata.moved = false;
+    if (vdata.degree == 0) return;
+    const community_info& own = COMMUNITIES->get(current);
+    const bool singleton = own.members == 1;
+    // the total of the current community without this vertex
+    const double current_rest = double(own.total) - degree;
+    double best_gain = total.links.get(current) -
+      current_rest * degree / TOTAL_WEIGHT;
+    uint32_t best = current;
+    for (size_t i = 0; i < total.links.num_slots(); ++i) {
+      const uint32_t label = total.links.slot(i).label;
+      if (label == NO_LABEL || label == current) continue;
+      const uint64_t links = total.links.slot(i).count;
+      const bool target_singleton = total.members.get(label) == links;
+      if (singleton && target_singleton && label > current) continue;
+      const double gain = links -
+        double(total.totals.get(label) / links) * degree / TOTAL_WEIGHT;
+      if (gain > best_gain || (gain == best_gain && best != current &&
+                               label < best)) {
+        best_gain = gain;
+        best = label;
+      }
+    }
+    if (best != current) {
+      vdata.label = best;
+      vdata.moved = true;
+    }
+  }
+
+  edge_dir_type scatter_edges(icontext_type& context,
+                              const vertex_type& vertex) const {
+    return graphlab::NO_EDGES;
+  }
+}; // end of louvain
+
+
+size_t count_moved(const graph_type::vertex_type& vertex) {
+  return vertex.data().moved;
+}
+
+/// Both directions of the edges inside a community
+double internal_weight(const graph_type::edge_type& edge) {
+  return edge.source().data().label == edge.target().data().label ? 2 : 0;
+}
+
+/**
+ * The modularity of the current labels. Must be called on all
+ * machines after COMMUNITIES->update().
+ */
+double modularity(graph_type& graph, size_t& ncommunities) {
+  const double internal = graph.map_reduce_edges<double>(internal_weight);
+  const std::pair<double, size_t> summary = COMMUNITIES->summarize();
+  ncommunities = summary.second;
+  return internal / TOTAL_WEIGHT -
+    summary.first / (TOTAL_WEIGHT * TOTAL_WEIGHT);
+}
+
+void run_louvain(graphlab::distributed_control& dc, graph_type& graph,
+                 const std::string& exec_type,
+                 graphlab::command_line_options& clopts,
+                 size_t max_rounds, double tolerance) {
+  TOTAL_WEIGHT = 2.0 * graph.num_edges();
+  if (TOTAL_WEIGHT == 0) return;
+  graphlab::omni_engine<louvain> engine(dc, graph, exec_type, clopts);
+  community_table communities(dc);
+  COMMUNITIES = &communities;
+  communities.update(graph);
+  size_t ncommunities = 0;
+  double current = modularity(graph, ncommunities);
+  for (size_t round = 0; round < max_rounds; ++round) {
+    engine.signal_all();
+    engine.start();
+    communities.update(graph);
+    current = modularity(graph, ncommunities);
+    const size_t moved = graph.map_reduce_vertices<size_t>(count_moved);
+    dc.cout() << "Round " << round << ": modularity " << current
+              << " over " << ncommunities << " communities, "
+              << moved << " vertices moved" << std::endl;
+    if (moved <= tolerance * graph.num_vertices()) break;
+  }
+  dc.cout() << "Final modularity " << current << " over "
+            << ncommunities << " communities" << std::endl;
+  COMMUNITIES = NULL;
+}
+
+
+struct community_writer {
+  std::string save_vertex(graph_type::vertex_type v) {
+    std::stringstream strm;
+    strm << v.id() << "\t";
+    const uint32_t label = v.data().label;
+    if (label == NO_LABEL) strm << "-";
+    else if (NAMED_LABELS) strm << DICTIONARY.label(label);
+    else strm << label;
+    strm << "\n";
+    return strm.str();
+  }
+  std::string save_edge(graph_type::edge_type e) { return ""; }
+};
+
+
+int main(int argc, char** argv) {
+  graphlab::mpi_tools::init(argc, argv);
+  graphlab::distributed_control dc;
+  global_logger().set_log_level(LOG_INFO);
+
+  graphlab::command_line_options clopts("Community detection.");
+  std::string graph_dir;
+  std::string format = "labeled";
+  std::string exec_type = "synchronous";
+  std::string mode = "classic";
+  std::string saveprefix;
+  size_t max_rounds = 100;
+  double tolerance = 0;
+  clopts.attach_option("graph", graph_dir,
+                       "The graph file. Required.");
+  clopts.add_positional("graph");
+  clopts.attach_option("format", format,
+                       "The graph file format. \"labeled\" lines are "
+                       "[vertex] [label or -] [neighbors...]; any other "
+                       "format leaves all vertices unlabeled.");
+  clopts.attach_option("engine", exec_type,
+                       "The engine type synchronous or asynchronous. "
+                       "louvain always runs synchronously");
+  clopts.attach_option("mode", mode,
+                       "classic, semi (labeled vertices are fixed seeds) "
+                       "or louvain");
+  clopts.attach_option("max_rounds", max_rounds,
+                       "louvain: the maximum number of rounds");
+  clopts.attach_option("tolerance", tolerance,
+                       "louvain: stop once at most this fraction of the "
+                       "vertices moves in a round");
+  clopts.attach_option("saveprefix", saveprefix,
+                       "If set, will save the label of each vertex to a "
+                       "sequence of files with prefix saveprefix");
+  if (!clopts.parse(argc, argv)) {
+    dc.cout() << "Error in parsing command line arguments." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (graph_dir == "") {
+    dc.cout() << "Graph not specified. Cannot continue" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (mode != "classic" && mode != "semi" && mode != "louvain") {
+    dc.cout() << "Unknown mode " << mode << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (mode == "semi" && format != "labeled") {
+    dc.cout() << "semi mode requires the labeled format" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  graph_type graph(dc, clopts);
+  dc.cout() << "Loading graph in format: " << format << std::endl;
+  DICTIONARY.init(dc);
+  if (format == "labeled") graph.load(graph_dir, labeled_line_parser);
+  else graph.load_format(graph_dir, format);
+  graph.finalize();
+  DICTIONARY.finalize(dc);
+  dc.cout() << "#vertices: " << graph.num_vertices()
+            << " #edges: " << graph.num_edges()
+            << " #labels: " << DICTIONARY.size() << std::endl;
+
+  graphlab::timer ti;
+  if (mode == "louvain" || (mode == "classic" && format != "labeled")) {
+    graph.transform_vertices(initialize_own_label);
+  } else {
+    NAMED_LABELS = true;
+    FIX_SEEDS = (mode == "semi");
+    graph.transform_vertices(initialize_labeled);
+  }
+
+  if (mode == "louvain") {
+    // rounds move all vertices at once against the totals of the last
+    // round, and the community table only holds the labels seen then
+    dc.cout() << "louvain mode. Forcing Synchronous engine." << std::endl;
+    exec_type = "synchronous";
+    clopts.get_engine_args().set_option("type", "synchronous");
+    run_louvain(dc, graph, exec_type, clopts, max_rounds, tolerance);
+  } else {
+    graphlab::omni_engine<label_propagation> engine(dc, graph, exec_type, clopts);
+    engine.signal_all();
+    engine.start();
+  }
+  dc.cout() << "Finished in " << ti.current_time() << " seconds." << std::endl;
+
+  if (saveprefix != "") {
+    graph.save(saveprefix, community_writer(),
+               false,  // do not gzip
+               true,   // save vertices
+               false); // do not save edges
+  }
+
+  graphlab::mpi_tools::finalize();
+  return EXIT_SUCCESS;
+}
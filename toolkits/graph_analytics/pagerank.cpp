@@ -36,8 +36,16 @@ size_t ITERATIONS = 0;
 
 bool USE_DELTA_CACHE = false;
 
-// The vertex data is just the pagerank value (a double)
-typedef double vertex_data_type;
+/*
+ * The vertex data is the pagerank value together with the out degree
+ * of the vertex, so that the contribution of a vertex to its out
+ * neighbors only depends on its data.
+ */
+struct vertex_data_type : public graphlab::IS_POD_TYPE {
+  double rank;
+  size_t num_out_edges;
+  vertex_data_type() : rank(0), num_out_edges(0) { }
+};
 
 // There is no edge data in the pagerank application
 typedef graphlab::empty edge_data_type;
@@ -49,7 +57,22 @@ typedef graphlab::distributed_graph<vertex_data_type, edge_data_type> graph_type
  * A simple function used by graph.transform_vertices(init_vertex);
  * to initialize the vertes data.
  */
-void init_vertex(graph_type::vertex_type& vertex) { vertex.data() = 1; }
+void init_vertex(graph_type::vertex_type& vertex) {
+  vertex.data().rank = 1;
+  vertex.data().num_out_edges = vertex.num_out_edges();
+}
+
+/*
+ * Refreshes the out degree of a vertex after edges were added to the
+ * graph.
+ */
+void update_out_degree(graph_type::vertex_type& vertex) {
+  vertex.data().num_out_edges = vertex.num_out_edges();
+}
+
+void update_out_degrees(graph_type& graph, const graphlab::vertex_set& vset) {
+  graph.transform_vertices(update_out_degree, vset);
+}
 
 
 
@@ -72,9 +95,15 @@ void init_vertex(graph_type::vertex_type& vertex) { vertex.data() = 1; }
  * (converted to a byte stream) by directly reading its in memory
  * representation.  If a vertex program does not exted
  * graphlab::IS_POD_TYPE it must implement load and save functions.
+ *
+ * Since the gather only reads the data of the source vertex, pagerank
+ * also extends graphlab::IS_BULK_GATHER which lets the synchronous
+ * engine compute the gather with a tight loop over the local
+ * adjacency.
  */
 class pagerank :
-  public graphlab::ivertex_program<graph_type, double> {
+  public graphlab::ivertex_program<graph_type, double>,
+  public graphlab::IS_BULK_GATHER {
 
   double last_change;
 public:
@@ -91,7 +120,14 @@ public:
   /* Gather the weighted rank of the adjacent page   */
   double gather(icontext_type& context, const vertex_type& vertex,
                edge_type& edge) const {
-    return (edge.source().data() / edge.source().num_out_edges());
+    return gather_edge(edge.source().data(), edge.data(), vertex.data());
+  }
+
+  /* The same as gather, for the bulk gather of the engine */
+  static double gather_edge(const vertex_data_type& source,
+                            const edge_data_type& edge,
+                            const vertex_data_type& target) {
+    return source.rank / source.num_out_edges;
   }
 
   /* Use the total rank of adjacent pages to update this page */
@@ -99,8 +135,8 @@ public:
              const gather_type& total) {
 
     const double newval = (1.0 - RESET_PROB) * total + RESET_PROB;
-    last_change = (newval - vertex.data());
-    vertex.data() = newval;
+    last_change = (newval - vertex.data().rank);
+    vertex.data().rank = newval;
     if (ITERATIONS) context.signal(vertex);
   }
 
@@ -153,18 +189,18 @@ public:
 struct pagerank_writer {
   std::string save_vertex(graph_type::vertex_type v) {
     std::stringstream strm;
-    strm << v.id() << "\t" << v.data() << "\n";
+    strm << v.id() << "\t" << v.data().rank << "\n";
     return strm.str();
   }
   std::string save_edge(graph_type::edge_type e) { return ""; }
 }; // end of pagerank writer
 
 
-double map_rank(const graph_type::vertex_type& v) { return v.data(); }
+double map_rank(const graph_type::vertex_type& v) { return v.data().rank; }
 
 
 double pagerank_sum(graph_type::vertex_type v) {
-  return v.data();
+  return v.data().rank;
 }
 
 int main(int argc, char** argv) {
@@ -203,6 +239,19 @@ int main(int argc, char** argv) {
   clopts.attach_option("saveprefix", saveprefix,
                        "If set, will save the resultant pagerank to a "
                        "sequence of files with prefix saveprefix");
+  std::string stream_spec;
+  clopts.attach_option("stream", stream_spec,
+                       "If set, keeps the pagerank up to date as edges arrive "
+                       "on this source: a named pipe, tcp://host:port to "
+                       "connect to a producer or listen://port to wait for "
+                       "one. Each line holds a source and a target id.");
+  size_t batch_size = 10000;
+  clopts.attach_option("batch_size", batch_size,
+                       "The largest number of streamed edges applied at once.");
+  double batch_window = 0.1;
+  clopts.attach_option("batch_window", batch_window,
+                       "The longest time in seconds streamed edges are "
+                       "held back before they are applied.");
 
   if(!clopts.parse(argc, argv)) {
     dc.cout() << "Error in parsing command line arguments." << std::endl;
@@ -213,6 +262,13 @@ int main(int argc, char** argv) {
   // Enable gather caching in the engine
   clopts.get_engine_args().set_option("use_cache", USE_DELTA_CACHE);
 
+  if (stream_spec.length() > 0 && !ITERATIONS) {
+    // only the synchronous engine adapts to the graph growing between runs
+    dc.cout() << "--stream set. Forcing Synchronous engine." << std::endl;
+    exec_type = "synchronous";
+    clopts.get_engine_args().set_option("type", "synchronous");
+  }
+
   if (ITERATIONS) {
     // make sure this is the synchronous engine
     dc.cout() << "--iterations set. Forcing Synchronous engine, and running "
@@ -232,8 +288,8 @@ int main(int argc, char** argv) {
     dc.cout() << "Loading graph in format: "<< format << std::endl;
     graph.load_format(graph_dir, format);
   }
-  else {
-    dc.cout() << "graph or powerlaw option must be specified" << std::endl;
+  else if (stream_spec.length() == 0) {
+    dc.cout() << "graph, powerlaw or stream option must be specified" << std::endl;
     clopts.print_description();
     return 0;
   }
@@ -253,6 +309,26 @@ int main(int argc, char** argv) {
   dc.cout() << "Finished Running engine in " << runtime
             << " seconds." << std::endl;
 
+  // Follow the stream -------------------------------------------------------
+  if (stream_spec.length() > 0) {
+    graphlab::stream_ingest<graph_type> stream(dc, graph);
+    stream.set_batch_size(batch_size);
+    stream.set_batch_window(batch_window);
+    // a new edge changes the out degree of its source and with it the
+    // contribution of the source to all of its out neighbors
+    stream.set_signal_neighbors(graphlab::OUT_EDGES);
+    stream.set_batch_callback(boost::bind(update_out_degrees,
+                                          boost::ref(graph), _1));
+    if (!stream.open(stream_spec)) {
+      dc.cout() << "Unable to open the stream " << stream_spec << std::endl;
+      return EXIT_FAILURE;
+    }
+    const graphlab::stream_ingest_metrics metrics = stream.run(engine);
+    dc.cout() << "Stream ended. " << metrics << std::endl;
+    dc.cout() << "#vertices: " << graph.num_vertices()
+              << " #edges:" << graph.num_edges() << std::endl;
+  }
+
 
   const double total_rank = graph.map_reduce_vertices<double>(map_rank);
   std::cout << "Total rank: " << total_rank << std::endl;
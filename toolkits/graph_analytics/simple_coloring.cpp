@@ -21,9 +21,9 @@
  */
 
 
-#include <boost/unordered_set.hpp>
 #include <graphlab.hpp>
 #include <graphlab/ui/metrics_server.hpp>
+#include <graphlab/util/small_gather_set.hpp>
 #include <graphlab/macros_def.hpp>
 
 
@@ -37,39 +37,11 @@ bool EDGE_CONSISTENT = false;
 
 
 /*
- * This is the gathering type which accumulates an (unordered) set of
- * all neighboring colors 
- * It is a simple wrapper around a boost::unordered_set with
- * an operator+= which simply performs a set union.
- *
- * This struct can be significantly accelerated for small sets.
- * Small collections of vertex IDs should not require the overhead
- * of the unordered_set.
+ * This is the gathering type which accumulates a set of all
+ * neighboring colors. Most vertices have few neighbors, so up to
+ * 16 colors are stored inline without allocating.
  */
-struct set_union_gather {
-  boost::unordered_set<color_type> colors;
-
-  /*
-   * Combining with another collection of vertices.
-   * Union it into the current set.
-   */
-  set_union_gather& operator+=(const set_union_gather& other) {
-    foreach(graphlab::vertex_id_type othervid, other.colors) {
-      colors.insert(othervid);
-    }
-    return *this;
-  }
-  
-  // serialize
-  void save(graphlab::oarchive& oarc) const {
-    oarc << colors;
-  }
-
-  // deserialize
-  void load(graphlab::iarchive& iarc) {
-    iarc >> colors;
-  }
-};
+typedef graphlab::small_gather_set<16, color_type> set_union_gather;
 
 /*
  * Define the type of the graph
@@ -100,13 +72,9 @@ public:
   gather_type gather(icontext_type& context,
                      const vertex_type& vertex,
                      edge_type& edge) const {
-    set_union_gather gather;
     color_type other_color = edge.source().id() == vertex.id() ?
                                  edge.target().data(): edge.source().data();
-    // vertex_id_type otherid= edge.source().id() == vertex.id() ?
-    //                              edge.target().id(): edge.source().id();
-     gather.colors.insert(other_color);
-    return gather;
+    return set_union_gather(other_color);
   }
 
   /*
@@ -114,15 +82,17 @@ public:
    * pick a different color and store it 
    */
   void apply(icontext_type& context, vertex_type& vertex,
-             const gather_type& neighborhood) {
-    // find the smallest color not described in the neighborhood
-    size_t neighborhoodsize = neighborhood.colors.size();
-    for (color_type curcolor = 0; curcolor < neighborhoodsize + 1; ++curcolor) {
-      if (neighborhood.colors.count(curcolor) == 0) {
-        vertex.data() = curcolor;
-        break;
-      }
+             const gather_type& total) {
+    set_union_gather neighborhood(total);
+    neighborhood.normalize();
+    // find the smallest color not described in the neighborhood.
+    // the colors are sorted so this is the first gap.
+    color_type curcolor = 0;
+    foreach(color_type color, neighborhood) {
+      if (color > curcolor) break;
+      curcolor = color + 1;
     }
+    vertex.data() = curcolor;
   }
 
 
@@ -53,6 +53,10 @@ struct vertex_data : graphlab::IS_POD_TYPE {
     dist(dist) { }
 }; // end of vertex data
 
+// Most applies leave the distance unchanged, and those vertices need
+// not be resent to their mirrors.
+GRAPHLAB_DATA_FIELDS(vertex_data, (dist))
+
 
 
 /**
@@ -243,7 +247,7 @@ int main(int argc, char** argv) {
                        "Treat edges as directed.");
 
   clopts.attach_option("engine", exec_type, 
-                       "The engine type synchronous or asynchronous");
+                       "The engine type synchronous, asynchronous or adaptive");
  
   
   clopts.attach_option("powerlaw", powerlaw,
@@ -25,6 +25,7 @@
 #include <graphlab.hpp>
 #include <graphlab/ui/metrics_server.hpp>
 #include <graphlab/util/hopscotch_set.hpp>
+#include <graphlab/util/small_gather_set.hpp>
 #include <graphlab/macros_def.hpp>
 /**
  *  
@@ -69,88 +70,20 @@
  */
  
 
-// Radix sort implementation from https://github.com/gorset/radix
-// Thanks to Erik Gorset
-//
-/*
-Copyright 2011 Erik Gorset. All rights reserved.
-
-Redistribution and use in source and binary forms, with or without modification, are
-permitted provided that the following conditions are met:
-
-1. Redistributions of source code must retain the above copyright notice, this list of
-conditions and the following disclaimer.
-
-2. Redistributions in binary form must reproduce the above copyright notice, this list
-of conditions and the following disclaimer in the documentation and/or other materials
-provided with the distribution.
-
-THIS SOFTWARE IS PROVIDED BY Erik Gorset ``AS IS'' AND ANY EXPRESS OR IMPLIED
-WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
-FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Erik Gorset OR
-CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
-CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
-ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
-NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
-ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-
-The views and conclusions contained in the software and documentation are those of the
-authors and should not be interpreted as representing official policies, either expressed
-or implied, of Erik Gorset.
-*/
-void radix_sort(graphlab::vertex_id_type *array, int offset, int end, int shift) {
-    int x, y;
-    graphlab::vertex_id_type value, temp;
-    int last[256] = { 0 }, pointer[256];
-
-    for (x=offset; x<end; ++x) {
-        ++last[(array[x] >> shift) & 0xFF];
-    }
-
-    last[0] += offset;
-    pointer[0] = offset;
-    for (x=1; x<256; ++x) {
-        pointer[x] = last[x-1];
-        last[x] += last[x-1];
-    }
-
-    for (x=0; x<256; ++x) {
-        while (pointer[x] != last[x]) {
-            value = array[pointer[x]];
-            y = (value >> shift) & 0xFF;
-            while (x != y) {
-                temp = array[pointer[y]];
-                array[pointer[y]++] = value;
-                value = temp;
-                y = (value >> shift) & 0xFF;
-            }
-            array[pointer[x]++] = value;
-        }
-    }
-
-    if (shift > 0) {
-        shift -= 8;
-        for (x=0; x<256; ++x) {
-            temp = x > 0 ? pointer[x] - pointer[x-1] : pointer[0] - offset;
-            if (temp > 64) {
-                radix_sort(array, pointer[x] - temp, pointer[x], shift);
-            } else if (temp > 1) {
-                std::sort(array + (pointer[x] - temp), array + pointer[x]);
-                //insertion_sort(array, pointer[x] - temp, pointer[x]);
-            }
-        }
-    }
-}
-
 size_t HASH_THRESHOLD = 64;
 
-// We on each vertex, either a vector of sorted VIDs
+/*
+ * A set of neighboring vertex IDs. Up to 16 IDs are stored inline,
+ * larger sets are stored as sorted vectors.
+ */
+typedef graphlab::small_gather_set<16, graphlab::vertex_id_type> neighbor_set;
+
+// We on each vertex, either a sorted set of VIDs
 // or a hash set (cuckoo hash) of VIDs.
 // If the number of elements is greater than HASH_THRESHOLD,
-// the hash set is used. Otherwise the vector is used.
+// the hash set is used. Otherwise the sorted set is used.
 struct vid_vector{
-  std::vector<graphlab::vertex_id_type> vid_vec;
+  neighbor_set vids;
   graphlab::hopscotch_set<graphlab::vertex_id_type> *cset;
   vid_vector(): cset(NULL) { }
   vid_vector(const vid_vector& v):cset(NULL) {
@@ -159,7 +92,7 @@ struct vid_vector{
 
   vid_vector& operator=(const vid_vector& v) {
     if (this == &v) return *this;
-    vid_vec = v.vid_vec;
+    vids = v.vids;
     if (v.cset != NULL) {
       // allocate the cuckoo set if the other side is using a cuckoo set
       // or clear if I alrady have one
@@ -186,44 +119,35 @@ struct vid_vector{
     if (cset != NULL) delete cset;
   }
 
-  // assigns a vector of vertex IDs to this storage.
+  // assigns a normalized set of vertex IDs to this storage.
   // this function will clear the contents of the vid_vector
   // and reconstruct it.
   // If the assigned values has length >= HASH_THRESHOLD,
   // we will allocate a cuckoo set to store it. Otherwise,
-  // we just store a sorted vector
-  void assign(const std::vector<graphlab::vertex_id_type>& vec) {
+  // we just store the sorted set
+  void assign(const neighbor_set& set) {
     clear();
-    if (vec.size() >= HASH_THRESHOLD) {
+    if (set.size() >= HASH_THRESHOLD) {
         // move to cset
         cset = new graphlab::hopscotch_set<graphlab::vertex_id_type>(HASH_THRESHOLD);
-        foreach (graphlab::vertex_id_type v, vec) {
+        foreach (graphlab::vertex_id_type v, set) {
           cset->insert(v);
         }
     }
     else {
-      vid_vec = vec;
-      if (vid_vec.size() > 64) {
-        radix_sort(&(vid_vec[0]), 0, vid_vec.size(), 24);
-      }
-      else {
-        std::sort(vid_vec.begin(), vid_vec.end());
-      }
-      std::vector<graphlab::vertex_id_type>::iterator new_end = std::unique(vid_vec.begin(),
-                                               vid_vec.end());
-      vid_vec.erase(new_end, vid_vec.end());
+      vids = set;
     }
   }
 
   void save(graphlab::oarchive& oarc) const {
     oarc << (cset != NULL);
-    if (cset == NULL) oarc << vid_vec;
+    if (cset == NULL) oarc << vids;
     else oarc << (*cset);
   }
 
 
   void clear() {
-    vid_vec.clear();
+    vids.clear();
     if (cset != NULL) {
       delete cset;
       cset = NULL;
@@ -231,14 +155,14 @@ struct vid_vector{
   }
 
   size_t size() const {
-    return cset == NULL ? vid_vec.size() : cset->size();
+    return cset == NULL ? vids.size() : cset->size();
   }
 
   void load(graphlab::iarchive& iarc) {
     clear();
     bool hascset;
     iarc >> hascset;
-    if (!hascset) iarc >> vid_vec;
+    if (!hascset) iarc >> vids;
     else {
       cset = new graphlab::hopscotch_set<graphlab::vertex_id_type>(HASH_THRESHOLD);
       iarc >> (*cset);
@@ -246,35 +170,6 @@ struct vid_vector{
   }
 };
 
-/*
-  A simple counting iterator which can be used as an insert iterator.
-  but only counts the number of elements inserted. Useful for
-  use with counting the size of an intersection using std::set_intersection
-*/
-template <typename T>
-struct counting_inserter {
-  size_t* i;
-  counting_inserter(size_t* i):i(i) { }
-  counting_inserter& operator++() {
-    ++(*i);
-    return *this;
-  }
-  void operator++(int) {
-    ++(*i);
-  }
-
-  struct empty_val {
-    empty_val operator=(const T&) { return empty_val(); }
-  };
-
-  empty_val operator*() {
-    return empty_val();
-  }
-
-  typedef empty_val reference;
-};
-
-
 /*
  * Computes the size of the intersection of two vid_vector's
  */
@@ -283,23 +178,18 @@ static uint32_t count_set_intersect(
              const vid_vector& larger_set) {
 
   if (smaller_set.cset == NULL && larger_set.cset == NULL) {
-    size_t i = 0;
-    counting_inserter<graphlab::vertex_id_type> iter(&i);
-    std::set_intersection(smaller_set.vid_vec.begin(), smaller_set.vid_vec.end(),
-                          larger_set.vid_vec.begin(), larger_set.vid_vec.end(),
-                          iter);
-    return i;
+    return graphlab::intersection_size(smaller_set.vids, larger_set.vids);
   }
   else if (smaller_set.cset == NULL && larger_set.cset != NULL) {
     size_t i = 0;
-    foreach(graphlab::vertex_id_type vid, smaller_set.vid_vec) {
+    foreach(graphlab::vertex_id_type vid, smaller_set.vids) {
       i += larger_set.cset->count(vid);
     }
     return i;
   }
   else if (smaller_set.cset != NULL && larger_set.cset == NULL) {
     size_t i = 0;
-    foreach(graphlab::vertex_id_type vid, larger_set.vid_vec) {
+    foreach(graphlab::vertex_id_type vid, larger_set.vids) {
       i += smaller_set.cset->count(vid);
     }
     return i;
@@ -351,69 +241,11 @@ bool PER_VERTEX_COUNT = false;
 
 
 /*
- * This is the gathering type which accumulates an array of
- * all neighboring vertices.
- * It is a simple wrapper around a vector with
- * an operator+= which simply performs a  +=
+ * This is the gathering type which accumulates the set of
+ * neighboring vertices. Small sets are stored inline, so that
+ * gathering on low degree vertices does not allocate.
  */
-struct set_union_gather {
-  graphlab::vertex_id_type v;
-  std::vector<graphlab::vertex_id_type> vid_vec;
-
-  set_union_gather():v(-1) {
-  }
-
-  size_t size() const {
-    if (v == (graphlab::vertex_id_type)-1) return vid_vec.size();
-    else return 1;
-  }
-  /*
-   * Combining with another collection of vertices.
-   * Union it into the current set.
-   */
-  set_union_gather& operator+=(const set_union_gather& other) {
-    if (size() == 0) {
-      (*this) = other;
-      return (*this);
-    }
-    else if (other.size() == 0) {
-      return *this;
-    }
-
-    if (vid_vec.size() == 0) {
-      vid_vec.push_back(v);
-      v = (graphlab::vertex_id_type)(-1);
-    }
-    if (other.vid_vec.size() > 0) {
-      size_t ct = vid_vec.size();
-      vid_vec.resize(vid_vec.size() + other.vid_vec.size());
-      for (size_t i = 0; i < other.vid_vec.size(); ++i) {
-        vid_vec[ct + i] = other.vid_vec[i];
-      }
-    }
-    else if (other.v != (graphlab::vertex_id_type)-1) {
-      vid_vec.push_back(other.v);
-    }
-    return *this;
-  }
-  
-  // serialize
-  void save(graphlab::oarchive& oarc) const {
-    oarc << bool(vid_vec.size() == 0);
-    if (vid_vec.size() == 0) oarc << v;
-    else oarc << vid_vec;
-  }
-
-  // deserialize
-  void load(graphlab::iarchive& iarc) {
-    bool novvec;
-    v = (graphlab::vertex_id_type)(-1);
-    vid_vec.clear();
-    iarc >> novvec;
-    if (novvec) iarc >> v;
-    else iarc >> vid_vec;
-  }
-};
+typedef neighbor_set set_union_gather;
 
 /*
  * Define the type of the graph
@@ -450,7 +282,6 @@ public:
   gather_type gather(icontext_type& context,
                      const vertex_type& vertex,
                      edge_type& edge) const {
-    set_union_gather gather;
     graphlab::vertex_id_type otherid = edge.target().id() == vertex.id() ?
                                        edge.source().id() : edge.target().id();
 
@@ -462,9 +293,9 @@ public:
 
     if (PER_VERTEX_COUNT || (other_nbrs > my_nbrs) || (other_nbrs == my_nbrs && otherid > vertex.id())) {
     //if (PER_VERTEX_COUNT || otherid > vertex.id()) {
-     gather.v = otherid;
+      return set_union_gather(otherid);
     } 
-    return gather;
+    return set_union_gather();
   }
 
   /*
@@ -473,17 +304,9 @@ public:
    */
   void apply(icontext_type& context, vertex_type& vertex,
              const gather_type& neighborhood) {
-   do_not_scatter = false;
-   if (neighborhood.vid_vec.size() == 0) {
-     // neighborhood set may be empty or has only 1 element
-     vertex.data().vid_set.clear();
-     if (neighborhood.v != (graphlab::vertex_id_type(-1))) {
-       vertex.data().vid_set.vid_vec.push_back(neighborhood.v);
-     }
-   }
-   else {
-     vertex.data().vid_set.assign(neighborhood.vid_vec);
-   }
+   set_union_gather neighbors(neighborhood);
+   neighbors.normalize();
+   vertex.data().vid_set.assign(neighbors);
    do_not_scatter = vertex.data().vid_set.size() == 0;
   } // end of apply
 
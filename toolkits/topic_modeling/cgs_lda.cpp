@@ -189,6 +189,14 @@ size_t MAX_COUNT = 100;
  */
 float BURNIN = -1;
 
+/**
+ * \brief The seed of the token sampler.  Each edge draws from a
+ * counter based stream keyed by the seed, the edge endpoints and the
+ * number of updates of the scattering vertex, so a run is repeatable
+ * regardless of which thread samples each edge.
+ */
+size_t SEED = 0;
+
 /**
  * \brief The json top word struct contains the current set of top
  * words for each topic encoded in the form of a json string.
@@ -529,6 +537,9 @@ public:
     std::vector<double> prob(NTOPICS);
     assignment_type& assignment = edge.data().assignment;
     edge.data().nchanges = 0;
+    const graphlab::vertex_id_type other_id = get_other_vertex(edge, vertex).id();
+    graphlab::random::counter_rng rng(SEED, vertex.id(), other_id,
+                                      vertex.data().nupdates);
     foreach(topic_id_type& asg, assignment) {
       const topic_id_type old_asg = asg;
       if(asg != NULL_TOPIC) { // construct the cavity
@@ -545,7 +556,7 @@ public:
           std::max(count_type(GLOBAL_TOPIC_COUNT[t]), count_type(0));
         prob[t] = (ALPHA + n_dt) * (BETA + n_wt) / (BETA * NWORDS + n_t);
       }
-      asg = graphlab::random::multinomial(prob);
+      asg = rng.multinomial(prob);
       // asg = std::max_element(prob.begin(), prob.end()) - prob.begin();
       ++doc_topic_count[asg];
       ++word_topic_count[asg];
@@ -1123,6 +1134,8 @@ int main(int argc, char** argv) {
   clopts.attach_option("burnin", BURNIN, 
                        "The time in second to run until a sample is collected. "
                        "If less than zero the sampler runs indefinitely.");
+  clopts.attach_option("seed", SEED,
+                       "The seed of the token sampler.");
   clopts.attach_option("doc_dir", doc_dir,
                        "The output directory to save the final document counts.");
   clopts.attach_option("word_dir", word_dir,